@@ -8,17 +8,56 @@ processes it, and outputs WAV files (will later be replaced with Deepgram stream
 This service is designed to be easily modular for future integration with
 Deepgram or other transcription services.
 
-Protocol:
+Protocol v2 (binary, the bot's default; all integers network byte order):
+- Client sends hello: b"ZBOT", u16 version, u16 flags; server answers with the same
+- Every message: u8 type, u8 flags, u16 stream_id, u32 body length, body
+- Type 1 (stream declare): u32 user_id, u32 sample_rate, u16 channels, u8 format
+  (1 pcm_s16le, 2 opus), u8 reserved, then the UTF-8 user name; sent once per
+  stream and connection
+- Type 2 (audio): u32 sequence, u64 capture time (ms), then raw PCM or one Opus
+  packet (decoded here with libopus through ctypes, if it is installed)
+- Type 3 (dropped): u32 first sequence, u32 count, u8 reason, u8 priority, u16 reserved
+- Type 4 (credit, server to client): u32 bytes
+- Type 5 (ack, server to client): u32 sequence of the first frame not processed yet
+- Type 6 (silence): u32 sequence, u64 capture time (ms), u32 samples per channel;
+  sent in place of audio the bot's voice-activity gate held back (ZOOM_BOT_VAD),
+  written here as that much silence so the file keeps the meeting's timeline
+
+Flow control: a client hello with flag 1 asks for credits. The server sets the
+flag in its answer and follows it with a credit for stream 0xFFFF, the window
+every stream starts with; each stream then gets its bytes back as they are
+processed. The bot holds (and eventually sheds) a stream's audio while it has
+no credit, so a slow stream doesn't hold up the others.
+
+Replay: a client hello with flag 2 asks for acks. The bot keeps every frame
+until it is acknowledged and sends the rest again after a reconnect; frames
+already processed are recognized by sequence number and skipped. Positions
+are kept per (user, rate, channels) across connections, but only restored
+when the hello also has flag 4 (the bot's sequence numbers continue).
+
+JSON compat (bot configured with "host:port?protocol=json"):
 - Each message starts with 4-byte header size (network byte order)
 - Header is JSON with metadata (user_id, user_name, sample_rate, channels, format, timestamp)
 - Then 4-byte audio data size (network byte order)  
 - Then raw PCM audio data
+
+The protocol is detected per connection from its first four bytes.
+
+Local transports (--unix-socket / --shm-socket) carry the same v2 messages
+without credits, acks or resume. Over a SOCK_SEQPACKET socket every packet
+holds complete messages. With the shared-memory ring the bot passes a memfd
+and two eventfds with its hello and writes records into the ring
+(src/shm_ring.h); the socket then only tells that the bot is still there.
 """
 
 import socket
 import json
 import struct
+import array
+import mmap
+import select
 import threading
+import queue
 import wave
 import os
 from pathlib import Path
@@ -26,6 +65,8 @@ from typing import Dict, Optional, BinaryIO
 import logging
 from datetime import datetime
 import argparse
+import ctypes
+import ctypes.util
 
 # Configure logging
 logging.basicConfig(
@@ -34,6 +75,85 @@ logging.basicConfig(
 )
 logger = logging.getLogger('AudioProcessor')
 
+WIRE_MAGIC = b'ZBOT'
+WIRE_VERSION = 2
+WIRE_HELLO = struct.Struct('!4sHH')
+WIRE_PREFIX = struct.Struct('!BBHI')
+WIRE_DECLARE = struct.Struct('!IIHBB')
+WIRE_AUDIO = struct.Struct('!IQ')
+WIRE_DROPPED = struct.Struct('!IIBBH')
+WIRE_CREDIT = struct.Struct('!BBHII')
+WIRE_SILENCE = struct.Struct('!IQI')
+MSG_STREAM_DECLARE = 1
+MSG_AUDIO = 2
+MSG_DROPPED = 3
+MSG_CREDIT = 4
+MSG_ACK = 5
+MSG_SILENCE = 6
+WIRE_ACK = WIRE_CREDIT      # same layout: prefix and one u32
+HELLO_CREDITS = 0x0001
+HELLO_ACKS = 0x0002
+HELLO_RESUME = 0x0004
+ACK_EVERY_FRAMES = 8
+ACK_IDLE_SECONDS = 0.1
+ALL_STREAMS = 0xFFFF
+SHM_RING_MAGIC = b'ZBOTRING'
+SHM_RING_VERSION = 1
+SHM_RING_HEADER = struct.Struct('=8sIIQ')     # host byte order, like everything in the ring
+SHM_RING_POSITION = struct.Struct('=Q')
+SHM_RING_LENGTH = struct.Struct('=I')
+SHM_RING_HEAD_OFFSET = 64
+SHM_RING_TAIL_OFFSET = 128
+SHM_RING_WRAP = 0xFFFFFFFF
+WIRE_FORMATS = {1: 'pcm_s16le', 2: 'opus'}
+DROP_REASONS = {1: 'shed under backpressure', 2: 'server unavailable'}
+STREAM_PRIORITIES = {0: 'mixed', 1: 'active speaker', 2: 'idle participant', 3: 'share/interpreter'}
+
+
+def sequence_before(a: int, b: int) -> bool:
+    """Whether sequence a comes before b, allowing for wraparound"""
+    return ((a - b) & 0xFFFFFFFF) >= 0x80000000
+
+
+class OpusDecoder:
+    """One stream's libopus decoder, called through ctypes so no extra package is needed"""
+    
+    MAX_PACKET_SAMPLES = 5760   # 120 ms at 48 kHz, the longest an Opus packet gets
+    _lib = None
+    
+    @classmethod
+    def available(cls) -> bool:
+        if cls._lib is None:
+            path = ctypes.util.find_library('opus')
+            cls._lib = ctypes.CDLL(path) if path else False
+            if cls._lib:
+                cls._lib.opus_decoder_create.restype = ctypes.c_void_p
+                cls._lib.opus_decoder_create.argtypes = [ctypes.c_int32, ctypes.c_int, ctypes.POINTER(ctypes.c_int)]
+                cls._lib.opus_decode.restype = ctypes.c_int
+                cls._lib.opus_decode.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int32,
+                                                 ctypes.POINTER(ctypes.c_int16), ctypes.c_int, ctypes.c_int]
+                cls._lib.opus_decoder_destroy.argtypes = [ctypes.c_void_p]
+        return bool(cls._lib)
+    
+    def __init__(self, sample_rate: int, channels: int):
+        error = ctypes.c_int(0)
+        self._decoder = self._lib.opus_decoder_create(sample_rate, channels, ctypes.byref(error))
+        if error.value != 0 or not self._decoder:
+            raise RuntimeError(f"opus_decoder_create failed ({error.value})")
+        self.channels = channels
+        self._pcm = (ctypes.c_int16 * (self.MAX_PACKET_SAMPLES * channels))()
+    
+    def decode(self, packet: bytes) -> bytes:
+        samples = self._lib.opus_decode(self._decoder, packet, len(packet), self._pcm, self.MAX_PACKET_SAMPLES, 0)
+        if samples < 0:
+            raise ValueError(f"Opus packet not decodable ({samples})")
+        return ctypes.string_at(self._pcm, samples * self.channels * 2)
+    
+    def close(self):
+        if self._decoder:
+            self._lib.opus_decoder_destroy(self._decoder)
+            self._decoder = None
+
 
 class AudioBuffer:
     """Manages buffered WAV writing for a single participant"""
@@ -89,15 +209,24 @@ class AudioBuffer:
 class AudioProcessor:
     """Main audio processing service"""
     
-    def __init__(self, host: str = "localhost", port: int = 8888, output_dir: str = "processed_audio"):
+    def __init__(self, host: str = "localhost", port: int = 8888, output_dir: str = "processed_audio",
+                 credit_window: int = 256 * 1024, unix_socket: Optional[str] = None,
+                 shm_socket: Optional[str] = None):
         self.host = host
         self.port = port
+        self.credit_window = credit_window
+        self.unix_socket = unix_socket
+        self.shm_socket = shm_socket
+        self.local_sockets = []
         self.output_dir = Path(output_dir)
         self.output_dir.mkdir(exist_ok=True)
         
         self.running = False
         self.server_socket = None
         self.audio_buffers: Dict[int, AudioBuffer] = {}
+        self.stream_positions: Dict[tuple, int] = {}   # (user, rate, channels) -> next sequence to process
+        self.opus_decoders: Dict[tuple, OpusDecoder] = {}   # (user, rate, channels)
+        self.opus_missing_logged = False
         self.client_threads = []
         
         logger.info(f"Audio processor initialized - listening on {host}:{port}")
@@ -107,6 +236,11 @@ class AudioProcessor:
         """Start the audio processing server"""
         self.running = True
         
+        # Bots on this host can also connect over a Unix socket or a shared ring
+        for path, shm in ((self.unix_socket, False), (self.shm_socket, True)):
+            if path:
+                threading.Thread(target=self._serve_local, args=(path, shm), daemon=True).start()
+        
         # Create server socket
         self.server_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
         self.server_socket.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
@@ -147,6 +281,8 @@ class AudioProcessor:
         
         if self.server_socket:
             self.server_socket.close()
+        for listener in self.local_sockets:
+            listener.close()
         
         self._cleanup()
     
@@ -156,52 +292,396 @@ class AudioProcessor:
         for buffer in self.audio_buffers.values():
             buffer.close()
         self.audio_buffers.clear()
+        for decoder in self.opus_decoders.values():
+            decoder.close()
+        self.opus_decoders.clear()
         
         logger.info("✅ Audio processing server stopped")
     
     def _handle_client(self, client_socket: socket.socket, client_address):
         """Handle individual client connection"""
         try:
-            while self.running:
-                # Read header size (4 bytes, network byte order)
-                header_size_data = self._recv_exact(client_socket, 4)
-                if not header_size_data:
-                    break
-                
-                header_size = struct.unpack('!I', header_size_data)[0]
-                
-                # Read header JSON
-                header_data = self._recv_exact(client_socket, header_size)
-                if not header_data:
-                    break
-                
-                try:
-                    header = json.loads(header_data.decode('utf-8'))
-                except json.JSONDecodeError as e:
-                    logger.error(f"Invalid JSON header: {e}")
-                    continue
-                
-                # Read audio data size (4 bytes, network byte order)
-                data_size_data = self._recv_exact(client_socket, 4)
-                if not data_size_data:
-                    break
-                
-                data_size = struct.unpack('!I', data_size_data)[0]
-                
-                # Read audio data
-                audio_data = self._recv_exact(client_socket, data_size)
-                if not audio_data:
-                    break
-                
-                # Process the audio data
-                self._process_audio_chunk(header, audio_data)
-                
+            first = self._recv_exact(client_socket, 4)
+            if not first:
+                return
+            if first == WIRE_MAGIC:
+                self._handle_binary_client(client_socket, client_address, first)
+            else:
+                self._handle_json_client(client_socket, first)
         except Exception as e:
             logger.error(f"Client handler error: {e}")
         finally:
             client_socket.close()
             logger.info(f"📡 Client {client_address} disconnected")
     
+    def _handle_binary_client(self, client_socket: socket.socket, client_address, magic: bytes):
+        """Protocol v2: stream metadata is declared once, frames reference it by id"""
+        rest = self._recv_exact(client_socket, WIRE_HELLO.size - len(magic))
+        if not rest:
+            return
+        _, version, flags = WIRE_HELLO.unpack(magic + rest)
+        credits = bool(flags & HELLO_CREDITS) and self.credit_window > 0 and version == WIRE_VERSION
+        acks = bool(flags & HELLO_ACKS) and version == WIRE_VERSION
+        reply = WIRE_HELLO.pack(WIRE_MAGIC, WIRE_VERSION,
+                                (HELLO_CREDITS if credits else 0) | (HELLO_ACKS if acks else 0))
+        if credits:
+            reply += WIRE_CREDIT.pack(MSG_CREDIT, 0, ALL_STREAMS, 4, self.credit_window)
+        client_socket.sendall(reply)
+        if version != WIRE_VERSION:
+            logger.error(f"Client {client_address} speaks protocol v{version}, expected v{WIRE_VERSION}")
+            return
+        logger.info(f"Client {client_address} using binary protocol v{version}"
+                    + (f", flow control {self.credit_window // 1024} KB per stream" if credits else "")
+                    + (", acknowledged" if acks else ""))
+        
+        session = {
+            'socket': client_socket,
+            'send_lock': threading.Lock(),
+            'credits': credits,
+            'acks': acks,
+            'resume': acks and bool(flags & HELLO_RESUME),
+        }
+        streams: Dict[int, dict] = {}
+        try:
+            self._read_binary_messages(session, streams)
+        finally:
+            self._finish_streams(streams)
+    
+    def _finish_streams(self, streams: Dict[int, dict]):
+        """Let every stream's consumer finish what it was given"""
+        for header in streams.values():
+            if 'queue' in header:
+                header['queue'].put(None)
+        for header in streams.values():
+            if 'consumer' in header:
+                header['consumer'].join()
+    
+    def _serve_local(self, path: str, shm: bool):
+        """Accepts bots configured with "unix:PATH" (or "shm:PATH" for the ring) on a
+        SOCK_SEQPACKET socket"""
+        listener = socket.socket(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+        try:
+            os.unlink(path)     # left over from an earlier run
+        except FileNotFoundError:
+            pass
+        try:
+            listener.bind(path)
+            listener.listen(5)
+        except OSError as e:
+            logger.error(f"Cannot listen on {path}: {e}")
+            return
+        self.local_sockets.append(listener)
+        logger.info(f"🎵 Listening for {'shared-memory' if shm else 'Unix socket'} streams on {path}")
+        while self.running:
+            try:
+                client_socket, _ = listener.accept()
+            except OSError:
+                break
+            client_thread = threading.Thread(
+                target=self._handle_local_client,
+                args=(client_socket, path, shm),
+                daemon=True
+            )
+            client_thread.start()
+            self.client_threads.append(client_thread)
+    
+    def _handle_local_client(self, client_socket: socket.socket, path: str, shm: bool):
+        """Local transports carry the same messages, without credits, acks or resume"""
+        fds = []
+        try:
+            hello, ancdata, _, _ = client_socket.recvmsg(WIRE_HELLO.size, socket.CMSG_LEN(4 * 4))
+            for level, kind, data in ancdata:
+                if level == socket.SOL_SOCKET and kind == socket.SCM_RIGHTS:
+                    fds += list(array.array('i', data[:len(data) - len(data) % 4]))
+            if len(hello) != WIRE_HELLO.size:
+                return
+            magic, version, _ = WIRE_HELLO.unpack(hello)
+            client_socket.sendall(WIRE_HELLO.pack(WIRE_MAGIC, WIRE_VERSION, 0))
+            if magic != WIRE_MAGIC or version != WIRE_VERSION:
+                logger.error(f"Bot on {path} speaks protocol v{version}, expected v{WIRE_VERSION}")
+                return
+            if shm and len(fds) != 3:
+                logger.error(f"Bot on {path} sent no ring")
+                return
+            logger.info(f"📡 Bot connected on {path}")
+            
+            session = {
+                'socket': client_socket,
+                'send_lock': threading.Lock(),
+                'credits': False,
+                'acks': False,
+                'resume': False,
+            }
+            streams: Dict[int, dict] = {}
+            try:
+                if shm:
+                    self._read_ring(session, streams, *fds)
+                else:
+                    # Each packet holds whole messages
+                    while self.running:
+                        packet = client_socket.recv(1 << 20)
+                        if not packet or not self._handle_wire_messages(session, streams, packet):
+                            break
+            finally:
+                self._finish_streams(streams)
+        except Exception as e:
+            logger.error(f"Client handler error: {e}")
+        finally:
+            for fd in fds:
+                os.close(fd)
+            client_socket.close()
+            logger.info(f"📡 Bot on {path} disconnected")
+    
+    def _read_ring(self, session: dict, streams: Dict[int, dict], ring_fd: int, data_fd: int, space_fd: int):
+        """Reads records in place from the bot's ring (layout in src/shm_ring.h). Relies on
+        aligned 8-byte loads and stores of head and tail being atomic and ordered, as on x86-64."""
+        ring = mmap.mmap(ring_fd, os.fstat(ring_fd).st_size)
+        try:
+            magic, version, data_offset, capacity = SHM_RING_HEADER.unpack_from(ring)
+            if magic != SHM_RING_MAGIC or version != SHM_RING_VERSION:
+                logger.error("Unknown ring layout")
+                return
+            data = memoryview(ring)[data_offset:data_offset + capacity]
+            tail, = SHM_RING_POSITION.unpack_from(ring, SHM_RING_TAIL_OFFSET)
+            poller = select.poll()
+            poller.register(data_fd, select.POLLIN)
+            poller.register(session['socket'], select.POLLIN)
+            try:
+                while self.running:
+                    events = dict(poller.poll(500))
+                    if data_fd in events:
+                        try:
+                            os.read(data_fd, 8)
+                        except BlockingIOError:
+                            pass
+                    head, = SHM_RING_POSITION.unpack_from(ring, SHM_RING_HEAD_OFFSET)
+                    if tail != head:
+                        while tail != head:
+                            offset = tail % capacity
+                            length, = SHM_RING_LENGTH.unpack_from(data, offset)
+                            if length == SHM_RING_WRAP:
+                                tail += capacity - offset
+                                continue
+                            self._handle_wire_messages(session, streams, data[offset + 4:offset + 4 + length])
+                            tail += (4 + length + 7) & ~7
+                        SHM_RING_POSITION.pack_into(ring, SHM_RING_TAIL_OFFSET, tail)
+                        os.write(space_fd, struct.pack('=Q', 1))
+                    # The bot never writes to the socket; readable means it closed
+                    if session['socket'].fileno() in events:
+                        break
+            finally:
+                data.release()
+        finally:
+            ring.close()
+    
+    def _read_binary_messages(self, session: dict, streams: Dict[int, dict]):
+        client_socket = session['socket']
+        while self.running:
+            prefix = self._recv_exact(client_socket, WIRE_PREFIX.size)
+            if not prefix:
+                break
+            msg_type, _, stream_id, body_len = WIRE_PREFIX.unpack(prefix)
+            body = self._recv_exact(client_socket, body_len)
+            if body is None:
+                break
+            self._handle_wire_message(session, streams, msg_type, stream_id, body)
+    
+    def _handle_wire_messages(self, session: dict, streams: Dict[int, dict], data) -> bool:
+        """Complete messages back to back, as in a seqpacket packet or a ring record"""
+        offset = 0
+        while offset + WIRE_PREFIX.size <= len(data):
+            msg_type, _, stream_id, body_len = WIRE_PREFIX.unpack_from(data, offset)
+            offset += WIRE_PREFIX.size
+            if offset + body_len > len(data):
+                break
+            self._handle_wire_message(session, streams, msg_type, stream_id, bytes(data[offset:offset + body_len]))
+            offset += body_len
+        if offset != len(data):
+            logger.error(f"Malformed message block ({len(data) - offset} bytes left over)")
+            return False
+        return True
+    
+    def _handle_wire_message(self, session: dict, streams: Dict[int, dict], msg_type: int, stream_id: int,
+                             body: bytes):
+        body_len = len(body)
+        if msg_type == MSG_STREAM_DECLARE:
+            user_id, sample_rate, channels, audio_format, _ = WIRE_DECLARE.unpack_from(body)
+            user_name = body[WIRE_DECLARE.size:].decode('utf-8', errors='replace')
+            previous = streams.get(stream_id)
+            if previous is not None:
+                # A new name for the same stream; its consumer carries on
+                previous['user_name'] = user_name
+                return
+            key = (user_id, sample_rate, channels)
+            position = self.stream_positions.get(key) if session['resume'] else None
+            streams[stream_id] = {
+                'user_id': user_id,
+                'user_name': user_name,
+                'sample_rate': sample_rate,
+                'channels': channels,
+                'format': WIRE_FORMATS.get(audio_format, str(audio_format)),
+                'key': key,
+                'next_sequence': position,
+            }
+            logger.debug(f"Stream {stream_id}: {user_name} (ID: {user_id}) {sample_rate}Hz/{channels}ch")
+            if position is not None:
+                # Tell the bot right away what it no longer needs to replay
+                self._send_control(session, WIRE_ACK.pack(MSG_ACK, 0, stream_id, 4, position))
+        elif msg_type == MSG_AUDIO:
+            header = streams.get(stream_id)
+            if header is None:
+                logger.error(f"Audio for undeclared stream {stream_id}")
+                return
+            sequence, capture_ms = WIRE_AUDIO.unpack_from(body)
+            expected = header['next_sequence']
+            if expected is not None and sequence_before(sequence, expected):
+                # Replayed after a reconnect, and already processed; only its credit counts
+                if session['credits']:
+                    self._stream_queue(session, stream_id, header).put((None, None, body_len - WIRE_AUDIO.size))
+                return
+            if expected is not None and sequence != expected:
+                logger.warning(f"{header['user_name']}: {(sequence - expected) & 0xFFFFFFFF} frames lost "
+                               f"before sequence {sequence}")
+            header['next_sequence'] = (sequence + 1) & 0xFFFFFFFF
+            header['timestamp'] = capture_ms
+            if not session['credits'] and not session['acks']:
+                self._process_audio_chunk(header, body[WIRE_AUDIO.size:])
+                return
+            self._stream_queue(session, stream_id, header).put(
+                (header['next_sequence'], body[WIRE_AUDIO.size:], body_len - WIRE_AUDIO.size))
+        elif msg_type == MSG_SILENCE:
+            header = streams.get(stream_id)
+            if header is None:
+                logger.error(f"Silence for undeclared stream {stream_id}")
+                return
+            sequence, capture_ms, samples = WIRE_SILENCE.unpack_from(body)
+            expected = header['next_sequence']
+            if expected is not None and sequence_before(sequence, expected):
+                return    # replayed, already seen
+            if expected is not None and sequence != expected:
+                logger.warning(f"{header['user_name']}: {(sequence - expected) & 0xFFFFFFFF} frames lost "
+                               f"before sequence {sequence}")
+            header['next_sequence'] = (sequence + 1) & 0xFFFFFFFF
+            header['timestamp'] = capture_ms
+            if not session['credits'] and not session['acks']:
+                self._process_silence(header, samples)
+                return
+            # Costs no credit; acknowledged in order with the audio
+            self._stream_queue(session, stream_id, header).put((header['next_sequence'], samples, 0))
+        elif msg_type == MSG_DROPPED:
+            header = streams.get(stream_id)
+            if header is None:
+                logger.error(f"Drop notice for undeclared stream {stream_id}")
+                return
+            # Intentional gap: skip ahead so it isn't reported as loss
+            first, count, reason, priority, _ = WIRE_DROPPED.unpack_from(body)
+            end = (first + count) & 0xFFFFFFFF
+            expected = header['next_sequence']
+            if expected is not None and not sequence_before(expected, end):
+                return    # replayed, already seen
+            header['next_sequence'] = end
+            if session['credits'] or session['acks']:
+                # Acknowledged in order with the audio
+                self._stream_queue(session, stream_id, header).put((end, None, 0))
+            header['dropped'] = header.get('dropped', 0) + count
+            level = logging.INFO if reason != 1 else logging.DEBUG
+            logger.log(level, f"{header['user_name']}: bot dropped {count} frames from sequence {first} "
+                              f"({DROP_REASONS.get(reason, reason)}, {STREAM_PRIORITIES.get(priority, priority)}; "
+                              f"{header['dropped']} so far)")
+        else:
+            logger.debug(f"Skipping unknown message type {msg_type}")
+
+    def _stream_queue(self, session: dict, stream_id: int, header: dict) -> queue.Queue:
+        """With flow control or acks each stream is processed on its own thread, which hands
+        back credit and acknowledges; the bot never sends more than the window, so the queue
+        stays bounded"""
+        if 'queue' not in header:
+            header['queue'] = queue.Queue()
+            header['consumer'] = threading.Thread(
+                target=self._consume_stream,
+                args=(session, stream_id, header),
+                daemon=True
+            )
+            header['consumer'].start()
+        return header['queue']
+    
+    def _consume_stream(self, session: dict, stream_id: int, header: dict):
+        """Processes one stream's audio, grants its bytes back and acknowledges it in batches.
+        Items are (next sequence or None, PCM or a silent sample count or None, bytes to grant back)."""
+        pending = 0
+        processed = None    # next sequence, once it moved since the last ack
+        unacked = 0
+        while True:
+            try:
+                item = header['queue'].get(timeout=ACK_IDLE_SECONDS if unacked else None)
+            except queue.Empty:
+                item = ()       # idle: acknowledge what there is
+            if item is None:
+                return
+            if item:
+                next_sequence, audio_data, length = item
+                if isinstance(audio_data, int):
+                    self._process_silence(header, audio_data)
+                elif audio_data is not None:
+                    self._process_audio_chunk(header, audio_data)
+                if next_sequence is not None:
+                    processed = next_sequence
+                    unacked += 1
+                    if session['acks']:
+                        self.stream_positions[header['key']] = processed
+                pending += length
+            # A quarter window at a time keeps a stream that is keeping up from ever running dry
+            if session['credits'] and pending >= self.credit_window // 4:
+                self._send_control(session, WIRE_CREDIT.pack(MSG_CREDIT, 0, stream_id, 4, pending))
+                pending = 0
+            if session['acks'] and unacked and (unacked >= ACK_EVERY_FRAMES or not item):
+                self._send_control(session, WIRE_ACK.pack(MSG_ACK, 0, stream_id, 4, processed))
+                unacked = 0
+    
+    def _send_control(self, session: dict, message: bytes):
+        try:
+            with session['send_lock']:
+                session['socket'].sendall(message)
+        except OSError:
+            pass    # the reader notices the connection is gone
+    
+    def _handle_json_client(self, client_socket: socket.socket, header_size_data: bytes):
+        """Original framing: a JSON header and the PCM for every chunk"""
+        while self.running:
+            header_size = struct.unpack('!I', header_size_data)[0]
+            
+            # Read header JSON
+            header_data = self._recv_exact(client_socket, header_size)
+            if not header_data:
+                break
+            
+            try:
+                header = json.loads(header_data.decode('utf-8'))
+            except json.JSONDecodeError as e:
+                logger.error(f"Invalid JSON header: {e}")
+                header = None
+            
+            # Read audio data size (4 bytes, network byte order)
+            data_size_data = self._recv_exact(client_socket, 4)
+            if not data_size_data:
+                break
+            
+            data_size = struct.unpack('!I', data_size_data)[0]
+            
+            # Read audio data
+            audio_data = self._recv_exact(client_socket, data_size)
+            if not audio_data:
+                break
+            
+            # Process the audio data
+            if header is not None:
+                self._process_audio_chunk(header, audio_data)
+            
+            # Read next header size (4 bytes, network byte order)
+            header_size_data = self._recv_exact(client_socket, 4)
+            if not header_size_data:
+                break
+    
     def _recv_exact(self, sock: socket.socket, size: int) -> Optional[bytes]:
         """Receive exactly 'size' bytes from socket"""
         data = b''
@@ -219,6 +699,11 @@ class AudioProcessor:
         sample_rate = header.get('sample_rate', 32000)
         channels = header.get('channels', 1)
         
+        if header.get('format') == 'opus':
+            audio_data = self._decode_opus(user_id, sample_rate, channels, audio_data)
+            if audio_data is None:
+                return
+        
         # Get or create audio buffer for this user
         if user_id not in self.audio_buffers:
             self.audio_buffers[user_id] = AudioBuffer(
@@ -234,6 +719,31 @@ class AudioProcessor:
         if buffer.bytes_written % (sample_rate * channels * 2 * 10) < len(audio_data):  # Every ~10 seconds
             duration = buffer.bytes_written / (sample_rate * channels * 2)
             logger.info(f"📊 {user_name}: {duration:.1f}s recorded ({buffer.bytes_written} bytes)")
+    
+    def _process_silence(self, header: dict, samples: int):
+        """Gated silence: written out as zeros, so the file stays aligned with the meeting"""
+        if samples <= 0:
+            return
+        channels = header.get('channels', 1)
+        self._process_audio_chunk(dict(header, format='pcm_s16le'), bytes(samples * channels * 2))
+    
+    def _decode_opus(self, user_id: int, sample_rate: int, channels: int, packet: bytes) -> Optional[bytes]:
+        """Opus packets back to PCM at the declared rate; one decoder per stream, kept across
+        connections. Gaps are not concealed, as with PCM."""
+        key = (user_id, sample_rate, channels)
+        decoder = self.opus_decoders.get(key)
+        if decoder is None:
+            if not OpusDecoder.available():
+                if not self.opus_missing_logged:
+                    logger.error("Received Opus audio but libopus was not found; install libopus0 to decode it")
+                    self.opus_missing_logged = True
+                return None
+            decoder = self.opus_decoders[key] = OpusDecoder(sample_rate, channels)
+        try:
+            return decoder.decode(packet)
+        except ValueError as e:
+            logger.warning(f"User {user_id}: {e}")
+            return None
 
 
 def main():
@@ -241,6 +751,12 @@ def main():
     parser.add_argument('--host', default='localhost', help='Host to bind to')
     parser.add_argument('--port', type=int, default=8888, help='Port to bind to')
     parser.add_argument('--output-dir', default='processed_audio', help='Output directory for WAV files')
+    parser.add_argument('--credit-window', type=int, default=256,
+                        help='Per-stream flow control window in KB (0 disables flow control)')
+    parser.add_argument('--unix-socket', metavar='PATH',
+                        help='Also accept bots on this Unix socket (endpoint "unix:PATH")')
+    parser.add_argument('--shm-socket', metavar='PATH',
+                        help='Also accept shared-memory ring streams on this Unix socket (endpoint "shm:PATH")')
     parser.add_argument('--verbose', '-v', action='store_true', help='Verbose logging')
     
     args = parser.parse_args()
@@ -248,7 +764,8 @@ def main():
     if args.verbose:
         logging.getLogger().setLevel(logging.DEBUG)
     
-    processor = AudioProcessor(args.host, args.port, args.output_dir)
+    processor = AudioProcessor(args.host, args.port, args.output_dir, args.credit_window * 1024,
+                               args.unix_socket, args.shm_socket)
     
     try:
         processor.start()
@@ -0,0 +1,43 @@
+#include "alloc_counter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef ZOOMBOT_COUNT_ALLOCATIONS
+
+static std::atomic<uint64_t> g_allocations{0};
+
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace ZoomBot {
+namespace AllocCounter {
+    bool enabled() { return true; }
+    uint64_t allocations() { return g_allocations.load(std::memory_order_relaxed); }
+}
+}
+
+#else
+
+namespace ZoomBot {
+namespace AllocCounter {
+    bool enabled() { return false; }
+    uint64_t allocations() { return 0; }
+}
+}
+
+#endif
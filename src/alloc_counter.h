@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+namespace ZoomBot {
+
+/**
+ * Global heap allocation counter for allocation-free path checks.
+ *
+ * Only active when alloc_counter.cpp is built with ZOOMBOT_COUNT_ALLOCATIONS,
+ * which replaces the global operator new/delete. Regular targets don't link it.
+ */
+namespace AllocCounter {
+    bool enabled();
+    uint64_t allocations();
+}
+
+} // namespace ZoomBot
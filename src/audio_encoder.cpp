@@ -0,0 +1,334 @@
+#include "audio_encoder.h"
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#ifdef ZOOMBOT_HAVE_OPUS
+#include <opus.h>
+#endif
+
+namespace ZoomBot {
+
+// make_unique forwards it by reference
+const size_t OpusEncodePool::kQueueFrames;
+
+OpusEncodePool::OpusEncodePool(size_t threads, const OpusSettings& settings, Output output, const std::string& tag)
+    : settings_(settings), output_(std::move(output)), tag_(tag) {
+    for (size_t i = 0; i < std::max<size_t>(1, threads); ++i) {
+        auto worker = std::make_unique<Worker>(kQueueFrames);
+        worker->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (worker->wake_fd < 0) {
+            std::cerr << tag_ << " Failed to create eventfd: " << strerror(errno) << std::endl;
+        }
+        worker->packet.resize(kMaxPacketBytes);
+        workers_.push_back(std::move(worker));
+    }
+}
+
+OpusEncodePool::~OpusEncodePool() {
+    stop();
+    for (auto& worker : workers_) {
+#ifdef ZOOMBOT_HAVE_OPUS
+        for (auto& entry : worker->streams) {
+            if (entry.second.encoder) {
+                opus_encoder_destroy(entry.second.encoder);
+            }
+        }
+#endif
+        if (worker->wake_fd != -1) {
+            close(worker->wake_fd);
+        }
+    }
+}
+
+bool OpusEncodePool::available() {
+#ifdef ZOOMBOT_HAVE_OPUS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void OpusEncodePool::start() {
+    if (running_.exchange(true)) {
+        return;
+    }
+    for (auto& worker : workers_) {
+        worker->thread = std::thread(&OpusEncodePool::workerLoop, this, std::ref(*worker));
+    }
+    std::cout << tag_ << " ✓ Encoding Opus on " << workers_.size() << " threads (" << settings_.bitrate / 1000
+              << " kbit/s per channel, " << settings_.frame_ms << " ms packets)" << std::endl;
+}
+
+void OpusEncodePool::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    for (auto& worker : workers_) {
+        uint64_t one = 1;
+        ssize_t written = write(worker->wake_fd, &one, sizeof(one));
+        (void)written;
+    }
+    uint64_t frames = 0, bytes_in = 0, packets = 0, bytes_out = 0;
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+        frames += worker->frames_in;
+        bytes_in += worker->bytes_in;
+        packets += worker->packets_out;
+        bytes_out += worker->bytes_out;
+    }
+    if (packets > 0) {
+        std::cout << tag_ << " Encoded " << frames << " frames into " << packets << " Opus packets ("
+                  << bytes_in / 1024 << " KB of PCM to " << bytes_out / 1024 << " KB)" << std::endl;
+    }
+}
+
+bool OpusEncodePool::submit(AudioChunk&& chunk) {
+    // Fibonacci hash, as for shards: a stream always goes to the same thread
+    uint64_t hash = (static_cast<uint64_t>(chunk.user_id) * 0x9E3779B97F4A7C15ull) >> 32;
+    Worker& worker = *workers_[static_cast<size_t>((hash * workers_.size()) >> 32)];
+    if (!worker.queue.tryPush(std::move(chunk))) {
+        return false;
+    }
+    // Pairs with the fence in workerLoop: either it sees the chunk, or we see it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (worker.sleeping.load(std::memory_order_relaxed) && worker.sleeping.exchange(false)) {
+        uint64_t one = 1;
+        ssize_t written = write(worker.wake_fd, &one, sizeof(one));
+        (void)written;   // EAGAIN only if the counter is already huge, so the thread is awake anyway
+    }
+    return true;
+}
+
+uint64_t OpusEncodePool::queueOverflows() const {
+    uint64_t overflows = 0;
+    for (const auto& worker : workers_) {
+        overflows += worker->queue.overflowCount();
+    }
+    return overflows;
+}
+
+void OpusEncodePool::workerLoop(Worker& worker) {
+    AudioChunk chunk;
+    for (;;) {
+        while (worker.queue.tryPop(chunk)) {
+            encode(worker, chunk);
+            chunk.frame.reset();
+            chunk.user_name.reset();
+        }
+        if (!running_.load()) {
+            break;
+        }
+        worker.sleeping.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (worker.queue.empty()) {
+            struct pollfd pfd{worker.wake_fd, POLLIN, 0};
+            poll(&pfd, 1, 250);
+            uint64_t value;
+            ssize_t n = read(worker.wake_fd, &value, sizeof(value));
+            (void)n;
+        }
+        worker.sleeping.store(false);
+    }
+
+    // Whatever was submitted before stop: the last partial packets, padded with silence
+    while (worker.queue.tryPop(chunk)) {
+        encode(worker, chunk);
+    }
+    for (auto& entry : worker.streams) {
+        Stream& stream = entry.second;
+        if (stream.encoder && stream.filled > 0) {
+            std::fill(stream.pcm.begin() + stream.filled * stream.channels, stream.pcm.end(), 0);
+            stream.filled = stream.packet_samples;
+            emitPacket(worker, stream);
+        }
+    }
+}
+
+OpusEncodePool::Stream* OpusEncodePool::streamFor(Worker& worker, const AudioChunk& chunk) {
+    const AudioFrame& frame = *chunk.frame;
+    FormatKey key{chunk.user_id, frame.sampleRate, frame.channels, frame.format};
+    auto it = worker.streams.find(key);
+    if (it != worker.streams.end()) {
+        return it->second.encoder ? &it->second : nullptr;
+    }
+
+    // Created once per stream; a stream that can't be encoded stays in the table without an encoder
+    Stream& stream = worker.streams[key];
+    stream.user_id = chunk.user_id;
+    stream.input_rate = frame.sampleRate;
+    stream.channels = frame.channels;
+    switch (frame.sampleRate) {
+        case 8000: case 12000: case 16000: case 24000: case 48000:
+            stream.rate = frame.sampleRate;
+            break;
+        default:
+            stream.rate = 48000;
+    }
+    if (frame.channels < 1 || frame.channels > 2 || frame.sampleRate == 0) {
+        std::cerr << tag_ << " Can't encode " << frame.channels << " channels at " << frame.sampleRate
+                  << " Hz for user " << chunk.user_id << ", dropping its audio" << std::endl;
+        return nullptr;
+    }
+#ifdef ZOOMBOT_HAVE_OPUS
+    int error = OPUS_OK;
+    stream.encoder = opus_encoder_create(static_cast<opus_int32>(stream.rate), stream.channels,
+                                         OPUS_APPLICATION_VOIP, &error);
+    if (error != OPUS_OK || !stream.encoder) {
+        std::cerr << tag_ << " Opus encoder for user " << chunk.user_id << " failed: " << opus_strerror(error)
+                  << std::endl;
+        stream.encoder = nullptr;
+        return nullptr;
+    }
+    opus_encoder_ctl(stream.encoder, OPUS_SET_BITRATE(settings_.bitrate * stream.channels));
+    opus_encoder_ctl(stream.encoder, OPUS_SET_COMPLEXITY(settings_.complexity));
+    opus_encoder_ctl(stream.encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+#else
+    return nullptr;
+#endif
+    stream.packet_samples = stream.rate * static_cast<uint32_t>(settings_.frame_ms) / 1000;
+    stream.pcm.assign(stream.packet_samples * stream.channels, 0);
+    stream.last.assign(stream.channels, 0);
+    return &stream;
+}
+
+void OpusEncodePool::encode(Worker& worker, const AudioChunk& chunk) {
+    Stream* found = streamFor(worker, chunk);
+    if (!found) {
+        return;
+    }
+    Stream& stream = *found;
+    stream.user_name = chunk.user_name;
+    stream.priority = chunk.priority;
+    if (chunk.frame->silentSamples > 0) {
+        silence(worker, stream, *chunk.frame);
+        return;
+    }
+    worker.frames_in++;
+    worker.bytes_in += chunk.frame->size();
+
+    const int16_t* samples = reinterpret_cast<const int16_t*>(chunk.frame->data());
+    size_t count = chunk.frame->size() / (sizeof(int16_t) * stream.channels);
+    if (count == 0) {
+        return;
+    }
+    if (stream.input_rate == stream.rate) {
+        append(worker, stream, samples, count, chunk.frame->captureTimeMs);
+        return;
+    }
+
+    // Linear interpolation between input samples; output k sits at input k * input_rate / rate,
+    // and position 0 is the last sample of the previous frame
+    uint64_t end = static_cast<uint64_t>(count) * stream.rate;
+    int16_t out[2];
+    while (stream.position < end) {
+        size_t index = static_cast<size_t>(stream.position / stream.rate);
+        int64_t fraction = static_cast<int64_t>(stream.position % stream.rate);
+        for (uint16_t c = 0; c < stream.channels; ++c) {
+            int64_t a = index == 0 ? stream.last[c] : samples[(index - 1) * stream.channels + c];
+            int64_t b = samples[index * stream.channels + c];
+            out[c] = static_cast<int16_t>(a + (b - a) * fraction / static_cast<int64_t>(stream.rate));
+        }
+        append(worker, stream, out, 1,
+               chunk.frame->captureTimeMs + static_cast<int64_t>(index) * 1000 / stream.input_rate);
+        stream.position += stream.input_rate;
+    }
+    stream.position -= end;
+    for (uint16_t c = 0; c < stream.channels; ++c) {
+        stream.last[c] = samples[(count - 1) * stream.channels + c];
+    }
+}
+
+void OpusEncodePool::append(Worker& worker, Stream& stream, const int16_t* samples, size_t count, int64_t capture_ms) {
+    while (count > 0) {
+        if (stream.filled == 0) {
+            stream.first_capture_ms = capture_ms;
+        }
+        size_t take = std::min(count, stream.packet_samples - stream.filled);
+        memcpy(stream.pcm.data() + stream.filled * stream.channels, samples, take * stream.channels * sizeof(int16_t));
+        stream.filled += take;
+        samples += take * stream.channels;
+        count -= take;
+        capture_ms += static_cast<int64_t>(take) * 1000 / stream.rate;
+        if (stream.filled == stream.packet_samples) {
+            emitPacket(worker, stream);
+        }
+    }
+}
+
+void OpusEncodePool::silence(Worker& worker, Stream& stream, const AudioFrame& marker) {
+    uint64_t samples = static_cast<uint64_t>(marker.silentSamples) * stream.rate / stream.input_rate;
+    int64_t capture_ms = marker.captureTimeMs;
+    if (stream.filled > 0) {
+        // The packet being collected ends in (some of) the silence, so the timeline stays exact
+        size_t take = static_cast<size_t>(std::min<uint64_t>(samples, stream.packet_samples - stream.filled));
+        std::fill(stream.pcm.begin() + stream.filled * stream.channels,
+                  stream.pcm.begin() + (stream.filled + take) * stream.channels, 0);
+        stream.filled += take;
+        samples -= take;
+        capture_ms += static_cast<int64_t>(take) * 1000 / stream.rate;
+        if (stream.filled == stream.packet_samples) {
+            emitPacket(worker, stream);
+        }
+    }
+    // The resampler starts over after the gap
+    stream.position = 0;
+    std::fill(stream.last.begin(), stream.last.end(), 0);
+    if (samples == 0) {
+        return;
+    }
+
+    AudioFrameRef frame = AudioFramePool::instance().acquire();
+    frame->sampleRate = stream.rate;
+    frame->channels = stream.channels;
+    frame->format = AudioFormat::Opus;
+    frame->captureTimeMs = capture_ms;
+    frame->silentSamples = static_cast<uint32_t>(samples);
+
+    AudioChunk chunk;
+    chunk.user_id = stream.user_id;
+    chunk.priority = stream.priority;
+    chunk.user_name = stream.user_name;
+    chunk.frame = std::move(frame);
+    output_(std::move(chunk));
+}
+
+void OpusEncodePool::emitPacket(Worker& worker, Stream& stream) {
+    stream.filled = 0;
+#ifdef ZOOMBOT_HAVE_OPUS
+    opus_int32 length = opus_encode(stream.encoder, stream.pcm.data(), static_cast<int>(stream.packet_samples),
+                                    worker.packet.data(), static_cast<opus_int32>(worker.packet.size()));
+    if (length < 0) {
+        std::cerr << tag_ << " Opus encoding failed for user " << stream.user_id << ": " << opus_strerror(length)
+                  << std::endl;
+        return;
+    }
+
+    // Pooled frames keep their storage, so this doesn't allocate once the pool is warm
+    AudioFrameRef frame = AudioFramePool::instance().acquire();
+    frame->assign(reinterpret_cast<const char*>(worker.packet.data()), static_cast<size_t>(length));
+    frame->sampleRate = stream.rate;
+    frame->channels = stream.channels;
+    frame->format = AudioFormat::Opus;
+    frame->captureTimeMs = stream.first_capture_ms;
+    worker.packets_out++;
+    worker.bytes_out += static_cast<uint64_t>(length);
+
+    AudioChunk chunk;
+    chunk.user_id = stream.user_id;
+    chunk.priority = stream.priority;
+    chunk.user_name = stream.user_name;
+    chunk.frame = std::move(frame);
+    output_(std::move(chunk));
+#else
+    (void)worker;
+#endif
+}
+
+} // namespace ZoomBot
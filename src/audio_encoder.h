@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+#include "audio_streamer.h"
+#include "mpsc_queue.h"
+
+struct OpusEncoder;
+
+namespace ZoomBot {
+
+struct OpusSettings {
+    int bitrate = 24000;    // bits/s per channel
+    int frame_ms = 20;      // packet duration: 10, 20, 40 or 60
+    int complexity = 5;     // 0-10, encoder CPU against quality
+};
+
+/**
+ * Optional Opus encode stage in front of an AudioStreamer's queue (codec=opus).
+ *
+ * Every stream (participant and capture format) gets its own encoder, owned by
+ * one of a few encoder threads picked by user id, so a stream is encoded in
+ * order on one thread and encoder state is never shared. Captured frames are
+ * collected until a packet's worth (frame_ms) is there, resampled to 48 kHz
+ * when Opus doesn't take the capture rate (32 kHz, 44.1 kHz), and each packet
+ * goes on to output as a frame of its own (format Opus, the encoded rate), with
+ * the capture time of its first sample. A silence marker (voice_activity.h)
+ * fills up the packet being collected and passes on as a marker for the rest,
+ * counted at the encoded rate.
+ *
+ * Submitting never blocks: each thread has a bounded lock-free queue and the
+ * newest frame is dropped when it is full. Only built with libopus
+ * (ZOOMBOT_HAVE_OPUS); otherwise available() is false.
+ */
+class OpusEncodePool {
+public:
+    // Takes an encoded chunk, on an encoder thread
+    using Output = std::function<bool(AudioChunk&& chunk)>;
+
+    OpusEncodePool(size_t threads, const OpusSettings& settings, Output output, const std::string& tag);
+    ~OpusEncodePool();
+
+    OpusEncodePool(const OpusEncodePool&) = delete;
+    OpusEncodePool& operator=(const OpusEncodePool&) = delete;
+
+    static bool available();
+
+    void start();
+    // Capture threads; false if the stream's encoder thread is behind and the frame was dropped
+    bool submit(AudioChunk&& chunk);
+    // Encodes everything queued, pads partly filled packets with silence, and joins the threads
+    void stop();
+
+    uint64_t queueOverflows() const;
+
+private:
+    struct Stream {
+        ::OpusEncoder* encoder = nullptr;
+        uint32_t rate = 0;                  // encoded
+        uint16_t channels = 0;
+        size_t packet_samples = 0;          // per channel
+        std::vector<int16_t> pcm;           // one packet, interleaved
+        size_t filled = 0;                  // samples per channel in pcm
+        int64_t first_capture_ms = 0;       // of pcm[0]
+        // Linear resampler from the capture rate; position counts 1/rate steps from last
+        uint32_t input_rate = 0;
+        uint64_t position = 0;
+        std::vector<int16_t> last;          // previous input sample per channel
+        uint32_t user_id = 0;
+        SharedName user_name;
+        StreamPriority priority = StreamPriority::Idle;
+    };
+
+    struct Worker {
+        explicit Worker(size_t capacity) : queue(capacity) {}
+        MPSCQueue<AudioChunk> queue;
+        int wake_fd = -1;
+        std::atomic<bool> sleeping{false};
+        std::thread thread;
+        std::unordered_map<FormatKey, Stream, FormatKeyHash> streams;   // worker only
+        std::vector<unsigned char> packet;
+        uint64_t frames_in = 0;
+        uint64_t bytes_in = 0;
+        uint64_t packets_out = 0;
+        uint64_t bytes_out = 0;
+    };
+
+    static const size_t kQueueFrames = 2048;
+    static const size_t kMaxPacketBytes = 4000;
+
+    OpusSettings settings_;
+    Output output_;
+    std::string tag_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<bool> running_{false};
+
+    void workerLoop(Worker& worker);
+    void encode(Worker& worker, const AudioChunk& chunk);
+    Stream* streamFor(Worker& worker, const AudioChunk& chunk);
+    void append(Worker& worker, Stream& stream, const int16_t* samples, size_t count, int64_t capture_ms);
+    void emitPacket(Worker& worker, Stream& stream);
+    void silence(Worker& worker, Stream& stream, const AudioFrame& marker);
+};
+
+} // namespace ZoomBot
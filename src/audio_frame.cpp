@@ -0,0 +1,133 @@
+#include "audio_frame.h"
+
+namespace ZoomBot {
+
+// ---------------- AudioFrame ----------------
+void AudioFrame::attach(const char* data, size_t size, ReleaseFn release, void* context) {
+    data_ = data;
+    size_ = size;
+    release_ = release;
+    releaseContext_ = context;
+}
+
+void AudioFrame::assign(const char* data, size_t size) {
+    storage_.assign(data, data + size);
+    data_ = storage_.data();
+    size_ = size;
+    release_ = nullptr;
+    releaseContext_ = nullptr;
+}
+
+void AudioFrame::reset() {
+    if (release_) {
+        release_(releaseContext_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    release_ = nullptr;
+    releaseContext_ = nullptr;
+    sampleRate = 0;
+    channels = 0;
+    format = AudioFormat::PcmS16LE;
+    captureTimeMs = 0;
+    silentSamples = 0;
+}
+
+// ---------------- AudioFrameRef ----------------
+void AudioFrameRef::reset() {
+    if (!frame_) return;
+    if (frame_->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        AudioFramePool::instance().recycle(frame_);
+    }
+    frame_ = nullptr;
+}
+
+// ---------------- AudioFramePool ----------------
+AudioFramePool& AudioFramePool::instance() {
+    static AudioFramePool pool;
+    return pool;
+}
+
+AudioFramePool::AudioFramePool() {}
+
+AudioFramePool::~AudioFramePool() {
+    while (AudioFrame* frame = pop()) {
+        delete frame;
+    }
+}
+
+AudioFrameRef AudioFramePool::acquire() {
+    AudioFrame* frame = pop();
+    if (!frame) {
+        frame = create();
+    }
+    return AudioFrameRef(frame);
+}
+
+void AudioFramePool::reserve(size_t count) {
+    while (freeCount() < count) {
+        AudioFrame* frame = create();
+        if (frame->poolSlot_ == kNoSlot) {
+            // Every slot is taken
+            delete frame;
+            return;
+        }
+        push(frame);
+    }
+}
+
+void AudioFramePool::recycle(AudioFrame* frame) {
+    // Hand the buffer back to its owner before the frame is reused
+    frame->reset();
+    
+    if (frame->poolSlot_ != kNoSlot) {
+        push(frame);
+        return;
+    }
+    delete frame;
+}
+
+size_t AudioFramePool::freeCount() const {
+    return free_.load(std::memory_order_relaxed);
+}
+
+// Allocates a frame and gives it a slot if one is left
+AudioFrame* AudioFramePool::create() {
+    auto* frame = new AudioFrame();
+    allocated_.fetch_add(1, std::memory_order_relaxed);
+    uint32_t slot = slotsUsed_.load(std::memory_order_relaxed);
+    while (slot < kMaxFree && !slotsUsed_.compare_exchange_weak(slot, slot + 1, std::memory_order_relaxed)) {}
+    if (slot < kMaxFree) {
+        slots_[slot] = frame;
+        frame->poolSlot_ = slot;
+    }
+    return frame;
+}
+
+void AudioFramePool::push(AudioFrame* frame) {
+    const uint64_t top = frame->poolSlot_ + 1;
+    // Counted first, so freeCount() may run ahead of the stack but never behind it
+    free_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    do {
+        next_[frame->poolSlot_].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+    } while (!head_.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | top,
+                                          std::memory_order_release, std::memory_order_relaxed));
+}
+
+AudioFrame* AudioFramePool::pop() {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    while (true) {
+        uint32_t top = static_cast<uint32_t>(head);
+        if (top == 0) return nullptr;
+        // May be stale if another thread got there first; the tag makes the exchange fail then
+        uint32_t next = next_[top - 1].load(std::memory_order_relaxed);
+        if (head_.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | next,
+                                        std::memory_order_acquire, std::memory_order_acquire)) {
+            free_.fetch_sub(1, std::memory_order_relaxed);
+            return slots_[top - 1];
+        }
+    }
+}
+
+} // namespace ZoomBot
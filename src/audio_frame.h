@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+namespace ZoomBot {
+
+class AudioFrameRef;
+
+// Encoding of a frame's data; the values are the wire protocol's format codes
+enum class AudioFormat : uint8_t {
+    PcmS16LE = 1,
+    Opus = 2        // one Opus packet
+};
+
+/**
+ * One audio frame shared between the disk writer and the streamer.
+ *
+ * A frame either borrows a buffer owned elsewhere (the SDK's AudioRawData,
+ * retained with AddRef) or, as a fallback, holds its own copy. The release
+ * hook runs when the last AudioFrameRef goes away; the frame object itself
+ * then goes back to the pool. A frame without data may stand for a run of
+ * gated silence instead (silentSamples).
+ */
+class AudioFrame {
+public:
+    using ReleaseFn = void (*)(void* context);
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // Borrow an external buffer; release(context) runs once all references are gone
+    void attach(const char* data, size_t size, ReleaseFn release, void* context);
+    // Copy into frame-owned storage (capacity is kept when the frame is reused)
+    void assign(const char* data, size_t size);
+
+    uint32_t sampleRate = 0;
+    uint16_t channels = 0;
+    AudioFormat format = AudioFormat::PcmS16LE;
+    int64_t captureTimeMs = 0;   // wall clock at the SDK callback
+    // Silence marker (voice_activity.h): no data, the stream was gated for this
+    // many samples per channel from captureTimeMs on
+    uint32_t silentSamples = 0;
+
+private:
+    friend class AudioFrameRef;
+    friend class AudioFramePool;
+
+    void reset();
+
+    std::atomic<uint32_t> refs_{0};
+    uint32_t poolSlot_ = ~0u;   // the pool's slot for it, ~0u if it has none
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    ReleaseFn release_ = nullptr;
+    void* releaseContext_ = nullptr;
+    std::vector<char> storage_;
+};
+
+// One participant's audio in one format, for the maps that keep such streams apart
+struct FormatKey {
+    uint32_t userId;
+    uint32_t sampleRate;
+    uint16_t channels;
+    AudioFormat format;
+
+    bool operator==(const FormatKey& other) const {
+        return userId == other.userId && sampleRate == other.sampleRate && channels == other.channels &&
+               format == other.format;
+    }
+};
+
+// Keys compare in full, so formats that hash alike still get streams of their own
+struct FormatKeyHash {
+    size_t operator()(const FormatKey& key) const {
+        uint64_t format = (static_cast<uint64_t>(key.channels) << 8) | static_cast<uint8_t>(key.format);
+        return std::hash<uint64_t>()(((static_cast<uint64_t>(key.userId) << 32) | key.sampleRate) * 31 + format);
+    }
+};
+
+// Intrusive reference to a pooled AudioFrame
+class AudioFrameRef {
+public:
+    AudioFrameRef() = default;
+    AudioFrameRef(const AudioFrameRef& other) : frame_(other.frame_) { retain(); }
+    AudioFrameRef(AudioFrameRef&& other) noexcept : frame_(other.frame_) { other.frame_ = nullptr; }
+    ~AudioFrameRef() { reset(); }
+
+    AudioFrameRef& operator=(const AudioFrameRef& other) {
+        if (this != &other) {
+            reset();
+            frame_ = other.frame_;
+            retain();
+        }
+        return *this;
+    }
+    AudioFrameRef& operator=(AudioFrameRef&& other) noexcept {
+        if (this != &other) {
+            reset();
+            frame_ = other.frame_;
+            other.frame_ = nullptr;
+        }
+        return *this;
+    }
+
+    AudioFrame* get() const { return frame_; }
+    AudioFrame* operator->() const { return frame_; }
+    AudioFrame& operator*() const { return *frame_; }
+    explicit operator bool() const { return frame_ != nullptr; }
+
+    void reset();
+
+private:
+    friend class AudioFramePool;
+    explicit AudioFrameRef(AudioFrame* frame) : frame_(frame) { retain(); }
+
+    void retain() {
+        if (frame_) frame_->refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    AudioFrame* frame_ = nullptr;
+};
+
+/**
+ * Process-wide free list of AudioFrame objects, so steady-state capture does
+ * not allocate. Frames come back here when their last reference is dropped.
+ *
+ * The list is a lock-free stack: acquire() runs on the SDK callback and must
+ * not wait on the threads recycling frames (disk writer, streamer workers).
+ */
+class AudioFramePool {
+public:
+    static AudioFramePool& instance();
+
+    AudioFrameRef acquire();
+    // Pre-allocate frames so the pool never has to grow on the capture path
+    void reserve(size_t count);
+
+    size_t freeCount() const;
+    uint64_t allocatedCount() const { return allocated_.load(std::memory_order_relaxed); }
+
+private:
+    friend class AudioFrameRef;
+
+    AudioFramePool();
+    ~AudioFramePool();
+
+    void recycle(AudioFrame* frame);
+    AudioFrame* create();
+    void push(AudioFrame* frame);
+    AudioFrame* pop();
+
+    static const size_t kMaxFree = 4096;
+    static const uint32_t kNoSlot = ~0u;
+
+    // The first kMaxFree frames get a fixed slot and are pooled; later ones are
+    // deleted when released. The head packs the top slot + 1 (0 when empty) with
+    // a tag bumped on every change, so a pop can't succeed against a head that was
+    // popped and pushed back in between (ABA).
+    AudioFrame* slots_[kMaxFree] = {};
+    std::atomic<uint32_t> next_[kMaxFree];   // slot + 1 below each free slot
+    std::atomic<uint64_t> head_{0};
+    std::atomic<uint32_t> slotsUsed_{0};
+    std::atomic<size_t> free_{0};
+    std::atomic<uint64_t> allocated_{0};
+};
+
+} // namespace ZoomBot
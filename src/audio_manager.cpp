@@ -1,4 +1,5 @@
 #include "audio_manager.h"
+#include "config.h"
 #include "meeting_service_components/meeting_audio_interface.h"
 #include <iostream>
 #include <thread>
@@ -42,7 +43,7 @@ AudioManager::AudioSetupResult AudioManager::setupAudioCapture(ZOOM_SDK_NAMESPAC
 
         // Enable streaming
         std::cout << "[AUDIO] Enabling streaming..." << std::endl;
-        result.streamingEnabled = audioHandler.enableStreaming("tcp", "localhost:8888");
+        result.streamingEnabled = audioHandler.enableStreaming("tcp", Config::getStreamEndpoint());
         if (result.streamingEnabled) {
             std::cout << "[AUDIO] ✓ Streaming enabled" << std::endl;
         } else {
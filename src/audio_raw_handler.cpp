@@ -5,22 +5,36 @@
 #include <cstring>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <ctime>
-#include <cctype>
 #include <thread>
-#include <dirent.h>
 #include <chrono>
 
 namespace ZoomBot {
 
-// ---------------- PCMFile ----------------
-PCMFile::PCMFile(const std::string& path) : ofs_(path, std::ios::binary | std::ios::out | std::ios::app) {}
-PCMFile::~PCMFile() { if (ofs_.is_open()) ofs_.close(); }
-bool PCMFile::good() const { return ofs_.good(); }
-void PCMFile::write(const char* data, size_t len) { ofs_.write(data, static_cast<std::streamsize>(len)); }
-void PCMFile::flush() { ofs_.flush(); }
-
 // --------------- AudioRawHandler ---------------
+// ~2.5 s of 10 ms frames per stream before the capture stage starts dropping
+static const size_t kCaptureRingDepth = 256;
+// Upper bound on how long a frame waits in a ring if a wakeup is missed
+static const std::chrono::milliseconds kCaptureDrainInterval(10);
+// Frames in flight for a typical meeting (rings plus streamer queue) before the pool grows
+static const size_t kFramePoolPrealloc = 2048;
+// A participant counts as an active speaker for this long after their last loud frame
+static const int64_t kSpeakerHangoverMs = 1500;
+// Peak level that counts as speech for stream priorities, about -30 dBFS
+static const int kSpeechPeak = 1000;
+
+// Cheap presence check, only used to pick a stream's streaming priority
+static bool hasSpeech(const AudioFrame& frame) {
+    const char* data = frame.data();
+    for (size_t i = 0; i + 1 < frame.size(); i += 2) {
+        int16_t sample;
+        memcpy(&sample, data + i, sizeof(sample));
+        if (sample > kSpeechPeak || sample < -kSpeechPeak) return true;
+    }
+    return false;
+}
+
 static std::string timestampForFile() {
     std::time_t t = std::time(nullptr);
     std::tm tm{};
@@ -38,42 +52,45 @@ bool AudioRawHandler::ensureDir(const std::string& path) {
     return mkdir(path.c_str(), 0755) == 0;
 }
 
-std::string AudioRawHandler::sanitize(const std::string& s) {
-    std::string out;
-    out.reserve(s.size());
-    for (char c : s) {
-        if (std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' ) out.push_back(c);
-        else out.push_back('_');
-    }
-    return out;
-}
-
-static std::string buildUserFilenameInDir(const std::string& dir, uint32_t user_id, unsigned int sampleRate, unsigned int channels) {
-    std::ostringstream oss;
-    oss << dir << "/user_" << user_id
-        << "_" << sampleRate << "Hz_" << channels << "ch.pcm";
-    return oss.str();
-}
-
 static std::string buildMixedFilenameInDir(const std::string& dir, unsigned int sampleRate, unsigned int channels) {
     std::ostringstream oss;
     oss << dir << "/mixed_" << sampleRate
-        << "Hz_" << channels << "ch.pcm";
+        << "Hz_" << channels << "ch";
     return oss.str();
 }
 
-AudioRawHandler::AudioRawHandler() {
+AudioRawHandler::AudioRawHandler(const DiskWriterConfig& diskConfig, const VoiceActivityConfig& vad)
+    : disk_(diskConfig), vad_(vad), streams_(kCaptureRingDepth) {
     outDir_ = "recordings/" + timestampForFile();
     ensureDir("recordings");
     ensureDir(outDir_);
+    if (diskConfig.segmentSeconds > 0 || diskConfig.segmentBytes > 0) {
+        manifest_.reset(new SegmentManifest(disk_, outDir_ + "/manifest.jsonl"));
+    }
+    if (diskConfig.format == RecordingFormat::Flac) {
+        flac_.reset(new FlacEncodePool(diskConfig.encoderThreads));
+    }
+    if (vad_.enabled) {
+        silence_.reset(new SilenceLog(disk_, outDir_ + "/silence.jsonl"));
+        std::cout << "[AUDIO] Voice-activity gate on participant streams (" << frameAnalyzerName() << ", "
+                  << vad_.marginDb << " dB over the noise floor, " << vad_.hangoverMs << " ms hangover, "
+                  << vad_.prerollMs << " ms pre-roll)" << std::endl;
+    }
+    AudioFramePool::instance().reserve(kFramePoolPrealloc);
     
     // Initialize streaming system
     streamer_ = std::make_unique<AudioStreamer>();
 }
 
 AudioRawHandler::~AudioRawHandler() {
-    disableStreaming();
     unsubscribe();
+    disableStreaming();
+}
+
+void AudioRawHandler::setMeetingService(ZOOM_SDK_NAMESPACE::IMeetingService* svc) {
+    meetingService_ = svc;
+    // Load names once here; participant events keep them current from now on
+    participants_.attach(svc ? svc->GetMeetingParticipantsController() : nullptr);
 }
 
 bool AudioRawHandler::requestRecordingPermission() {
@@ -182,8 +199,13 @@ bool AudioRawHandler::stopRecording() {
     if (result == ZOOM_SDK_NAMESPACE::SDKERR_SUCCESS) {
         std::cout << "[RECORDING] ✓ Raw recording stopped successfully!" << std::endl;
         
-        // Convert all PCM files to WAV format for easy playback
-        convertAllPCMToWAV();
+        // Drain pending frames; closing each file writes its final header. While
+        // still subscribed the worker is started again, since callbacks keep coming
+        // until unsubscribe() and a later startRecording() needs it running.
+        if (captureRunning_.load()) {
+            stopCaptureWorker();
+            startCaptureWorker();
+        }
         
         return true;
     } else {
@@ -211,6 +233,14 @@ bool AudioRawHandler::subscribe(bool withInterpreters) {
     std::cout << "[AUDIO] Attempting to subscribe to raw audio data..." << std::endl;
     std::cout << "[AUDIO] Using withInterpreters = " << (withInterpreters ? "true" : "false") << std::endl;
     
+    // After an unsubscribe() the directory is detached; names come from events again
+    if (meetingService_ && !participants_.attached()) {
+        participants_.attach(meetingService_->GetMeetingParticipantsController());
+    }
+    
+    // Consumer must be running before the SDK starts producing
+    startCaptureWorker();
+    
     auto err = helper->subscribe(this, withInterpreters);
     std::cout << "[AUDIO] Subscribe result: " << err << std::endl;
     
@@ -256,9 +286,16 @@ void AudioRawHandler::unsubscribe() {
         }
     }
     
-    std::lock_guard<std::mutex> lk(mtx_);
-    mixedFile_.reset();
-    userFiles_.clear();
+    // Stop participant events here, while the SDK is still up: main() cleans the SDK
+    // up before this handler (and the directory in it) is destroyed
+    participants_.detach();
+    
+    // Callbacks have stopped: drain what is left, then drop all streams
+    stopCaptureWorker();
+    
+    logStreamStats();
+    streams_.clear();
+    disk_.drain();
 }
 
 bool AudioRawHandler::enableStreaming(const std::string& backend_type, const std::string& config) {
@@ -283,272 +320,363 @@ void AudioRawHandler::disableStreaming() {
     }
 }
 
-void AudioRawHandler::writeToFile(PCMFile& file, AudioRawData* data_) {
-    if (!data_) return;
-    if (!data_->CanAddRef()) return; // ensure buffer validity beyond callback if needed
-    data_->AddRef();
-    file.write(data_->GetBuffer(), data_->GetBufferLen());
-    file.flush();
-    data_->Release();
+bool AudioRawHandler::streamAudioData(uint32_t user_id, const std::shared_ptr<const std::string>& user_name,
+                                      const AudioFrameRef& frame, StreamPriority priority) {
+    // Queued even while the server is down: the streamer's sends are what drive reconnects
+    if (!streamer_ || !streamer_->isRunning()) return true;
+    
+    // Stream the audio data to our processing service (shares the frame, no copy)
+    return streamer_->queueAudio(user_id, user_name, frame, priority);
+}
+
+// ---------------- Capture stage ----------------
+// SDK callbacks only take a reference to the frame, push it into the stream's
+// ring and return; file and network work happens on the capture worker thread.
+
+// Drops our AddRef once the disk writer and streamer are both done with the buffer
+static void releaseSdkFrame(void* context) {
+    static_cast<AudioRawData*>(context)->Release();
 }
 
-void AudioRawHandler::streamAudioData(uint32_t user_id, const std::string& user_name, AudioRawData* data_) {
-    if (!data_ || !streamer_ || !streamer_->isConnected()) return;
+StreamKey AudioRawHandler::keyFor(StreamKind kind, uint32_t id, AudioRawData* data_) {
+    return StreamKey{kind, id, data_->GetSampleRate(), static_cast<uint16_t>(data_->GetChannelNum())};
+}
+
+void AudioRawHandler::captureFrame(CaptureStream& stream, AudioRawData* data_) {
+    AudioFrameRef* slot = stream.ring.acquire();
+    if (!slot) return; // ring full: counted as overflow, reported by the worker
+    
+    AudioFrameRef frame = AudioFramePool::instance().acquire();
+    if (data_->CanAddRef() && data_->AddRef()) {
+        // Heap memory mode: keep the SDK buffer alive until the last consumer releases it
+        frame->attach(data_->GetBuffer(), data_->GetBufferLen(), &releaseSdkFrame, data_);
+    } else {
+        // Buffer is only valid for the duration of this callback
+        frame->assign(data_->GetBuffer(), data_->GetBufferLen());
+    }
+    frame->sampleRate = data_->GetSampleRate();
+    frame->channels = static_cast<uint16_t>(data_->GetChannelNum());
+    frame->captureTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    
+    // Single producer: plain load/store is enough for the counters
+    auto& stats = stream.stats;
+    stats.frames.store(stats.frames.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    stats.bytes.store(stats.bytes.load(std::memory_order_relaxed) + frame->size(), std::memory_order_relaxed);
+    if (stats.firstTimestampMs.load(std::memory_order_relaxed) == 0) {
+        stats.firstTimestampMs.store(frame->captureTimeMs, std::memory_order_relaxed);
+    }
+    stats.lastTimestampMs.store(frame->captureTimeMs, std::memory_order_relaxed);
+    
+    *slot = std::move(frame);
+    stream.ring.publish();
     
-    // Stream the audio data to our processing service
-    streamer_->queueAudio(
-        user_id, 
-        user_name,
-        data_->GetBuffer(), 
-        data_->GetBufferLen(),
-        data_->GetSampleRate(), 
-        data_->GetChannelNum()
-    );
+    // Only wake the worker on the first frame since its last pass
+    if (!capturePending_.exchange(true, std::memory_order_acq_rel)) {
+        captureCv_.notify_one();
+    }
 }
 
-void AudioRawHandler::onMixedAudioRawDataReceived(AudioRawData* data_) {
-    if (!data_) return;
-    std::lock_guard<std::mutex> lk(mtx_);
-    if (!mixedFile_) {
-        auto path = buildMixedFilenameInDir(outDir_, data_->GetSampleRate(), data_->GetChannelNum());
-        mixedFile_ = std::make_unique<PCMFile>(path);
-        if (!mixedFile_->good()) {
-            std::cerr << "Failed to open mixed PCM file for writing" << std::endl;
-            mixedFile_.reset();
-            return;
+void AudioRawHandler::startCaptureWorker() {
+    if (captureRunning_.exchange(true)) return;
+    captureThread_ = std::thread(&AudioRawHandler::captureWorkerLoop, this);
+}
+
+void AudioRawHandler::stopCaptureWorker() {
+    if (!captureRunning_.exchange(false)) return;
+    captureCv_.notify_all();
+    if (captureThread_.joinable()) {
+        captureThread_.join();
+    }
+}
+
+void AudioRawHandler::captureWorkerLoop() {
+    std::vector<std::shared_ptr<CaptureStream>> streams;
+    uint64_t seenGeneration = ~0ull;
+    
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lk(captureMtx_);
+            captureCv_.wait_for(lk, kCaptureDrainInterval, [this] {
+                return capturePending_.load() || !captureRunning_.load();
+            });
+            capturePending_.store(false);
+        }
+        streams_.snapshot(streams, seenGeneration);
+        
+        // Read the flag before draining so the last pass sees every published frame
+        bool running = captureRunning_.load();
+        auto now = std::chrono::steady_clock::now();
+        for (auto& stream : streams) {
+            drainStream(*stream, now);
+        }
+        if (manifest_) {
+            manifest_->poll();
         }
-        std::cout << "Writing mixed audio to " << path << std::endl;
+        if (silence_) {
+            silence_->flushIfStale(now);
+        }
+        if (!running) break;
     }
-    writeToFile(*mixedFile_, data_);
     
-    // Stream mixed audio (using special user_id 0 for mixed audio)
-    streamAudioData(0, "Mixed_Audio", data_);
+    closeStreamFiles(streams);
 }
 
-void AudioRawHandler::onOneWayAudioRawDataReceived(AudioRawData* data_, uint32_t user_id) {
-    if (!data_) return;
-    std::lock_guard<std::mutex> lk(mtx_);
-    auto it = userFiles_.find(user_id);
-    if (it == userFiles_.end()) {
-        std::string name = displayNameForUser(user_id);
-        std::ostringstream fname;
-        fname << outDir_ << "/user_" << user_id;
-        if (!name.empty()) {
-            fname << "_" << sanitize(name);
+void AudioRawHandler::closeStreamFiles(const std::vector<std::shared_ptr<CaptureStream>>& streams) {
+    // Hand every partial buffer to the writer and wait, so the files are complete on return.
+    // A stream that resumes later appends to its file, or starts the next segment.
+    vadFramesIn_ = vadFramesGated_ = vadBytesGated_ = 0;
+    for (auto& stream : streams) {
+        if (stream->gate) {
+            // Whatever the gate still holds was silence; it ends in a marker
+            const auto& name = refreshStreamName(*stream);
+            stream->gate->flush(stream->released);
+            for (auto& frame : stream->released) {
+                deliverFrame(*stream, name, frame);
+            }
+            stream->released.clear();
+            vadFramesIn_ += stream->gate->framesIn();
+            vadFramesGated_ += stream->gate->framesGated();
+            vadBytesGated_ += stream->gate->bytesGated();
         }
-        fname << "_" << data_->GetSampleRate() << "Hz_" << data_->GetChannelNum() << "ch.pcm";
-        auto path = fname.str();
-        auto file = std::make_unique<PCMFile>(path);
-        if (!file->good()) {
-            std::cerr << "Failed to open PCM file for user " << user_id << std::endl;
-            return;
+        if (stream->file) {
+            stream->file->close();
         }
-        std::cout << "Writing user " << user_id << " audio to " << path << std::endl;
-        it = userFiles_.emplace(user_id, std::move(file)).first;
     }
-    writeToFile(*it->second, data_);
-    
-    // Stream individual participant audio
-    std::string user_name = displayNameForUser(user_id);
-    if (user_name.empty()) {
-        user_name = "User_" + std::to_string(user_id);
+    if (silence_) {
+        silence_->flush();
+    }
+    if (flac_) {
+        // Closes go through the encoder threads before they reach the writer
+        flac_->drain();
+    }
+    disk_.drain();
+    if (manifest_) {
+        // Every segment is closed now; list the last ones too
+        manifest_->poll();
+        disk_.drain();
     }
-    streamAudioData(user_id, user_name, data_);
 }
 
-void AudioRawHandler::onShareAudioRawDataReceived(AudioRawData* data_, uint32_t user_id) {
-    if (!data_) return;
-    // Optional: record share audio as separate file
-    std::lock_guard<std::mutex> lk(mtx_);
-    uint32_t share_key = (user_id << 1) ^ 0xAAAAAAAA; // derive a distinct key
-    auto it = userFiles_.find(share_key);
-    if (it == userFiles_.end()) {
-        auto path = outDir_ + "/share_user_" + std::to_string(user_id) + 
-                    "_" + std::to_string(data_->GetSampleRate()) + "Hz_" + 
-                    std::to_string(data_->GetChannelNum()) + "ch.pcm";
-        auto file = std::make_unique<PCMFile>(path);
-        if (!file->good()) {
-            std::cerr << "Failed to open share PCM file for user " << user_id << std::endl;
-            return;
+const std::shared_ptr<const std::string>& AudioRawHandler::refreshStreamName(CaptureStream& stream) {
+    if (!stream.participant) {
+        if (!stream.currentName) {
+            stream.currentName = std::make_shared<const std::string>(stream.displayName);
         }
-        std::cout << "Writing share audio for user " << user_id << " to " << path << std::endl;
-        it = userFiles_.emplace(share_key, std::move(file)).first;
+        return stream.currentName;
     }
-    writeToFile(*it->second, data_);
+    
+    // Only touch the directory when something in it changed
+    uint64_t version = participants_.version();
+    if (version != stream.directoryVersion || !stream.currentName) {
+        stream.directoryVersion = version;
+        auto record = participants_.find(stream.key.id);
+        if (record) {
+            if (stream.key.kind == StreamKind::User && stream.participant && stream.participant->inMeeting &&
+                !record->inMeeting && streamer_ && streamer_->isRunning()) {
+                // Left the meeting: the streamer can let go of its route
+                streamer_->forgetUser(stream.key.id);
+            }
+            stream.participant = std::move(record);
+        }
+        // Aliasing constructor: shares the record's ownership, no allocation
+        stream.currentName = std::shared_ptr<const std::string>(stream.participant, &stream.participant->displayName);
+    }
+    return stream.currentName;
 }
 
-void AudioRawHandler::onOneWayInterpreterAudioRawDataReceived(AudioRawData* data_, const zchar_t* pLanguageName) {
-    if (!data_) return;
-    std::string lang = pLanguageName ? sanitize(pLanguageName) : std::string("unknown");
-    std::lock_guard<std::mutex> lk(mtx_);
-    // Use a fixed key space above UINT32_MAX for interpreters by using path map only
-    auto path = outDir_ + "/interpreter_" + lang + "_" + std::to_string(data_->GetSampleRate()) + "Hz_" + std::to_string(data_->GetChannelNum()) + "ch.pcm";
-    // Create/open per language file lazily each callback
-    PCMFile file(path);
-    if (!file.good()) {
-        std::cerr << "Failed to open interpreter PCM file for language " << lang << std::endl;
-        return;
-    }
-    writeToFile(file, data_);
-}
-
-std::string AudioRawHandler::displayNameForUser(uint32_t user_id) {
-    if (!meetingService_) return {};
-    auto* pc = meetingService_->GetMeetingParticipantsController();
-    if (!pc) return {};
-    auto* info = pc->GetUserByUserID(user_id);
-    if (!info) return {};
-    const zchar_t* name = info->GetUserName();
-    if (!name) return {};
-    return std::string(name);
-}
-
-// WAV file header structure
-struct WAVHeader {
-    // RIFF header
-    char riff_header[4] = {'R', 'I', 'F', 'F'};
-    uint32_t wav_size;
-    char wave_header[4] = {'W', 'A', 'V', 'E'};
-    
-    // fmt subchunk
-    char fmt_header[4] = {'f', 'm', 't', ' '};
-    uint32_t fmt_chunk_size = 16;
-    uint16_t audio_format = 1; // PCM
-    uint16_t num_channels;
-    uint32_t sample_rate;
-    uint32_t byte_rate;
-    uint16_t sample_alignment;
-    uint16_t bit_depth;
-    
-    // data subchunk
-    char data_header[4] = {'d', 'a', 't', 'a'};
-    uint32_t data_bytes;
-};
-
-bool AudioRawHandler::convertPCMToWAV(const std::string& pcmFilePath, const std::string& wavFilePath, 
-                                      uint32_t sampleRate, uint16_t channels, uint16_t bitsPerSample) {
-    std::ifstream pcmFile(pcmFilePath, std::ios::binary);
-    if (!pcmFile) {
-        std::cerr << "Failed to open PCM file: " << pcmFilePath << std::endl;
-        return false;
+void AudioRawHandler::drainStream(CaptureStream& stream, std::chrono::steady_clock::time_point now) {
+    const auto& name = refreshStreamName(stream);
+    if (vad_.enabled && stream.key.kind == StreamKind::User && !stream.gate) {
+        stream.gate.reset(new VoiceActivityGate(vad_, stream.key.sampleRate, stream.key.channels));
     }
-    
-    // Get PCM file size
-    pcmFile.seekg(0, std::ios::end);
-    uint32_t pcmDataSize = static_cast<uint32_t>(pcmFile.tellg());
-    pcmFile.seekg(0, std::ios::beg);
-    
-    if (pcmDataSize == 0) {
-        std::cerr << "PCM file is empty: " << pcmFilePath << std::endl;
-        return false;
+    while (AudioFrameRef* slot = stream.ring.front()) {
+        if (!stream.file && !stream.openFailed) {
+            stream.openFailed = !openStreamFile(stream, **slot);
+        }
+        if (stream.gate) {
+            // Frames come out of the gate in order, possibly later, with markers for the silence
+            stream.gate->push(std::move(*slot), stream.released);
+            for (auto& frame : stream.released) {
+                deliverFrame(stream, name, frame);
+            }
+            stream.released.clear();
+        } else {
+            deliverFrame(stream, name, *slot);
+        }
+        
+        // Drop the ring's reference now; the SDK buffer is released once the streamer is done too
+        slot->reset();
+        stream.ring.pop();
     }
-    
-    // Create WAV header
-    WAVHeader header;
-    header.num_channels = channels;
-    header.sample_rate = sampleRate;
-    header.bit_depth = bitsPerSample;
-    header.byte_rate = sampleRate * channels * (bitsPerSample / 8);
-    header.sample_alignment = channels * (bitsPerSample / 8);
-    header.data_bytes = pcmDataSize;
-    header.wav_size = sizeof(WAVHeader) - 8 + pcmDataSize; // Total file size - 8 bytes (RIFF header)
-    
-    // Create WAV file
-    std::ofstream wavFile(wavFilePath, std::ios::binary);
-    if (!wavFile) {
-        std::cerr << "Failed to create WAV file: " << wavFilePath << std::endl;
-        return false;
+    if (stream.file) {
+        // Buffers go to disk when full or once they hold maxBufferAgeMs of audio
+        stream.file->flushIfStale(now);
+        uint64_t dropped = stream.file->droppedBytes();
+        if (dropped != stream.reportedDiskDrops) {
+            std::cerr << "[AUDIO] Disk writer behind for " << *name << ", dropped "
+                      << (dropped - stream.reportedDiskDrops) << " bytes (total " << dropped << ")" << std::endl;
+            stream.reportedDiskDrops = dropped;
+        }
     }
     
-    // Write WAV header
-    wavFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
-    
-    // Copy PCM data
-    char buffer[8192];
-    while (pcmFile.read(buffer, sizeof(buffer)) || pcmFile.gcount() > 0) {
-        wavFile.write(buffer, pcmFile.gcount());
+    uint64_t overflows = stream.ring.overflowCount();
+    if (overflows != stream.reportedOverflows) {
+        std::cerr << "[AUDIO] Capture ring full for " << *name << ", dropped "
+                  << (overflows - stream.reportedOverflows) << " frames (total " << overflows << ")" << std::endl;
+        stream.reportedOverflows = overflows;
     }
-    
-    std::cout << "Converted " << pcmFilePath << " to " << wavFilePath 
-              << " (" << sampleRate << " Hz, " << channels << " channels, " 
-              << bitsPerSample << " bits)" << std::endl;
-    
-    return true;
 }
 
-void AudioRawHandler::convertAllPCMToWAV() const {
-    DIR* dir = opendir(outDir_.c_str());
-    if (!dir) {
-        std::cerr << "Output directory does not exist: " << outDir_ << std::endl;
-        return;
+void AudioRawHandler::deliverFrame(CaptureStream& stream, const std::shared_ptr<const std::string>& name,
+                                   const AudioFrameRef& ref) {
+    const AudioFrame& frame = *ref;
+    if (stream.file) {
+        if (frame.silentSamples > 0) {
+            stream.file->gap(frame.silentSamples, frame.captureTimeMs);
+        } else {
+            stream.file->write(frame.data(), frame.size(), frame.captureTimeMs);
+        }
     }
     
-    std::cout << "\n[WAV CONVERSION] Converting all PCM files to WAV format..." << std::endl;
-    int converted = 0;
-    
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        std::string filename(entry->d_name);
-        
-        // Check if it's a .pcm file
-        if (filename.size() > 4 && filename.substr(filename.size() - 4) == ".pcm") {
-            std::string pcmPath = outDir_ + "/" + filename;
-            
-            // Check if it's a regular file
-            struct stat fileStat;
-            if (stat(pcmPath.c_str(), &fileStat) == 0 && S_ISREG(fileStat.st_mode)) {
-                // Remove .pcm extension for base name
-                std::string baseName = filename.substr(0, filename.size() - 4);
-                
-                // Extract sample rate and channels from filename
-                // Expected format: mixed_48000Hz_2ch.pcm or user_12345_DisplayName_48000Hz_1ch.pcm
-                uint32_t sampleRate = 48000; // default
-                uint16_t channels = 2;       // default
-                
-                size_t hzPos = baseName.find("Hz_");
-                size_t chPos = baseName.find("ch");
-                
-                if (hzPos != std::string::npos && chPos != std::string::npos) {
-                    // Find start of sample rate (work backwards from Hz)
-                    size_t rateStart = hzPos;
-                    while (rateStart > 0 && std::isdigit(baseName[rateStart - 1])) {
-                        rateStart--;
-                    }
-                    
-                    if (rateStart < hzPos) {
-                        try {
-                            sampleRate = std::stoul(baseName.substr(rateStart, hzPos - rateStart));
-                        } catch (const std::exception&) {
-                            // Keep default on parse error
-                        }
-                    }
-                    
-                    // Extract channels (should be right after Hz_)
-                    size_t chStart = hzPos + 3; // Skip "Hz_"
-                    if (chStart < chPos) {
-                        try {
-                            channels = std::stoul(baseName.substr(chStart, chPos - chStart));
-                        } catch (const std::exception&) {
-                            // Keep default on parse error
-                        }
-                    }
-                }
-                
-                // Create WAV filename
-                std::string wavPath = outDir_ + "/" + baseName + ".wav";
-                
-                // Convert to WAV
-                if (convertPCMToWAV(pcmPath, wavPath, sampleRate, channels, 16)) {
-                    converted++;
-                }
-            }
+    // Mixed (user_id 0) and per-participant audio go to the processing service
+    if (stream.key.kind == StreamKind::Mixed || stream.key.kind == StreamKind::User) {
+        if (!streamAudioData(stream.key.id, name, ref, streamPriority(stream, frame))) {
+            stream.streamDrops.fetch_add(1, std::memory_order_relaxed);
         }
     }
+}
+
+// Mixed audio matters most; participants rank by whether they spoke recently
+StreamPriority AudioRawHandler::streamPriority(CaptureStream& stream, const AudioFrame& frame) {
+    switch (stream.key.kind) {
+        case StreamKind::Mixed:
+            return StreamPriority::Mixed;
+        case StreamKind::User:
+            break;
+        default:
+            return StreamPriority::Share;
+    }
+    if (!streamer_ || !streamer_->isRunning()) {
+        return StreamPriority::Idle;
+    }
+    if (hasSpeech(frame)) {
+        stream.spoke = true;
+        stream.lastSpeechMs = frame.captureTimeMs;
+    }
+    bool active = stream.spoke && frame.captureTimeMs - stream.lastSpeechMs < kSpeakerHangoverMs;
+    return active ? StreamPriority::ActiveSpeaker : StreamPriority::Idle;
+}
+
+bool AudioRawHandler::openStreamFile(CaptureStream& stream, const AudioFrame& frame) {
+    std::ostringstream fname;
+    switch (stream.key.kind) {
+        case StreamKind::Mixed:
+            fname << buildMixedFilenameInDir(outDir_, frame.sampleRate, frame.channels);
+            break;
+        case StreamKind::User:
+            fname << outDir_ << "/user_" << stream.key.id;
+            if (stream.participant && !stream.participant->sanitizedName.empty()) {
+                fname << "_" << stream.participant->sanitizedName;
+            }
+            fname << "_" << frame.sampleRate << "Hz_" << frame.channels << "ch";
+            break;
+        case StreamKind::Share:
+            fname << outDir_ << "/share_user_" << stream.key.id
+                  << "_" << frame.sampleRate << "Hz_" << frame.channels << "ch";
+            break;
+        case StreamKind::Interpreter:
+            fname << outDir_ << "/interpreter_" << stream.fileTag
+                  << "_" << frame.sampleRate << "Hz_" << frame.channels << "ch";
+            break;
+    }
     
-    closedir(dir);
+    auto file = std::make_unique<SegmentedWavFile>(disk_, manifest_.get(), flac_.get(), silence_.get(), fname.str(),
+                                                   frame.sampleRate, frame.channels);
+    if (!file->good()) {
+        return false;   // logged by SegmentedWavFile
+    }
+    std::cout << "Writing " << (stream.participant ? stream.participant->displayName : stream.displayName)
+              << " audio to " << file->path() << std::endl;
+    stream.file = std::move(file);
+    return true;
+}
+
+void AudioRawHandler::onMixedAudioRawDataReceived(AudioRawData* data_) {
+    if (!data_) return;
+    auto key = keyFor(StreamKind::Mixed, 0, data_);
+    auto* stream = streams_.find(key);
+    if (!stream) {
+        // Stream mixed audio using special user_id 0
+        stream = streams_.create(key, "", "Mixed_Audio");
+    }
+    captureFrame(*stream, data_);
+}
+
+void AudioRawHandler::onOneWayAudioRawDataReceived(AudioRawData* data_, uint32_t user_id) {
+    if (!data_) return;
+    auto key = keyFor(StreamKind::User, user_id, data_);
+    auto* stream = streams_.find(key);
+    if (!stream) {
+        // First frame from this participant: names come from the directory, never the SDK
+        auto participant = participants_.resolve(user_id);
+        stream = streams_.create(key, "", participant->displayName, participant);
+    }
+    captureFrame(*stream, data_);
+}
+
+void AudioRawHandler::onShareAudioRawDataReceived(AudioRawData* data_, uint32_t user_id) {
+    if (!data_) return;
+    // Optional: record share audio as separate file
+    auto key = keyFor(StreamKind::Share, user_id, data_);
+    auto* stream = streams_.find(key);
+    if (!stream) {
+        stream = streams_.create(key, "", "Share_" + std::to_string(user_id));
+    }
+    captureFrame(*stream, data_);
+}
+
+void AudioRawHandler::onOneWayInterpreterAudioRawDataReceived(AudioRawData* data_, const zchar_t* pLanguageName) {
+    if (!data_) return;
+    std::string lang = pLanguageName ? pLanguageName : "unknown";
+    auto key = keyFor(StreamKind::Interpreter, streams_.internLanguage(lang), data_);
+    auto* stream = streams_.find(key);
+    if (!stream) {
+        auto tag = ParticipantDirectory::sanitize(lang);
+        stream = streams_.create(key, tag, "Interpreter_" + tag);
+    }
+    captureFrame(*stream, data_);
+}
+
+void AudioRawHandler::logStreamStats() const {
+    auto stats = streams_.stats();
+    if (stats.empty()) return;
+    
+    std::cout << "[AUDIO] Capture summary (" << stats.size() << " streams):" << std::endl;
+    for (const auto& st : stats) {
+        int64_t seconds = (st.lastTimestampMs - st.firstTimestampMs) / 1000;
+        std::cout << "  " << streamKindName(st.key.kind) << " " << st.name
+                  << " " << st.key.sampleRate << "Hz/" << st.key.channels << "ch: "
+                  << st.frames << " frames, " << st.bytes << " bytes, "
+                  << st.overflows << " dropped, " << st.streamDrops << " not streamed, " << seconds << "s" << std::endl;
+    }
     
-    std::cout << "[WAV CONVERSION] Converted " << converted << " PCM files to WAV format." << std::endl;
-    std::cout << "[WAV CONVERSION] WAV files can now be played with any standard audio player." << std::endl;
+    auto disk = disk_.stats();
+    std::cout << "[AUDIO] Disk writer (" << disk_.backendName() << "): " << disk.bytesWritten << " bytes in " << disk.writeCalls
+              << " writes, " << disk.syncCalls << " syncs, " << disk.errors << " errors" << std::endl;
+    if (flac_) {
+        auto flac = flac_->stats();
+        std::cout << "[AUDIO] FLAC: " << flac.pcmBytes << " bytes of PCM in " << flac.flacBytes << " bytes ("
+                  << std::fixed << std::setprecision(1)
+                  << (flac.flacBytes > 0 ? static_cast<double>(flac.pcmBytes) / flac.flacBytes : 0.0) << ":1), "
+                  << flac.cpuNanos / 1000000 << " ms encoder CPU on " << flac_->threads() << " threads"
+                  << std::defaultfloat << std::endl;
+    }
+    if (vad_.enabled && vadFramesIn_ > 0) {
+        std::cout << "[AUDIO] Voice activity: " << vadFramesGated_ << " of " << vadFramesIn_
+                  << " participant frames gated as silence (" << vadBytesGated_ / 1024 << " KB neither written nor streamed)"
+                  << std::endl;
+    }
 }
 
 } // namespace ZoomBot
@@ -1,11 +1,14 @@
 #pragma once
 
-#include <unordered_map>
-#include <fstream>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
 #include <string>
 #include <memory>
+#include <vector>
 #include <cstdint>
+#include <chrono>
 
 // Zoom SDK raw data
 #include "rawdata/zoom_rawdata_api.h"
@@ -18,25 +21,20 @@
 
 // Our streaming system
 #include "audio_streamer.h"
+#include "stream_registry.h"
+#include "participant_directory.h"
+#include "disk_writer.h"
+#include "flac_file.h"
+#include "silence_log.h"
+#include "voice_activity.h"
 
 namespace ZoomBot {
 
-// Simple PCM writer that opens a .pcm file and appends bytes
-class PCMFile {
-public:
-    explicit PCMFile(const std::string& path);
-    ~PCMFile();
-    bool good() const;
-    void write(const char* data, size_t len);
-    void flush();
-private:
-    std::ofstream ofs_;
-};
-
-// Delegates raw audio frames to per-participant PCM files and streams to processing service
+// Delegates raw audio frames to per-participant WAV/FLAC files and streams to processing service
 class AudioRawHandler : public ZOOM_SDK_NAMESPACE::IZoomSDKAudioRawDataDelegate {
 public:
-    AudioRawHandler();
+    explicit AudioRawHandler(const DiskWriterConfig& diskConfig = DiskWriterConfig(),
+                             const VoiceActivityConfig& vad = VoiceActivityConfig());
     ~AudioRawHandler();
 
     // Start/stop subscription
@@ -45,7 +43,7 @@ public:
     bool stopRecording();
     bool subscribe(bool withInterpreters = false);
     void unsubscribe();
-    void setMeetingService(ZOOM_SDK_NAMESPACE::IMeetingService* svc) { meetingService_ = svc; }
+    void setMeetingService(ZOOM_SDK_NAMESPACE::IMeetingService* svc);
     
     // Streaming configuration
     bool enableStreaming(const std::string& backend_type = "tcp", 
@@ -53,11 +51,9 @@ public:
     void disableStreaming();
     bool isStreamingEnabled() const { return streamer_ && streamer_->isConnected(); }
     
-    // WAV conversion utility
-    static bool convertPCMToWAV(const std::string& pcmFilePath, const std::string& wavFilePath, 
-                                uint32_t sampleRate, uint16_t channels, uint16_t bitsPerSample = 16);
-    void convertAllPCMToWAV() const;
-
+    // Per-stream capture statistics (frames, bytes, drops, first/last capture time)
+    std::vector<StreamStatsSnapshot> streamStats() const { return streams_.stats(); }
+    
     // IZoomSDKAudioRawDataDelegate
     void onMixedAudioRawDataReceived(AudioRawData* data_) override;
     void onOneWayAudioRawDataReceived(AudioRawData* data_, uint32_t user_id) override;
@@ -66,19 +62,51 @@ public:
 
 private:
     std::string outDir_;
-    std::mutex mtx_;
-    std::unique_ptr<PCMFile> mixedFile_;
-    std::unordered_map<uint32_t, std::unique_ptr<PCMFile>> userFiles_;
     ZOOM_SDK_NAMESPACE::IMeetingService* meetingService_ = nullptr; // weak ref
+    ParticipantDirectory participants_;
+    
+    // Batched writes for every recording file; outlives the streams that feed it
+    DiskWriter disk_;
+    // Finished segments, when recordings are split (null otherwise)
+    std::unique_ptr<SegmentManifest> manifest_;
+    // FLAC encoder threads (null when recording WAV); stopped before the DiskWriter
+    std::unique_ptr<FlacEncodePool> flac_;
+    // Silence gated out of participant streams, when ZOOM_BOT_VAD is on (null otherwise)
+    VoiceActivityConfig vad_;
+    std::unique_ptr<SilenceLog> silence_;
+    // Gate totals as of the last time the capture worker stopped
+    uint64_t vadFramesIn_ = 0;
+    uint64_t vadFramesGated_ = 0;
+    uint64_t vadBytesGated_ = 0;
+    
+    // Every capture stream, keyed by (kind, id, format)
+    StreamRegistry streams_;
+
+    // Capture worker: drains every stream's ring, writes files and feeds the streamer
+    std::mutex captureMtx_;                     // wakeup only
+    std::condition_variable captureCv_;
+    std::atomic<bool> capturePending_{false};
+    std::atomic<bool> captureRunning_{false};
+    std::thread captureThread_;
     
     // Streaming system
     std::unique_ptr<AudioStreamer> streamer_;
 
     static bool ensureDir(const std::string& path);
-    static std::string sanitize(const std::string& s);
-    void writeToFile(PCMFile& file, AudioRawData* data_);
-    void streamAudioData(uint32_t user_id, const std::string& user_name, AudioRawData* data_);
-    std::string displayNameForUser(uint32_t user_id);
+    static StreamKey keyFor(StreamKind kind, uint32_t id, AudioRawData* data_);
+    void logStreamStats() const;
+    void captureFrame(CaptureStream& stream, AudioRawData* data_);
+    void startCaptureWorker();
+    void stopCaptureWorker();
+    void captureWorkerLoop();
+    void drainStream(CaptureStream& stream, std::chrono::steady_clock::time_point now);
+    void deliverFrame(CaptureStream& stream, const std::shared_ptr<const std::string>& name, const AudioFrameRef& ref);
+    void closeStreamFiles(const std::vector<std::shared_ptr<CaptureStream>>& streams);
+    bool openStreamFile(CaptureStream& stream, const AudioFrame& frame);
+    const std::shared_ptr<const std::string>& refreshStreamName(CaptureStream& stream);
+    bool streamAudioData(uint32_t user_id, const std::shared_ptr<const std::string>& user_name,
+                         const AudioFrameRef& frame, StreamPriority priority);
+    StreamPriority streamPriority(CaptureStream& stream, const AudioFrame& frame);
 };
 
 } // namespace ZoomBot
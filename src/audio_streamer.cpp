@@ -1,346 +1,2180 @@
 #include "audio_streamer.h"
+#include "local_backends.h"
+#include "audio_encoder.h"
 #include <iostream>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <linux/errqueue.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <unistd.h>
+#include <climits>
 #include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <limits>
 #include <sstream>
 #include <chrono>
-#include <nlohmann/json.hpp>
+#include <sys/time.h>
 
 namespace ZoomBot {
 
+const char* streamPriorityName(StreamPriority priority) {
+    switch (priority) {
+        case StreamPriority::Mixed: return "mixed";
+        case StreamPriority::ActiveSpeaker: return "active speaker";
+        case StreamPriority::Idle: return "idle participant";
+        case StreamPriority::Share: return "share/interpreter";
+    }
+    return "unknown";
+}
+
+bool StreamingBackend::streamBatch(const AudioChunk* chunks, size_t count) {
+    bool all = true;
+    for (size_t i = 0; i < count; ++i) {
+        all = streamAudio(chunks[i].user_id, *chunks[i].user_name, chunks[i].frame) && all;
+    }
+    return all;
+}
+
+// Queue and backlog accounting: a silence marker has no data but still has to go out
+static size_t queuedBytes(const AudioFrame& frame) {
+    return frame.silentSamples > 0 ? kWireSilenceSize : frame.size();
+}
+
 // ============================================================================
 // TCPStreamingBackend Implementation
 // ============================================================================
 
+// Connection timing
+static const int kConnectTimeoutSec = 5;
+static const int kHandshakeTimeoutSec = 3;          // a JSON-only receiver never answers the hello
+static const int kSendStallTimeoutMs = 2000;        // receiver took nothing for this long: reconnect
+static const int kReconnectBaseDelayMs = 250;
+static const int kReconnectMaxDelayMs = 30000;
+
+// Socket tuning: keep at most this much unsent audio in the kernel, so a slow
+// receiver makes sends wait (and the batch budget shrink) rather than queueing stale audio
+static const int kNotSentLowatBytes = 128 * 1024;
+static const int kKeepAliveIdleSec = 10;
+static const int kKeepAliveIntervalSec = 5;
+static const int kKeepAliveCount = 3;
+
 TCPStreamingBackend::TCPStreamingBackend() 
-    : connection_(std::make_unique<TCPConnection>()) {
+    : connection_(std::make_unique<TCPConnection>()),
+      backoff_rng_(static_cast<std::minstd_rand::result_type>(
+          std::chrono::steady_clock::now().time_since_epoch().count())) {
     connection_->socket_fd = -1;
     connection_->connected = false;
+    batch_pieces_.reserve(512);
+    batch_iov_.reserve(512);
 }
 
 TCPStreamingBackend::~TCPStreamingBackend() {
     shutdown();
+    if (epoll_fd_ != -1) {
+        close(epoll_fd_);
+    }
 }
 
 bool TCPStreamingBackend::initialize(const std::string& config) {
-    // Parse config: "host:port"
-    size_t colon_pos = config.find(':');
+    std::lock_guard<std::mutex> lock(connection_mutex_);
+    
+    // Parse config: "host:port[?protocol=binary|json&zerocopy=0|1&credits=0|1&replay=0|1&...]"
+    std::string endpoint = config;
+    std::string spill_dir = "/tmp";
+    size_t query_pos = config.find('?');
+    if (query_pos != std::string::npos) {
+        endpoint = config.substr(0, query_pos);
+        std::stringstream options(config.substr(query_pos + 1));
+        std::string option;
+        while (std::getline(options, option, '&')) {
+            if (option == "protocol=json") {
+                protocol_ = StreamProtocol::Json;
+            } else if (option == "protocol=binary") {
+                protocol_ = StreamProtocol::Binary;
+            } else if (option == "zerocopy=1" || option == "zerocopy=0") {
+                zerocopy_requested_ = option == "zerocopy=1";
+            } else if (option == "credits=1" || option == "credits=0") {
+                credits_requested_ = option == "credits=1";
+            } else if (option == "replay=1" || option == "replay=0") {
+                replay_requested_ = option == "replay=1";
+            } else if (option.compare(0, 10, "replay_kb=") == 0) {
+                replay_memory_ = static_cast<size_t>(std::max(0, atoi(option.c_str() + 10))) * 1024;
+            } else if (option.compare(0, 10, "spill_dir=") == 0) {
+                spill_dir = option.substr(10);
+            } else if (option.compare(0, 9, "spill_mb=") == 0) {
+                spill_limit_ = static_cast<uint64_t>(std::max(0, atoi(option.c_str() + 9))) << 20;
+            } else if (!option.empty()) {
+                std::cerr << "[TCP] Ignoring unknown option: " << option << std::endl;
+            }
+        }
+    }
+    
+    size_t colon_pos = endpoint.find(':');
     if (colon_pos == std::string::npos) {
         std::cerr << "[TCP] Invalid config format. Expected 'host:port', got: " << config << std::endl;
         return false;
     }
     
-    connection_->host = config.substr(0, colon_pos);
-    connection_->port = std::stoi(config.substr(colon_pos + 1));
+    connection_->host = endpoint.substr(0, colon_pos);
+    connection_->port = std::stoi(endpoint.substr(colon_pos + 1));
     
     std::cout << "[TCP] Configured to connect to " << connection_->host 
-              << ":" << connection_->port << std::endl;
+              << ":" << connection_->port << " (" << streamProtocolName(protocol_) << " protocol)" << std::endl;
     
-    return connectToServer();
-}
-
-bool TCPStreamingBackend::connectToServer() {
-    std::lock_guard<std::mutex> lock(connection_mutex_);
+    // Until a receiver says otherwise, audio is kept for replay from the start
+    replay_expected_ = replay_requested_ && protocol_ == StreamProtocol::Binary;
+    uint64_t segment = spill_limit_ / 16;
+    segment = segment < (1u << 20) ? (1u << 20) : segment > (64u << 20) ? (64u << 20) : segment;
+    spill_.configure(spill_dir, segment);
     
-    // Close existing connection
-    if (connection_->socket_fd != -1) {
-        close(connection_->socket_fd);
-        connection_->socket_fd = -1;
-        connection_->connected = false;
+    if (epoll_fd_ == -1) {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) {
+            std::cerr << "[TCP] Failed to create epoll instance: " << strerror(errno) << std::endl;
+            return false;
+        }
     }
-    
-    // Create socket
-    connection_->socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (connection_->socket_fd < 0) {
-        std::cerr << "[TCP] Failed to create socket" << std::endl;
+    if (!resolve()) {
         return false;
     }
     
-    // Set up server address
-    struct sockaddr_in server_addr{};
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(connection_->port);
-    
-    // Try to resolve hostname to IP address
-    if (inet_pton(AF_INET, connection_->host.c_str(), &server_addr.sin_addr) <= 0) {
-        // If inet_pton fails, try hostname resolution
-        struct hostent* host_entry = gethostbyname(connection_->host.c_str());
-        if (!host_entry) {
-            std::cerr << "[TCP] Failed to resolve hostname: " << connection_->host << std::endl;
-            close(connection_->socket_fd);
-            connection_->socket_fd = -1;
-            return false;
-        }
-        
-        // Copy the resolved IP address
-        memcpy(&server_addr.sin_addr, host_entry->h_addr_list[0], host_entry->h_length);
-        std::cout << "[TCP] Resolved " << connection_->host << " to " 
-                  << inet_ntoa(server_addr.sin_addr) << std::endl;
+    // Only start the connect: the caller may hold locks (enableStreaming, a fan-out
+    // retry), so the worker's advance() calls finish the connect and the handshake
+    closeSocket();
+    connection_->failures = 0;
+    connection_->next_attempt = std::chrono::steady_clock::now();
+    if (!advance(0)) {
+        std::cout << "[TCP] Connecting to audio processing server in the background" << std::endl;
     }
-    
-    // Connect to server
-    if (connect(connection_->socket_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        std::cerr << "[TCP] Failed to connect to " << connection_->host 
-                  << ":" << connection_->port << " - " << strerror(errno) << std::endl;
-        close(connection_->socket_fd);
-        connection_->socket_fd = -1;
+    return true;
+}
+
+bool TCPStreamingBackend::resolve() {
+    struct addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* results = nullptr;
+    std::string port = std::to_string(connection_->port);
+    int rc = getaddrinfo(connection_->host.c_str(), port.c_str(), &hints, &results);
+    if (rc != 0) {
+        std::cerr << "[TCP] Failed to resolve hostname: " << connection_->host << " - " << gai_strerror(rc) << std::endl;
         return false;
     }
     
-    connection_->connected = true;
-    std::cout << "[TCP] ✓ Connected to audio processing server" << std::endl;
+    addresses_.clear();
+    next_address_ = 0;
+    for (struct addrinfo* ai = results; ai; ai = ai->ai_next) {
+        ResolvedAddress address{};
+        memcpy(&address.addr, ai->ai_addr, ai->ai_addrlen);
+        address.len = ai->ai_addrlen;
+        addresses_.push_back(address);
+    }
+    freeaddrinfo(results);
+    
+    char text[INET6_ADDRSTRLEN] = "?";
+    const struct sockaddr* first = reinterpret_cast<const struct sockaddr*>(&addresses_[0].addr);
+    if (first->sa_family == AF_INET) {
+        inet_ntop(AF_INET, &reinterpret_cast<const struct sockaddr_in*>(first)->sin_addr, text, sizeof(text));
+    } else if (first->sa_family == AF_INET6) {
+        inet_ntop(AF_INET6, &reinterpret_cast<const struct sockaddr_in6*>(first)->sin6_addr, text, sizeof(text));
+    }
+    std::cout << "[TCP] Resolved " << connection_->host << " to " << text;
+    if (addresses_.size() > 1) {
+        std::cout << " (+" << addresses_.size() - 1 << " more)";
+    }
+    std::cout << std::endl;
     return true;
 }
 
-bool TCPStreamingBackend::streamAudio(uint32_t user_id, const std::string& user_name,
-                                    const char* data, size_t length,
-                                    uint32_t sample_rate, uint16_t channels) {
-    std::lock_guard<std::mutex> lock(connection_mutex_);
+// Moves the connection along without blocking longer than timeout_ms; true once audio can go out
+bool TCPStreamingBackend::advance(int timeout_ms) {
+    auto now = std::chrono::steady_clock::now();
+    switch (connection_->state) {
+        case ConnectionState::Connected:
+            return true;
+        case ConnectionState::Idle:
+            if (now < connection_->next_attempt) return false;
+            startConnect(now);
+            if (connection_->state != ConnectionState::Connecting &&
+                connection_->state != ConnectionState::Handshaking) {
+                return connection_->state == ConnectionState::Connected;
+            }
+            break;
+        default:
+            break;
+    }
     
-    if (!connection_->connected || connection_->socket_fd < 0) {
-        // Try to reconnect
-        if (!connectToServer()) {
-            return false;
+    struct epoll_event event{};
+    int ready = epoll_wait(epoll_fd_, &event, 1, timeout_ms);
+    now = std::chrono::steady_clock::now();
+    if (ready > 0) {
+        if (connection_->state == ConnectionState::Connecting) {
+            finishConnect(now);
+        } else if (connection_->state == ConnectionState::Handshaking) {
+            readHello();
         }
     }
-    
-    // Send header first (JSON metadata)
-    if (!sendHeader(user_id, user_name, sample_rate, channels)) {
-        return false;
+    if ((connection_->state == ConnectionState::Connecting || connection_->state == ConnectionState::Handshaking) &&
+        now >= connection_->deadline) {
+        if (connection_->state == ConnectionState::Handshaking) {
+            std::cerr << "[TCP] No protocol handshake from server; for an older receiver use "
+                      << connection_->host << ":" << connection_->port << "?protocol=json" << std::endl;
+        }
+        scheduleReconnect("timed out");
     }
-    
-    // Send audio data
-    if (!sendAudioData(data, length)) {
-        return false;
+    return connection_->state == ConnectionState::Connected;
+}
+
+void TCPStreamingBackend::startConnect(std::chrono::steady_clock::time_point now) {
+    const ResolvedAddress& address = addresses_[next_address_];
+    const struct sockaddr* addr = reinterpret_cast<const struct sockaddr*>(&address.addr);
+    connection_->socket_fd = socket(addr->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (connection_->socket_fd < 0) {
+        std::cerr << "[TCP] Failed to create socket" << std::endl;
+        scheduleReconnect(strerror(errno));
+        return;
     }
     
-    return true;
+    // Every batch goes out whole in one call; Nagle would only hold it back
+    int one = 1;
+    setsockopt(connection_->socket_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    int lowat = kNotSentLowatBytes;
+    setsockopt(connection_->socket_fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat));
+    
+    // Notice a receiver that vanished without a FIN within ~25 s, even when idle
+    int idle = kKeepAliveIdleSec, interval = kKeepAliveIntervalSec, count = kKeepAliveCount;
+    setsockopt(connection_->socket_fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+    setsockopt(connection_->socket_fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(connection_->socket_fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+    setsockopt(connection_->socket_fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+    
+    struct epoll_event event{};
+    event.events = EPOLLOUT;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, connection_->socket_fd, &event);
+    
+    connection_->state = ConnectionState::Connecting;
+    connection_->deadline = now + std::chrono::seconds(kConnectTimeoutSec);
+    if (connect(connection_->socket_fd, addr, address.len) == 0) {
+        finishConnect(now);
+    } else if (errno != EINPROGRESS) {
+        scheduleReconnect(strerror(errno));
+    }
 }
 
-bool TCPStreamingBackend::sendHeader(uint32_t user_id, const std::string& user_name,
-                                   uint32_t sample_rate, uint16_t channels) {
-    nlohmann::json header;
-    header["type"] = "audio_header";
-    header["user_id"] = user_id;
-    header["user_name"] = user_name;
-    header["sample_rate"] = sample_rate;
-    header["channels"] = channels;
-    header["format"] = "pcm_s16le";
-    header["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::system_clock::now().time_since_epoch()).count();
-    
-    std::string header_str = header.dump();
-    uint32_t header_size = htonl(static_cast<uint32_t>(header_str.size()));
+void TCPStreamingBackend::finishConnect(std::chrono::steady_clock::time_point now) {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    getsockopt(connection_->socket_fd, SOL_SOCKET, SO_ERROR, &error, &len);
+    if (error != 0) {
+        scheduleReconnect(strerror(error));
+        return;
+    }
     
-    // Send header size (4 bytes, network byte order)
-    if (send(connection_->socket_fd, &header_size, sizeof(header_size), 0) != sizeof(header_size)) {
-        std::cerr << "[TCP] Failed to send header size" << std::endl;
-        connection_->connected = false;
-        return false;
+    if (protocol_ == StreamProtocol::Json) {
+        markConnected();
+        return;
     }
     
-    // Send header JSON
-    if (send(connection_->socket_fd, header_str.c_str(), header_str.size(), 0) != static_cast<ssize_t>(header_str.size())) {
-        std::cerr << "[TCP] Failed to send header" << std::endl;
-        connection_->connected = false;
-        return false;
+    // Fresh socket: the 8-byte hello always fits in the send buffer
+    char hello[kWireHelloSize];
+    uint16_t flags = (credits_requested_ ? kWireHelloCredits : 0) | (replay_requested_ ? kWireHelloAcks : 0) |
+                     (wire_streams_.empty() ? 0 : kWireHelloResume);
+    encodeWireHello(hello, flags);
+    if (send(connection_->socket_fd, hello, sizeof(hello), MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(hello))) {
+        std::cerr << "[TCP] Failed to send protocol hello" << std::endl;
+        scheduleReconnect(strerror(errno));
+        return;
+    }
+    connection_->state = ConnectionState::Handshaking;
+    connection_->deadline = now + std::chrono::seconds(kHandshakeTimeoutSec);
+    connection_->hello_received = 0;
+    watch(EPOLLIN);
+}
+
+void TCPStreamingBackend::readHello() {
+    // The hello, then the initial credit window if the receiver grants credit
+    uint16_t flags = 0;
+    for (;;) {
+        size_t expected = kWireHelloSize;
+        if (connection_->hello_received >= kWireHelloSize) {
+            uint16_t version = 0;
+            if (!decodeWireHello(connection_->hello, version, flags)) {
+                std::cerr << "[TCP] Unexpected handshake reply; for an older receiver use "
+                          << connection_->host << ":" << connection_->port << "?protocol=json" << std::endl;
+                scheduleReconnect("bad handshake");
+                return;
+            }
+            if (version != kWireVersion) {
+                std::cerr << "[TCP] Server speaks protocol v" << version << ", expected v" << kWireVersion << std::endl;
+                scheduleReconnect("version mismatch");
+                return;
+            }
+            if (credits_requested_ && (flags & kWireHelloCredits)) {
+                expected += kWireCreditSize;
+            }
+        }
+        if (connection_->hello_received == expected) break;
+        
+        ssize_t n = recv(connection_->socket_fd, connection_->hello + connection_->hello_received,
+                         expected - connection_->hello_received, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n <= 0) {
+            scheduleReconnect(n == 0 ? "closed during handshake" : strerror(errno));
+            return;
+        }
+        connection_->hello_received += static_cast<size_t>(n);
     }
     
-    return true;
+    credits_active_ = connection_->hello_received > kWireHelloSize;
+    if (credits_active_) {
+        uint16_t stream_id = 0;
+        uint32_t window = 0;
+        if (!decodeWireCredit(connection_->hello + kWireHelloSize, stream_id, window) || stream_id != kWireAllStreams) {
+            std::cerr << "[TCP] Expected the initial credit window after the handshake" << std::endl;
+            scheduleReconnect("bad handshake");
+            return;
+        }
+        initial_credit_ = window;
+    }
+    acks_active_ = replay_requested_ && (flags & kWireHelloAcks);
+    markConnected();
 }
 
-bool TCPStreamingBackend::sendAudioData(const char* data, size_t length) {
-    uint32_t data_size = htonl(static_cast<uint32_t>(length));
+void TCPStreamingBackend::markConnected() {
+    int one = 1;
+    if (zerocopy_requested_) {
+#ifdef SO_ZEROCOPY
+        zerocopy_active_ = setsockopt(connection_->socket_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+#endif
+        if (!zerocopy_active_) {
+            std::cerr << "[TCP] MSG_ZEROCOPY not supported, sending with copies" << std::endl;
+        } else if (zerocopy_slots_.empty()) {
+            zerocopy_slots_.resize(kZeroCopyMaxPending);
+        }
+    }
     
-    // Send data size (4 bytes, network byte order)
-    if (send(connection_->socket_fd, &data_size, sizeof(data_size), 0) != sizeof(data_size)) {
-        std::cerr << "[TCP] Failed to send data size" << std::endl;
-        connection_->connected = false;
-        return false;
+    // From here on epoll is only asked when a send would block
+    watch(EPOLLOUT);
+    connection_->state = ConnectionState::Connected;
+    connection_->connected = true;
+    reachable_.store(true);
+    connection_->generation++;
+    connection_->failures = 0;
+    control_buffered_ = 0;
+    std::cout << "[TCP] ✓ Connected to audio processing server";
+    if (credits_active_) {
+        std::cout << " (flow control, " << initial_credit_ / 1024 << " KB per stream)";
     }
+    std::cout << std::endl;
     
-    // Send audio data
-    size_t bytes_sent = 0;
-    while (bytes_sent < length) {
-        ssize_t sent = send(connection_->socket_fd, data + bytes_sent, length - bytes_sent, 0);
-        if (sent <= 0) {
-            std::cerr << "[TCP] Failed to send audio data" << std::endl;
-            connection_->connected = false;
-            return false;
+    // Keep audio through the next outage only for a receiver that acknowledges it
+    replay_expected_ = acks_active_;
+    spill_failed_ = false;
+    spill_logged_ = false;
+    if (journal_size_ > 0) {
+        std::cout << "[TCP] Replaying " << journal_size_ << " frames the server has not acknowledged";
+        if (journal_spilled_ > 0) {
+            std::cout << " (" << spill_.diskBytes() / 1024 << " KB from disk)";
         }
-        bytes_sent += sent;
+        std::cout << std::endl;
+        replaying_ = true;
     }
-    
-    return true;
 }
 
-void TCPStreamingBackend::shutdown() {
-    std::lock_guard<std::mutex> lock(connection_mutex_);
+void TCPStreamingBackend::watch(uint32_t events) {
+    struct epoll_event event{};
+    event.events = events;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection_->socket_fd, &event);
+}
+
+bool TCPStreamingBackend::waitWritable() {
+    struct epoll_event event{};
+    int ready;
+    do {
+        ready = epoll_wait(epoll_fd_, &event, 1, kSendStallTimeoutMs);
+    } while (ready < 0 && errno == EINTR);
+    // On EPOLLERR the next send reports the error itself
+    return ready > 0 && (event.events & (EPOLLOUT | EPOLLERR));
+}
+
+void TCPStreamingBackend::scheduleReconnect(const char* reason) {
+    closeSocket();
+    connection_->state = ConnectionState::Idle;
+    
+    // Exponential backoff with jitter, so a fleet of bots doesn't reconnect in lockstep
+    uint32_t shift = std::min<uint32_t>(connection_->failures, 16);
+    int64_t ceiling = std::min<int64_t>(kReconnectMaxDelayMs, static_cast<int64_t>(kReconnectBaseDelayMs) << shift);
+    int64_t delay = ceiling / 2 + static_cast<int64_t>(backoff_rng_() % static_cast<uint32_t>(ceiling / 2 + 1));
+    connection_->failures++;
+    connection_->next_attempt = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay);
+    
+    // Rotate through the resolved addresses
+    next_address_ = (next_address_ + 1) % addresses_.size();
     
+    std::cerr << "[TCP] Connection to " << connection_->host << ":" << connection_->port << " failed ("
+              << reason << "), retrying in " << delay << " ms" << std::endl;
+}
+
+void TCPStreamingBackend::closeSocket() {
     if (connection_->socket_fd != -1) {
-        close(connection_->socket_fd);
+        close(connection_->socket_fd);   // also leaves the epoll set
         connection_->socket_fd = -1;
     }
     connection_->connected = false;
+    reachable_.store(false);
+    connection_->state = ConnectionState::Idle;
+    credits_active_ = false;
+    acks_active_ = false;
+    journal_sent_ = 0;   // everything unacknowledged goes out again on the next connection
     
-    std::cout << "[TCP] Connection closed" << std::endl;
+    // The counter restarts with the next socket; the old completions will never come.
+    // The kernel holds its own page references, so dropping the frames here is safe.
+    releaseZeroCopy();
+    zerocopy_active_ = false;
+    zerocopy_next_id_ = 0;
 }
 
-// ============================================================================
-// AudioStreamer Implementation
-// ============================================================================
+TCPStreamingBackend::WireStream* TCPStreamingBackend::wireStreamFor(uint32_t user_id, const AudioFrameRef& frame) {
+    // One stream per (participant, format), like the capture side
+    FormatKey key{user_id, frame->sampleRate, frame->channels, frame->format};
+    auto it = wire_stream_ids_.find(key);
+    if (it == wire_stream_ids_.end()) {
+        if (wire_streams_.size() >= kWireAllStreams) {   // the last id stands for all streams in credits
+            std::cerr << "[TCP] Out of stream ids, dropping audio for user " << user_id << std::endl;
+            return nullptr;
+        }
+        WireStream stream;
+        stream.user_id = user_id;
+        stream.sample_rate = frame->sampleRate;
+        stream.channels = frame->channels;
+        stream.format = frame->format;
+        it = wire_stream_ids_.emplace(key, static_cast<uint16_t>(wire_streams_.size())).first;
+        wire_streams_.push_back(std::move(stream));
+    }
+    return &wire_streams_[it->second];
+}
 
-AudioStreamer::AudioStreamer() 
-    : running_(false), connected_(false) {}
+void TCPStreamingBackend::noteDropped(const AudioChunk& chunk, DropReason reason) {
+    std::lock_guard<std::mutex> lock(connection_mutex_);
+    recordDropped(chunk, reason);
+}
 
-AudioStreamer::~AudioStreamer() {
-    stop();
+void TCPStreamingBackend::recordDropped(const AudioChunk& chunk, DropReason reason) {
+    if (protocol_ != StreamProtocol::Binary) {
+        return;   // the JSON framing has no way to say so
+    }
+    WireStream* stream = wireStreamFor(chunk.user_id, chunk.frame);
+    if (!stream) {
+        return;
+    }
+    // Dropped frames still use up their sequence numbers
+    uint32_t sequence = stream->next_sequence++;
+    if (journaling()) {
+        // Announced when the journal gets there, so the notice stays in order with the audio around it
+        journalAppend(static_cast<uint16_t>(stream - wire_streams_.data()), sequence, chunk, false);
+        journalAt(journal_size_ - 1).reason = reason;
+        return;
+    }
+    noteGap(*stream, sequence, reason, chunk.priority);
 }
 
-bool AudioStreamer::initialize(const std::string& backend_type, const std::string& config) {
-    if (backend_type == "tcp") {
-        backend_ = std::make_unique<TCPStreamingBackend>();
-    } else {
-        std::cerr << "[STREAMER] Unsupported backend type: " << backend_type << std::endl;
-        return false;
+// Adds sequence to the stream's pending drop notice; one notice covers the run
+void TCPStreamingBackend::noteGap(WireStream& stream, uint32_t sequence, DropReason reason, StreamPriority priority) {
+    if (stream.dropped_count == 0) {
+        stream.dropped_first = sequence;
     }
+    stream.dropped_count = sequence - stream.dropped_first + 1;
+    stream.dropped_reason = reason;
+    stream.dropped_priority = priority;
+}
+
+bool TCPStreamingBackend::streamAudio(uint32_t user_id, const std::string& user_name, const AudioFrameRef& frame) {
+    // Not on the streamer's path (it sends batches); the chunk may outlive this call in the journal
+    AudioChunk chunk;
+    chunk.user_id = user_id;
+    chunk.user_name = std::make_shared<const std::string>(user_name);
+    chunk.frame = frame;
+    return streamBatch(&chunk, 1);
+}
+
+bool TCPStreamingBackend::streamBatch(const AudioChunk* chunks, size_t count) {
+    std::lock_guard<std::mutex> lock(connection_mutex_);
     
-    if (!backend_->initialize(config)) {
-        std::cerr << "[STREAMER] Failed to initialize backend" << std::endl;
-        backend_.reset();
+    bool connected = advance(0);
+    if (connected && journal_sent_ < journal_size_) {
+        // Audio the receiver hasn't acknowledged goes first, a slice at a time
+        connected = replayJournal(kReplaySliceBytes);
+    }
+    if (!connected || journal_sent_ < journal_size_) {
+        if (journaling()) {
+            // Queued behind the rest of the journal for when the receiver is back (or caught up)
+            for (size_t i = 0; i < count; ++i) {
+                keepForReplay(chunks[i]);
+            }
+            enforceJournalLimits();
+            if (connected && (credits_active_ || acks_active_)) readControl();
+            return true;
+        }
+        // Not connected (yet): drop the batch without waiting; frames that never
+        // went out are announced once the receiver is back
+        for (size_t i = 0; i < count; ++i) {
+            recordDropped(chunks[i], DropReason::Unavailable);
+        }
         return false;
     }
     
-    connected_.store(true);
-    std::cout << "[STREAMER] ✓ Initialized " << backend_type << " streaming backend" << std::endl;
+    batch_headers_.clear();
+    batch_pieces_.clear();
+    bool all = true;
+    for (size_t i = 0; i < count; ++i) {
+        const AudioChunk& chunk = chunks[i];
+        if (protocol_ == StreamProtocol::Binary) {
+            all = appendWireFrame(chunk) && all;
+        } else {
+            appendJsonFrame(chunk.user_id, *chunk.user_name, chunk.frame);
+        }
+    }
+    // With acks the frames are in the journal now, so a failed send only delays them
+    bool kept = acks_active_;
+    if (!sendBatch(chunks, count)) {
+        enforceJournalLimits();
+        return kept;
+    }
+    if (credits_active_ || acks_active_) readControl();
+    enforceJournalLimits();
+    return all;
+}
+
+void TCPStreamingBackend::syncCredit(WireStream& stream) {
+    // Credit doesn't outlive the connection; every stream starts the next one with the full window
+    if (stream.credit_on != connection_->generation) {
+        stream.credit = initial_credit_;
+        stream.credit_on = connection_->generation;
+    }
+}
+
+bool TCPStreamingBackend::takeCredit(const AudioChunk& chunk) {
+    std::lock_guard<std::mutex> lock(connection_mutex_);
+    if (!credits_active_ || connection_->state != ConnectionState::Connected || journal_sent_ < journal_size_) {
+        return true;   // nothing to wait for; a disconnected send drops it, a replay charges it
+    }
+    WireStream* stream = wireStreamFor(chunk.user_id, chunk.frame);
+    if (!stream) {
+        return true;
+    }
+    syncCredit(*stream);
+    
+    // Sending while any credit is left lets a window smaller than one frame still make progress
+    if (stream->credit <= 0) {
+        if (!stream->starved) {
+            stream->starved = true;
+            credit_stalls_++;
+        }
+        return false;
+    }
+    stream->starved = false;
+    stream->credit -= static_cast<int64_t>(chunk.frame->size());
     return true;
 }
 
-void AudioStreamer::queueAudio(uint32_t user_id, const std::string& user_name,
-                              const char* data, size_t length,
-                              uint32_t sample_rate, uint16_t channels) {
-    if (!backend_ || !running_.load()) {
+void TCPStreamingBackend::waitForCredit(std::chrono::microseconds timeout) {
+    std::lock_guard<std::mutex> lock(connection_mutex_);
+    if (!credits_active_ || connection_->state != ConnectionState::Connected) {
         return;
     }
     
-    auto chunk = std::make_unique<AudioChunk>(user_id, user_name, data, length, sample_rate, channels);
-    
-    {
-        std::lock_guard<std::mutex> lock(queue_mutex_);
-        audio_queue_.push(std::move(chunk));
+    // Pending zero-copy completions would end the wait at once
+    reapZeroCopy();
+    struct pollfd pfd{connection_->socket_fd, POLLIN, 0};
+    struct timespec wait{};
+    wait.tv_sec = static_cast<time_t>(timeout.count() / 1000000);
+    wait.tv_nsec = static_cast<long>(timeout.count() % 1000000 * 1000);
+    if (ppoll(&pfd, 1, &wait, nullptr) > 0) {
+        readControl();
+    }
+}
+
+// Applies every credit and ack the receiver has sent so far, without blocking
+void TCPStreamingBackend::readControl() {
+    for (;;) {
+        ssize_t n = recv(connection_->socket_fd, control_buf_ + control_buffered_,
+                         sizeof(control_buf_) - control_buffered_, MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n <= 0) {
+            scheduleReconnect(n == 0 ? "closed by server" : strerror(errno));
+            return;
+        }
+        control_buffered_ += static_cast<size_t>(n);
         
-        // Prevent queue from growing too large (drop old data)
-        const size_t MAX_QUEUE_SIZE = 1000;
-        while (audio_queue_.size() > MAX_QUEUE_SIZE) {
-            std::cout << "[STREAMER] Warning: Queue overflow, dropping old audio data" << std::endl;
-            audio_queue_.pop();
+        bool acked = false;
+        size_t offset = 0;
+        for (; offset + kWireCreditSize <= control_buffered_; offset += kWireCreditSize) {
+            const char* message = control_buf_ + offset;
+            uint16_t stream_id = 0;
+            uint32_t value = 0;
+            bool is_ack = static_cast<uint8_t>(message[0]) == kWireAck;
+            if (!(is_ack ? decodeWireAck(message, stream_id, value) : decodeWireCredit(message, stream_id, value))) {
+                std::cerr << "[TCP] Unexpected message from server" << std::endl;
+                scheduleReconnect("protocol error");
+                return;
+            }
+            if (stream_id >= wire_streams_.size()) {
+                continue;   // not one of ours
+            }
+            WireStream& stream = wire_streams_[stream_id];
+            if (is_ack) {
+                if (static_cast<int32_t>(value - stream.acked) > 0) {
+                    stream.acked = value;
+                    acked = true;
+                }
+            } else {
+                syncCredit(stream);
+                stream.credit += value;
+            }
+        }
+        // Keep a partial message for the next read
+        control_buffered_ -= offset;
+        memmove(control_buf_, control_buf_ + offset, control_buffered_);
+        if (acked) {
+            trimJournal();
         }
     }
-    
-    queue_cv_.notify_one();
 }
 
-void AudioStreamer::start() {
-    if (running_.load() || !backend_) {
-        return;
+// ---------------------------------------------------------------------------
+// Replay journal
+// ---------------------------------------------------------------------------
+
+static bool isAcked(uint32_t acked, uint32_t sequence) {
+    return static_cast<int32_t>(sequence - acked) < 0;
+}
+
+bool TCPStreamingBackend::journaling() const {
+    if (protocol_ != StreamProtocol::Binary) {
+        return false;
+    }
+    // Whatever is already in the journal decides the order, receiver or not
+    if (connection_->state == ConnectionState::Connected) {
+        return acks_active_ || journal_size_ > 0;
+    }
+    return replay_expected_ || journal_size_ > 0;
+}
+
+void TCPStreamingBackend::journalAppend(uint16_t stream_id, uint32_t sequence, const AudioChunk& chunk, bool audio) {
+    if (journal_size_ == journal_.size()) {
+        if (journal_.size() < kJournalMaxEntries) {
+            // Grows during warm-up and long outages only; entries keep their order
+            std::vector<JournalEntry> grown(journal_.empty() ? 1024 : journal_.size() * 2);
+            for (size_t i = 0; i < journal_size_; ++i) {
+                grown[i] = std::move(journalAt(i));
+            }
+            journal_.swap(grown);
+            journal_head_ = 0;
+        } else {
+            // Out of entries: the oldest goes for good
+            JournalEntry& oldest = journalAt(0);
+            if (journal_sent_ == 0 && !isAcked(wire_streams_[oldest.stream_id].acked, oldest.sequence)) {
+                noteGap(wire_streams_[oldest.stream_id], oldest.sequence, DropReason::Unavailable, oldest.priority);
+                journal_dropped_++;
+            }
+            popJournalHead();
+            releaseSpilled();
+        }
     }
     
-    running_.store(true);
-    worker_thread_ = std::thread(&AudioStreamer::workerLoop, this);
-    
-    std::cout << "[STREAMER] ✓ Started audio streaming worker thread" << std::endl;
+    JournalEntry& entry = journalAt(journal_size_++);
+    entry.stream_id = stream_id;
+    entry.priority = chunk.priority;
+    entry.stored = false;
+    entry.reason = DropReason::Unavailable;
+    entry.sequence = sequence;
+    entry.user_name = chunk.user_name;
+    entry.silent_samples = 0;
+    if (audio && chunk.frame->silentSamples > 0) {
+        entry.len = 0;
+        entry.silent_samples = chunk.frame->silentSamples;
+        entry.capture_time_ms = chunk.frame->captureTimeMs;
+    } else if (audio) {
+        entry.len = static_cast<uint32_t>(chunk.frame->size());
+        entry.capture_time_ms = chunk.frame->captureTimeMs;
+        entry.frame = chunk.frame;
+        journal_memory_ += entry.len;
+    } else {
+        entry.len = 0;
+    }
 }
 
-void AudioStreamer::stop() {
-    if (!running_.load()) {
+void TCPStreamingBackend::keepForReplay(const AudioChunk& chunk) {
+    WireStream* stream = wireStreamFor(chunk.user_id, chunk.frame);
+    if (!stream) {
         return;
     }
-    
-    std::cout << "[STREAMER] Stopping audio streamer..." << std::endl;
-    running_.store(false);
-    queue_cv_.notify_all();
-    
-    if (worker_thread_.joinable()) {
-        worker_thread_.join();
+    journalAppend(static_cast<uint16_t>(stream - wire_streams_.data()), stream->next_sequence++, chunk, true);
+}
+
+void TCPStreamingBackend::popJournalHead() {
+    JournalEntry& entry = journalAt(0);
+    if (journal_spilled_ > 0) {
+        journal_spilled_--;
+    } else {
+        journal_memory_ -= entry.len;
     }
-    
-    if (backend_) {
-        backend_->shutdown();
+    if (journal_sent_ > 0) journal_sent_--;
+    if (journal_unstored_ > 0) journal_unstored_--;
+    entry.frame.reset();
+    entry.user_name.reset();
+    journal_head_ = (journal_head_ + 1) % journal_.size();
+    journal_size_--;
+}
+
+// Drops what the receiver has acknowledged from the front
+void TCPStreamingBackend::trimJournal() {
+    bool connected = connection_->state == ConnectionState::Connected;
+    while (journal_size_ > 0) {
+        JournalEntry& entry = journalAt(0);
+        // A receiver without acks gets the journal once
+        bool done = isAcked(wire_streams_[entry.stream_id].acked, entry.sequence) ||
+                    (connected && !acks_active_ && journal_sent_ > 0);
+        if (!done) break;
+        popJournalHead();
     }
-    
-    // Clear queue
-    {
-        std::lock_guard<std::mutex> lock(queue_mutex_);
-        while (!audio_queue_.empty()) {
-            audio_queue_.pop();
+    releaseSpilled();
+}
+
+// Gives back spill log segments nothing in the journal needs any more
+void TCPStreamingBackend::releaseSpilled() {
+    while (journal_unstored_ < journal_spilled_ && !journalAt(journal_unstored_).stored) {
+        journal_unstored_++;
+    }
+    spill_.release(journal_unstored_ < journal_spilled_ ? journalAt(journal_unstored_).offset
+                                                        : std::numeric_limits<uint64_t>::max());
+}
+
+// Moves the oldest in-memory entry to disk; false if it had to be dropped instead
+bool TCPStreamingBackend::spillNext() {
+    JournalEntry& entry = journalAt(journal_spilled_);
+    bool kept = true;
+    if (entry.frame && !isAcked(wire_streams_[entry.stream_id].acked, entry.sequence)) {
+        if (!spill_logged_) {
+            std::cout << "[TCP] Over " << replay_memory_ / 1024 << " KB of unacknowledged audio, spilling to "
+                      << spill_.directory() << std::endl;
+            spill_logged_ = true;
+        }
+        kept = !spill_failed_ && spill_.append(entry.frame->data(), entry.len, entry.offset);
+        if (kept) {
+            entry.stored = true;
+            spilled_frames_++;
+        } else {
+            if (!spill_failed_) {
+                std::cerr << "[TCP] Failed to write spill log in " << spill_.directory() << ": " << strerror(errno)
+                          << ", dropping the oldest audio instead" << std::endl;
+                spill_failed_ = true;
+            }
+            journal_dropped_++;
         }
     }
+    if (entry.frame) {
+        entry.frame.reset();
+        journal_memory_ -= entry.len;
+    }
+    journal_spilled_++;
+    return kept;
+}
+
+void TCPStreamingBackend::enforceJournalLimits() {
+    while (journal_memory_ > replay_memory_ && journal_spilled_ < journal_size_) {
+        spillNext();
+    }
     
-    connected_.store(false);
-    std::cout << "[STREAMER] ✓ Audio streamer stopped" << std::endl;
+    // Past the disk limit the oldest spilled audio goes, a segment at a time
+    if (spill_.diskBytes() > spill_limit_) {
+        std::cerr << "[TCP] Spill log over " << (spill_limit_ >> 20) << " MB, dropping the oldest audio" << std::endl;
+        while (spill_.diskBytes() > spill_limit_ && journal_unstored_ < journal_spilled_) {
+            JournalEntry& entry = journalAt(journal_unstored_);
+            if (entry.stored) {
+                entry.stored = false;
+                journal_dropped_++;
+            }
+            journal_unstored_++;
+            releaseSpilled();
+        }
+    }
 }
 
-void AudioStreamer::workerLoop() {
-    std::cout << "[STREAMER] Worker thread started" << std::endl;
+// Sends the next slice of the journal not yet sent on this connection; false if the send failed
+bool TCPStreamingBackend::replayJournal(size_t max_bytes) {
+    batch_headers_.clear();
+    batch_pieces_.clear();
+    if (replay_buf_.size() < kReplaySliceBytes) {
+        replay_buf_.resize(kReplaySliceBytes);   // once
+    }
     
-    while (running_.load()) {
-        std::unique_ptr<AudioChunk> chunk;
+    size_t used = 0;      // of replay_buf_
+    size_t bytes = 0;
+    size_t frames = 0;
+    size_t pieced = 0;    // batch_headers_ bytes already covered by a piece
+    size_t next = journal_sent_;
+    while (next < journal_size_ && bytes < max_bytes && batch_pieces_.size() + 2 < IOV_MAX) {
+        JournalEntry& entry = journalAt(next);
+        WireStream& stream = wire_streams_[entry.stream_id];
+        if (isAcked(stream.acked, entry.sequence)) {
+            next++;
+            continue;
+        }
         
-        // Get next chunk from queue
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex_);
-            queue_cv_.wait(lock, [this] { 
-                return !audio_queue_.empty() || !running_.load(); 
-            });
-            
-            if (!running_.load()) {
-                break;
+        if (entry.silent_samples > 0) {
+            appendWirePreamble(stream, entry.stream_id, entry.user_name ? *entry.user_name : stream.user_name);
+            char silence[kWireSilenceSize];
+            encodeWireSilence(silence, entry.stream_id, entry.sequence, static_cast<uint64_t>(entry.capture_time_ms),
+                              entry.silent_samples);
+            batch_headers_.append(silence, sizeof(silence));
+            next++;
+            frames++;
+            continue;
+        }
+        
+        const char* data = nullptr;
+        if (entry.frame) {
+            data = entry.frame->data();
+        } else if (entry.stored) {
+            if (used + entry.len > replay_buf_.size()) {
+                if (used > 0) break;          // the rest goes in the next slice
+                replay_buf_.resize(entry.len);
             }
-            
-            if (!audio_queue_.empty()) {
-                chunk = std::move(audio_queue_.front());
-                audio_queue_.pop();
+            if (spill_.read(entry.offset, replay_buf_.data() + used, entry.len)) {
+                data = replay_buf_.data() + used;
+                used += entry.len;
+            } else {
+                std::cerr << "[TCP] Failed to read spill log: " << strerror(errno) << std::endl;
+                journal_dropped_++;
             }
         }
+        next++;
         
-        // Process chunk
-        if (chunk && backend_) {
-            bool success = backend_->streamAudio(
-                chunk->user_id, chunk->user_name,
-                chunk->data.data(), chunk->data.size(),
-                chunk->sample_rate, chunk->channels
-            );
-            
-            if (!success) {
-                std::cerr << "[STREAMER] Failed to stream audio for user " 
-                          << chunk->user_id << " (" << chunk->user_name << ")" << std::endl;
-                connected_.store(false);
-                
-                // Try to reconnect after a short delay
-                std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-                if (backend_->initialize("localhost:8888")) { // TODO: store config
-                    connected_.store(true);
-                }
-            } else {
-                connected_.store(true);
+        if (!data) {
+            // Shed or lost: announced ahead of the stream's next audio, like live drops
+            noteGap(stream, entry.sequence, entry.reason, entry.priority);
+            continue;
+        }
+        appendWirePreamble(stream, entry.stream_id, entry.user_name ? *entry.user_name : stream.user_name);
+        char header[kWireAudioHeaderSize];
+        encodeWireAudioHeader(header, entry.stream_id, entry.sequence, static_cast<uint64_t>(entry.capture_time_ms),
+                              entry.len);
+        batch_headers_.append(header, sizeof(header));
+        batch_pieces_.push_back({nullptr, pieced, batch_headers_.size() - pieced});
+        batch_pieces_.push_back({data, 0, entry.len});
+        pieced = batch_headers_.size();
+        if (credits_active_) {
+            syncCredit(stream);
+            stream.credit -= entry.len;
+        }
+        bytes += entry.len;
+        frames++;
+    }
+    if (batch_headers_.size() > pieced) {
+        batch_pieces_.push_back({nullptr, pieced, batch_headers_.size() - pieced});
+    }
+    
+    // The buffer is reused for the next slice, so no zero-copy here
+    if (!batch_pieces_.empty() && !sendBatch(nullptr, 0)) {
+        return false;
+    }
+    journal_sent_ = next;
+    replayed_frames_ += frames;
+    if (replaying_ && journal_sent_ == journal_size_) {
+        std::cout << "[TCP] ✓ Replay caught up (" << replayed_frames_ << " frames replayed so far)" << std::endl;
+        replaying_ = false;
+    }
+    if (!acks_active_) {
+        trimJournal();
+    }
+    return true;
+}
+
+void TCPStreamingBackend::flush(std::chrono::steady_clock::time_point deadline) {
+    std::lock_guard<std::mutex> lock(connection_mutex_);
+    
+    while (journal_size_ > 0) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) break;
+        int remaining_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count());
+        int step_ms = remaining_ms < 100 ? remaining_ms + 1 : 100;
+        
+        if (!advance(step_ms)) {
+            if (connection_->state == ConnectionState::Idle) {
+                if (connection_->next_attempt >= deadline) break;
+                std::this_thread::sleep_until(connection_->next_attempt);
             }
+            continue;
+        }
+        if (journal_sent_ < journal_size_) {
+            if (replayJournal(kReplaySliceBytes) && (credits_active_ || acks_active_)) readControl();
+            continue;
+        }
+        if (!acks_active_) break;
+        
+        // All sent: wait for the receiver to acknowledge it
+        struct pollfd pfd{connection_->socket_fd, POLLIN, 0};
+        if (poll(&pfd, 1, step_ms) > 0) {
+            readControl();
         }
     }
     
-    std::cout << "[STREAMER] Worker thread finished" << std::endl;
+    size_t unacked = 0;
+    for (size_t i = 0; i < journal_size_; ++i) {
+        JournalEntry& entry = journalAt(i);
+        if ((entry.frame || entry.stored || entry.silent_samples > 0) &&
+            !isAcked(wire_streams_[entry.stream_id].acked, entry.sequence)) {
+            unacked++;
+        }
+    }
+    if (unacked > 0) {
+        std::cerr << "[TCP] " << unacked << " frames not acknowledged by the server at shutdown" << std::endl;
+    }
 }
 
-size_t AudioStreamer::getQueueSize() const {
-    std::lock_guard<std::mutex> lock(queue_mutex_);
-    return audio_queue_.size();
+void TCPStreamingBackend::maintain() {
+    std::lock_guard<std::mutex> lock(connection_mutex_);
+    if (zerocopy_pending_ > 0) {
+        // Without new sends nothing else collects completions, and the frames stay held
+        reapZeroCopy();
+        // A socket error shows up as POLLERR too; notice it now rather than at the next send
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (getsockopt(connection_->socket_fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error != 0) {
+            scheduleReconnect(strerror(error));
+            return;
+        }
+    }
+    if (!advance(0)) {
+        return;
+    }
+    if (journal_sent_ < journal_size_ && !replayJournal(kReplaySliceBytes)) {
+        return;
+    }
+    if (credits_active_ || acks_active_) readControl();
 }
 
-bool AudioStreamer::isConnected() const {
-    return connected_.load();
+int TCPStreamingBackend::completionFd() {
+    std::lock_guard<std::mutex> lock(connection_mutex_);
+    return zerocopy_pending_ > 0 ? connection_->socket_fd : -1;
+}
+
+// Json compat stand-in for the samples of a silence marker, sent as many times as it takes
+static const char kZeroPcm[64 * 1024] = {};
+
+void TCPStreamingBackend::appendJsonFrame(uint32_t user_id, const std::string& user_name, const AudioFrameRef& frame) {
+    // Json receivers predate silence markers: a PCM gap goes out as that many zero
+    // samples, and an Opus gap, which no packet stands for, is left out
+    size_t size = frame->size();
+    if (frame->silentSamples > 0) {
+        if (frame->format != AudioFormat::PcmS16LE) {
+            return;
+        }
+        size = static_cast<size_t>(frame->silentSamples) * frame->channels * sizeof(int16_t);
+    }
+    
+    long long timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    formatJsonAudioHeader(header_buf_, user_id, user_name, frame->sampleRate, frame->channels,
+                          static_cast<uint8_t>(frame->format), timestamp);
+    
+    // Header size, header JSON, data size (network byte order), then the samples
+    size_t offset = batch_headers_.size();
+    uint32_t header_size = htonl(static_cast<uint32_t>(header_buf_.size()));
+    uint32_t data_size = htonl(static_cast<uint32_t>(size));
+    batch_headers_.append(reinterpret_cast<const char*>(&header_size), sizeof(header_size));
+    batch_headers_ += header_buf_;
+    batch_headers_.append(reinterpret_cast<const char*>(&data_size), sizeof(data_size));
+    batch_pieces_.push_back({nullptr, offset, batch_headers_.size() - offset});
+    if (frame->silentSamples == 0) {
+        batch_pieces_.push_back({frame->data(), 0, size});
+        return;
+    }
+    for (size_t left = size; left > 0;) {
+        size_t take = std::min(left, sizeof(kZeroPcm));
+        batch_pieces_.push_back({kZeroPcm, 0, take});
+        left -= take;
+    }
+}
+
+// Declaration (when due) and pending drop notice, ahead of the stream's next message
+void TCPStreamingBackend::appendWirePreamble(WireStream& stream, uint16_t stream_id, const std::string& user_name) {
+    // Metadata goes out once per connection, and again only if the display name changes.
+    // If the send fails the connection goes with it, and the next one declares again.
+    if (stream.declared_on != connection_->generation || stream.user_name != user_name) {
+        stream.user_name = user_name;
+        stream.declared_on = connection_->generation;
+        appendWireStreamDeclare(batch_headers_, stream_id, stream.user_id, stream.sample_rate, stream.channels,
+                                static_cast<uint8_t>(stream.format), user_name);
+    }
+    if (stream.dropped_count > 0) {
+        char notice[kWireDroppedSize];
+        encodeWireDropped(notice, stream_id, stream.dropped_first, stream.dropped_count,
+                          static_cast<uint8_t>(stream.dropped_reason), static_cast<uint8_t>(stream.dropped_priority));
+        batch_headers_.append(notice, sizeof(notice));
+        stream.dropped_count = 0;
+    }
+}
+
+bool TCPStreamingBackend::appendWireFrame(const AudioChunk& chunk) {
+    WireStream* found = wireStreamFor(chunk.user_id, chunk.frame);
+    if (!found) {
+        return false;
+    }
+    WireStream& stream = *found;
+    uint16_t stream_id = static_cast<uint16_t>(found - wire_streams_.data());
+    size_t offset = batch_headers_.size();
+    appendWirePreamble(stream, stream_id, *chunk.user_name);
+    
+    uint32_t sequence = stream.next_sequence++;
+    if (chunk.frame->silentSamples > 0) {
+        char silence[kWireSilenceSize];
+        encodeWireSilence(silence, stream_id, sequence, static_cast<uint64_t>(chunk.frame->captureTimeMs),
+                          chunk.frame->silentSamples);
+        batch_headers_.append(silence, sizeof(silence));
+        batch_pieces_.push_back({nullptr, offset, batch_headers_.size() - offset});
+    } else {
+        char header[kWireAudioHeaderSize];
+        encodeWireAudioHeader(header, stream_id, sequence, static_cast<uint64_t>(chunk.frame->captureTimeMs),
+                              static_cast<uint32_t>(chunk.frame->size()));
+        batch_headers_.append(header, sizeof(header));
+        batch_pieces_.push_back({nullptr, offset, batch_headers_.size() - offset});
+        batch_pieces_.push_back({chunk.frame->data(), 0, chunk.frame->size()});
+    }
+    
+    if (acks_active_) {
+        // Held until acknowledged; it is part of what this connection has sent
+        journalAppend(stream_id, sequence, chunk, true);
+        journal_sent_++;
+    }
+    return true;
+}
+
+bool TCPStreamingBackend::sendBatch(const AudioChunk* chunks, size_t count) {
+    batch_iov_.resize(batch_pieces_.size());
+    for (size_t i = 0; i < batch_pieces_.size(); ++i) {
+        const BatchPiece& piece = batch_pieces_[i];
+        const char* base = piece.data ? piece.data : batch_headers_.data() + piece.offset;
+        batch_iov_[i].iov_base = const_cast<char*>(base);
+        batch_iov_[i].iov_len = piece.len;
+    }
+    return sendv(batch_iov_.data(), batch_iov_.size(), count == 1 ? "audio frame" : "audio batch", chunks, count);
+}
+
+bool TCPStreamingBackend::sendv(struct iovec* iov, size_t count, const char* what,
+                                const AudioChunk* chunks, size_t chunk_count) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += iov[i].iov_len;
+    }
+    
+    bool zerocopy = false;
+    if (zerocopy_active_ && chunks && total >= kZeroCopyMinBytes) {
+        reapZeroCopy();
+        zerocopy = zerocopy_pending_ + chunk_count <= zerocopy_slots_.size();
+    }
+    
+    bool pinned = false;   // some call went out zero-copy
+    struct msghdr msg{};
+    msg.msg_iov = iov;
+    size_t remaining = count;
+    while (remaining > 0) {
+        // Large batches go out IOV_MAX pieces at a time
+        msg.msg_iovlen = std::min<size_t>(remaining, IOV_MAX);
+        int flags = MSG_NOSIGNAL;
+#ifdef MSG_ZEROCOPY
+        if (zerocopy) flags |= MSG_ZEROCOPY;
+#endif
+        ssize_t sent = sendmsg(connection_->socket_fd, &msg, flags);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && zerocopy && errno == ENOBUFS) {
+            // Out of pinned-page budget (optmem): copy this one
+            zerocopy = false;
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Socket full (or past TCP_NOTSENT_LOWAT): wait for the receiver, within reason
+            if (waitWritable()) continue;
+            std::cerr << "[TCP] Receiver stopped reading " << what << std::endl;
+            scheduleReconnect("send stalled");
+            return false;
+        }
+        if (sent <= 0) {
+            std::cerr << "[TCP] Failed to send " << what << ": " << strerror(errno) << std::endl;
+            scheduleReconnect(strerror(errno));
+            return false;
+        }
+        if (zerocopy) {
+            zerocopy_next_id_++;
+            zerocopy_sends_++;
+            pinned = true;
+        }
+        
+        // Skip what went out; a short send resumes inside the current piece
+        size_t done = static_cast<size_t>(sent);
+        while (remaining > 0 && done >= msg.msg_iov->iov_len) {
+            done -= msg.msg_iov->iov_len;
+            ++msg.msg_iov;
+            --remaining;
+        }
+        if (remaining > 0) {
+            msg.msg_iov->iov_base = static_cast<char*>(msg.msg_iov->iov_base) + done;
+            msg.msg_iov->iov_len -= done;
+        }
+    }
+    
+    if (pinned) {
+        // The kernel still reads from the frames; keep them until the last call's completion
+        for (size_t i = 0; i < chunk_count; ++i) {
+            ZeroCopySlot& slot = zerocopy_slots_[(zerocopy_head_ + zerocopy_pending_) % zerocopy_slots_.size()];
+            slot.id = zerocopy_next_id_ - 1;
+            slot.frame = chunks[i].frame;
+            zerocopy_pending_++;
+        }
+        // Only sendBatch passes chunks, so the headers are in batch_headers_
+        holdZeroCopyHeaders();
+    }
+    return true;
+}
+
+// Keeps the headers of the batch just sent until its completion; the next batch is
+// built in a buffer whose send has completed (or a new one, while the ring grows)
+void TCPStreamingBackend::holdZeroCopyHeaders() {
+    if (zerocopy_headers_pending_ == zerocopy_headers_.size()) {
+        std::vector<ZeroCopyHeaders> grown(std::max<size_t>(16, zerocopy_headers_.size() * 2));
+        for (size_t i = 0; i < zerocopy_headers_.size(); ++i) {
+            grown[i] = std::move(zerocopy_headers_[(zerocopy_headers_head_ + i) % zerocopy_headers_.size()]);
+        }
+        zerocopy_headers_.swap(grown);
+        zerocopy_headers_head_ = 0;
+    }
+    ZeroCopyHeaders& held = zerocopy_headers_[(zerocopy_headers_head_ + zerocopy_headers_pending_) % zerocopy_headers_.size()];
+    held.id = zerocopy_next_id_ - 1;
+    held.bytes.swap(batch_headers_);
+    zerocopy_headers_pending_++;
+}
+
+void TCPStreamingBackend::reapZeroCopy() {
+    while (zerocopy_pending_ > 0) {
+        char control[128];
+        struct msghdr msg{};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(connection_->socket_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            return;   // nothing completed yet
+        }
+        
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            bool recverr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                           (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+            if (!recverr) continue;
+            struct sock_extended_err err;
+            memcpy(&err, CMSG_DATA(cm), sizeof(err));
+            if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+            
+            // Sends ee_info..ee_data (inclusive) are done with their buffers
+            if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                zerocopy_copied_ += err.ee_data - err.ee_info + 1;
+            }
+            while (zerocopy_pending_ > 0) {
+                ZeroCopySlot& slot = zerocopy_slots_[zerocopy_head_];
+                if (static_cast<int32_t>(slot.id - err.ee_data) > 0) break;
+                slot.frame.reset();
+                zerocopy_head_ = (zerocopy_head_ + 1) % zerocopy_slots_.size();
+                zerocopy_pending_--;
+            }
+            while (zerocopy_headers_pending_ > 0) {
+                const ZeroCopyHeaders& held = zerocopy_headers_[zerocopy_headers_head_];
+                if (static_cast<int32_t>(held.id - err.ee_data) > 0) break;
+                zerocopy_headers_head_ = (zerocopy_headers_head_ + 1) % zerocopy_headers_.size();
+                zerocopy_headers_pending_--;
+            }
+        }
+    }
+}
+
+void TCPStreamingBackend::releaseZeroCopy() {
+    while (zerocopy_pending_ > 0) {
+        zerocopy_slots_[zerocopy_head_].frame.reset();
+        zerocopy_head_ = (zerocopy_head_ + 1) % zerocopy_slots_.size();
+        zerocopy_pending_--;
+    }
+    zerocopy_head_ = 0;
+    zerocopy_headers_head_ = 0;
+    zerocopy_headers_pending_ = 0;
+}
+
+void TCPStreamingBackend::shutdown() {
+    std::lock_guard<std::mutex> lock(connection_mutex_);
+    
+    closeSocket();
+    if (zerocopy_sends_ > 0) {
+        std::cout << "[TCP] Zero-copy sends: " << zerocopy_sends_ << " (" << zerocopy_copied_
+                  << " completed by copying)" << std::endl;
+        zerocopy_sends_ = 0;
+        zerocopy_copied_ = 0;
+    }
+    if (credit_stalls_ > 0) {
+        std::cout << "[TCP] Streams ran out of receiver credit " << credit_stalls_ << " times" << std::endl;
+        credit_stalls_ = 0;
+    }
+    if (replayed_frames_ > 0 || journal_dropped_ > 0) {
+        std::cout << "[TCP] Replayed " << replayed_frames_ << " frames after reconnects (" << spilled_frames_
+                  << " spilled to disk, " << journal_dropped_ << " dropped)" << std::endl;
+    }
+    
+    // Whatever flush() couldn't deliver goes now
+    for (size_t i = 0; i < journal_size_; ++i) {
+        JournalEntry& entry = journalAt(i);
+        entry.frame.reset();
+        entry.user_name.reset();
+    }
+    journal_head_ = journal_size_ = journal_spilled_ = journal_sent_ = journal_unstored_ = journal_memory_ = 0;
+    replayed_frames_ = spilled_frames_ = journal_dropped_ = 0;
+    replaying_ = false;
+    spill_.clear();
+    
+    std::cout << "[TCP] Connection closed" << std::endl;
+}
+
+// ============================================================================
+// AudioStreamer Implementation
+// ============================================================================
+
+// Out-of-line definitions for the constants that are bound by reference
+// (std::min, std::chrono::milliseconds)
+const size_t AudioStreamer::kMaxShards;
+const int AudioStreamer::kIdleTickMs;
+const int AudioStreamer::kSinkRetryMaxMs;
+
+// Removes "name=value" from the options after '?' and returns the value, or "" if absent
+static std::string takeOption(std::string& config, const std::string& name) {
+    size_t query_pos = config.find('?');
+    if (query_pos == std::string::npos) return "";
+    
+    std::string value;
+    std::string rest;
+    std::stringstream options(config.substr(query_pos + 1));
+    std::string option;
+    while (std::getline(options, option, '&')) {
+        if (option.compare(0, name.size() + 1, name + "=") == 0) {
+            value = option.substr(name.size() + 1);
+        } else if (!option.empty()) {
+            rest += rest.empty() ? "" : "&";
+            rest += option;
+        }
+    }
+    config.erase(query_pos);
+    if (!rest.empty()) config += "?" + rest;
+    return value;
+}
+
+// splitmix64 finalizer
+static uint64_t mixHash(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// FNV-1a, mixed
+static uint64_t ringHash(const std::string& key) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (char c : key) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+    }
+    return mixHash(hash);
+}
+
+AudioStreamer::AudioStreamer() 
+    : running_(false), connected_(false), queue_(MAX_QUEUE_SIZE),
+      wake_threshold_(std::numeric_limits<int64_t>::max()), batch_(kMaxBatchFrames) {
+    for (auto& shed : shed_frames_) {
+        shed.store(0);
+    }
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        std::cerr << tag_ << " Failed to create eventfd: " << strerror(errno) << std::endl;
+    }
+}
+
+AudioStreamer::~AudioStreamer() {
+    stop();
+    if (wake_fd_ != -1) {
+        close(wake_fd_);
+    }
+}
+
+bool AudioStreamer::initialize(const std::string& backend_type, const std::string& config) {
+    if (running_.load()) {
+        std::cerr << tag_ << " Can't initialize while running" << std::endl;
+        return false;
+    }
+    ready_.store(false);
+    resetRouting();
+    if (!configure(backend_type, config)) {
+        resetRouting();
+        return false;
+    }
+    ready_.store(true);
+    return true;
+}
+
+// Forgets the shards, sinks and routes of an earlier initialize
+void AudioStreamer::resetRouting() {
+    shards_.clear();
+    sink_configs_.clear();
+    fanout_ = false;
+    ring_.clear();
+    endpoints_.clear();
+    routes_.reset();
+}
+
+bool AudioStreamer::configure(const std::string& backend_type, const std::string& config) {
+    if (config.find(';') != std::string::npos) {
+        // One streamer per sink, each configured independently; one that fails is
+        // kept and retried once streaming starts, so it can't hold up the others
+        std::stringstream sink_items(config);
+        std::string sink;
+        size_t ready = 0;
+        while (std::getline(sink_items, sink, ';')) {
+            if (sink.empty()) continue;
+            if (shards_.size() == kMaxShards) {
+                std::cerr << tag_ << " Too many sinks, ignoring " << sink << std::endl;
+                continue;
+            }
+            auto streamer = std::make_unique<AudioStreamer>();
+            streamer->tag_ = "[STREAMER " + sink.substr(0, sink.find('?')) + "]";
+            if (streamer->initialize(backend_type, sink)) {
+                ready++;
+            } else {
+                std::cerr << tag_ << " Sink " << sink << " failed to initialize, will keep retrying" << std::endl;
+            }
+            shards_.push_back(std::move(streamer));
+            sink_configs_.push_back(sink);
+        }
+        if (ready == 0) {
+            std::cerr << tag_ << " No sink could be initialized" << std::endl;
+            return false;
+        }
+        backend_type_ = backend_type;
+        fanout_ = true;
+        connected_.store(true);
+        std::cout << tag_ << " ✓ Streaming all audio to " << ready << " of " << shards_.size() << " sinks" << std::endl;
+        return true;
+    }
+    
+    // Batching and sharding options are ours; the rest goes to the backend
+    std::string backend_config = config;
+    std::string shards = takeOption(backend_config, "shards");
+    std::string cpus = takeOption(backend_config, "cpus");
+    std::vector<int> cpu_list;
+    std::stringstream cpu_items(cpus);
+    std::string cpu;
+    while (std::getline(cpu_items, cpu, ',')) {
+        if (!cpu.empty()) cpu_list.push_back(atoi(cpu.c_str()));
+    }
+    size_t shard_count = shards.empty() ? 1 : static_cast<size_t>(std::max(1, atoi(shards.c_str())));
+    shard_count = std::min(shard_count, kMaxShards);
+    std::string failover_ms = takeOption(backend_config, "failover_ms");
+    if (!failover_ms.empty()) {
+        failover_after_ = std::chrono::milliseconds(std::max(0, atoi(failover_ms.c_str())));
+    }
+    
+    size_t query_pos = backend_config.find('?');
+    std::string options = query_pos == std::string::npos ? "" : backend_config.substr(query_pos + 1);
+    std::vector<std::string> endpoints;
+    std::stringstream endpoint_items(backend_config.substr(0, query_pos));
+    std::string endpoint;
+    while (std::getline(endpoint_items, endpoint, ',')) {
+        if (!endpoint.empty()) endpoints.push_back(endpoint);
+    }
+    
+    if (endpoints.size() > 1) {
+        // One sharded streamer per endpoint; the CPU list continues where the last endpoint left off.
+        // One that fails to initialize stays on the ring as down, and is retried like a failed sink.
+        shards_.clear();
+        ring_.clear();
+        endpoints_.clear();
+        size_t ready = 0;
+        for (size_t e = 0; e < endpoints.size() && e < kMaxShards; ++e) {
+            std::string endpoint_config = endpoints[e] + "?shards=" + std::to_string(shard_count);
+            if (!cpu_list.empty()) {
+                endpoint_config += "&cpus=";
+                for (size_t i = 0; i < cpu_list.size(); ++i) {
+                    endpoint_config += (i ? "," : "") + std::to_string(cpu_list[(e * shard_count + i) % cpu_list.size()]);
+                }
+            }
+            if (!options.empty()) {
+                endpoint_config += "&" + options;
+            }
+            auto streamer = std::make_unique<AudioStreamer>();
+            streamer->tag_ = "[STREAMER " + endpoints[e] + "]";
+            if (streamer->initialize(backend_type, endpoint_config)) {
+                ready++;
+            } else {
+                std::cerr << tag_ << " Endpoint " << endpoints[e] << " failed to initialize, routing around it" << std::endl;
+            }
+            shards_.push_back(std::move(streamer));
+            sink_configs_.push_back(endpoint_config);
+            endpoints_.push_back(endpoints[e]);
+            
+            // Points depend only on the endpoint's name, so the ring doesn't change when others are added
+            for (size_t i = 0; i < kRingPoints; ++i) {
+                ring_.emplace_back(ringHash(endpoints[e] + "#" + std::to_string(i)), static_cast<uint16_t>(e));
+            }
+        }
+        if (ready == 0) {
+            std::cerr << tag_ << " No endpoint could be initialized" << std::endl;
+            return false;
+        }
+        backend_type_ = backend_type;
+        std::sort(ring_.begin(), ring_.end());
+        routes_.reset(new std::atomic<uint64_t>[kRouteSlots]);
+        for (size_t i = 0; i < kRouteSlots; ++i) {
+            routes_[i].store(0);
+        }
+        connected_.store(true);
+        std::cout << tag_ << " ✓ Routing participants across " << ready << " of " << shards_.size()
+                  << " endpoints (failover after " << failover_after_.count() << " ms)" << std::endl;
+        return true;
+    }
+    
+    if (shard_count > 1) {
+        // The remaining options (batching included) apply to every shard
+        shards_.clear();
+        for (size_t i = 0; i < shard_count; ++i) {
+            auto shard = std::make_unique<AudioStreamer>();
+            shard->tag_ = tag_.substr(0, tag_.size() - 1) + " " + std::to_string(i + 1) + "/" +
+                          std::to_string(shard_count) + "]";
+            shard->cpu_ = cpu_list.empty() ? -1 : cpu_list[i % cpu_list.size()];
+            if (!shard->initialize(backend_type, backend_config)) {
+                shards_.clear();
+                return false;
+            }
+            shards_.push_back(std::move(shard));
+        }
+        connected_.store(true);
+        std::cout << tag_ << " ✓ Initialized " << shard_count << " " << backend_type << " streaming shards" << std::endl;
+        return true;
+    }
+    if (!cpu_list.empty()) {
+        cpu_ = cpu_list[0];
+    }
+    
+    std::string batch_ms = takeOption(backend_config, "batch_ms");
+    std::string batch_kb = takeOption(backend_config, "batch_kb");
+    std::string queue_kb = takeOption(backend_config, "queue_kb");
+    std::string codec = takeOption(backend_config, "codec");
+    std::string encoders = takeOption(backend_config, "encoders");
+    std::string opus_kbps = takeOption(backend_config, "opus_kbps");
+    std::string opus_frame_ms = takeOption(backend_config, "opus_frame_ms");
+    std::string opus_complexity = takeOption(backend_config, "opus_complexity");
+    if (!batch_ms.empty()) {
+        max_batch_latency_ = std::chrono::microseconds(std::max(0, atoi(batch_ms.c_str())) * 1000);
+    }
+    if (!batch_kb.empty()) {
+        size_t kb = static_cast<size_t>(std::max(0, atoi(batch_kb.c_str())));
+        max_batch_bytes_ = kb * 1024 < kMinBatchBytes ? kMinBatchBytes : kb * 1024;
+    }
+    batch_budget_ = max_batch_bytes_;
+    if (!queue_kb.empty()) {
+        backlog_budget_ = std::max(64, atoi(queue_kb.c_str())) * size_t(1024);
+    }
+    
+    // A "unix:" or "shm:" endpoint picks a local backend whatever the type says
+    std::string type = backend_type;
+    for (const char* scheme : {"unix", "shm"}) {
+        size_t length = strlen(scheme);
+        if (backend_config.compare(0, length, scheme) == 0 && backend_config.size() > length &&
+            backend_config[length] == ':') {
+            type = scheme;
+            backend_config.erase(0, length + 1);
+        }
+    }
+    
+    if (type == "tcp") {
+        backend_ = std::make_unique<TCPStreamingBackend>();
+    } else if (type == "unix") {
+        backend_ = std::make_unique<SeqpacketStreamingBackend>();
+    } else if (type == "shm") {
+        backend_ = std::make_unique<ShmRingStreamingBackend>();
+    } else {
+        std::cerr << tag_ << " Unsupported backend type: " << type << std::endl;
+        return false;
+    }
+    
+    if (!backend_->initialize(backend_config)) {
+        std::cerr << tag_ << " Failed to initialize backend" << std::endl;
+        backend_.reset();
+        return false;
+    }
+    
+    encoders_.reset();
+    if (codec == "opus" && !OpusEncodePool::available()) {
+        std::cerr << tag_ << " Built without Opus, streaming PCM" << std::endl;
+    } else if (codec == "opus") {
+        OpusSettings settings;
+        if (!opus_kbps.empty()) {
+            settings.bitrate = std::min(256, std::max(6, atoi(opus_kbps.c_str()))) * 1000;
+        }
+        if (!opus_frame_ms.empty()) {
+            int ms = atoi(opus_frame_ms.c_str());
+            settings.frame_ms = ms == 10 || ms == 40 || ms == 60 ? ms : 20;
+        }
+        if (!opus_complexity.empty()) {
+            settings.complexity = std::min(10, std::max(0, atoi(opus_complexity.c_str())));
+        }
+        size_t threads = encoders.empty() ? 1 : static_cast<size_t>(std::min(16, std::max(1, atoi(encoders.c_str()))));
+        encoders_.reset(new OpusEncodePool(threads, settings,
+                                           [this](AudioChunk&& chunk) { return enqueue(std::move(chunk)); }, tag_));
+    } else if (!codec.empty() && codec != "pcm") {
+        std::cerr << tag_ << " Unknown codec " << codec << ", streaming PCM" << std::endl;
+    }
+    
+    connected_.store(true);
+    std::cout << tag_ << " ✓ Initialized " << type << (encoders_ ? " Opus" : "") << " streaming backend (batches up to "
+              << max_batch_latency_.count() / 1000.0 << " ms / " << max_batch_bytes_ / 1024 << " KB)" << std::endl;
+    return true;
+}
+
+bool AudioStreamer::queueAudio(uint32_t user_id, const SharedName& user_name, const AudioFrameRef& frame,
+                               StreamPriority priority) {
+    // First, so a stopped streamer never looks at its shards: initialize() replaces them
+    if (!running_.load()) {
+        return false;
+    }
+    if (fanout_) {
+        // Each sink takes its own reference; a full queue in one doesn't keep the frame from the others
+        bool queued = false;
+        for (auto& sink : shards_) {
+            if (sink->ready_.load()) {
+                queued |= sink->queueAudio(user_id, user_name, frame, priority);
+            }
+        }
+        return queued;
+    }
+    if (!shards_.empty()) {
+        size_t shard = ring_.empty() ? shardFor(user_id) : routeFor(user_id);
+        return shards_[shard]->queueAudio(user_id, user_name, frame, priority);
+    }
+    if (!backend_ || !frame || !user_name) {
+        return false;
+    }
+    
+    AudioChunk chunk;
+    chunk.user_id = user_id;
+    chunk.priority = priority;
+    chunk.user_name = user_name;
+    chunk.frame = frame;
+    if (encoders_) {
+        return encoders_->submit(std::move(chunk));
+    }
+    return enqueue(std::move(chunk));
+}
+
+bool AudioStreamer::enqueue(AudioChunk&& chunk) {
+    int64_t size = static_cast<int64_t>(queuedBytes(*chunk.frame));
+    if (!queue_.tryPush(std::move(chunk))) {
+        // Full: the newest frame goes, counted by the queue and by the caller's stream
+        return false;
+    }
+    
+    // The worker only cares when the queued bytes reach the mark it is waiting for
+    int64_t after = queue_bytes_.fetch_add(size) + size;
+    int64_t threshold = wake_threshold_.load();
+    if (after >= threshold && after - size < threshold) {
+        uint64_t one = 1;
+        ssize_t written = write(wake_fd_, &one, sizeof(one));
+        (void)written;   // EAGAIN only if the counter is already huge, so the worker is awake anyway
+    }
+    return true;
+}
+
+size_t AudioStreamer::shardFor(uint32_t user_id) const {
+    // Fibonacci hashing spreads consecutive ids, and the top bits pick the shard;
+    // the same user always lands on the same shard
+    uint64_t hash = (static_cast<uint64_t>(user_id) * 0x9E3779B97F4A7C15ull) >> 32;
+    return static_cast<size_t>((hash * shards_.size()) >> 32);
+}
+
+bool AudioStreamer::isReachable() const {
+    if (shards_.empty()) {
+        return backend_ && backend_->isConnected();
+    }
+    for (const auto& shard : shards_) {
+        if (shard->ready_.load() && shard->isReachable()) return true;
+    }
+    return false;
+}
+
+// Whether an endpoint can keep (or take) streams: reachable, or not unreachable for long.
+// One that hasn't initialized yet is down.
+bool AudioStreamer::endpointUp(size_t endpoint, int64_t now_ms) {
+    AudioStreamer& streamer = *shards_[endpoint];
+    if (!streamer.ready_.load()) {
+        return false;
+    }
+    if (streamer.isReachable()) {
+        streamer.down_since_ms_.store(0, std::memory_order_relaxed);
+        return true;
+    }
+    int64_t since = streamer.down_since_ms_.load(std::memory_order_relaxed);
+    if (since == 0) {
+        streamer.down_since_ms_.compare_exchange_strong(since, now_ms, std::memory_order_relaxed);
+        return true;
+    }
+    return now_ms - since < failover_after_.count();
+}
+
+// First endpoint that is up clockwise from hash; the primary owner if none is
+size_t AudioStreamer::ringOwner(uint64_t hash, int64_t now_ms) {
+    auto first = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(hash, uint16_t(0)));
+    size_t start = first == ring_.end() ? 0 : static_cast<size_t>(first - ring_.begin());
+    for (size_t i = 0; i < ring_.size(); ++i) {
+        uint16_t endpoint = ring_[(start + i) % ring_.size()].second;
+        if (endpointUp(endpoint, now_ms)) return endpoint;
+    }
+    return ring_[start].second;
+}
+
+size_t AudioStreamer::routeFor(uint32_t user_id) {
+    int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    uint64_t hash = mixHash(user_id);
+    uint64_t key = static_cast<uint64_t>(user_id) + 1;
+    
+    // A probe ends at the user's entry or the first free slot. Forgotten routes
+    // don't end it, but a new route takes the first of them it passed.
+    while (true) {
+        std::atomic<uint64_t>* reusable = nullptr;
+        size_t probe = 0;
+        for (; probe < kRouteSlots; ++probe) {
+            std::atomic<uint64_t>& slot = routes_[(hash + probe) % kRouteSlots];
+            uint64_t entry = slot.load(std::memory_order_acquire);
+            if (entry == kRouteRemoved) {
+                if (!reusable) reusable = &slot;
+                continue;
+            }
+            if (entry == 0) break;
+            if (entry >> 16 != key) continue;
+            
+            size_t current = entry & 0xFFFF;
+            if (endpointUp(current, now_ms)) return current;
+            size_t owner = ringOwner(hash, now_ms);
+            if (owner != current && slot.compare_exchange_strong(entry, key << 16 | owner, std::memory_order_acq_rel)) {
+                rerouted_++;
+                std::cerr << tag_ << " " << endpoints_[current] << " unreachable for over " << failover_after_.count()
+                          << " ms, moving user " << user_id << " to " << endpoints_[owner] << std::endl;
+                return owner;
+            }
+            return slot.load(std::memory_order_acquire) & 0xFFFF;
+        }
+        
+        size_t owner = ringOwner(hash, now_ms);
+        std::atomic<uint64_t>* target = reusable;
+        uint64_t expected = kRouteRemoved;
+        if (!target) {
+            if (probe == kRouteSlots) return owner;   // table full: still consistent, just not sticky
+            target = &routes_[(hash + probe) % kRouteSlots];
+            expected = 0;
+        }
+        if (target->compare_exchange_strong(expected, key << 16 | owner, std::memory_order_acq_rel)) {
+            return owner;
+        }
+        // Another producer took the slot; look again
+    }
+}
+
+void AudioStreamer::forgetUser(uint32_t user_id) {
+    if (fanout_) {
+        for (auto& sink : shards_) {
+            if (sink->ready_.load()) sink->forgetUser(user_id);
+        }
+        return;
+    }
+    if (!routes_ || !running_.load()) {
+        return;
+    }
+    uint64_t hash = mixHash(user_id);
+    uint64_t key = static_cast<uint64_t>(user_id) + 1;
+    for (size_t probe = 0; probe < kRouteSlots; ++probe) {
+        std::atomic<uint64_t>& slot = routes_[(hash + probe) % kRouteSlots];
+        uint64_t entry = slot.load(std::memory_order_acquire);
+        if (entry == 0) return;
+        // Retried if a failover moves the route meanwhile
+        while (entry != kRouteRemoved && entry >> 16 == key &&
+               !slot.compare_exchange_weak(entry, kRouteRemoved, std::memory_order_acq_rel)) {}
+    }
+}
+
+void AudioStreamer::start() {
+    if (running_.load()) {
+        return;
+    }
+    if (!shards_.empty()) {
+        bool retry = false;
+        for (auto& shard : shards_) {
+            if (shard->ready_.load()) {
+                shard->start();
+            } else {
+                retry = true;
+            }
+        }
+        running_.store(true);
+        if (retry) {
+            worker_thread_ = std::thread(&AudioStreamer::retrySinks, this);
+        }
+        return;
+    }
+    if (!backend_ || wake_fd_ < 0) {
+        return;
+    }
+    
+    running_.store(true);
+    worker_thread_ = std::thread(&AudioStreamer::workerLoop, this);
+    if (encoders_) {
+        encoders_->start();
+    }
+    
+    std::cout << tag_ << " ✓ Started audio streaming worker thread" << std::endl;
+}
+
+void AudioStreamer::stop() {
+    if (!running_.load()) {
+        return;
+    }
+    
+    std::cout << tag_ << " Stopping audio streamer..." << std::endl;
+    // Shards drain at the same time, so stopping takes no longer than with one
+    signalStop();
+    finishStop();
+    connected_.store(false);
+    // The sinks stay until the next initialize(), which replaces them: producers may
+    // still be looking at them, and start() can use them again
+    std::cout << tag_ << " ✓ Audio streamer stopped" << std::endl;
+}
+
+void AudioStreamer::signalStop() {
+    if (!shards_.empty() && worker_thread_.joinable()) {
+        // The retry loop first, so no sink starts while the others stop. An attempt
+        // doesn't wait for a connection (backends connect from their own worker), and
+        // wake_fd_ cuts the backoff short, so this returns promptly.
+        running_.store(false);
+        uint64_t one = 1;
+        ssize_t written = write(wake_fd_, &one, sizeof(one));
+        (void)written;
+        worker_thread_.join();
+    }
+    for (auto& shard : shards_) {
+        shard->signalStop();
+    }
+    if (encoders_) {
+        // Encoded first, so the worker's drain includes the last packets
+        encoders_->stop();
+    }
+    running_.store(false);
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd_, &one, sizeof(one));
+    (void)written;
+}
+
+void AudioStreamer::finishStop() {
+    for (auto& shard : shards_) {
+        shard->finishStop();
+    }
+    if (rerouted_.load() > 0) {
+        std::cout << tag_ << " Moved " << rerouted_.load() << " streams off unreachable endpoints" << std::endl;
+    }
+    if (worker_thread_.joinable()) {
+        worker_thread_.join();
+    }
+    
+    if (backend_) {
+        backend_->shutdown();
+    }
+    
+    // Clear queue, releasing the frames it still references. Producers have
+    // stopped pushing: queueAudio checks running_ first.
+    while (AudioChunk* chunk = queue_.front()) {
+        chunk->frame.reset();
+        chunk->user_name.reset();
+        queue_.pop();
+    }
+    queue_bytes_.store(0);
+    for (auto& stream : backlog_) {
+        for (auto& chunk : stream.ring) {
+            chunk.frame.reset();
+            chunk.user_name.reset();
+        }
+        stream.head = stream.size = stream.bytes = 0;
+    }
+    backlog_bytes_ = 0;
+    if (queue_.overflowCount() > 0) {
+        std::cout << tag_ << " Queue full " << queue_.overflowCount() << " times, newest frames dropped" << std::endl;
+    }
+    for (size_t i = 0; i < kStreamPriorityCount; ++i) {
+        if (shed_frames_[i].load() > 0) {
+            std::cout << tag_ << " Shed " << shed_frames_[i].load() << " " << streamPriorityName(static_cast<StreamPriority>(i))
+                      << " frames under backpressure" << std::endl;
+        }
+    }
+    
+    if (batches_sent_ > 0) {
+        std::cout << tag_ << " Sent " << frames_sent_ << " frames in " << batches_sent_ << " batches ("
+                  << static_cast<double>(frames_sent_) / batches_sent_ << " per batch)" << std::endl;
+    }
+    if (dropped_frames_.load() > 0) {
+        std::cout << tag_ << " Dropped " << dropped_frames_.load() << " frames while the server was unavailable" << std::endl;
+    }
+}
+
+void AudioStreamer::updateBatchBudget(size_t bytes, std::chrono::steady_clock::duration elapsed) {
+    // Small sends say more about syscall overhead than about the socket
+    if (bytes < kMinBatchBytes) return;
+    
+    double us = std::max<double>(1.0, std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    double rate = bytes / us;
+    send_bytes_per_us_ = send_bytes_per_us_ == 0 ? rate : send_bytes_per_us_ + (rate - send_bytes_per_us_) / 8;
+    
+    // As much as the socket has been taking within the latency bound; a slow sink gets small batches
+    double budget = send_bytes_per_us_ * std::max<double>(1000.0, max_batch_latency_.count());
+    size_t clamped = budget < kMinBatchBytes ? kMinBatchBytes : static_cast<size_t>(budget);
+    batch_budget_ = std::min(clamped, max_batch_bytes_);
+}
+
+// Sleeps until at least threshold bytes are queued (true), the deadline passes or the streamer stops
+bool AudioStreamer::waitForBytes(int64_t threshold, std::chrono::steady_clock::time_point deadline) {
+    for (;;) {
+        if (!running_.load()) return false;
+        if (queue_bytes_.load() >= threshold) return true;
+        
+        // Publish the mark, then look again: a producer that added its bytes before
+        // seeing the mark is caught by this second check
+        wake_threshold_.store(threshold);
+        bool ready = queue_bytes_.load() >= threshold;
+        auto now = std::chrono::steady_clock::now();
+        if (!ready && now < deadline) {
+            // Also wake for send completions, so held frames go back as soon as the kernel is done
+            int completion_fd = backend_ ? backend_->completionFd() : -1;
+            struct pollfd pfds[2] = {{wake_fd_, POLLIN, 0}, {completion_fd, 0, 0}};
+            struct timespec timeout{};
+            struct timespec* wait = nullptr;
+            if (deadline != std::chrono::steady_clock::time_point::max()) {
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count();
+                timeout.tv_sec = static_cast<time_t>(ns / 1000000000);
+                timeout.tv_nsec = static_cast<long>(ns % 1000000000);
+                wait = &timeout;
+            }
+            if (ppoll(pfds, completion_fd >= 0 ? 2 : 1, wait, nullptr) > 0) {
+                if (pfds[0].revents) {
+                    uint64_t count;
+                    ssize_t n = read(wake_fd_, &count, sizeof(count));
+                    (void)n;
+                }
+                if (pfds[1].revents) {
+                    backend_->maintain();
+                }
+            }
+        }
+        wake_threshold_.store(std::numeric_limits<int64_t>::max());
+        if (ready) return true;
+        if (std::chrono::steady_clock::now() >= deadline) return queue_bytes_.load() >= threshold;
+    }
+}
+
+AudioStreamer::BacklogStream& AudioStreamer::backlogFor(uint32_t user_id) {
+    auto it = backlog_index_.find(user_id);
+    if (it != backlog_index_.end()) {
+        return backlog_[it->second];
+    }
+    // First frame of a stream: the only allocation on this path
+    backlog_index_.emplace(user_id, backlog_.size());
+    backlog_.emplace_back();
+    BacklogStream& stream = backlog_.back();
+    stream.user_id = user_id;
+    stream.ring.resize(kBacklogDepth);
+    return stream;
+}
+
+// Moves everything queued into the backlog, then sheds until it is within budget
+void AudioStreamer::drainQueue() {
+    int64_t drained = 0;
+    while (AudioChunk* chunk = queue_.front()) {
+        size_t size = queuedBytes(*chunk->frame);
+        BacklogStream& stream = backlogFor(chunk->user_id);
+        stream.priority = chunk->priority;
+        if (stream.size == kBacklogDepth) {
+            shedOldest(stream);
+        }
+        stream.ring[(stream.head + stream.size) % kBacklogDepth] = std::move(*chunk);
+        stream.size++;
+        stream.bytes += size;
+        backlog_bytes_ += size;
+        drained += static_cast<int64_t>(size);
+        queue_.pop();
+    }
+    queue_bytes_.fetch_sub(drained);
+    
+    while (backlog_bytes_ > backlog_budget_) {
+        // Streams out of credit first, then the lowest class; within it, the stream holding the most
+        BacklogStream* victim = nullptr;
+        for (auto& stream : backlog_) {
+            if (stream.size == 0) continue;
+            if (!victim) {
+                victim = &stream;
+            } else if (stream.blocked != victim->blocked) {
+                if (stream.blocked) victim = &stream;
+            } else if (stream.priority > victim->priority ||
+                       (stream.priority == victim->priority && stream.bytes > victim->bytes)) {
+                victim = &stream;
+            }
+        }
+        int level = static_cast<int>(victim->priority);
+        if (shedding_level_ < 0 || level < shedding_level_) {
+            std::cerr << tag_ << " Backlog over " << backlog_budget_ / 1024 << " KB, shedding "
+                      << streamPriorityName(victim->priority) << " audio" << std::endl;
+            shedding_level_ = level;
+        }
+        shedOldest(*victim);
+    }
+    
+    // Hysteresis, so a backlog hovering at the budget doesn't flood the log
+    if (shedding_level_ >= 0 && backlog_bytes_ < backlog_budget_ / 2) {
+        std::cout << tag_ << " Backlog back under budget, shedding stopped" << std::endl;
+        shedding_level_ = -1;
+    }
+}
+
+void AudioStreamer::shedOldest(BacklogStream& stream) {
+    AudioChunk& chunk = stream.ring[stream.head];
+    size_t size = queuedBytes(*chunk.frame);
+    shed_frames_[static_cast<size_t>(chunk.priority)]++;
+    if (backend_) {
+        backend_->noteDropped(chunk, DropReason::Shed);
+    }
+    chunk.frame.reset();
+    chunk.user_name.reset();
+    stream.head = (stream.head + 1) % kBacklogDepth;
+    stream.size--;
+    stream.bytes -= size;
+    backlog_bytes_ -= size;
+}
+
+// Highest class first, one frame per stream per round within a class. True if the
+// batch filled up before everything sendable was taken.
+bool AudioStreamer::fillBatch(size_t& count, size_t& bytes) {
+    size_t streams = backlog_.size();
+    if (streams == 0) return false;
+    size_t start = backlog_rotation_++ % streams;
+    // An empty stream keeps what its last try found, so new audio for a stream out of credit still goes first when shedding
+    for (auto& stream : backlog_) {
+        if (stream.size > 0) stream.blocked = false;
+    }
+    
+    for (size_t level = 0; level < kStreamPriorityCount; ++level) {
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            for (size_t i = 0; i < streams; ++i) {
+                if (count == kMaxBatchFrames || bytes >= batch_budget_) return true;
+                BacklogStream& stream = backlog_[(start + i) % streams];
+                if (stream.size == 0 || stream.blocked || static_cast<size_t>(stream.priority) != level) continue;
+                if (backend_ && !backend_->takeCredit(stream.ring[stream.head])) {
+                    // The receiver isn't keeping up with this one; its audio waits here
+                    stream.blocked = true;
+                    continue;
+                }
+                
+                // Moving out leaves the slot empty and ready for reuse
+                AudioChunk& chunk = stream.ring[stream.head];
+                size_t size = queuedBytes(*chunk.frame);
+                batch_[count++] = std::move(chunk);
+                stream.head = (stream.head + 1) % kBacklogDepth;
+                stream.size--;
+                stream.bytes -= size;
+                backlog_bytes_ -= size;
+                bytes += size;
+                progress = true;
+            }
+        }
+    }
+    return false;
+}
+
+// Sinks and endpoints only: initializes and starts the ones that failed, with backoff, until all are up or stop()
+void AudioStreamer::retrySinks() {
+    int delay_ms = kSinkRetryBaseMs;
+    while (running_.load()) {
+        struct pollfd pfd{wake_fd_, POLLIN, 0};
+        if (poll(&pfd, 1, delay_ms) > 0) {
+            uint64_t count;
+            ssize_t n = read(wake_fd_, &count, sizeof(count));
+            (void)n;
+        }
+        
+        size_t pending = 0;
+        for (size_t i = 0; i < shards_.size() && running_.load(); ++i) {
+            AudioStreamer& sink = *shards_[i];
+            if (sink.ready_.load()) continue;
+            if (sink.initialize(backend_type_, sink_configs_[i])) {
+                if (!running_.load()) return;   // stopped during the attempt: the next start() starts it
+                sink.start();
+                std::cout << tag_ << " ✓ Sink " << sink_configs_[i] << " initialized, streaming to it from now on" << std::endl;
+            } else {
+                pending++;
+            }
+        }
+        if (pending == 0) return;
+        delay_ms = std::min(delay_ms * 2, kSinkRetryMaxMs);
+    }
+}
+
+void AudioStreamer::workerLoop() {
+    if (cpu_ >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu_, &cpus);
+        int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (error != 0) {
+            std::cerr << tag_ << " Failed to pin worker thread to CPU " << cpu_ << ": " << strerror(error) << std::endl;
+        } else {
+            std::cout << tag_ << " Worker thread started on CPU " << cpu_ << std::endl;
+        }
+    } else {
+        std::cout << tag_ << " Worker thread started" << std::endl;
+    }
+    
+    bool more = false;   // the last batch filled up with sendable audio left over
+    while (running_.load()) {
+        size_t count = 0;
+        size_t bytes = 0;
+        
+        // Gather a batch: wait for the first chunk, then up to the latency bound for the budget
+        // to fill. Sendable audio left over from last time means the receiver is behind: no waiting.
+        if (!more && backlog_bytes_ > 0) {
+            // All that's left waits for credit: until a grant arrives, or the latency bound for other streams
+            backend_->waitForCredit(max_batch_latency_);
+        } else if (!more) {
+            if (!waitForBytes(1, std::chrono::steady_clock::now() + std::chrono::milliseconds(kIdleTickMs))) {
+                // Idle (or stopping): reconnects and replay shouldn't wait for new audio
+                if (running_.load()) backend_->maintain();
+                continue;
+            }
+            waitForBytes(static_cast<int64_t>(batch_budget_), std::chrono::steady_clock::now() + max_batch_latency_);
+        }
+        drainQueue();
+        more = fillBatch(count, bytes);
+        deliverBatch(count, bytes);
+    }
+    
+    // Stopping: what's still queued gets a bounded chance to go out, and the
+    // backend to deliver anything it holds for the receiver
+    static const int kStopDrainMs = 2000;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kStopDrainMs);
+    drainQueue();
+    while (backlog_bytes_ > 0 && backend_ && std::chrono::steady_clock::now() < deadline) {
+        size_t count = 0;
+        size_t bytes = 0;
+        fillBatch(count, bytes);
+        if (count == 0) {
+            backend_->waitForCredit(max_batch_latency_);
+        }
+        deliverBatch(count, bytes);
+    }
+    if (backend_) {
+        backend_->flush(deadline);
+    }
+    
+    std::cout << tag_ << " Worker thread finished" << std::endl;
+}
+
+void AudioStreamer::deliverBatch(size_t count, size_t bytes) {
+    if (count > 0 && backend_) {
+        auto started = std::chrono::steady_clock::now();
+        bool success = backend_->streamBatch(batch_.data(), count);
+        
+        if (!success) {
+            // The backend reconnects on its own; until then audio is dropped here, not held
+            dropped_frames_ += count;
+            if (connected_.exchange(false)) {
+                std::cerr << tag_ << " Audio processing server unavailable, dropping audio until it is back"
+                          << std::endl;
+            }
+        } else {
+            if (!connected_.exchange(true)) {
+                std::cout << tag_ << " ✓ Streaming resumed (" << dropped_frames_.load()
+                          << " frames dropped so far)" << std::endl;
+            }
+            batches_sent_++;
+            frames_sent_ += count;
+            updateBatchBudget(bytes, std::chrono::steady_clock::now() - started);
+        }
+    }
+    
+    for (size_t i = 0; i < count; ++i) {
+        batch_[i].frame.reset();
+        batch_[i].user_name.reset();
+    }
+}
+
+size_t AudioStreamer::getQueueSize() const {
+    size_t size = queue_.size();
+    for (const auto& shard : shards_) {
+        if (!shard->ready_.load()) continue;   // a sink still being retried
+        size += shard->getQueueSize();
+    }
+    return size;
+}
+
+bool AudioStreamer::isConnected() const {
+    if (shards_.empty()) {
+        return connected_.load();
+    }
+    for (const auto& shard : shards_) {
+        if (shard->ready_.load() && shard->isConnected()) return true;
+    }
+    return false;
+}
+
+uint64_t AudioStreamer::getDroppedFrames() const {
+    uint64_t dropped = dropped_frames_.load();
+    for (const auto& shard : shards_) {
+        if (!shard->ready_.load()) continue;
+        dropped += shard->getDroppedFrames();
+    }
+    return dropped;
+}
+
+uint64_t AudioStreamer::getQueueOverflows() const {
+    uint64_t overflows = queue_.overflowCount() + (encoders_ ? encoders_->queueOverflows() : 0);
+    for (const auto& shard : shards_) {
+        if (!shard->ready_.load()) continue;
+        overflows += shard->getQueueOverflows();
+    }
+    return overflows;
+}
+
+uint64_t AudioStreamer::getShedFrames(StreamPriority priority) const {
+    uint64_t shed = shed_frames_[static_cast<size_t>(priority)].load();
+    for (const auto& shard : shards_) {
+        if (!shard->ready_.load()) continue;
+        shed += shard->getShedFrames(priority);
+    }
+    return shed;
 }
 
 } // namespace ZoomBot
\ No newline at end of file
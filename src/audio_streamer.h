@@ -5,15 +5,36 @@
 #include <thread>
 #include <atomic>
 #include <mutex>
-#include <queue>
-#include <condition_variable>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <random>
 #include <cstdint>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#include "audio_frame.h"
+#include "mpsc_queue.h"
+#include "spill_log.h"
+#include "stream_protocol.h"
 
 namespace ZoomBot {
 
 // Forward declarations
 struct AudioChunk;
 class AudioStreamer;
+class OpusEncodePool;
+
+// Participant name shared with the capture side; copying the handle never allocates
+using SharedName = std::shared_ptr<const std::string>;
+
+// Streaming priority classes; under backpressure the lowest class is shed first
+enum class StreamPriority : uint8_t { Mixed, ActiveSpeaker, Idle, Share };
+static const size_t kStreamPriorityCount = 4;
+const char* streamPriorityName(StreamPriority priority);
+
+// Why frames never reached the receiver (values are on the wire, see stream_protocol.h)
+enum class DropReason : uint8_t { Shed = 1, Unavailable = 2 };
 
 /**
  * Abstract base class for audio streaming backends
@@ -23,14 +44,55 @@ class StreamingBackend {
 public:
     virtual ~StreamingBackend() = default;
     virtual bool initialize(const std::string& config) = 0;
-    virtual bool streamAudio(uint32_t user_id, const std::string& user_name, 
-                           const char* data, size_t length, 
-                           uint32_t sample_rate, uint16_t channels) = 0;
+    // The backend may keep a reference to the frame until the kernel is done with it
+    virtual bool streamAudio(uint32_t user_id, const std::string& user_name, const AudioFrameRef& frame) = 0;
+    // Several chunks in queue order; the default sends them one at a time. False if any failed.
+    virtual bool streamBatch(const AudioChunk* chunks, size_t count);
+    // The streamer gave up on a frame; backends that can tell the receiver do so in-band
+    virtual void noteDropped(const AudioChunk& chunk, DropReason reason) { (void)chunk; (void)reason; }
+    // Flow control, for receivers that grant credit. False if the chunk's stream has
+    // used up its grant, and the streamer keeps the chunk; otherwise true, with the
+    // chunk charged against the grant. Backends without flow control always say true.
+    virtual bool takeCredit(const AudioChunk& chunk) { (void)chunk; return true; }
+    // Waits up to timeout for the receiver to grant more
+    virtual void waitForCredit(std::chrono::microseconds timeout) { (void)timeout; }
+    // The streamer is stopping: deliver what is still held until the deadline, if possible
+    virtual void flush(std::chrono::steady_clock::time_point deadline) { (void)deadline; }
+    // Called by the worker while no audio is queued, so reconnects and held audio still make progress
+    virtual void maintain() {}
+    // While sends are waiting for completion: a descriptor that reports POLLERR when
+    // maintain() has completions to collect. -1 when nothing is outstanding.
+    virtual int completionFd() { return -1; }
+    // Whether the receiver is reachable right now; safe to call from any thread
+    virtual bool isConnected() const { return true; }
     virtual void shutdown() = 0;
 };
 
 /**
- * TCP-based streaming backend
+ * TCP-based streaming backend.
+ * Config: "host:port[?options]", options joined with '&':
+ *   protocol=json   original per-chunk JSON framing for older receivers (see stream_protocol.h)
+ *   zerocopy=1      MSG_ZEROCOPY for sends of kZeroCopyMinBytes or more; frames and
+ *                   the batch's header bytes are held until the kernel reports the
+ *                   transmission complete
+ *   credits=0       don't ask the receiver for flow control (binary protocol only)
+ *   replay=0        don't ask the receiver to acknowledge audio (binary protocol only)
+ *   replay_kb=N     unacknowledged audio held in memory before spilling (default 4096)
+ *   spill_dir=PATH  directory for the spill log (default /tmp)
+ *   spill_mb=N      spill log limit; past it the oldest audio is dropped (default 1024)
+ * A batch of messages (headers and samples) leaves in a single sendmsg call.
+ *
+ * The socket is non-blocking and watched with epoll. Connecting, the protocol
+ * handshake and reconnects after a failure (exponential backoff with jitter)
+ * advance a step at a time from the send calls, so the worker never sits in
+ * connect() and audio sent while the receiver is away is dropped at once.
+ * The address is resolved once, in initialize().
+ *
+ * With a receiver that acknowledges audio, every frame is kept in a journal
+ * until its sequence number is acknowledged, and audio arriving while the
+ * receiver is away is added to it rather than dropped. After a reconnect the
+ * unacknowledged frames go out again, oldest first, before any new audio.
+ * Frames past the memory limit move to the spill log on disk.
  */
 class TCPStreamingBackend : public StreamingBackend {
 public:
@@ -38,42 +100,203 @@ public:
     ~TCPStreamingBackend() override;
     
     bool initialize(const std::string& config) override;
-    bool streamAudio(uint32_t user_id, const std::string& user_name,
-                    const char* data, size_t length,
-                    uint32_t sample_rate, uint16_t channels) override;
+    bool streamAudio(uint32_t user_id, const std::string& user_name, const AudioFrameRef& frame) override;
+    bool streamBatch(const AudioChunk* chunks, size_t count) override;
+    void noteDropped(const AudioChunk& chunk, DropReason reason) override;
+    bool takeCredit(const AudioChunk& chunk) override;
+    void waitForCredit(std::chrono::microseconds timeout) override;
+    void flush(std::chrono::steady_clock::time_point deadline) override;
+    void maintain() override;
+    int completionFd() override;
+    bool isConnected() const override { return reachable_.load(); }
     void shutdown() override;
 
+    // Below this the page pinning and completion handling cost more than the copy
+    static const size_t kZeroCopyMinBytes = 16 * 1024;
+
 private:
+    enum class ConnectionState { Idle, Connecting, Handshaking, Connected };
+    
     struct TCPConnection {
         int socket_fd;
         std::string host;
         int port;
         bool connected;
+        uint64_t generation = 0;   // bumped on every handshake; declarations are per connection
+        ConnectionState state = ConnectionState::Idle;
+        std::chrono::steady_clock::time_point next_attempt;   // Idle: when to connect again
+        std::chrono::steady_clock::time_point deadline;       // Connecting/Handshaking
+        char hello[kWireHelloSize + kWireCreditSize];   // with flow control, the initial window follows
+        size_t hello_received = 0;
+        uint32_t failures = 0;     // consecutive, drives the backoff
+    };
+    
+    // Binary protocol stream table, indexed by stream id
+    struct WireStream {
+        uint32_t user_id;
+        uint32_t sample_rate;
+        uint16_t channels;
+        AudioFormat format;
+        std::string user_name;      // as last declared
+        uint32_t next_sequence = 0; // keeps counting across reconnects, so the receiver sees gaps
+        uint64_t declared_on = 0;   // connection generation of the last declare
+        // Frames dropped on purpose since the last audio message, announced before the next one
+        uint32_t dropped_first = 0;
+        uint32_t dropped_count = 0;
+        DropReason dropped_reason = DropReason::Shed;
+        StreamPriority dropped_priority = StreamPriority::Idle;
+        // Bytes the receiver still takes; may go one frame negative
+        int64_t credit = 0;
+        uint64_t credit_on = 0;     // connection generation the credit belongs to
+        bool starved = false;
+        uint32_t acked = 0;         // receiver has processed everything before this sequence
     };
     
     std::unique_ptr<TCPConnection> connection_;
     std::mutex connection_mutex_;
+    std::atomic<bool> reachable_{false};   // connection_->connected, for other threads
+    
+    // Resolved once; attempts rotate through them
+    struct ResolvedAddress {
+        struct sockaddr_storage addr;
+        socklen_t len;
+    };
+    std::vector<ResolvedAddress> addresses_;
+    size_t next_address_ = 0;
+    int epoll_fd_ = -1;
+    std::minstd_rand backoff_rng_;
+    
+    StreamProtocol protocol_ = StreamProtocol::Binary;
+    std::string header_buf_;   // reused for every header, so steady-state sends don't allocate
+    
+    // Batch being built: header bytes are packed into batch_headers_ and the
+    // iovecs are filled in once it is complete, as the buffer may still move
+    struct BatchPiece {
+        const char* data;           // null: offset into batch_headers_
+        size_t offset;
+        size_t len;
+    };
+    std::string batch_headers_;
+    std::vector<BatchPiece> batch_pieces_;
+    std::vector<struct iovec> batch_iov_;
+    std::vector<WireStream> wire_streams_;
+    std::unordered_map<FormatKey, uint16_t, FormatKeyHash> wire_stream_ids_;
+    
+    // MSG_ZEROCOPY: frames stay referenced until their send's completion arrives
+    struct ZeroCopySlot {
+        uint32_t id;                // kernel's counter value for the send
+        AudioFrameRef frame;
+    };
+    // ...and so do the batch's header bytes, swapped out of batch_headers_. Slots
+    // keep their buffers once completed, and batch_headers_ takes them back.
+    struct ZeroCopyHeaders {
+        uint32_t id;
+        std::string bytes;
+    };
+    static const size_t kZeroCopyMaxPending = 4096;
+    bool zerocopy_requested_ = false;
+    bool zerocopy_active_ = false;          // SO_ZEROCOPY accepted on the current socket
+    std::vector<ZeroCopySlot> zerocopy_slots_;   // ring, sized once
+    size_t zerocopy_head_ = 0;
+    size_t zerocopy_pending_ = 0;
+    std::vector<ZeroCopyHeaders> zerocopy_headers_;   // ring, grows with the batches in flight
+    size_t zerocopy_headers_head_ = 0;
+    size_t zerocopy_headers_pending_ = 0;
+    uint32_t zerocopy_next_id_ = 0;
+    uint64_t zerocopy_sends_ = 0;
+    uint64_t zerocopy_copied_ = 0;          // completions where the kernel fell back to copying
+    
+    // Credit flow control, negotiated in the handshake
+    bool credits_requested_ = true;
+    bool credits_active_ = false;           // on the current connection
+    uint32_t initial_credit_ = 0;           // every stream's window at the start of a connection
+    char control_buf_[kWireCreditSize * 64];   // credits and acks from the receiver (same size)
+    size_t control_buffered_ = 0;
+    uint64_t credit_stalls_ = 0;            // times a stream ran out
+    
+    // Replay journal: a ring in sequence order per stream. From the head, the first
+    // journal_spilled_ entries are on disk (or gone), the rest hold their frames;
+    // the first journal_sent_ went out on the current connection.
+    struct JournalEntry {
+        uint16_t stream_id = 0;
+        StreamPriority priority = StreamPriority::Idle;
+        bool stored = false;        // audio is in spill_ at offset
+        DropReason reason = DropReason::Unavailable;   // reported if the audio is gone
+        uint32_t sequence = 0;
+        uint32_t len = 0;
+        uint32_t silent_samples = 0;   // a silence marker: nothing to keep but this
+        int64_t capture_time_ms = 0;
+        SharedName user_name;
+        AudioFrameRef frame;        // null once spilled
+        uint64_t offset = 0;
+    };
+    static const size_t kJournalMaxEntries = 1 << 20;
+    static const size_t kReplaySliceBytes = 1024 * 1024;   // replayed per send, ahead of new audio
+    bool replay_requested_ = true;
+    bool acks_active_ = false;              // on the current connection
+    bool replay_expected_ = true;           // keep audio while disconnected: the last receiver acked
+    size_t replay_memory_ = 4096 * 1024;
+    uint64_t spill_limit_ = 1024ull << 20;
+    std::vector<JournalEntry> journal_;
+    size_t journal_head_ = 0;
+    size_t journal_size_ = 0;
+    size_t journal_spilled_ = 0;
+    size_t journal_sent_ = 0;
+    size_t journal_unstored_ = 0;           // entries from the head known to have nothing on disk
+    size_t journal_memory_ = 0;             // bytes held by in-memory entries
+    bool replaying_ = false;                // catching up after a reconnect (for the log)
+    SpillLog spill_;
+    bool spill_failed_ = false;
+    bool spill_logged_ = false;
+    std::vector<char> replay_buf_;          // spilled audio read back for one slice
+    uint64_t replayed_frames_ = 0;
+    uint64_t spilled_frames_ = 0;
+    uint64_t journal_dropped_ = 0;          // never delivered: over the limits or the disk failed
     
-    bool connectToServer();
-    bool sendHeader(uint32_t user_id, const std::string& user_name, 
-                   uint32_t sample_rate, uint16_t channels);
-    bool sendAudioData(const char* data, size_t length);
+    bool resolve();
+    bool advance(int timeout_ms);
+    void startConnect(std::chrono::steady_clock::time_point now);
+    void finishConnect(std::chrono::steady_clock::time_point now);
+    void readHello();
+    void markConnected();
+    void watch(uint32_t events);
+    bool waitWritable();
+    void scheduleReconnect(const char* reason);
+    void closeSocket();
+    bool sendv(struct iovec* iov, size_t count, const char* what, const AudioChunk* chunks, size_t chunk_count);
+    void holdZeroCopyHeaders();
+    void reapZeroCopy();
+    void releaseZeroCopy();
+    void readControl();
+    void syncCredit(WireStream& stream);
+    void noteGap(WireStream& stream, uint32_t sequence, DropReason reason, StreamPriority priority);
+    bool journaling() const;
+    JournalEntry& journalAt(size_t index) { return journal_[(journal_head_ + index) % journal_.size()]; }
+    void journalAppend(uint16_t stream_id, uint32_t sequence, const AudioChunk& chunk, bool audio);
+    void keepForReplay(const AudioChunk& chunk);
+    void enforceJournalLimits();
+    bool spillNext();
+    void popJournalHead();
+    void trimJournal();
+    void releaseSpilled();
+    bool replayJournal(size_t max_bytes);
+    WireStream* wireStreamFor(uint32_t user_id, const AudioFrameRef& frame);
+    void recordDropped(const AudioChunk& chunk, DropReason reason);
+    void appendJsonFrame(uint32_t user_id, const std::string& user_name, const AudioFrameRef& frame);
+    void appendWirePreamble(WireStream& stream, uint16_t stream_id, const std::string& user_name);
+    bool appendWireFrame(const AudioChunk& chunk);
+    bool sendBatch(const AudioChunk* chunks, size_t count);
 };
 
 /**
- * Audio chunk for queuing
+ * Audio chunk for queuing. Holds references to the captured frame and the
+ * sender's name rather than copies, so a chunk can be recycled in place.
  */
 struct AudioChunk {
-    uint32_t user_id;
-    std::string user_name;
-    std::vector<char> data;
-    uint32_t sample_rate;
-    uint16_t channels;
-    
-    AudioChunk(uint32_t id, const std::string& name, const char* audio_data, 
-               size_t length, uint32_t rate, uint16_t ch)
-        : user_id(id), user_name(name), data(audio_data, audio_data + length), 
-          sample_rate(rate), channels(ch) {}
+    uint32_t user_id = 0;
+    StreamPriority priority = StreamPriority::Idle;
+    SharedName user_name;
+    AudioFrameRef frame;
 };
 
 /**
@@ -84,35 +307,178 @@ public:
     AudioStreamer();
     ~AudioStreamer();
     
-    // Initialize with backend type and configuration
+    // Initialize with backend type and configuration. Besides the backend's own
+    // options, the config takes batch_ms=N (default 5), batch_kb=N (default 256),
+    // queue_kb=N, the backlog budget (default 2048), shards=N (default 1) and
+    // cpus=A,B,.. to pin shard i's worker to the i-th CPU listed (wrapping around).
+    //
+    // With N shards each has its own queue, worker thread and backend connection,
+    // and a participant's audio always goes to the same shard (by user id), so
+    // per-stream order is kept. The budgets apply per shard.
+    //
+    // The config may list several endpoints ("hostA:port,hostB:port?options"): each
+    // gets its own shards, and participants are spread across them by consistent
+    // hashing. failover_ms=N (default 3000) is how long an endpoint may be
+    // unreachable before its participants move to the next one on the ring. One
+    // that fails to initialize counts as down from the start and is retried in the
+    // background; only if none initializes, this fails.
+    //
+    // An endpoint "unix:PATH" or "shm:PATH" uses a local backend (local_backends.h)
+    // instead of TCP, whatever backend_type says.
+    //
+    // codec=opus encodes each stream before it is queued (audio_encoder.h), on
+    // encoders=N threads (default 1) with opus_kbps=N per channel (default 24),
+    // opus_frame_ms=10|20|40|60 (default 20) and opus_complexity=0-10 (default 5).
+    //
+    // Sinks that should each get all of the audio are separated by ';', each a
+    // config of its own ("asr:8888;archive:9000?replay_kb=65536;unix:/run/monitor").
+    // Every sink has its own queue, worker and options, so a stalled sink only
+    // sheds its own audio; the frames themselves are shared, not copied. A sink
+    // that fails to initialize (bad config, DNS failure) is logged and retried in
+    // the background while the others stream; only if none does, this fails.
+    //
+    // Not while running. Whatever was configured before (sinks included) is
+    // replaced here; stop() keeps it, so start() can pick it up again.
     bool initialize(const std::string& backend_type = "tcp", 
                    const std::string& config = "localhost:8888");
     
-    // Queue audio data for streaming (non-blocking)
-    void queueAudio(uint32_t user_id, const std::string& user_name,
-                   const char* data, size_t length,
-                   uint32_t sample_rate, uint16_t channels);
+    // Queue audio data for streaming (non-blocking, lock-free). The frame is shared, not copied.
+    // False if the queue is full and the frame was dropped (by every sink, with several),
+    // or the streamer isn't running; callers count that per stream.
+    bool queueAudio(uint32_t user_id, const SharedName& user_name, const AudioFrameRef& frame,
+                    StreamPriority priority = StreamPriority::Idle);
     
-    // Start/stop streaming
+    // The participant left the meeting: with several endpoints, its sticky route is
+    // dropped, so the table only holds current participants. Audio that still comes
+    // for it is routed afresh.
+    void forgetUser(uint32_t user_id);
+    
+    // Start/stop streaming. Stopping gives queued audio up to two seconds to go out.
     void start();
     void stop();
     
-    // Stats
+    // Stats, summed over shards and sinks
     size_t getQueueSize() const;
-    bool isConnected() const;
+    bool isConnected() const;   // any shard
+    bool isRunning() const { return running_.load(); }
+    uint64_t getDroppedFrames() const;
+    uint64_t getQueueOverflows() const;
+    uint64_t getShedFrames(StreamPriority priority) const;
 
 private:
     std::unique_ptr<StreamingBackend> backend_;
     
+    // Sharding: with more than one shard (or endpoint, or sink) this instance only routes,
+    // and each shard is an AudioStreamer of its own: a single worker, one endpoint's
+    // shards, or a whole sink
+    static const size_t kMaxShards = 64;
+    std::vector<std::unique_ptr<AudioStreamer>> shards_;
+    bool fanout_ = false;                   // shards_ are sinks: every frame goes to each
+    // Set once initialize succeeds. Until then a sink or endpoint belongs to the
+    // thread retrying it, and is left out of queueing, routing and stats.
+    std::atomic<bool> ready_{false};
+    std::string tag_ = "[STREAMER]";       // log prefix, numbered per shard
+    int cpu_ = -1;                          // worker's CPU, -1 for any
+    size_t shardFor(uint32_t user_id) const;
+    bool isReachable() const;
+    bool configure(const std::string& backend_type, const std::string& config);
+    void resetRouting();
+    
+    // Sinks and endpoints that failed to initialize, retried on worker_thread_ with backoff
+    static const int kSinkRetryBaseMs = 5000;
+    static const int kSinkRetryMaxMs = 60000;
+    std::string backend_type_;
+    std::vector<std::string> sink_configs_;   // sinks' or endpoints' configs, indexed like shards_
+    void retrySinks();
+    void signalStop();
+    void finishStop();
+    
+    // Endpoint routing (shards_ are endpoints): a consistent hash ring with
+    // kRingPoints points per endpoint, and sticky routes in a lock-free open
+    // addressing table. A stream moves only when its endpoint has been unreachable
+    // for failover_after_, to the next reachable endpoint along the ring.
+    static const size_t kRingPoints = 64;
+    static const size_t kRouteSlots = 4096;
+    std::vector<std::string> endpoints_;                // as configured, indexed like shards_
+    std::vector<std::pair<uint64_t, uint16_t>> ring_;   // (point, endpoint), sorted
+    std::unique_ptr<std::atomic<uint64_t>[]> routes_;   // (user id + 1) << 16 | endpoint; 0 is free
+    static const uint64_t kRouteRemoved = 1;            // a forgotten route: probes go past it, inserts reuse it
+    std::chrono::milliseconds failover_after_{3000};
+    std::atomic<int64_t> down_since_ms_{0};   // as an endpoint: when it became unreachable, 0 if up
+    std::atomic<uint64_t> rerouted_{0};
+    size_t routeFor(uint32_t user_id);
+    size_t ringOwner(uint64_t hash, int64_t now_ms);
+    bool endpointUp(size_t endpoint, int64_t now_ms);
+    
+    // Optional encode stage: queueAudio hands frames to it, and it queues the packets
+    std::unique_ptr<OpusEncodePool> encoders_;
+    bool enqueue(AudioChunk&& chunk);
+    
     // Threading for async streaming
     std::thread worker_thread_;
     std::atomic<bool> running_;
     std::atomic<bool> connected_;
+    std::atomic<uint64_t> dropped_frames_{0};   // sent while the receiver was unreachable
+    
+    // Audio queue: fixed slots, allocated once in the constructor and recycled in
+    // place, so the queue/send path never allocates or takes a lock
+    static const size_t MAX_QUEUE_SIZE = 4096;
+    MPSCQueue<AudioChunk> queue_;
+    std::atomic<int64_t> queue_bytes_{0};   // producers add after pushing, so may briefly dip below 0
+    
+    // Wakeups: the worker sleeps on wake_fd_ (an eventfd) after publishing how many
+    // queued bytes it is waiting for; only the producer that crosses that mark writes it
+    int wake_fd_ = -1;
+    std::atomic<int64_t> wake_threshold_;
+    bool waitForBytes(int64_t threshold, std::chrono::steady_clock::time_point deadline);
+    
+    // Batching: once a chunk is waiting, the worker holds it up to max_batch_latency_
+    // for more, or less once batch_budget_ bytes are queued. The budget follows the
+    // measured send rate (what the socket takes within the latency bound), capped
+    // at max_batch_bytes_.
+    static const size_t kMaxBatchFrames = 256;
+    static const int kIdleTickMs = 250;     // longest the worker sleeps without checking on the backend
+    static const size_t kMinBatchBytes = 4 * 1024;
+    std::chrono::microseconds max_batch_latency_{5000};
+    size_t max_batch_bytes_ = 256 * 1024;
+    size_t batch_budget_ = 256 * 1024;
+    double send_bytes_per_us_ = 0;          // moving average, worker only
+    std::vector<AudioChunk> batch_;         // kMaxBatchFrames slots, allocated once
+    uint64_t batches_sent_ = 0;
+    uint64_t frames_sent_ = 0;
+    
+    void updateBatchBudget(size_t bytes, std::chrono::steady_clock::duration elapsed);
+    
+    // Backlog (worker only): queued chunks move into per-stream FIFOs whose total
+    // is kept under backlog_budget_ bytes. Over budget, the oldest frame of the
+    // lowest priority class goes, taken from whichever stream of that class
+    // holds the most; streams the receiver has stopped granting credit to go
+    // before all others, so one slow consumer costs only its own audio.
+    // Batches are filled from the highest class down, round-robin across the
+    // streams of a class.
+    struct BacklogStream {
+        uint32_t user_id = 0;
+        StreamPriority priority = StreamPriority::Idle;   // of its newest frame
+        std::vector<AudioChunk> ring;                     // kBacklogDepth slots
+        size_t head = 0;
+        size_t size = 0;
+        size_t bytes = 0;
+        bool blocked = false;                             // out of credit the last time a fill tried it
+    };
+    static const size_t kBacklogDepth = 512;
+    std::vector<BacklogStream> backlog_;
+    std::unordered_map<uint32_t, size_t> backlog_index_;   // user id -> backlog_ slot
+    size_t backlog_bytes_ = 0;
+    size_t backlog_budget_ = 2048 * 1024;
+    size_t backlog_rotation_ = 0;
+    int shedding_level_ = -1;                // most important class shed since shedding began
+    std::atomic<uint64_t> shed_frames_[kStreamPriorityCount];
     
-    // Audio queue
-    std::queue<std::unique_ptr<AudioChunk>> audio_queue_;
-    mutable std::mutex queue_mutex_;
-    std::condition_variable queue_cv_;
+    BacklogStream& backlogFor(uint32_t user_id);
+    void drainQueue();
+    void shedOldest(BacklogStream& stream);
+    bool fillBatch(size_t& count, size_t& bytes);
+    void deliverBatch(size_t count, size_t bytes);
     
     // Worker thread function
     void workerLoop();
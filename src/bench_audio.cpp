@@ -0,0 +1,63 @@
+#include "bench_audio.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+namespace ZoomBot {
+
+std::vector<int16_t> loadWav(const std::string& path, uint32_t& rate) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::vector<int16_t> pcm;
+    if (data.size() < 12 || std::memcmp(data.data(), "RIFF", 4) != 0 || std::memcmp(data.data() + 8, "WAVE", 4) != 0) {
+        return pcm;
+    }
+    uint16_t channels = 0, bits = 0;
+    for (size_t pos = 12; pos + 8 <= data.size();) {
+        uint32_t size;
+        std::memcpy(&size, data.data() + pos + 4, 4);
+        const char* body = data.data() + pos + 8;
+        size_t avail = std::min<size_t>(size, data.size() - pos - 8);
+        if (std::memcmp(data.data() + pos, "fmt ", 4) == 0 && avail >= 16) {
+            std::memcpy(&channels, body + 2, 2);
+            std::memcpy(&rate, body + 4, 4);
+            std::memcpy(&bits, body + 14, 2);
+        } else if (std::memcmp(data.data() + pos, "data", 4) == 0 && channels > 0 && bits == 16) {
+            size_t frames = avail / (2 * channels);
+            pcm.resize(frames);
+            for (size_t i = 0; i < frames; ++i) {
+                int32_t sum = 0;
+                for (uint16_t c = 0; c < channels; ++c) {
+                    int16_t s;
+                    std::memcpy(&s, body + (i * channels + c) * 2, 2);
+                    sum += s;
+                }
+                pcm[i] = static_cast<int16_t>(sum / channels);
+            }
+            return pcm;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    return pcm;
+}
+
+std::vector<int16_t> syntheticVoice(uint32_t rate, int seconds) {
+    std::vector<int16_t> pcm(static_cast<size_t>(rate) * seconds);
+    std::mt19937 rng(7);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    double phase = 0;
+    for (size_t i = 0; i < pcm.size(); ++i) {
+        double t = static_cast<double>(i) / rate;
+        double pitch = 140 + 40 * std::sin(2 * M_PI * 0.7 * t);
+        phase += 2 * M_PI * pitch / rate;
+        double envelope = 0.5 + 0.5 * std::sin(2 * M_PI * 4 * t);
+        double v = std::sin(phase) + 0.5 * std::sin(2 * phase) + 0.3 * std::sin(3 * phase) + 0.15 * std::sin(5 * phase);
+        pcm[i] = static_cast<int16_t>(std::max(-32768.0, std::min(32767.0, 5000 * envelope * v + 150 * noise(rng))));
+    }
+    return pcm;
+}
+
+} // namespace ZoomBot
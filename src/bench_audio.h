@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace ZoomBot {
+
+// Test audio shared by the benchmarks (bench_flac, bench_vad)
+
+// Mono 16-bit PCM from a WAV file, downmixed; empty if it isn't one. rate is set from the file.
+std::vector<int16_t> loadWav(const std::string& path, uint32_t& rate);
+
+// A voice-like signal: a gliding pitch with a few harmonics, syllable envelope and breath noise
+std::vector<int16_t> syntheticVoice(uint32_t rate, int seconds);
+
+} // namespace ZoomBot
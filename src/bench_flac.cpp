@@ -0,0 +1,174 @@
+// Measures FLAC recording against WAV: compression ratio and encoder CPU per
+// participant stream. Audio goes through FlacFile/DiskWriter exactly as the
+// capture worker sends it: one 10 ms frame per participant per tick.
+// Build target: bench_flac
+//
+// Participants take turns talking over digital silence, like per-user tracks
+// of a meeting; --wav FILE uses a 16-bit recording (each participant starts at
+// a different offset) instead of the synthetic voice.
+//
+// Usage: bench_flac <dir> [participants=20] [seconds=300] [sample_rate=32000] [--threads N] [--wav FILE] [--noise]
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "flac_file.h"
+#include "disk_writer.h"
+#include "bench_audio.h"
+
+using namespace ZoomBot;
+
+namespace {
+    struct Result {
+        double seconds;
+        uint64_t pcmBytes;
+        uint64_t fileBytes;
+        FlacEncodeStats flac;
+        double captureNanos;        // capture worker time in write/flushIfStale
+        uint64_t dropped;
+    };
+
+    Result run(const std::string& dir, int participants, int seconds, uint32_t rate, size_t threads,
+               const std::vector<int16_t>& voice, bool noiseFloor) {
+        DiskWriterConfig config;
+        // The benchmark produces faster than real time; let the writer fall behind without dropping
+        config.maxBuffersPerFile = 64;
+        std::vector<std::string> paths;
+        for (int p = 0; p < participants; ++p) {
+            paths.push_back(dir + "/bench_user_" + std::to_string(p) + "_" + std::to_string(rate) + "Hz_1ch.flac");
+            unlink(paths.back().c_str());
+        }
+
+        const size_t frameSamples = rate / 100;
+        std::vector<int16_t> frame(frameSamples);
+        std::mt19937 rng(1);
+        std::normal_distribution<double> noise(0.0, 3.0);
+        std::uniform_real_distribution<double> turn(1.0, 8.0);
+
+        Result result{};
+        auto start = std::chrono::steady_clock::now();
+        {
+            DiskWriter writer(config);
+            FlacEncodePool pool(threads);
+            std::vector<std::unique_ptr<FlacFile>> files;
+            for (const auto& path : paths) {
+                files.emplace_back(new FlacFile(pool, writer, path, rate, 1));
+            }
+
+            // One speaker at a time for a few seconds, the others silent
+            int speaker = 0;
+            int turnEnd = static_cast<int>(turn(rng) * 100);
+            const int ticks = seconds * 100;
+            for (int t = 0; t < ticks; ++t) {
+                if (t >= turnEnd) {
+                    speaker = static_cast<int>(rng() % participants);
+                    turnEnd = t + static_cast<int>(turn(rng) * 100);
+                }
+                auto now = std::chrono::steady_clock::now();
+                for (int p = 0; p < participants; ++p) {
+                    if (p == speaker) {
+                        size_t offset = (static_cast<size_t>(t) * frameSamples + static_cast<size_t>(p) * rate * 7) %
+                                        (voice.size() - frameSamples);
+                        std::memcpy(frame.data(), voice.data() + offset, frameSamples * sizeof(int16_t));
+                    } else if (noiseFloor) {
+                        for (auto& s : frame) s = static_cast<int16_t>(noise(rng));
+                    } else {
+                        std::fill(frame.begin(), frame.end(), 0);
+                    }
+                    auto before = std::chrono::steady_clock::now();
+                    files[p]->write(reinterpret_cast<const char*>(frame.data()), frame.size() * sizeof(int16_t));
+                    files[p]->flushIfStale(now);
+                    result.captureNanos += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - before).count();
+                }
+                // Keep the encoders within their backlog limit (a second of audio is 8-12 blocks)
+                if (t % 100 == 99) {
+                    pool.drain();
+                }
+            }
+            for (auto& file : files) {
+                result.pcmBytes += file->dataBytes();
+                file->close();
+            }
+            pool.drain();
+            writer.drain();
+            for (auto& file : files) {
+                result.dropped += file->droppedBytes();
+            }
+            files.clear();
+            result.flac = pool.stats();
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (const auto& path : paths) {
+            std::ifstream in(path, std::ios::binary | std::ios::ate);
+            result.fileBytes += static_cast<uint64_t>(in.tellg());
+            unlink(path.c_str());
+        }
+        return result;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> args;
+    size_t threads = 2;
+    std::string wavPath;
+    bool noiseFloor = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--wav") == 0 && i + 1 < argc) wavPath = argv[++i];
+        else if (std::strcmp(argv[i], "--noise") == 0) noiseFloor = true;
+        else args.push_back(argv[i]);
+    }
+    if (args.empty()) {
+        std::cerr << "Usage: " << argv[0] << " <dir> [participants=20] [seconds=300] [sample_rate=32000]"
+                  << " [--threads N] [--wav FILE] [--noise]" << std::endl;
+        return 1;
+    }
+
+    const std::string dir = args[0];
+    const int participants = args.size() > 1 ? std::atoi(args[1].c_str()) : 20;
+    const int seconds = args.size() > 2 ? std::atoi(args[2].c_str()) : 300;
+    uint32_t rate = args.size() > 3 ? static_cast<uint32_t>(std::atoi(args[3].c_str())) : 32000;
+    if (participants < 1 || seconds < 1 || rate < 8000) {
+        std::cerr << "Need at least one participant, one second and 8000 Hz" << std::endl;
+        return 1;
+    }
+
+    std::vector<int16_t> voice;
+    if (!wavPath.empty()) {
+        voice = loadWav(wavPath, rate);
+        if (voice.size() < rate) {
+            std::cerr << "Can't use " << wavPath << ": needs a second or more of 16-bit PCM" << std::endl;
+            return 1;
+        }
+    } else {
+        voice = syntheticVoice(rate, 60);
+    }
+
+    std::cout << participants << " participants x " << seconds << " s at " << rate << " Hz, one talking at a time over "
+              << (noiseFloor ? "a noise floor" : "digital silence") << ", " << threads << " encoder threads"
+              << (wavPath.empty() ? "" : ", voice from " + wavPath) << std::endl;
+
+    Result r = run(dir, participants, seconds, rate, threads, voice, noiseFloor);
+    double streamSeconds = static_cast<double>(participants) * seconds;
+    std::cout << std::fixed << std::setprecision(1)
+              << "  WAV " << r.pcmBytes / (1024.0 * 1024.0) << " MB -> FLAC " << r.fileBytes / (1024.0 * 1024.0)
+              << " MB, ratio " << std::setprecision(2) << static_cast<double>(r.pcmBytes) / r.fileBytes << ":1" << std::endl
+              << std::setprecision(1)
+              << "  Encoder CPU: " << r.flac.cpuNanos / 1e6 << " ms total, "
+              << r.flac.cpuNanos / 1e3 / streamSeconds << " us per stream-second ("
+              << std::setprecision(3) << r.flac.cpuNanos / 1e7 / streamSeconds << "% of a core per participant)" << std::endl
+              << std::setprecision(1)
+              << "  Capture worker: " << r.captureNanos / 1e3 / streamSeconds << " us per stream-second in write/flushIfStale" << std::endl
+              << "  " << streamSeconds / r.seconds << "x realtime, dropped " << r.dropped << " B" << std::endl;
+    return 0;
+}
@@ -0,0 +1,117 @@
+// Compares the recording storage backends (posix pwritev vs io_uring) by
+// writing synthetic participant audio through DiskWriter/PCMFile exactly as
+// the capture worker does: one 10 ms frame per participant per tick.
+// Build target: bench_storage
+//
+// Usage: bench_storage <dir> [participants=200] [seconds=60] [frame_bytes=640] [--direct] [--sync]
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "pcm_file.h"
+#include "disk_writer.h"
+
+using namespace ZoomBot;
+
+namespace {
+    struct Result {
+        double seconds;
+        DiskWriterStats stats;
+        uint64_t dropped;
+        const char* backend;
+    };
+
+    Result run(const std::string& dir, DiskWriterConfig config, int participants, int seconds, size_t frameBytes) {
+        std::vector<char> pcm(frameBytes);
+        for (size_t i = 0; i < frameBytes; ++i) pcm[i] = static_cast<char>(i * 31);
+
+        std::vector<std::string> paths;
+        for (int p = 0; p < participants; ++p) {
+            paths.push_back(dir + "/bench_user_" + std::to_string(p) + "_32000Hz_1ch.pcm");
+            unlink(paths.back().c_str());
+        }
+
+        Result result{};
+        auto start = std::chrono::steady_clock::now();
+        {
+            DiskWriter writer(config);
+            result.backend = writer.backendName();
+            std::vector<std::unique_ptr<PCMFile>> files;
+            for (const auto& path : paths) {
+                files.emplace_back(new PCMFile(writer, path));
+            }
+
+            const int ticks = seconds * 100;
+            for (int t = 0; t < ticks; ++t) {
+                auto now = std::chrono::steady_clock::now();
+                for (auto& file : files) {
+                    file->write(pcm.data(), pcm.size());
+                    file->flushIfStale(now);
+                }
+            }
+            for (auto& file : files) {
+                result.dropped += file->droppedBytes();
+            }
+            files.clear();
+            writer.drain();
+            result.stats = writer.stats();
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (const auto& path : paths) {
+            unlink(path.c_str());
+        }
+        return result;
+    }
+
+    void report(const Result& r, int participants, int seconds) {
+        double mb = r.stats.bytesWritten / (1024.0 * 1024.0);
+        std::cout << std::left << std::setw(10) << r.backend << std::right
+                  << std::fixed << std::setprecision(3)
+                  << std::setw(9) << r.seconds << " s"
+                  << std::setprecision(1)
+                  << std::setw(10) << mb / r.seconds << " MB/s"
+                  << std::setw(10) << r.stats.writeCalls << " write calls"
+                  << std::setw(8) << r.stats.syncCalls << " syncs"
+                  << std::setw(8) << (participants * static_cast<double>(seconds)) / r.seconds << "x realtime"
+                  << "  dropped " << r.dropped << " B, errors " << r.stats.errors << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> args;
+    DiskWriterConfig config;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--direct") == 0) config.directIO = true;
+        else if (std::strcmp(argv[i], "--sync") == 0) config.syncData = true;
+        else args.push_back(argv[i]);
+    }
+    if (args.empty()) {
+        std::cerr << "Usage: " << argv[0] << " <dir> [participants=200] [seconds=60] [frame_bytes=640] [--direct] [--sync]" << std::endl;
+        return 1;
+    }
+
+    const std::string dir = args[0];
+    const int participants = args.size() > 1 ? std::atoi(args[1].c_str()) : 200;
+    const int seconds = args.size() > 2 ? std::atoi(args[2].c_str()) : 60;
+    const size_t frameBytes = args.size() > 3 ? std::strtoul(args[3].c_str(), nullptr, 10) : 640;
+    // The benchmark produces faster than real time; let the writer fall behind without dropping
+    config.maxBuffersPerFile = 64;
+
+    std::cout << participants << " participants x " << seconds << " s of " << frameBytes
+              << "-byte frames, " << config.bufferBytes / 1024 << " KB buffers"
+              << (config.directIO ? ", O_DIRECT" : "") << (config.syncData ? ", fdatasync" : "") << std::endl;
+
+    for (StorageBackendType type : {StorageBackendType::Posix, StorageBackendType::IoUring}) {
+        config.backend = type;
+        report(run(dir, config, participants, seconds, frameBytes), participants, seconds);
+    }
+    return 0;
+}
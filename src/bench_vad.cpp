@@ -0,0 +1,210 @@
+// Measures the voice-activity gate: frame analysis throughput of the vector
+// implementation against the scalar one (and that they agree), then how much
+// of each participant's audio the gate keeps out of storage and streaming.
+// Build target: bench_vad
+//
+// Participants take turns talking, like per-user tracks of a meeting, over
+// digital silence or, with --noise, a room-noise floor; --wav FILE uses a
+// 16-bit recording (each participant starts at a different offset) instead of
+// the synthetic voice.
+//
+// Usage: bench_vad [participants=20] [seconds=300] [sample_rate=32000] [--wav FILE] [--noise]
+//                  [--hangover MS] [--preroll MS] [--margin DB]
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#include "voice_activity.h"
+#include "audio_frame.h"
+#include "bench_audio.h"
+
+using namespace ZoomBot;
+
+namespace {
+    // Frames per second through analyzeFrame and analyzeFrameScalar; false if they disagree
+    bool analysisThroughput(const std::vector<int16_t>& voice, size_t frameSamples, double& vectorRate, double& scalarRate) {
+        const size_t frames = (voice.size() - frameSamples) / frameSamples;
+        const int passes = 20;
+        bool same = true;
+        for (size_t f = 0; f < frames; ++f) {
+            FrameFeatures a = analyzeFrame(voice.data() + f * frameSamples, frameSamples, 1);
+            FrameFeatures b = analyzeFrameScalar(voice.data() + f * frameSamples, frameSamples, 1);
+            same = same && a.energy == b.energy && a.crossings == b.crossings;
+        }
+
+        uint64_t sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int p = 0; p < passes; ++p) {
+            for (size_t f = 0; f < frames; ++f) {
+                sink += analyzeFrame(voice.data() + f * frameSamples, frameSamples, 1).crossings;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        vectorRate = passes * frames / seconds;
+
+        start = std::chrono::steady_clock::now();
+        for (int p = 0; p < passes; ++p) {
+            for (size_t f = 0; f < frames; ++f) {
+                sink += analyzeFrameScalar(voice.data() + f * frameSamples, frameSamples, 1).crossings;
+            }
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        scalarRate = passes * frames / seconds;
+        return same && sink != 1;   // keeps the loops from being optimized away
+    }
+
+    struct Result {
+        double gateNanos;           // time spent in push
+        uint64_t framesIn;
+        uint64_t framesGated;
+        uint64_t bytesIn;
+        uint64_t bytesGated;
+        uint64_t markers;
+        uint64_t speechFrames;      // frames a participant was actually talking in
+        uint64_t speechGated;       // of those, frames the gate dropped
+    };
+
+    Result run(int participants, int seconds, uint32_t rate, const VoiceActivityConfig& config,
+               const std::vector<int16_t>& voice, bool noiseFloor) {
+        const size_t frameSamples = rate / 100;
+        const size_t frameBytes = frameSamples * sizeof(int16_t);
+        std::vector<int16_t> frame(frameSamples);
+        std::mt19937 rng(1);
+        std::normal_distribution<double> noise(0.0, 30.0);
+        std::uniform_real_distribution<double> turn(1.0, 8.0);
+
+        std::vector<std::unique_ptr<VoiceActivityGate>> gates;
+        for (int p = 0; p < participants; ++p) {
+            gates.emplace_back(new VoiceActivityGate(config, rate, 1));
+        }
+        std::vector<AudioFrameRef> released;
+        released.reserve(64);
+        // Which frames were speech, by their capture time, to tell dropped speech from dropped silence
+        std::vector<std::vector<bool>> talking(participants, std::vector<bool>(static_cast<size_t>(seconds) * 100));
+
+        Result result{};
+        uint64_t speechKept = 0;
+        int speaker = 0;
+        int turnEnd = static_cast<int>(turn(rng) * 100);
+        const int ticks = seconds * 100;
+        for (int t = 0; t < ticks; ++t) {
+            if (t >= turnEnd) {
+                speaker = static_cast<int>(rng() % participants);
+                turnEnd = t + static_cast<int>(turn(rng) * 100);
+            }
+            for (int p = 0; p < participants; ++p) {
+                if (p == speaker) {
+                    size_t offset = (static_cast<size_t>(t) * frameSamples + static_cast<size_t>(p) * rate * 7) %
+                                    (voice.size() - frameSamples);
+                    std::memcpy(frame.data(), voice.data() + offset, frameBytes);
+                    talking[p][t] = true;
+                } else if (noiseFloor) {
+                    for (auto& s : frame) s = static_cast<int16_t>(noise(rng));
+                } else {
+                    std::fill(frame.begin(), frame.end(), 0);
+                }
+                AudioFrameRef ref = AudioFramePool::instance().acquire();
+                ref->assign(reinterpret_cast<const char*>(frame.data()), frameBytes);
+                ref->sampleRate = rate;
+                ref->channels = 1;
+                ref->captureTimeMs = static_cast<int64_t>(t) * 10;
+                result.bytesIn += frameBytes;
+
+                released.clear();
+                auto before = std::chrono::steady_clock::now();
+                gates[p]->push(std::move(ref), released);
+                result.gateNanos += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - before).count();
+                for (const auto& out : released) {
+                    if (out->silentSamples > 0) {
+                        result.markers++;
+                    } else if (talking[p][static_cast<size_t>(out->captureTimeMs / 10)]) {
+                        speechKept++;
+                    }
+                }
+            }
+        }
+        for (int p = 0; p < participants; ++p) {
+            released.clear();
+            gates[p]->flush(released);
+            for (const auto& out : released) {
+                if (out->silentSamples > 0) result.markers++;
+            }
+            result.framesIn += gates[p]->framesIn();
+            result.framesGated += gates[p]->framesGated();
+            result.bytesGated += gates[p]->bytesGated();
+            for (bool speech : talking[p]) {
+                result.speechFrames += speech;
+            }
+        }
+        result.speechGated = result.speechFrames - speechKept;
+        return result;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> args;
+    std::string wavPath;
+    bool noiseFloor = false;
+    VoiceActivityConfig config;
+    config.enabled = true;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--wav") == 0 && i + 1 < argc) wavPath = argv[++i];
+        else if (std::strcmp(argv[i], "--noise") == 0) noiseFloor = true;
+        else if (std::strcmp(argv[i], "--hangover") == 0 && i + 1 < argc) config.hangoverMs = std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--preroll") == 0 && i + 1 < argc) config.prerollMs = std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--margin") == 0 && i + 1 < argc) config.marginDb = std::strtoul(argv[++i], nullptr, 10);
+        else args.push_back(argv[i]);
+    }
+
+    const int participants = args.size() > 0 ? std::atoi(args[0].c_str()) : 20;
+    const int seconds = args.size() > 1 ? std::atoi(args[1].c_str()) : 300;
+    uint32_t rate = args.size() > 2 ? static_cast<uint32_t>(std::atoi(args[2].c_str())) : 32000;
+    if (participants < 1 || seconds < 1 || rate < 8000) {
+        std::cerr << "Usage: " << argv[0] << " [participants=20] [seconds=300] [sample_rate=32000]"
+                  << " [--wav FILE] [--noise] [--hangover MS] [--preroll MS] [--margin DB]" << std::endl;
+        return 1;
+    }
+
+    std::vector<int16_t> voice;
+    if (!wavPath.empty()) {
+        voice = loadWav(wavPath, rate);
+        if (voice.size() < rate) {
+            std::cerr << "Can't use " << wavPath << ": needs a second or more of 16-bit PCM" << std::endl;
+            return 1;
+        }
+    } else {
+        voice = syntheticVoice(rate, 60);
+    }
+
+    double vectorRate = 0, scalarRate = 0;
+    bool same = analysisThroughput(voice, rate / 100, vectorRate, scalarRate);
+    std::cout << "Frame analysis (" << rate / 100 << "-sample frames): " << std::fixed << std::setprecision(1)
+              << frameAnalyzerName() << " " << vectorRate / 1e6 << " M frames/s, scalar " << scalarRate / 1e6
+              << " M frames/s (" << std::setprecision(2) << vectorRate / scalarRate << "x), "
+              << (same ? "results match" : "RESULTS DIFFER") << std::endl;
+
+    std::cout << participants << " participants x " << seconds << " s at " << rate << " Hz, one talking at a time over "
+              << (noiseFloor ? "a noise floor" : "digital silence") << ", hangover " << config.hangoverMs
+              << " ms, pre-roll " << config.prerollMs << " ms, margin " << config.marginDb << " dB"
+              << (wavPath.empty() ? "" : ", voice from " + wavPath) << std::endl;
+
+    Result r = run(participants, seconds, rate, config, voice, noiseFloor);
+    double streamSeconds = static_cast<double>(participants) * seconds;
+    std::cout << std::fixed << std::setprecision(1)
+              << "  Gated " << r.framesGated << " of " << r.framesIn << " frames ("
+              << 100.0 * r.framesGated / r.framesIn << "%), " << r.markers << " silence markers" << std::endl
+              << "  Kept " << (r.bytesIn - r.bytesGated) / (1024.0 * 1024.0) << " MB of "
+              << r.bytesIn / (1024.0 * 1024.0) << " MB, " << (r.bytesIn - r.bytesGated) * 8.0 / streamSeconds / 1000
+              << " kbit/s per participant instead of " << r.bytesIn * 8.0 / streamSeconds / 1000 << std::endl
+              << "  Speech frames gated: " << r.speechGated << " of " << r.speechFrames << std::endl
+              << "  Gate: " << r.gateNanos / r.framesIn << " ns per frame, "
+              << r.gateNanos / 1e3 / streamSeconds << " us per stream-second" << std::endl;
+    return same ? 0 : 1;
+}
@@ -13,6 +13,9 @@ std::string Config::appSecret_;
 uint64_t Config::meetingNumber_ = 0;
 std::string Config::meetingPassword_;
 std::string Config::botUsername_;
+DiskWriterConfig Config::diskWriter_;
+VoiceActivityConfig Config::voiceActivity_;
+std::string Config::streamEndpoint_ = "localhost:8888";
 std::string Config::jwtToken_;
 bool Config::loaded_ = false;
 
@@ -50,6 +53,26 @@ bool Config::loadFromEnvironment() {
     meetingPassword_ = getEnvVar("ZOOM_MEETING_PASSWORD");
     botUsername_ = getEnvVar("ZOOM_BOT_USERNAME", "ZoomBot");
 
+    // Recording flush policy
+    diskWriter_.bufferBytes = getEnvVarUint64("ZOOM_BOT_RECORDING_BUFFER_KB", diskWriter_.bufferBytes / 1024) * 1024;
+    diskWriter_.maxBufferAgeMs = static_cast<uint32_t>(getEnvVarUint64("ZOOM_BOT_RECORDING_FLUSH_MS", diskWriter_.maxBufferAgeMs));
+    diskWriter_.syncData = getEnvVarUint64("ZOOM_BOT_RECORDING_SYNC", diskWriter_.syncData ? 1 : 0) != 0;
+    diskWriter_.directIO = getEnvVarUint64("ZOOM_BOT_RECORDING_DIRECT_IO", diskWriter_.directIO ? 1 : 0) != 0;
+    diskWriter_.backend = parseStorageBackend(getEnvVar("ZOOM_BOT_RECORDING_IO", storageBackendName(diskWriter_.backend)));
+    diskWriter_.segmentSeconds = static_cast<uint32_t>(getEnvVarUint64("ZOOM_BOT_RECORDING_SEGMENT_SECONDS", diskWriter_.segmentSeconds));
+    diskWriter_.segmentBytes = getEnvVarUint64("ZOOM_BOT_RECORDING_SEGMENT_MB", diskWriter_.segmentBytes / (1024 * 1024)) * 1024 * 1024;
+    diskWriter_.format = parseRecordingFormat(getEnvVar("ZOOM_BOT_RECORDING_FORMAT", recordingFormatName(diskWriter_.format)));
+    diskWriter_.encoderThreads = static_cast<unsigned>(getEnvVarUint64("ZOOM_BOT_RECORDING_ENCODERS", diskWriter_.encoderThreads));
+
+    // Voice-activity gate (recording and streaming)
+    voiceActivity_.enabled = getEnvVarUint64("ZOOM_BOT_VAD", voiceActivity_.enabled ? 1 : 0) != 0;
+    voiceActivity_.hangoverMs = static_cast<uint32_t>(getEnvVarUint64("ZOOM_BOT_VAD_HANGOVER_MS", voiceActivity_.hangoverMs));
+    voiceActivity_.prerollMs = static_cast<uint32_t>(getEnvVarUint64("ZOOM_BOT_VAD_PREROLL_MS", voiceActivity_.prerollMs));
+    voiceActivity_.marginDb = static_cast<uint32_t>(getEnvVarUint64("ZOOM_BOT_VAD_MARGIN_DB", voiceActivity_.marginDb));
+
+    // Streaming
+    streamEndpoint_ = getEnvVar("ZOOM_BOT_STREAM_ENDPOINT", streamEndpoint_);
+
     loaded_ = true;
     return isValid();
 }
@@ -62,6 +85,9 @@ const std::string& Config::getAppSecret() { return appSecret_; }
 uint64_t Config::getMeetingNumber() { return meetingNumber_; }
 const std::string& Config::getMeetingPassword() { return meetingPassword_; }
 const std::string& Config::getBotUsername() { return botUsername_; }
+const DiskWriterConfig& Config::getDiskWriterConfig() { return diskWriter_; }
+const VoiceActivityConfig& Config::getVoiceActivityConfig() { return voiceActivity_; }
+const std::string& Config::getStreamEndpoint() { return streamEndpoint_; }
 
 void Config::setMeetingNumber(uint64_t meetingNumber) {
     meetingNumber_ = meetingNumber;
@@ -176,6 +202,28 @@ void Config::printStatus() {
     std::cout << "  Meeting Number: " << (meetingNumber_ == 0 ? "❌ NOT SET" : std::to_string(meetingNumber_)) << std::endl;
     std::cout << "  Meeting Password: " << (meetingPassword_.empty() ? "❌ NOT SET" : "✅ SET") << std::endl;
     std::cout << "  Bot Username: " << botUsername_ << std::endl;
+    
+    std::cout << "Recording:" << std::endl;
+    std::cout << "  Format: " << recordingFormatName(diskWriter_.format)
+              << (diskWriter_.format == RecordingFormat::Flac ? " (" + std::to_string(diskWriter_.encoderThreads) + " encoder threads)" : "")
+              << std::endl;
+    std::cout << "  Write buffer: " << storageBackendName(diskWriter_.backend) << ", "
+              << diskWriter_.bufferBytes / 1024 << " KB, flush every "
+              << diskWriter_.maxBufferAgeMs << " ms" << (diskWriter_.syncData ? ", fdatasync" : "")
+              << (diskWriter_.directIO ? ", O_DIRECT" : "") << std::endl;
+    if (diskWriter_.segmentSeconds > 0 || diskWriter_.segmentBytes > 0) {
+        std::cout << "  Segments: " << (diskWriter_.segmentSeconds > 0 ? std::to_string(diskWriter_.segmentSeconds) + " s" : "")
+                  << (diskWriter_.segmentSeconds > 0 && diskWriter_.segmentBytes > 0 ? " or " : "")
+                  << (diskWriter_.segmentBytes > 0 ? std::to_string(diskWriter_.segmentBytes / (1024 * 1024)) + " MB" : "")
+                  << ", listed in manifest.jsonl" << std::endl;
+    }
+    if (voiceActivity_.enabled) {
+        std::cout << "  Voice activity gate: " << voiceActivity_.marginDb << " dB margin, "
+                  << voiceActivity_.hangoverMs << " ms hangover, " << voiceActivity_.prerollMs
+                  << " ms pre-roll, gaps listed in silence.jsonl" << std::endl;
+    }
+    std::cout << "Streaming:" << std::endl;
+    std::cout << "  Endpoint: " << streamEndpoint_ << std::endl;
     std::cout << "=============================" << std::endl;
 }
 
@@ -3,6 +3,9 @@
 #include <string>
 #include <cstdint>
 
+#include "disk_writer.h"
+#include "voice_activity.h"
+
 namespace ZoomBot {
 
 /**
@@ -36,6 +39,23 @@ public:
     static const std::string& getMeetingPassword();
     static const std::string& getBotUsername();
 
+    /**
+     * @brief Recording format and flush policy (ZOOM_BOT_RECORDING_* variables, defaults otherwise)
+     */
+    static const DiskWriterConfig& getDiskWriterConfig();
+
+    /**
+     * @brief Voice-activity gate for participant streams (ZOOM_BOT_VAD* variables, off by default)
+     */
+    static const VoiceActivityConfig& getVoiceActivityConfig();
+
+    /**
+     * @brief Audio processing service(s) the bot streams to (ZOOM_BOT_STREAM_ENDPOINT,
+     *        "host:port[,host:port...][?options]", "unix:PATH" or "shm:PATH";
+     *        several sinks separated by ';'; default localhost:8888)
+     */
+    static const std::string& getStreamEndpoint();
+
     /**
      * @brief Override meeting configuration (for console input)
      */
@@ -83,6 +103,13 @@ private:
     static std::string meetingPassword_;
     static std::string botUsername_;
 
+    // Recording
+    static DiskWriterConfig diskWriter_;
+    static VoiceActivityConfig voiceActivity_;
+
+    // Streaming
+    static std::string streamEndpoint_;
+
     // Runtime tokens
     static std::string jwtToken_;
 
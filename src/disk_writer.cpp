@@ -0,0 +1,247 @@
+#include "disk_writer.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace ZoomBot {
+
+const char* recordingFormatName(RecordingFormat format) {
+    switch (format) {
+        case RecordingFormat::Wav: return "wav";
+        case RecordingFormat::Flac: return "flac";
+    }
+    return "unknown";
+}
+
+RecordingFormat parseRecordingFormat(const std::string& name) {
+    if (name == "flac") return RecordingFormat::Flac;
+    return RecordingFormat::Wav;
+}
+
+DiskWriter::FileState::~FileState() {
+    if (fd >= 0) ::close(fd);
+    if (patchFd >= 0) ::close(patchFd);
+}
+
+DiskWriter::DiskWriter(const DiskWriterConfig& config) : config_(config) {
+    // Buffers double as O_DIRECT transfer units, so keep them whole blocks
+    config_.bufferBytes = (config_.bufferBytes + kBlockSize - 1) / kBlockSize * kBlockSize;
+    if (config_.bufferBytes == 0) config_.bufferBytes = kBlockSize;
+    if (config_.maxBuffersPerFile < 2) config_.maxBuffersPerFile = 2;
+    backend_ = createStorageBackend(config_.backend, config_.queueDepth);
+    thread_ = std::thread(&DiskWriter::writerLoop, this);
+}
+
+DiskWriter::~DiskWriter() {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    backend_.reset();
+    for (char* slab : slabs_) {
+        std::free(slab);
+    }
+}
+
+void DiskWriter::drain() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    drainedCv_.wait(lk, [this] { return outstanding_ == 0; });
+}
+
+DiskWriterStats DiskWriter::stats() const {
+    return DiskWriterStats{bytesWritten_.load(), writeCalls_.load(), syncCalls_.load(), errors_.load()};
+}
+
+std::shared_ptr<DiskWriter::FileState> DiskWriter::open(const std::string& path, uint64_t& size, bool allowDirect) {
+    auto state = std::make_shared<FileState>();
+    state->path = path;
+
+    // Existing files are continued, not truncated (re-subscribing reuses the name)
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+    if (config_.directIO && allowDirect) {
+        state->fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+        if (state->fd < 0) {
+            std::cerr << "[AUDIO] O_DIRECT not supported for " << path << ", using buffered I/O" << std::endl;
+        } else {
+            state->direct = true;
+        }
+    }
+    if (state->fd < 0) {
+        state->fd = ::open(path.c_str(), flags, 0644);
+    }
+    if (state->fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st{};
+    size = (fstat(state->fd, &st) == 0) ? static_cast<uint64_t>(st.st_size) : 0;
+    if (state->direct && size % kBlockSize != 0) {
+        // Appending at an unaligned offset cannot go through O_DIRECT
+        int fl = fcntl(state->fd, F_GETFL);
+        fcntl(state->fd, F_SETFL, fl & ~O_DIRECT);
+        state->direct = false;
+    }
+    return state;
+}
+
+bool DiskWriter::takeBuffer(FileState& file, Buffer& out) {
+    std::lock_guard<std::mutex> lk(poolMtx_);
+    if (file.buffersInUse >= config_.maxBuffersPerFile) {
+        return false;
+    }
+    if (freeBuffers_.empty()) {
+        void* mem = nullptr;
+        size_t slabBytes = config_.bufferBytes * kBuffersPerSlab;
+        if (posix_memalign(&mem, kBlockSize, slabBytes) != 0) {
+            return false;
+        }
+        uint32_t index = static_cast<uint32_t>(slabs_.size());
+        slabs_.push_back(static_cast<char*>(mem));
+        for (size_t i = kBuffersPerSlab; i-- > 0;) {
+            freeBuffers_.push_back(Buffer{static_cast<char*>(mem) + i * config_.bufferBytes, index});
+        }
+        backend_->addSlab(index, static_cast<char*>(mem), slabBytes);
+    }
+    out = freeBuffers_.back();
+    freeBuffers_.pop_back();
+    ++file.buffersInUse;
+    return true;
+}
+
+void DiskWriter::submit(Job&& job) {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        queue_.push_back(std::move(job));
+        ++outstanding_;
+    }
+    cv_.notify_one();
+}
+
+void DiskWriter::writerLoop() {
+    std::vector<Job> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lk(mtx_);
+            cv_.wait(lk, [this] { return !queue_.empty() || stopping_; });
+            if (queue_.empty()) break;   // stopping and nothing left
+            batch.swap(queue_);
+        }
+
+        size_t count = batch.size();
+        writeBatch(batch);
+        batch.clear();
+
+        {
+            std::lock_guard<std::mutex> lk(mtx_);
+            outstanding_ -= count;
+        }
+        drainedCv_.notify_all();
+    }
+}
+
+void DiskWriter::writeBatch(std::vector<Job>& batch) {
+    // Everything queued goes to the backend in one call; offsets are absolute, so order does not matter
+    ops_.clear();
+    for (Job& job : batch) {
+        FileState& file = *job.file;
+        if (file.failed.load(std::memory_order_relaxed)) {
+            job.len = 0;   // file is already broken; just recycle the buffer
+        }
+        if (job.len == 0) continue;
+        if (job.close && file.direct) {
+            // The final tail is not block-sized; finish it through the page cache
+            int fl = fcntl(file.fd, F_GETFL);
+            fcntl(file.fd, F_SETFL, fl & ~O_DIRECT);
+            file.direct = false;
+        }
+        ops_.push_back(WriteOp{file.fd, job.buffer.data, job.len, job.offset, job.buffer.slab, 0});
+    }
+    if (!ops_.empty()) {
+        writeCalls_.fetch_add(backend_->write(ops_.data(), ops_.size()), std::memory_order_relaxed);
+    }
+
+    syncFds_.clear();
+    for (const WriteOp& op : ops_) {
+        if (op.result == 0) {
+            bytesWritten_.fetch_add(op.len, std::memory_order_relaxed);
+            if (config_.syncData && std::find(syncFds_.begin(), syncFds_.end(), op.fd) == syncFds_.end()) {
+                syncFds_.push_back(op.fd);
+            }
+        }
+    }
+    if (!syncFds_.empty()) {
+        syncCalls_.fetch_add(backend_->sync(syncFds_.data(), syncFds_.size()), std::memory_order_relaxed);
+    }
+
+    size_t opIndex = 0;
+    for (Job& job : batch) {
+        FileState& file = *job.file;
+        if (job.len > 0) {
+            const WriteOp& op = ops_[opIndex++];
+            if (op.result < 0) {
+                std::cerr << "[AUDIO] Write to " << file.path << " failed: " << std::strerror(-op.result) << std::endl;
+                errors_.fetch_add(1, std::memory_order_relaxed);
+                file.failed.store(true, std::memory_order_relaxed);
+            }
+        }
+        if (job.patchLen > 0 && !file.failed.load(std::memory_order_relaxed)) {
+            applyPatch(job);
+        }
+        if (job.close) {
+            ::close(file.fd);
+            file.fd = -1;
+            if (file.patchFd >= 0) {
+                ::close(file.patchFd);
+                file.patchFd = -1;
+            }
+            file.closed.store(true, std::memory_order_release);
+        }
+        recycle(job);
+    }
+}
+
+void DiskWriter::applyPatch(const Job& job) {
+    FileState& file = *job.file;
+    int fd = file.fd;
+    if (file.direct) {
+        // Headers are small and unaligned; write them through the page cache
+        if (file.patchFd < 0) {
+            file.patchFd = ::open(file.path.c_str(), O_WRONLY | O_CLOEXEC);
+        }
+        fd = file.patchFd;
+    }
+    ssize_t n;
+    do {
+        n = pwrite(fd, job.patch, job.patchLen, static_cast<off_t>(job.patchOffset));
+    } while (n < 0 && errno == EINTR);
+    if (n != static_cast<ssize_t>(job.patchLen)) {
+        std::cerr << "[AUDIO] Header update for " << file.path << " failed: " << std::strerror(errno) << std::endl;
+        errors_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (job.close && config_.syncData) {
+        fdatasync(fd);
+        syncCalls_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void DiskWriter::recycle(Job& job) {
+    if (job.buffer.data) {
+        std::lock_guard<std::mutex> lk(poolMtx_);
+        freeBuffers_.push_back(job.buffer);
+        --job.file->buffersInUse;
+    }
+    job.file.reset();
+}
+
+} // namespace ZoomBot
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+#include "storage_backend.h"
+
+namespace ZoomBot {
+
+enum class RecordingFormat : uint8_t {
+    Wav,        // 16-bit PCM, WAV/RF64
+    Flac        // lossless, encoded on FlacEncodePool threads
+};
+
+const char* recordingFormatName(RecordingFormat format);
+// "wav" / "flac"; anything else maps to Wav
+RecordingFormat parseRecordingFormat(const std::string& name);
+
+// Flush policy for recordings. A buffer is handed to the writer thread when it
+// fills up (size) or when its oldest byte is maxBufferAgeMs old (time), so a
+// process crash loses at most maxBufferAgeMs of audio per stream. With
+// syncData the same bound holds for a host crash. WAV headers are rewritten
+// every headerUpdateMs, so after a crash they cover all but that much audio.
+// With segmentSeconds/segmentBytes set, each stream is split into numbered
+// files listed in the recording's manifest.jsonl as they complete.
+// FLAC recordings take the same flush and header policy.
+struct DiskWriterConfig {
+    size_t bufferBytes = 128 * 1024;     // per batch; rounded up to kBlockSize
+    uint32_t maxBufferAgeMs = 1000;
+    uint32_t headerUpdateMs = 5000;
+    uint32_t segmentSeconds = 0;         // audio per segment file (0 = no time limit)
+    uint64_t segmentBytes = 0;           // audio bytes per segment file (0 = no size limit)
+    size_t maxBuffersPerFile = 8;        // backlog per file before new audio is dropped
+    bool syncData = false;               // fdatasync after every batch
+    bool directIO = false;               // O_DIRECT, block-aligned writes (keeps a < 4 KiB tail in memory)
+    StorageBackendType backend = StorageBackendType::Posix;
+    unsigned queueDepth = 256;           // io_uring submission queue size
+    RecordingFormat format = RecordingFormat::Wav;
+    unsigned encoderThreads = 2;         // FLAC only
+};
+
+struct DiskWriterStats {
+    uint64_t bytesWritten;
+    uint64_t writeCalls;
+    uint64_t syncCalls;
+    uint64_t errors;
+};
+
+/**
+ * Background writer shared by every recording file.
+ *
+ * PCMFile collects frames into large aligned buffers on the capture worker;
+ * full or stale buffers are queued here and written by one thread through
+ * the configured StorageBackend, a whole queue's worth at a time.
+ * Buffers come from one pool of aligned slabs shared by all files, so
+ * they can be registered with the kernel once.
+ */
+class DiskWriter {
+public:
+    static const size_t kBlockSize = 4096;
+    static const size_t kBuffersPerSlab = 16;
+    static const size_t kMaxPatch = 128;
+
+    explicit DiskWriter(const DiskWriterConfig& config = DiskWriterConfig());
+    ~DiskWriter();   // writes everything still queued and closes the files
+
+    DiskWriter(const DiskWriter&) = delete;
+    DiskWriter& operator=(const DiskWriter&) = delete;
+
+    const DiskWriterConfig& config() const { return config_; }
+    const char* backendName() const { return backend_->name(); }
+
+    // Block until every buffer queued so far is written
+    void drain();
+    DiskWriterStats stats() const;
+
+private:
+    friend class PCMFile;
+
+    struct Buffer {
+        char* data = nullptr;
+        uint32_t slab = 0;
+    };
+
+    struct FileState {
+        ~FileState();
+        std::string path;
+        int fd = -1;
+        int patchFd = -1;               // buffered fd for header patches when fd is O_DIRECT
+        bool direct = false;
+        std::atomic<bool> failed{false};
+        std::atomic<bool> closed{false};   // set by the writer once the close job is done
+        size_t buffersInUse = 0;        // guarded by poolMtx_
+    };
+
+    struct Job {
+        Job(std::shared_ptr<FileState> f, Buffer b, size_t l, uint64_t off, bool c)
+            : file(std::move(f)), buffer(b), len(l), offset(off), close(c) {}
+
+        std::shared_ptr<FileState> file;
+        Buffer buffer;
+        size_t len;
+        uint64_t offset;
+        bool close;
+        // Small overwrite applied after the data (file headers)
+        uint64_t patchOffset = 0;
+        size_t patchLen = 0;
+        char patch[kMaxPatch];
+    };
+
+    std::shared_ptr<FileState> open(const std::string& path, uint64_t& size, bool allowDirect);
+    bool takeBuffer(FileState& file, Buffer& out);
+    void submit(Job&& job);
+
+    void writerLoop();
+    void writeBatch(std::vector<Job>& batch);
+    void applyPatch(const Job& job);
+    void recycle(Job& job);
+
+    DiskWriterConfig config_;
+    std::unique_ptr<StorageBackend> backend_;
+
+    // Buffer pool: grows a slab at a time, never shrinks
+    std::mutex poolMtx_;
+    std::vector<char*> slabs_;
+    std::vector<Buffer> freeBuffers_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::condition_variable drainedCv_;
+    std::vector<Job> queue_;
+    size_t outstanding_ = 0;            // queued or being written
+    bool stopping_ = false;
+    std::thread thread_;
+    std::vector<WriteOp> ops_;          // writer thread scratch
+    std::vector<int> syncFds_;
+
+    std::atomic<uint64_t> bytesWritten_{0};
+    std::atomic<uint64_t> writeCalls_{0};
+    std::atomic<uint64_t> syncCalls_{0};
+    std::atomic<uint64_t> errors_{0};
+};
+
+} // namespace ZoomBot
@@ -0,0 +1,451 @@
+#include "flac_file.h"
+#include "flac_format.h"
+#include "pcm_file.h"
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <utility>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace ZoomBot {
+
+static_assert(kFLACStreamInfoSize <= DiskWriter::kMaxPatch, "STREAMINFO updates must fit in one patch");
+static_assert(kFLACHeaderSize % DiskWriter::kBlockSize == 0, "frames start block aligned");
+
+namespace {
+    const uint32_t kSeekIntervalSeconds = 10;
+    const uint32_t kMinBlockSamples = 16;       // smallest block FLAC allows mid-stream
+    // Seek points per patch
+    const uint32_t kPointsPerPatch = DiskWriter::kMaxPatch / kFLACSeekPointSize;
+
+    uint64_t threadCpuNanos() {
+        struct timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+    }
+
+    // What the STREAMINFO on disk says: totalSamples, and the block sizes used so far
+    // (16 to 4096 before the first frame)
+    FLACStreamInfo described(FLACStreamInfo info, uint64_t totalSamples) {
+        if (info.maxBlockSize == 0) info.maxBlockSize = FLACFrameEncoder::kMaxBlockSize;
+        info.minBlockSize = std::max<uint32_t>(16, std::min(info.minBlockSize, info.maxBlockSize));
+        info.totalSamples = totalSamples;
+        return info;
+    }
+}
+
+// Encoder side of a FlacFile; everything but the atomics belongs to the file's encoder thread
+struct FlacEncodePool::Stream {
+    Stream(DiskWriter& writer, const std::string& path, uint32_t sampleRate, uint16_t channels)
+        : pcm(writer, path), encoder(sampleRate, channels), lastPatch(std::chrono::steady_clock::now()) {
+        info.sampleRate = sampleRate;
+        info.channels = channels;
+        info.minBlockSize = FLACFrameEncoder::kMaxBlockSize;
+        info.maxBlockSize = 0;
+        seekInterval = static_cast<uint64_t>(sampleRate) * kSeekIntervalSeconds;
+    }
+
+    PCMFile pcm;
+    FLACFrameEncoder encoder;
+    FLACStreamInfo info;                // totalSamples: everything encoded
+    std::vector<FLACSeekPoint> points;
+    uint64_t seekInterval;              // samples; doubles when the table fills up
+    size_t pointsOnDisk = 0;            // table entries below this are current on disk
+    size_t pointsUsedOnDisk = 0;        // entries below this may be non-placeholders on disk
+    // (file size, total samples) after each frame not yet known to be handed to the writer
+    std::deque<std::pair<uint64_t, uint64_t>> frameEnds;
+    uint64_t queuedSamples = 0;         // samples in frames handed to the writer
+    uint64_t patchedSamples = 0;        // what the STREAMINFO on disk says
+    std::chrono::steady_clock::time_point lastPatch;
+
+    std::atomic<uint32_t> queued{0};    // blocks handed over, not yet encoded
+    std::atomic<uint64_t> dropped{0};   // encoded bytes the writer dropped
+    std::atomic<bool> failed{false};
+    std::atomic<bool> handedOff{false}; // closed on the writer's queue; pcm belongs to the capture side again
+};
+
+// std::chrono::milliseconds takes it by reference
+const int FlacEncodePool::kMaintainIntervalMs;
+
+FlacEncodePool::FlacEncodePool(size_t threads) {
+    for (size_t i = 0; i < std::max<size_t>(1, threads); ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (auto& worker : workers_) {
+        worker->thread = std::thread(&FlacEncodePool::workerLoop, this, std::ref(*worker));
+    }
+}
+
+FlacEncodePool::~FlacEncodePool() {
+    for (auto& worker : workers_) {
+        {
+            std::lock_guard<std::mutex> lk(worker->mtx);
+            worker->stopping = true;
+        }
+        worker->cv.notify_all();
+    }
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+void FlacEncodePool::drain() {
+    for (auto& worker : workers_) {
+        std::unique_lock<std::mutex> lk(worker->mtx);
+        worker->drainedCv.wait(lk, [&worker] { return worker->outstanding == 0; });
+    }
+}
+
+FlacEncodeStats FlacEncodePool::stats() const {
+    FlacEncodeStats total{0, 0, 0, 0};
+    for (const auto& worker : workers_) {
+        total.blocks += worker->blocks.load(std::memory_order_relaxed);
+        total.pcmBytes += worker->pcmBytes.load(std::memory_order_relaxed);
+        total.flacBytes += worker->flacBytes.load(std::memory_order_relaxed);
+        total.cpuNanos += worker->cpuNanos.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void FlacEncodePool::workerLoop(Worker& worker) {
+    std::unique_lock<std::mutex> lk(worker.mtx);
+    for (;;) {
+        worker.cv.wait_for(lk, std::chrono::milliseconds(kMaintainIntervalMs),
+                           [&worker] { return !worker.queue.empty() || worker.stopping; });
+        bool stopping = worker.stopping;
+        worker.batch.swap(worker.queue);
+        for (auto& stream : worker.added) {
+            worker.streams.push_back(std::move(stream));
+        }
+        worker.added.clear();
+        lk.unlock();
+
+        uint64_t cpuStart = threadCpuNanos();
+        for (Block& block : worker.batch) {
+            encode(worker, block);
+        }
+        // Closed files leave the list; the rest get the flush policy and header updates
+        auto now = std::chrono::steady_clock::now();
+        size_t kept = 0;
+        for (size_t i = 0; i < worker.streams.size(); ++i) {
+            if (worker.streams[i]->handedOff.load(std::memory_order_relaxed)) continue;
+            maintain(*worker.streams[i], now);
+            if (kept != i) worker.streams[kept] = std::move(worker.streams[i]);
+            ++kept;
+        }
+        worker.streams.resize(kept);
+        worker.cpuNanos.fetch_add(threadCpuNanos() - cpuStart, std::memory_order_relaxed);
+
+        lk.lock();
+        for (Block& block : worker.batch) {
+            if (block.pcm.capacity() > 0) {
+                worker.spare.push_back(std::move(block.pcm));
+            }
+        }
+        worker.outstanding -= worker.batch.size();
+        worker.batch.clear();
+        if (worker.outstanding == 0) {
+            worker.drainedCv.notify_all();
+        }
+        if (stopping && worker.queue.empty()) break;
+    }
+}
+
+void FlacEncodePool::encode(Worker& worker, Block& block) {
+    Stream& stream = *block.stream;
+    // Blocks dropped while this thread was behind: silence of the same length keeps the timeline.
+    // Each dropped block had 16 samples or more, so no chunk needs to be shorter.
+    uint64_t silence = block.silenceBefore;
+    if (silence > 0 && worker.silence.empty()) {
+        worker.silence.assign(2 * FLACFrameEncoder::kMaxBlockSize, 0);
+    }
+    while (silence > 0) {
+        uint64_t chunk = std::min<uint64_t>(silence, FLACFrameEncoder::kMaxBlockSize);
+        if (silence > chunk && silence - chunk < kMinBlockSamples) chunk = silence / 2;
+        encodeFrame(worker, stream, worker.silence.data(), static_cast<uint32_t>(chunk), false);
+        silence -= chunk;
+    }
+    if (block.samples > 0) {
+        encodeFrame(worker, stream, block.pcm.data(), block.samples, block.close);
+    }
+    stream.queued.fetch_sub(1, std::memory_order_relaxed);
+    stream.dropped.store(stream.pcm.droppedBytes(), std::memory_order_relaxed);
+    stream.failed.store(!stream.pcm.good(), std::memory_order_relaxed);
+
+    if (block.close) {
+        finish(stream);
+    }
+    block.stream.reset();
+}
+
+void FlacEncodePool::encodeFrame(Worker& worker, Stream& stream, const int16_t* pcm, uint32_t samples, bool last) {
+    worker.frame.clear();
+    stream.encoder.encode(pcm, samples, stream.info.totalSamples, worker.frame);
+
+    // One seek point per interval, at the first frame that starts past it
+    uint64_t offset = stream.pcm.size();
+    if (stream.points.empty() || stream.info.totalSamples >= stream.points.back().sample + stream.seekInterval) {
+        if (stream.points.size() == kFLACSeekPoints) {
+            // Table full: keep every other point at twice the spacing and rewrite it
+            size_t n = 0;
+            for (size_t i = 0; i < stream.points.size(); i += 2) {
+                stream.points[n++] = stream.points[i];
+            }
+            stream.points.resize(n);
+            stream.seekInterval *= 2;
+            stream.pointsUsedOnDisk = std::max(stream.pointsUsedOnDisk, stream.pointsOnDisk);
+            stream.pointsOnDisk = 0;
+        }
+        if (stream.points.empty() || stream.info.totalSamples >= stream.points.back().sample + stream.seekInterval) {
+            FLACSeekPoint point;
+            point.sample = stream.info.totalSamples;
+            point.offset = offset - kFLACHeaderSize;
+            point.samples = static_cast<uint16_t>(samples);
+            stream.points.push_back(point);
+        }
+    }
+
+    stream.pcm.write(reinterpret_cast<const char*>(worker.frame.data()), worker.frame.size());
+    stream.info.totalSamples += samples;
+    stream.frameEnds.emplace_back(stream.pcm.size(), stream.info.totalSamples);
+    uint32_t frameSize = static_cast<uint32_t>(worker.frame.size());
+    if (stream.info.minFrameSize == 0 || frameSize < stream.info.minFrameSize) stream.info.minFrameSize = frameSize;
+    stream.info.maxFrameSize = std::max(stream.info.maxFrameSize, frameSize);
+    stream.info.maxBlockSize = std::max(stream.info.maxBlockSize, samples);
+    if (!last) {
+        // The last block may be shorter than FLAC allows elsewhere; it doesn't count
+        stream.info.minBlockSize = std::min(stream.info.minBlockSize, samples);
+    }
+
+    worker.blocks.fetch_add(1, std::memory_order_relaxed);
+    worker.pcmBytes.fetch_add(samples * stream.info.channels * sizeof(int16_t), std::memory_order_relaxed);
+    worker.flacBytes.fetch_add(worker.frame.size(), std::memory_order_relaxed);
+}
+
+void FlacEncodePool::finish(Stream& stream) {
+    // Hand the header to the writer (frames may not have filled a buffer yet), so the
+    // final seek table can be patched over it; the rest goes out with the close
+    stream.pcm.flush();
+    if (stream.pcm.queuedSize() >= kFLACHeaderSize) {
+        patchSeekTable(stream, stream.pcm.queuedSize(), true);
+    }
+    char body[kFLACStreamInfoSize];
+    makeFLACStreamInfo(body, described(stream.info, stream.info.totalSamples));
+    stream.pcm.close(kFLACStreamInfoOffset, body, sizeof(body));
+    stream.handedOff.store(true, std::memory_order_release);
+}
+
+void FlacEncodePool::maintain(Stream& stream, std::chrono::steady_clock::time_point now) {
+    stream.pcm.flushIfStale(now);
+    stream.dropped.store(stream.pcm.droppedBytes(), std::memory_order_relaxed);
+
+    // Describe only what the writer already has, so the header never runs ahead of the data
+    uint64_t queued = stream.pcm.queuedSize();
+    if (queued < kFLACHeaderSize) return;
+    while (!stream.frameEnds.empty() && stream.frameEnds.front().first <= queued) {
+        stream.queuedSamples = stream.frameEnds.front().second;
+        stream.frameEnds.pop_front();
+    }
+    if (now - stream.lastPatch < std::chrono::milliseconds(stream.pcm.writer().config().headerUpdateMs)) return;
+
+    patchSeekTable(stream, queued, false);
+    if (stream.queuedSamples != stream.patchedSamples) {
+        char body[kFLACStreamInfoSize];
+        makeFLACStreamInfo(body, described(stream.info, stream.queuedSamples));
+        stream.pcm.patch(kFLACStreamInfoOffset, body, sizeof(body));
+        stream.patchedSamples = stream.queuedSamples;
+    }
+    stream.lastPatch = now;
+}
+
+void FlacEncodePool::patchSeekTable(Stream& stream, uint64_t queued, bool all) {
+    // Points go out once their frame has; after a rewrite the old entries past the
+    // kept points become placeholders again
+    size_t ready = stream.points.size();
+    if (!all) {
+        while (ready > stream.pointsOnDisk && stream.points[ready - 1].offset + kFLACHeaderSize >= queued) --ready;
+    }
+    size_t end = ready;
+    if (ready == stream.points.size()) end = std::max(end, stream.pointsUsedOnDisk);
+
+    char entries[kPointsPerPatch * kFLACSeekPointSize];
+    FLACSeekPoint placeholder;
+    for (size_t first = stream.pointsOnDisk; first < end; first += kPointsPerPatch) {
+        size_t count = std::min<size_t>(kPointsPerPatch, end - first);
+        for (size_t i = 0; i < count; ++i) {
+            size_t index = first + i;
+            makeFLACSeekPoint(entries + i * kFLACSeekPointSize,
+                              index < stream.points.size() ? stream.points[index] : placeholder);
+        }
+        stream.pcm.patch(kFLACSeekTableOffset + first * kFLACSeekPointSize, entries, count * kFLACSeekPointSize);
+    }
+    if (end > stream.pointsOnDisk) {
+        stream.pointsOnDisk = std::min(end, stream.points.size());
+        if (end >= stream.pointsUsedOnDisk) stream.pointsUsedOnDisk = stream.pointsOnDisk;
+    }
+}
+
+FlacFile::FlacFile(FlacEncodePool& pool, DiskWriter& writer, const std::string& path,
+                   uint32_t sampleRate, uint16_t channels)
+    : blockAlign_(channels * static_cast<uint32_t>(sizeof(int16_t))),
+      maxBufferAgeMs_(writer.config().maxBufferAgeMs) {
+    blockBytes_ = static_cast<size_t>(kBlockSamples) * blockAlign_;
+    if (channels < 1 || channels > 2 || sampleRate == 0 || sampleRate > 0xFFFFF) {
+        std::cerr << "[AUDIO] Can't record " << channels << " channels at " << sampleRate << " Hz as FLAC: "
+                  << path << std::endl;
+        return;
+    }
+    stream_ = std::make_shared<FlacEncodePool::Stream>(writer, path, sampleRate, channels);
+    PCMFile& pcm = stream_->pcm;
+    if (!pcm.good()) return;
+
+    if (pcm.size() == 0) {
+        // New file: the header rides along with the first buffer
+        std::vector<char> header(kFLACHeaderSize);
+        makeFLACHeader(header.data(), described(stream_->info, 0));
+        pcm.write(header.data(), header.size());
+    } else if (!resume(path, sampleRate, channels)) {
+        return;
+    }
+
+    // Round robin; the thread keeps the file until it is closed
+    worker_ = pool.workers_[pool.next_.fetch_add(1) % pool.workers_.size()].get();
+    {
+        std::lock_guard<std::mutex> lk(worker_->mtx);
+        worker_->added.push_back(stream_);
+        if (!worker_->spare.empty()) {
+            pending_ = std::move(worker_->spare.back());
+            worker_->spare.pop_back();
+        }
+    }
+    pending_.resize(blockBytes_ / sizeof(int16_t));
+    open_ = true;
+}
+
+FlacFile::~FlacFile() {
+    close();
+}
+
+bool FlacFile::resume(const std::string& path, uint32_t sampleRate, uint16_t channels) {
+    // A resumed stream appends to a file closed earlier: carry on from its metadata
+    std::vector<char> header(kFLACHeaderSize);
+    ssize_t n = -1;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        n = pread(fd, header.data(), header.size(), 0);
+        ::close(fd);
+    }
+    FlacEncodePool::Stream& stream = *stream_;
+    FLACStreamInfo info;
+    if (n != static_cast<ssize_t>(header.size()) || !parseFLACHeader(header.data(), header.size(), info, stream.points) ||
+        info.sampleRate != sampleRate || info.channels != channels || info.bitsPerSample != 16) {
+        std::cerr << "[AUDIO] Can't append to " << path << ": not a FLAC recording of this stream" << std::endl;
+        return false;
+    }
+    stream.info = info;
+    stream.queuedSamples = stream.patchedSamples = info.totalSamples;
+    stream.pointsOnDisk = stream.pointsUsedOnDisk = stream.points.size();
+    while (stream.points.size() >= 2 && stream.points[1].sample - stream.points[0].sample >= 2 * stream.seekInterval) {
+        stream.seekInterval *= 2;
+    }
+    return true;
+}
+
+bool FlacFile::good() const {
+    return open_ && !stream_->failed.load(std::memory_order_relaxed);
+}
+
+void FlacFile::write(const char* data, size_t len) {
+    if (!open_) return;
+    dataBytes_ += len;
+    char* block = reinterpret_cast<char*>(pending_.data());
+    while (len > 0) {
+        if (pendingBytes_ == 0) {
+            pendingSince_ = std::chrono::steady_clock::now();
+        }
+        size_t n = std::min(len, blockBytes_ - pendingBytes_);
+        std::memcpy(block + pendingBytes_, data, n);
+        pendingBytes_ += n;
+        data += n;
+        len -= n;
+        if (pendingBytes_ == blockBytes_) {
+            handOver(false);
+            block = reinterpret_cast<char*>(pending_.data());
+        }
+    }
+}
+
+void FlacFile::flushIfStale(std::chrono::steady_clock::time_point now) {
+    if (open_ && pendingBytes_ >= kMinFlushSamples * blockAlign_ &&
+        now - pendingSince_ >= std::chrono::milliseconds(maxBufferAgeMs_)) {
+        handOver(false);
+    }
+}
+
+void FlacFile::close() {
+    if (!open_) return;
+    handOver(true);
+    open_ = false;
+}
+
+bool FlacFile::closed() const {
+    if (open_) return false;
+    if (!closeSubmitted_) return true;   // never opened
+    return stream_->handedOff.load(std::memory_order_acquire) && stream_->pcm.closed();
+}
+
+uint64_t FlacFile::droppedBytes() const {
+    return droppedPcm_ + (stream_ ? stream_->dropped.load(std::memory_order_relaxed) : 0);
+}
+
+void FlacFile::handOver(bool close) {
+    uint32_t samples = static_cast<uint32_t>(pendingBytes_ / blockAlign_);
+    size_t used = samples * blockAlign_;
+    size_t tail = pendingBytes_ - used;     // part of a sample frame, kept for the next block
+    if (samples == 0 && !close) return;
+
+    if (!close && stream_->queued.load(std::memory_order_relaxed) >= kMaxQueuedBlocks) {
+        // Encoder thread is behind: drop rather than block capture. The samples still
+        // count towards the file, as silence written ahead of the next block.
+        droppedPcm_ += used;
+        lostSamples_ += samples;
+        std::memmove(pending_.data(), reinterpret_cast<char*>(pending_.data()) + used, tail);
+        pendingBytes_ = tail;
+        return;
+    }
+
+    FlacEncodePool::Block block;
+    block.stream = stream_;
+    block.samples = samples;
+    block.silenceBefore = lostSamples_;
+    block.close = close;
+    lostSamples_ = 0;
+    stream_->queued.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lk(worker_->mtx);
+        std::vector<int16_t> next;
+        if (!close) {
+            // Spare buffers already have the block size, so this doesn't allocate once warm
+            if (!worker_->spare.empty()) {
+                next = std::move(worker_->spare.back());
+                worker_->spare.pop_back();
+            }
+            next.resize(blockBytes_ / sizeof(int16_t));
+            std::memcpy(next.data(), reinterpret_cast<const char*>(pending_.data()) + used, tail);
+        }
+        block.pcm = std::move(pending_);
+        pending_ = std::move(next);
+        worker_->queue.push_back(std::move(block));
+        worker_->outstanding++;
+    }
+    worker_->cv.notify_one();
+    pendingBytes_ = tail;
+    closeSubmitted_ = close;
+}
+
+} // namespace ZoomBot
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "disk_writer.h"
+#include "recording_file.h"
+
+namespace ZoomBot {
+
+struct FlacEncodeStats {
+    uint64_t blocks;
+    uint64_t pcmBytes;
+    uint64_t flacBytes;
+    uint64_t cpuNanos;              // encoder thread CPU time, header updates included
+};
+
+/**
+ * Encoder threads for FLAC recordings (ZOOM_BOT_RECORDING_FORMAT=flac).
+ *
+ * Every file is assigned to one thread round robin when it opens. That thread
+ * encodes the file's blocks in order and owns its PCMFile from then on: it
+ * writes the frames, applies the flush policy and patches the header, so the
+ * capture worker only copies PCM into a block and hands it over.
+ */
+class FlacEncodePool {
+public:
+    explicit FlacEncodePool(size_t threads);
+    ~FlacEncodePool();   // encodes and writes everything handed over
+
+    FlacEncodePool(const FlacEncodePool&) = delete;
+    FlacEncodePool& operator=(const FlacEncodePool&) = delete;
+
+    size_t threads() const { return workers_.size(); }
+    // Block until every block handed over so far is encoded and queued on the DiskWriter;
+    // drain the DiskWriter after this to have closed files complete on disk
+    void drain();
+    FlacEncodeStats stats() const;
+
+private:
+    friend class FlacFile;
+    struct Stream;
+
+    struct Block {
+        std::shared_ptr<Stream> stream;
+        std::vector<int16_t> pcm;       // interleaved
+        uint32_t samples = 0;           // per channel
+        uint64_t silenceBefore = 0;     // samples dropped ahead of this block, encoded as silence first
+        bool close = false;             // last block of the file
+    };
+
+    struct Worker {
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::condition_variable drainedCv;
+        std::vector<Block> queue;
+        std::vector<std::vector<int16_t>> spare;            // block buffers for reuse
+        std::vector<std::shared_ptr<Stream>> added;         // opened since the last pass
+        size_t outstanding = 0;         // queued or being encoded
+        bool stopping = false;
+        std::thread thread;
+
+        // Worker thread only
+        std::vector<Block> batch;
+        std::vector<std::shared_ptr<Stream>> streams;       // open files, for the flush policy
+        std::vector<uint8_t> frame;
+        std::vector<int16_t> silence;   // one block of zeros, stereo
+
+        std::atomic<uint64_t> blocks{0};
+        std::atomic<uint64_t> pcmBytes{0};
+        std::atomic<uint64_t> flacBytes{0};
+        std::atomic<uint64_t> cpuNanos{0};
+    };
+
+    static const int kMaintainIntervalMs = 100;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> next_{0};
+
+    void workerLoop(Worker& worker);
+    void encode(Worker& worker, Block& block);
+    void encodeFrame(Worker& worker, Stream& stream, const int16_t* pcm, uint32_t samples, bool last);
+    void finish(Stream& stream);
+    void maintain(Stream& stream, std::chrono::steady_clock::time_point now);
+    void patchSeekTable(Stream& stream, uint64_t queued, bool all);
+};
+
+/**
+ * Recording written as FLAC, encoded off the capture worker by a FlacEncodePool.
+ *
+ * PCM is collected into 4096-sample blocks; a full block, or a partial one
+ * whose oldest sample is maxBufferAgeMs old, goes to the file's encoder
+ * thread. The metadata (flac_format.h) is written with the first buffer and
+ * patched in place like a WAV header: STREAMINFO every headerUpdateMs with
+ * the samples already handed to the writer, and a seek point about every
+ * 10 seconds of audio (the spacing doubles whenever the fixed table fills
+ * up, so any length fits). A stream that resumes appends to its file.
+ *
+ * If the encoder thread falls kMaxQueuedBlocks behind (about 4 s at 32 kHz),
+ * new blocks are dropped rather than blocking capture, as PCMFile does when
+ * the writer is behind. The next block handed over carries the number of
+ * samples lost, and the encoder thread writes that much silence ahead of it
+ * (constant subframes, next to no work), so the file keeps the stream's
+ * timeline: segment and silence log offsets stay right, and only the dropped
+ * stretch is missing. The PCM is still counted in droppedBytes().
+ */
+class FlacFile : public RecordingFile {
+public:
+    FlacFile(FlacEncodePool& pool, DiskWriter& writer, const std::string& path,
+             uint32_t sampleRate, uint16_t channels);
+    ~FlacFile() override;   // close()
+
+    bool good() const override;
+    void write(const char* data, size_t len) override;
+    void flushIfStale(std::chrono::steady_clock::time_point now) override;
+    void close() override;
+    bool closed() const override;
+
+    uint64_t dataBytes() const override { return dataBytes_; }
+    // PCM replaced by silence before encoding plus encoded bytes the writer dropped
+    uint64_t droppedBytes() const override;
+
+private:
+    static const uint32_t kBlockSamples = 4096;
+    static const uint32_t kMaxQueuedBlocks = 32;
+    static const uint32_t kMinFlushSamples = 16;     // smallest block FLAC allows mid-stream
+
+    bool resume(const std::string& path, uint32_t sampleRate, uint16_t channels);
+    void handOver(bool close);
+
+    FlacEncodePool::Worker* worker_ = nullptr;
+    std::shared_ptr<FlacEncodePool::Stream> stream_;
+    std::vector<int16_t> pending_;
+    size_t pendingBytes_ = 0;
+    size_t blockBytes_;
+    uint32_t blockAlign_;
+    uint32_t maxBufferAgeMs_;
+    std::chrono::steady_clock::time_point pendingSince_;
+    uint64_t dataBytes_ = 0;
+    uint64_t droppedPcm_ = 0;
+    uint64_t lostSamples_ = 0;          // dropped since the last block handed over
+    bool open_ = false;
+    bool closeSubmitted_ = false;
+};
+
+} // namespace ZoomBot
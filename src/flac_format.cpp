@@ -0,0 +1,437 @@
+#include "flac_format.h"
+#include <algorithm>
+#include <cstring>
+
+namespace ZoomBot {
+
+namespace {
+    const uint8_t kBlockStreamInfo = 0;
+    const uint8_t kBlockPadding = 1;
+    const uint8_t kBlockSeekTable = 3;
+
+    const int kConstant = -1;
+    const int kVerbatim = -2;
+    const int kMaxFixedOrder = 4;
+    const int kMaxPartitionOrder = 8;
+
+    struct CrcTables {
+        uint8_t crc8[256];
+        uint16_t crc16[256];
+        CrcTables() {
+            for (int i = 0; i < 256; ++i) {
+                uint8_t c8 = static_cast<uint8_t>(i);
+                uint16_t c16 = static_cast<uint16_t>(i << 8);
+                for (int b = 0; b < 8; ++b) {
+                    c8 = static_cast<uint8_t>((c8 & 0x80) ? (c8 << 1) ^ 0x07 : c8 << 1);
+                    c16 = static_cast<uint16_t>((c16 & 0x8000) ? (c16 << 1) ^ 0x8005 : c16 << 1);
+                }
+                crc8[i] = c8;
+                crc16[i] = c16;
+            }
+        }
+    };
+    const CrcTables kCrc;
+
+    uint8_t crc8(const uint8_t* p, size_t n) {
+        uint8_t crc = 0;
+        while (n--) crc = kCrc.crc8[crc ^ *p++];
+        return crc;
+    }
+
+    uint16_t crc16(const uint8_t* p, size_t n) {
+        uint16_t crc = 0;
+        while (n--) crc = static_cast<uint16_t>((crc << 8) ^ kCrc.crc16[(crc >> 8) ^ *p++]);
+        return crc;
+    }
+
+    void put16(char* p, uint32_t v) { p[0] = char(v >> 8); p[1] = char(v); }
+    void put24(char* p, uint32_t v) { p[0] = char(v >> 16); p[1] = char(v >> 8); p[2] = char(v); }
+    void put64(char* p, uint64_t v) { for (int i = 0; i < 8; ++i) p[i] = char(v >> (56 - 8 * i)); }
+    void blockHeader(char* p, bool last, uint8_t type, uint32_t len) {
+        p[0] = static_cast<char>((last ? 0x80 : 0) | type);
+        put24(p + 1, len);
+    }
+
+    uint32_t get16(const char* p) { return (uint32_t(uint8_t(p[0])) << 8) | uint8_t(p[1]); }
+    uint32_t get24(const char* p) { return (uint32_t(uint8_t(p[0])) << 16) | get16(p + 1); }
+    uint64_t get64(const char* p) {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i) v = (v << 8) | uint8_t(p[i]);
+        return v;
+    }
+
+    uint8_t sampleRateCode(uint32_t rate) {
+        switch (rate) {
+            case 8000: return 4;
+            case 16000: return 5;
+            case 22050: return 6;
+            case 24000: return 7;
+            case 32000: return 8;
+            case 44100: return 9;
+            case 48000: return 10;
+            case 96000: return 11;
+            default: return 0;      // from STREAMINFO
+        }
+    }
+
+    // Rice parameter for a partition of count residuals summing to sum, and its estimated size.
+    // Unary parts are estimated as sum >> k, which is what libFLAC does too.
+    unsigned riceParameter(uint64_t sum, uint32_t count, uint64_t& bits) {
+        unsigned guess = 0;
+        if (count > 0) {
+            uint64_t mean = sum / count;
+            while (guess < 30 && (mean >> (guess + 1)) > 0) ++guess;
+        }
+        unsigned best = guess;
+        bits = ~0ull;
+        for (unsigned k = guess > 0 ? guess - 1 : 0; k <= std::min(guess + 1, 30u); ++k) {
+            uint64_t cost = static_cast<uint64_t>(count) * (k + 1) + (sum >> k);
+            if (cost < bits) {
+                bits = cost;
+                best = k;
+            }
+        }
+        return best;
+    }
+}
+
+class FLACFrameEncoder::BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    // n <= 32
+    void put(uint32_t value, unsigned n) {
+        if (n == 0) return;
+        acc_ = (acc_ << n) | (value & (0xFFFFFFFFull >> (32 - n)));
+        bits_ += n;
+        while (bits_ >= 8) {
+            bits_ -= 8;
+            out_.push_back(static_cast<uint8_t>(acc_ >> bits_));
+        }
+    }
+
+    void rice(uint32_t u, unsigned k) {
+        uint32_t q = u >> k;
+        if (q + 1 + k <= 32) {
+            put((1u << k) | (u & ((1u << k) - 1)), q + 1 + k);
+            return;
+        }
+        for (; q >= 32; q -= 32) put(0, 32);
+        put(1, q + 1);
+        put(u, k);
+    }
+
+    void align() {
+        if (bits_ > 0) put(0, 8 - bits_);
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    uint64_t acc_ = 0;
+    unsigned bits_ = 0;
+};
+
+void makeFLACStreamInfo(char* out, const FLACStreamInfo& info) {
+    put16(out, info.minBlockSize);
+    put16(out + 2, info.maxBlockSize);
+    put24(out + 4, info.minFrameSize);
+    put24(out + 7, info.maxFrameSize);
+    // 20 bits rate, 3 bits channels - 1, 5 bits bits per sample - 1, 36 bits total samples
+    uint64_t packed = (static_cast<uint64_t>(info.sampleRate & 0xFFFFF) << 44) |
+                      (static_cast<uint64_t>((info.channels - 1) & 0x7) << 41) |
+                      (static_cast<uint64_t>((info.bitsPerSample - 1) & 0x1F) << 36) |
+                      (info.totalSamples & 0xFFFFFFFFFull);
+    put64(out + 10, packed);
+    std::memset(out + 18, 0, 16);   // MD5 not computed
+}
+
+void makeFLACSeekPoint(char* out, const FLACSeekPoint& point) {
+    put64(out, point.sample);
+    put64(out + 8, point.offset);
+    put16(out + 16, point.samples);
+}
+
+void makeFLACHeader(char* out, const FLACStreamInfo& info) {
+    std::memcpy(out, "fLaC", 4);
+    blockHeader(out + 4, false, kBlockStreamInfo, kFLACStreamInfoSize);
+    makeFLACStreamInfo(out + kFLACStreamInfoOffset, info);
+    blockHeader(out + kFLACSeekTableOffset - 4, false, kBlockSeekTable, kFLACSeekPoints * kFLACSeekPointSize);
+    FLACSeekPoint placeholder;
+    for (uint32_t i = 0; i < kFLACSeekPoints; ++i) {
+        makeFLACSeekPoint(out + kFLACSeekTableOffset + i * kFLACSeekPointSize, placeholder);
+    }
+    uint32_t padding = kFLACSeekTableOffset + kFLACSeekPoints * kFLACSeekPointSize;
+    blockHeader(out + padding, true, kBlockPadding, kFLACHeaderSize - padding - 4);
+    std::memset(out + padding + 4, 0, kFLACHeaderSize - padding - 4);
+}
+
+bool parseFLACHeader(const char* header, size_t len, FLACStreamInfo& info, std::vector<FLACSeekPoint>& points) {
+    if (len < kFLACHeaderSize || std::memcmp(header, "fLaC", 4) != 0 ||
+        uint8_t(header[4]) != kBlockStreamInfo || get24(header + 5) != kFLACStreamInfoSize ||
+        (uint8_t(header[kFLACSeekTableOffset - 4]) & 0x7F) != kBlockSeekTable ||
+        get24(header + kFLACSeekTableOffset - 3) != kFLACSeekPoints * kFLACSeekPointSize) {
+        return false;
+    }
+    const char* si = header + kFLACStreamInfoOffset;
+    info.minBlockSize = get16(si);
+    info.maxBlockSize = get16(si + 2);
+    info.minFrameSize = get24(si + 4);
+    info.maxFrameSize = get24(si + 7);
+    uint64_t packed = get64(si + 10);
+    info.sampleRate = static_cast<uint32_t>(packed >> 44);
+    info.channels = static_cast<uint16_t>(((packed >> 41) & 0x7) + 1);
+    info.bitsPerSample = static_cast<uint16_t>(((packed >> 36) & 0x1F) + 1);
+    info.totalSamples = packed & 0xFFFFFFFFFull;
+
+    points.clear();
+    for (uint32_t i = 0; i < kFLACSeekPoints; ++i) {
+        const char* p = header + kFLACSeekTableOffset + i * kFLACSeekPointSize;
+        FLACSeekPoint point;
+        point.sample = get64(p);
+        if (point.sample == kFLACPlaceholderPoint) break;
+        point.offset = get64(p + 8);
+        point.samples = static_cast<uint16_t>(get16(p + 16));
+        points.push_back(point);
+    }
+    return true;
+}
+
+FLACFrameEncoder::FLACFrameEncoder(uint32_t sampleRate, uint16_t channels)
+    : channels_(channels), rateCode_(sampleRateCode(sampleRate)) {
+    for (int c = 0; c < (channels_ == 2 ? 4 : 1); ++c) {
+        channel_[c].resize(kMaxBlockSize);
+    }
+    residual_.resize(kMaxBlockSize);
+    partitionSums_.resize(1u << kMaxPartitionOrder);
+}
+
+void FLACFrameEncoder::encode(const int16_t* pcm, uint32_t samples, uint64_t firstSample, std::vector<uint8_t>& out) {
+    const size_t start = out.size();
+    const bool stereo = channels_ == 2;
+
+    // Deinterleave; stereo also gets mid and side
+    if (stereo) {
+        int32_t* l = channel_[0].data();
+        int32_t* r = channel_[1].data();
+        int32_t* m = channel_[2].data();
+        int32_t* s = channel_[3].data();
+        for (uint32_t i = 0; i < samples; ++i) {
+            l[i] = pcm[2 * i];
+            r[i] = pcm[2 * i + 1];
+            m[i] = (l[i] + r[i]) >> 1;
+            s[i] = l[i] - r[i];
+        }
+    } else {
+        int32_t* x = channel_[0].data();
+        for (uint32_t i = 0; i < samples; ++i) {
+            x[i] = pcm[i];
+        }
+    }
+
+    // Channel assignment: 0 = mono, 1 = left/right, 8 = left/side, 9 = side/right, 10 = mid/side
+    int subframes[2] = {0, 1};
+    uint8_t assignment = stereo ? 1 : 0;
+    if (stereo) {
+        int order;
+        uint64_t cost[4];
+        for (int c = 0; c < 4; ++c) {
+            cost[c] = fixedCost(channel_[c].data(), samples, order);
+        }
+        uint64_t best = cost[0] + cost[1];
+        if (cost[0] + cost[3] < best) { best = cost[0] + cost[3]; assignment = 8; subframes[0] = 0; subframes[1] = 3; }
+        if (cost[3] + cost[1] < best) { best = cost[3] + cost[1]; assignment = 9; subframes[0] = 3; subframes[1] = 1; }
+        if (cost[2] + cost[3] < best) { assignment = 10; subframes[0] = 2; subframes[1] = 3; }
+    }
+
+    // Header: sync + variable block size flag, block size and rate codes, assignment, 16 bits
+    uint8_t blockCode = 7;
+    if (samples == 4096) blockCode = 12;
+    else if (samples == 2048) blockCode = 11;
+    else if (samples == 1024) blockCode = 10;
+    else if (samples <= 256) blockCode = 6;
+    out.push_back(0xFF);
+    out.push_back(0xF9);
+    out.push_back(static_cast<uint8_t>((blockCode << 4) | rateCode_));
+    out.push_back(static_cast<uint8_t>((assignment << 4) | (4 << 1)));
+
+    // First sample number, UTF-8 style (up to 36 bits in 7 bytes)
+    if (firstSample < 0x80) {
+        out.push_back(static_cast<uint8_t>(firstSample));
+    } else {
+        int extra = 1;
+        while (extra < 6 && firstSample >= (1ull << (5 * extra + 6))) ++extra;
+        out.push_back(static_cast<uint8_t>((0xFF00 >> (extra + 1)) | (firstSample >> (6 * extra))));
+        for (int i = extra - 1; i >= 0; --i) {
+            out.push_back(static_cast<uint8_t>(0x80 | ((firstSample >> (6 * i)) & 0x3F)));
+        }
+    }
+    if (blockCode == 6) {
+        out.push_back(static_cast<uint8_t>(samples - 1));
+    } else if (blockCode == 7) {
+        out.push_back(static_cast<uint8_t>((samples - 1) >> 8));
+        out.push_back(static_cast<uint8_t>(samples - 1));
+    }
+    out.push_back(crc8(out.data() + start, out.size() - start));
+
+    BitWriter bw(out);
+    for (int i = 0; i < (stereo ? 2 : 1); ++i) {
+        int c = subframes[i];
+        unsigned bps = c == 3 ? 17 : 16;      // side needs one more bit
+        const int32_t* x = channel_[c].data();
+        Candidate candidate = plan(x, samples, bps);
+        writeSubframe(bw, x, samples, bps, candidate);
+    }
+    bw.align();
+    uint16_t crc = crc16(out.data() + start, out.size() - start);
+    out.push_back(static_cast<uint8_t>(crc >> 8));
+    out.push_back(static_cast<uint8_t>(crc));
+}
+
+uint64_t FLACFrameEncoder::fixedCost(const int32_t* x, uint32_t n, int& order) const {
+    // Sum of absolute residuals of every fixed predictor, over the samples they all cover
+    if (n <= static_cast<uint32_t>(kMaxFixedOrder)) {
+        order = 0;
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < n; ++i) sum += static_cast<uint64_t>(x[i] < 0 ? -int64_t(x[i]) : x[i]);
+        return sum;
+    }
+    uint64_t sum[kMaxFixedOrder + 1] = {0, 0, 0, 0, 0};
+    int32_t e1 = x[3] - x[2];
+    int32_t e2 = e1 - (x[2] - x[1]);
+    int32_t e3 = e2 - ((x[2] - x[1]) - (x[1] - x[0]));
+    for (uint32_t i = 4; i < n; ++i) {
+        int32_t r0 = x[i];
+        int32_t r1 = r0 - x[i - 1];
+        int32_t r2 = r1 - e1;
+        int32_t r3 = r2 - e2;
+        int32_t r4 = r3 - e3;
+        e1 = r1; e2 = r2; e3 = r3;
+        sum[0] += static_cast<uint32_t>(r0 < 0 ? -r0 : r0);
+        sum[1] += static_cast<uint32_t>(r1 < 0 ? -r1 : r1);
+        sum[2] += static_cast<uint32_t>(r2 < 0 ? -r2 : r2);
+        sum[3] += static_cast<uint32_t>(r3 < 0 ? -r3 : r3);
+        sum[4] += static_cast<uint32_t>(r4 < 0 ? -r4 : r4);
+    }
+    order = 0;
+    for (int o = 1; o <= kMaxFixedOrder; ++o) {
+        if (sum[o] < sum[order]) order = o;
+    }
+    return sum[order];
+}
+
+void FLACFrameEncoder::residuals(const int32_t* x, uint32_t n, int order) {
+    uint32_t* u = residual_.data();
+    for (uint32_t i = static_cast<uint32_t>(order); i < n; ++i) {
+        int32_t r;
+        switch (order) {
+            case 0: r = x[i]; break;
+            case 1: r = x[i] - x[i - 1]; break;
+            case 2: r = x[i] - 2 * x[i - 1] + x[i - 2]; break;
+            case 3: r = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3]; break;
+            default: r = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4]; break;
+        }
+        *u++ = (static_cast<uint32_t>(r) << 1) ^ static_cast<uint32_t>(r >> 31);
+    }
+}
+
+int FLACFrameEncoder::bestPartitionOrder(uint32_t n, int order, uint64_t& bits, bool& rice2) {
+    // Finest usable order: n divides evenly and the first partition still has residuals
+    int finest = 0;
+    while (finest < kMaxPartitionOrder && (n & ((2u << finest) - 1)) == 0 &&
+           (n >> (finest + 1)) > static_cast<uint32_t>(order)) {
+        ++finest;
+    }
+
+    // Sums at the finest order, merged pairwise for the coarser ones
+    uint32_t partitions = 1u << finest;
+    uint32_t size = n >> finest;
+    const uint32_t* u = residual_.data();
+    for (uint32_t p = 0; p < partitions; ++p) {
+        uint32_t count = p == 0 ? size - order : size;
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < count; ++i) sum += *u++;
+        partitionSums_[p] = sum;
+    }
+
+    int bestOrder = finest;
+    bits = ~0ull;
+    for (int po = finest; po >= 0; --po) {
+        uint32_t count = 1u << po;
+        uint32_t psize = n >> po;
+        uint64_t total = 0;
+        bool needs5 = false;
+        for (uint32_t p = 0; p < count; ++p) {
+            uint64_t pbits;
+            unsigned k = riceParameter(partitionSums_[p], p == 0 ? psize - order : psize, pbits);
+            needs5 = needs5 || k > 14;
+            total += pbits;
+        }
+        total += static_cast<uint64_t>(count) * (needs5 ? 5 : 4);
+        if (total <= bits) {
+            bits = total;
+            bestOrder = po;
+            rice2 = needs5;
+        }
+        for (uint32_t p = 0; p + 1 < count; p += 2) {
+            partitionSums_[p / 2] = partitionSums_[p] + partitionSums_[p + 1];
+        }
+    }
+    return bestOrder;
+}
+
+FLACFrameEncoder::Candidate FLACFrameEncoder::plan(const int32_t* x, uint32_t n, unsigned bps) {
+    const uint64_t header = 8;
+    bool constant = true;
+    for (uint32_t i = 1; i < n && constant; ++i) constant = x[i] == x[0];
+    if (constant) {
+        return Candidate{header + bps, kConstant, 0, false};
+    }
+
+    Candidate verbatim{header + static_cast<uint64_t>(n) * bps, kVerbatim, 0, false};
+    int order;
+    fixedCost(x, n, order);
+    if (n <= static_cast<uint32_t>(order)) {
+        return verbatim;
+    }
+    residuals(x, n, order);
+    uint64_t bits;
+    bool rice2 = false;
+    int partitionOrder = bestPartitionOrder(n, order, bits, rice2);
+    Candidate fixed{header + static_cast<uint64_t>(order) * bps + 6 + bits, order, partitionOrder, rice2};
+    return fixed.bits < verbatim.bits ? fixed : verbatim;
+}
+
+void FLACFrameEncoder::writeSubframe(BitWriter& bw, const int32_t* x, uint32_t n, unsigned bps, const Candidate& c) {
+    if (c.type == kConstant) {
+        bw.put(0x00, 8);
+        bw.put(static_cast<uint32_t>(x[0]), bps);
+        return;
+    }
+    if (c.type == kVerbatim) {
+        bw.put(0x02, 8);
+        for (uint32_t i = 0; i < n; ++i) bw.put(static_cast<uint32_t>(x[i]), bps);
+        return;
+    }
+
+    int order = c.type;
+    bw.put(static_cast<uint32_t>((8 + order) << 1), 8);
+    for (int i = 0; i < order; ++i) bw.put(static_cast<uint32_t>(x[i]), bps);
+    // residual_ still holds this channel's residuals: plan() runs right before
+    bw.put(c.rice2 ? 1 : 0, 2);
+    bw.put(static_cast<uint32_t>(c.partitionOrder), 4);
+    uint32_t partitions = 1u << c.partitionOrder;
+    uint32_t size = n >> c.partitionOrder;
+    const uint32_t* u = residual_.data();
+    for (uint32_t p = 0; p < partitions; ++p) {
+        uint32_t count = p == 0 ? size - order : size;
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < count; ++i) sum += u[i];
+        uint64_t ignored;
+        unsigned k = riceParameter(sum, count, ignored);   // as bestPartitionOrder chose it
+        bw.put(k, c.rice2 ? 5 : 4);
+        for (uint32_t i = 0; i < count; ++i) bw.rice(u[i], k);
+        u += count;
+    }
+}
+
+} // namespace ZoomBot
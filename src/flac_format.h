@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ZoomBot {
+
+/**
+ * FLAC container layout used for recordings. The metadata takes a fixed
+ * kFLACHeaderSize bytes so it can be rewritten in place while the file grows:
+ *
+ *   "fLaC" | STREAMINFO | SEEKTABLE (kFLACSeekPoints) | PADDING | frames...
+ *
+ * Unused seek points are placeholders, which decoders skip. The size is two
+ * O_DIRECT blocks, so the frames start block aligned.
+ */
+static const uint32_t kFLACHeaderSize = 8192;
+static const uint32_t kFLACStreamInfoOffset = 8;        // STREAMINFO body
+static const uint32_t kFLACStreamInfoSize = 34;
+static const uint32_t kFLACSeekTableOffset = 46;        // first seek point
+static const uint32_t kFLACSeekPointSize = 18;
+static const uint32_t kFLACSeekPoints = (kFLACHeaderSize - kFLACSeekTableOffset - 4) / kFLACSeekPointSize;
+static const uint64_t kFLACPlaceholderPoint = ~0ull;
+
+struct FLACStreamInfo {
+    uint32_t minBlockSize = 16;
+    uint32_t maxBlockSize = 4096;
+    uint32_t minFrameSize = 0;      // bytes, 0 = unknown
+    uint32_t maxFrameSize = 0;
+    uint32_t sampleRate = 0;
+    uint16_t channels = 0;
+    uint16_t bitsPerSample = 16;
+    uint64_t totalSamples = 0;      // per channel, 0 = unknown
+};
+
+struct FLACSeekPoint {
+    uint64_t sample = kFLACPlaceholderPoint;
+    uint64_t offset = 0;            // of the frame header, from the first frame
+    uint16_t samples = 0;           // in that frame
+};
+
+// Full header for a new file (out holds kFLACHeaderSize bytes), every seek point a placeholder
+void makeFLACHeader(char* out, const FLACStreamInfo& info);
+// The STREAMINFO body alone (kFLACStreamInfoSize bytes), for patching at kFLACStreamInfoOffset
+void makeFLACStreamInfo(char* out, const FLACStreamInfo& info);
+void makeFLACSeekPoint(char* out, const FLACSeekPoint& point);
+// Reads back a header written by makeFLACHeader; false if header isn't one.
+// points gets the seek points in use, in order.
+bool parseFLACHeader(const char* header, size_t len, FLACStreamInfo& info, std::vector<FLACSeekPoint>& points);
+
+/**
+ * Encodes 16-bit interleaved PCM into FLAC frames (mono or stereo).
+ *
+ * Frames use the variable block size numbering (the header carries the first
+ * sample number), so a stream may hand over short blocks whenever it needs to
+ * flush. Each channel is coded as a constant (silence), with the best fixed
+ * predictor of order 0-4 and partitioned Rice residuals, or verbatim when
+ * nothing beats it; stereo picks the cheapest of left/right, mid/side and the
+ * two left/side variants. No LPC: speech compresses a little less than with
+ * libFLAC's default level, at a fraction of the CPU.
+ */
+class FLACFrameEncoder {
+public:
+    static const uint32_t kMaxBlockSize = 4096;
+
+    FLACFrameEncoder(uint32_t sampleRate, uint16_t channels);
+
+    // Appends the frame for samples (per channel, 1..kMaxBlockSize) starting at firstSample to out
+    void encode(const int16_t* pcm, uint32_t samples, uint64_t firstSample, std::vector<uint8_t>& out);
+
+private:
+    class BitWriter;
+
+    struct Candidate {
+        uint64_t bits;
+        int type;                   // kConstant, kVerbatim or the fixed order
+        int partitionOrder;
+        bool rice2;
+    };
+
+    uint64_t fixedCost(const int32_t* x, uint32_t n, int& order) const;
+    Candidate plan(const int32_t* x, uint32_t n, unsigned bps);
+    void writeSubframe(BitWriter& bw, const int32_t* x, uint32_t n, unsigned bps, const Candidate& c);
+    void residuals(const int32_t* x, uint32_t n, int order);
+    int bestPartitionOrder(uint32_t n, int order, uint64_t& bits, bool& rice2);
+
+    uint16_t channels_;
+    uint8_t rateCode_;                          // 0: the rate is only in STREAMINFO
+    std::vector<int32_t> channel_[4];           // left, right, mid, side
+    std::vector<uint32_t> residual_;            // zigzag coded
+    std::vector<uint64_t> partitionSums_;
+};
+
+} // namespace ZoomBot
@@ -0,0 +1,256 @@
+#include "io_uring_backend.h"
+#include <iostream>
+
+#ifdef ZOOMBOT_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace ZoomBot {
+
+#ifdef ZOOMBOT_HAVE_IO_URING
+
+static int ioUringSetup(unsigned entries, struct io_uring_params* p) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+static int ioUringRegister(int fd, unsigned opcode, const void* arg, unsigned nrArgs) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+}
+
+std::unique_ptr<IoUringStorageBackend> IoUringStorageBackend::create(unsigned queueDepth) {
+    std::unique_ptr<IoUringStorageBackend> backend(new IoUringStorageBackend());
+    if (!backend->setup(queueDepth)) {
+        return nullptr;
+    }
+    return backend;
+}
+
+bool IoUringStorageBackend::setup(unsigned queueDepth) {
+    struct io_uring_params p;
+    std::memset(&p, 0, sizeof(p));
+    ringFd_ = ioUringSetup(std::max(queueDepth, 8u), &p);
+    if (ringFd_ < 0) {
+        std::cerr << "[AUDIO] io_uring_setup failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    sqRingSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqRingSize_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap) {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        sqRing_ = nullptr;
+        return false;
+    }
+    if (singleMmap) {
+        cqRing_ = sqRing_;
+    } else {
+        cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            cqRing_ = nullptr;
+            return false;
+        }
+    }
+    sqesSize_ = p.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    sqEntries_ = p.sq_entries;
+
+    char* cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+    return true;
+}
+
+IoUringStorageBackend::~IoUringStorageBackend() {
+    if (sqes_) munmap(sqes_, sqesSize_);
+    if (cqRing_ && cqRing_ != sqRing_) munmap(cqRing_, cqRingSize_);
+    if (sqRing_) munmap(sqRing_, sqRingSize_);
+    if (ringFd_ >= 0) close(ringFd_);
+}
+
+void IoUringStorageBackend::addSlab(uint32_t index, char* base, size_t len) {
+    std::lock_guard<std::mutex> lk(slabMtx_);
+    if (slabs_.size() <= index) {
+        slabs_.resize(index + 1);
+    }
+    slabs_[index].iov_base = base;
+    slabs_[index].iov_len = len;
+    slabsChanged_ = true;
+}
+
+void IoUringStorageBackend::registerSlabs() {
+    // Only called between batches, so nothing in flight uses the old table
+    std::lock_guard<std::mutex> lk(slabMtx_);
+    if (!slabsChanged_) return;
+    slabsChanged_ = false;
+
+    if (registered_ > 0) {
+        ioUringRegister(ringFd_, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+        registered_ = 0;
+    }
+    if (ioUringRegister(ringFd_, IORING_REGISTER_BUFFERS, slabs_.data(), static_cast<unsigned>(slabs_.size())) == 0) {
+        registered_ = slabs_.size();
+    } else {
+        std::cerr << "[AUDIO] io_uring buffer registration failed (" << std::strerror(errno)
+                  << "), using unregistered writes" << std::endl;
+    }
+}
+
+struct io_uring_sqe* IoUringStorageBackend::nextSqe() {
+    unsigned tail = *sqTail_;
+    unsigned index = tail & sqMask_;
+    struct io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray_[index] = index;
+    return sqe;
+}
+
+uint64_t IoUringStorageBackend::write(WriteOp* ops, size_t count) {
+    registerSlabs();
+
+    pending_.clear();
+    progress_.assign(count, 0);
+    for (size_t i = 0; i < count; ++i) {
+        ops[i].result = 0;
+        pending_.push_back(i);
+    }
+
+    uint64_t calls = 0;
+    size_t cursor = 0;
+    while (cursor < pending_.size()) {
+        unsigned inflight = 0;
+        size_t end = pending_.size();
+        while (cursor < end && inflight < sqEntries_) {
+            size_t i = pending_[cursor++];
+            const WriteOp& op = ops[i];
+            size_t done = progress_[i];
+
+            struct io_uring_sqe* sqe = nextSqe();
+            bool fixed = op.slab < registered_;
+            sqe->opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+            sqe->fd = op.fd;
+            sqe->off = op.offset + done;
+            sqe->addr = reinterpret_cast<uint64_t>(op.data + done);
+            sqe->len = static_cast<uint32_t>(op.len - done);
+            if (fixed) {
+                sqe->buf_index = static_cast<uint16_t>(op.slab);
+            }
+            sqe->user_data = i;
+            __atomic_store_n(sqTail_, *sqTail_ + 1, __ATOMIC_RELEASE);
+            ++inflight;
+        }
+        calls += submitAndReap(inflight, ops, false);
+    }
+    return calls;
+}
+
+uint64_t IoUringStorageBackend::sync(const int* fds, size_t count) {
+    uint64_t calls = 0;
+    size_t i = 0;
+    while (i < count) {
+        unsigned inflight = 0;
+        while (i < count && inflight < sqEntries_) {
+            struct io_uring_sqe* sqe = nextSqe();
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fd = fds[i];
+            sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+            sqe->user_data = i;
+            __atomic_store_n(sqTail_, *sqTail_ + 1, __ATOMIC_RELEASE);
+            ++inflight;
+            ++i;
+        }
+        calls += submitAndReap(inflight, nullptr, true);
+    }
+    return calls;
+}
+
+uint64_t IoUringStorageBackend::submitAndReap(unsigned inflight, WriteOp* ops, bool isSync) {
+    uint64_t calls = 0;
+    unsigned toSubmit = inflight;
+    unsigned reaped = 0;
+    while (reaped < inflight) {
+        int ret = ioUringEnter(ringFd_, toSubmit, 1, IORING_ENTER_GETEVENTS);
+        ++calls;
+        if (ret >= 0) {
+            toSubmit -= std::min(toSubmit, static_cast<unsigned>(ret));
+        } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            std::cerr << "[AUDIO] io_uring_enter failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head, ++reaped) {
+            const struct io_uring_cqe& cqe = cqes_[head & cqMask_];
+            if (isSync) continue;
+
+            size_t i = static_cast<size_t>(cqe.user_data);
+            if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                pending_.push_back(i);
+            } else if (cqe.res < 0) {
+                ops[i].result = cqe.res;
+            } else if (cqe.res == 0) {
+                ops[i].result = -EIO;
+            } else {
+                progress_[i] += static_cast<size_t>(cqe.res);
+                if (progress_[i] < ops[i].len) {
+                    pending_.push_back(i);   // short write: resubmit the rest
+                }
+            }
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    }
+
+    if (reaped < inflight && ops) {
+        // Ring is unusable; fail whatever did not complete
+        for (size_t i = 0; i < progress_.size(); ++i) {
+            if (ops[i].result == 0 && progress_[i] < ops[i].len) {
+                ops[i].result = -EIO;
+            }
+        }
+        pending_.clear();
+    }
+    return calls;
+}
+
+#else
+
+std::unique_ptr<IoUringStorageBackend> IoUringStorageBackend::create(unsigned) {
+    std::cerr << "[AUDIO] Built without io_uring support" << std::endl;
+    return nullptr;
+}
+
+IoUringStorageBackend::~IoUringStorageBackend() = default;
+void IoUringStorageBackend::addSlab(uint32_t, char*, size_t) {}
+uint64_t IoUringStorageBackend::write(WriteOp*, size_t) { return 0; }
+uint64_t IoUringStorageBackend::sync(const int*, size_t) { return 0; }
+
+#endif
+
+} // namespace ZoomBot
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <sys/uio.h>
+
+#include "storage_backend.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace ZoomBot {
+
+/**
+ * io_uring storage backend, driven directly through the system calls (no liburing).
+ *
+ * Every recording file shares one ring: a batch of buffers for hundreds of
+ * files is submitted and reaped with a single io_uring_enter. Buffer slabs are
+ * registered with the kernel so writes use IORING_OP_WRITE_FIXED and skip
+ * per-call page pinning; if registration fails, plain IORING_OP_WRITE is used.
+ */
+class IoUringStorageBackend : public StorageBackend {
+public:
+    // nullptr if the kernel (or a seccomp policy) does not allow io_uring
+    static std::unique_ptr<IoUringStorageBackend> create(unsigned queueDepth);
+    ~IoUringStorageBackend() override;
+
+    const char* name() const override { return "io_uring"; }
+    void addSlab(uint32_t index, char* base, size_t len) override;
+    uint64_t write(WriteOp* ops, size_t count) override;
+    uint64_t sync(const int* fds, size_t count) override;
+
+private:
+    IoUringStorageBackend() = default;
+    bool setup(unsigned queueDepth);
+    void registerSlabs();
+    io_uring_sqe* nextSqe();
+    // Submits what is queued and waits until `inflight` completions were reaped
+    uint64_t submitAndReap(unsigned inflight, WriteOp* ops, bool isSync);
+
+    int ringFd_ = -1;
+    void* sqRing_ = nullptr;
+    size_t sqRingSize_ = 0;
+    void* cqRing_ = nullptr;
+    size_t cqRingSize_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqesSize_ = 0;
+
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned sqEntries_ = 0;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned cqMask_ = 0;
+
+    // Slabs are announced from any thread and (re)registered on the writer thread
+    std::mutex slabMtx_;
+    std::vector<struct iovec> slabs_;
+    bool slabsChanged_ = false;
+    size_t registered_ = 0;            // slabs usable with WRITE_FIXED
+
+    std::vector<size_t> pending_;      // op indices still to submit
+    std::vector<size_t> progress_;     // bytes of each op already written
+};
+
+} // namespace ZoomBot
@@ -0,0 +1,519 @@
+#include "local_backends.h"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <new>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+namespace ZoomBot {
+
+// ============================================================================
+// LocalStreamingBackend
+// ============================================================================
+
+// Bound by reference in std::min
+const int LocalStreamingBackend::kRetryMaxDelayMs;
+
+bool LocalStreamingBackend::initialize(const std::string& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Parse config: "PATH[?options]"
+    size_t query_pos = config.find('?');
+    path_ = config.substr(0, query_pos);
+    if (query_pos != std::string::npos) {
+        std::stringstream options(config.substr(query_pos + 1));
+        std::string option;
+        while (std::getline(options, option, '&')) {
+            if (!option.empty() && !setOption(option)) {
+                std::cerr << tag_ << " Ignoring unknown option: " << option << std::endl;
+            }
+        }
+    }
+    if (path_.empty() || path_.size() >= sizeof(sockaddr_un::sun_path)) {
+        std::cerr << tag_ << " Invalid socket path: '" << path_ << "'" << std::endl;
+        return false;
+    }
+
+    std::cout << tag_ << " Configured to stream to " << path_ << std::endl;
+    if (!ensureConnected()) {
+        std::cout << tag_ << " Reader not reachable yet, will keep retrying" << std::endl;
+    }
+    return true;
+}
+
+bool LocalStreamingBackend::ensureConnected() {
+    if (connected_.load()) {
+        return true;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now < next_attempt_) {
+        return false;
+    }
+
+    if (openReceiver()) {
+        connected_.store(true);
+        generation_++;
+        retry_delay_ms_ = 0;
+        reported_down_ = false;
+        std::cout << tag_ << " ✓ Connected to reader at " << path_ << std::endl;
+        return true;
+    }
+
+    int error = errno;
+    retry_delay_ms_ = retry_delay_ms_ == 0 ? kRetryBaseDelayMs : std::min(retry_delay_ms_ * 2, kRetryMaxDelayMs);
+    next_attempt_ = now + std::chrono::milliseconds(retry_delay_ms_);
+    if (!reported_down_) {
+        std::cerr << tag_ << " Connection to " << path_ << " failed (" << strerror(error) << "), retrying" << std::endl;
+        reported_down_ = true;
+    }
+    return false;
+}
+
+void LocalStreamingBackend::disconnect(const char* reason) {
+    closeReceiver();
+    connected_.store(false);
+    retry_delay_ms_ = kRetryBaseDelayMs;
+    next_attempt_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(retry_delay_ms_);
+    reported_down_ = true;   // until the next successful connect
+    std::cerr << tag_ << " Lost reader at " << path_ << " (" << reason << "), reconnecting" << std::endl;
+}
+
+int LocalStreamingBackend::connectSocket() {
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path_.c_str(), path_.size());
+
+    struct timeval timeout{};
+    timeout.tv_sec = kSocketTimeoutMs / 1000;
+    timeout.tv_usec = (kSocketTimeoutMs % 1000) * 1000;
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+bool LocalStreamingBackend::exchangeHello(int fd, const int* fds, size_t fd_count) {
+    char hello[kWireHelloSize];
+    encodeWireHello(hello);
+    struct iovec iov{hello, sizeof(hello)};
+    struct msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    // File descriptors for the reader travel with the hello
+    char control[CMSG_SPACE(sizeof(int) * 4)] = {};
+    if (fd_count > 0) {
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fd_count);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fd_count);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * fd_count);
+    }
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(hello))) {
+        return false;
+    }
+
+    char reply[kWireHelloSize];
+    ssize_t n = recv(fd, reply, sizeof(reply), 0);
+    uint16_t version = 0;
+    uint16_t flags = 0;
+    if (n != static_cast<ssize_t>(sizeof(reply)) || !decodeWireHello(reply, version, flags) || version != kWireVersion) {
+        if (n >= 0) {
+            std::cerr << tag_ << " Reader at " << path_ << " did not answer with a v" << kWireVersion << " hello" << std::endl;
+            errno = EPROTO;
+        }
+        return false;
+    }
+    return true;
+}
+
+LocalStreamingBackend::WireStream* LocalStreamingBackend::wireStreamFor(uint32_t user_id, const AudioFrameRef& frame) {
+    // One stream per (participant, format), as over TCP
+    FormatKey key{user_id, frame->sampleRate, frame->channels, frame->format};
+    auto it = wire_stream_ids_.find(key);
+    if (it == wire_stream_ids_.end()) {
+        if (wire_streams_.size() >= kWireAllStreams) {   // the last id stands for all streams in credits
+            std::cerr << tag_ << " Out of stream ids, dropping audio for user " << user_id << std::endl;
+            return nullptr;
+        }
+        WireStream stream;
+        stream.user_id = user_id;
+        stream.sample_rate = frame->sampleRate;
+        stream.channels = frame->channels;
+        stream.format = frame->format;
+        it = wire_stream_ids_.emplace(key, static_cast<uint16_t>(wire_streams_.size())).first;
+        wire_streams_.push_back(std::move(stream));
+    }
+    return &wire_streams_[it->second];
+}
+
+void LocalStreamingBackend::noteDropped(const AudioChunk& chunk, DropReason reason) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    recordDropped(chunk, reason);
+}
+
+void LocalStreamingBackend::recordDropped(const AudioChunk& chunk, DropReason reason) {
+    WireStream* stream = wireStreamFor(chunk.user_id, chunk.frame);
+    if (stream) {
+        noteGap(*stream, stream->next_sequence++, reason, chunk.priority);
+    }
+}
+
+void LocalStreamingBackend::noteGap(WireStream& stream, uint32_t sequence, DropReason reason, StreamPriority priority) {
+    if (stream.dropped_count == 0) {
+        stream.dropped_first = sequence;
+    }
+    stream.dropped_count = sequence - stream.dropped_first + 1;
+    stream.dropped_reason = reason;
+    stream.dropped_priority = priority;
+}
+
+bool LocalStreamingBackend::streamAudio(uint32_t user_id, const std::string& user_name, const AudioFrameRef& frame) {
+    AudioChunk chunk;
+    chunk.user_id = user_id;
+    chunk.user_name = std::make_shared<const std::string>(user_name);
+    chunk.frame = frame;
+    return streamBatch(&chunk, 1);
+}
+
+bool LocalStreamingBackend::streamBatch(const AudioChunk* chunks, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!ensureConnected()) {
+        for (size_t i = 0; i < count; ++i) {
+            recordDropped(chunks[i], DropReason::Unavailable);
+        }
+        return false;
+    }
+
+    bool all = true;
+    for (size_t i = 0; i < count; ++i) {
+        const AudioChunk& chunk = chunks[i];
+        WireStream* found = wireStreamFor(chunk.user_id, chunk.frame);
+        if (!found) {
+            all = false;
+            continue;
+        }
+        WireStream& stream = *found;
+        uint16_t stream_id = static_cast<uint16_t>(found - wire_streams_.data());
+
+        // Declaration and drop notice only count as sent once the frame is
+        headers_.clear();
+        bool declare = stream.declared_on != generation_ || stream.user_name != *chunk.user_name;
+        if (declare) {
+            appendWireStreamDeclare(headers_, stream_id, stream.user_id, stream.sample_rate, stream.channels,
+                                    static_cast<uint8_t>(stream.format), *chunk.user_name);
+        }
+        if (stream.dropped_count > 0) {
+            char notice[kWireDroppedSize];
+            encodeWireDropped(notice, stream_id, stream.dropped_first, stream.dropped_count,
+                              static_cast<uint8_t>(stream.dropped_reason), static_cast<uint8_t>(stream.dropped_priority));
+            headers_.append(notice, sizeof(notice));
+        }
+        uint32_t sequence = stream.next_sequence++;
+        if (chunk.frame->silentSamples > 0) {
+            // A silence marker is all header
+            char silence[kWireSilenceSize];
+            encodeWireSilence(silence, stream_id, sequence, static_cast<uint64_t>(chunk.frame->captureTimeMs),
+                              chunk.frame->silentSamples);
+            headers_.append(silence, sizeof(silence));
+        } else {
+            char header[kWireAudioHeaderSize];
+            encodeWireAudioHeader(header, stream_id, sequence, static_cast<uint64_t>(chunk.frame->captureTimeMs),
+                                  static_cast<uint32_t>(chunk.frame->size()));
+            headers_.append(header, sizeof(header));
+        }
+
+        switch (sendFrame(headers_, chunk)) {
+            case SendResult::Sent:
+                if (declare) {
+                    stream.user_name = *chunk.user_name;
+                    stream.declared_on = generation_;
+                }
+                stream.dropped_count = 0;
+                if (no_room_) {
+                    std::cout << tag_ << " Reader caught up (" << no_room_frames_ << " frames dropped so far)" << std::endl;
+                    no_room_ = false;
+                }
+                break;
+            case SendResult::NoRoom:
+                noteGap(stream, sequence, DropReason::Shed, chunk.priority);
+                no_room_frames_++;
+                if (!no_room_) {
+                    std::cerr << tag_ << " Reader is behind, dropping audio" << std::endl;
+                    no_room_ = true;
+                }
+                all = false;
+                break;
+            case SendResult::Failed:
+                int error = errno;
+                noteGap(stream, sequence, DropReason::Unavailable, chunk.priority);
+                for (size_t j = i + 1; j < count; ++j) {
+                    recordDropped(chunks[j], DropReason::Unavailable);
+                }
+                disconnect(error == EAGAIN || error == EWOULDBLOCK ? "send stalled" : strerror(error));
+                return false;
+        }
+    }
+    if (!finishBatch()) {
+        disconnect("closed by reader");
+        return false;
+    }
+    return all;
+}
+
+void LocalStreamingBackend::maintain() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (connected_.load() && !finishBatch()) {
+        disconnect("closed by reader");
+    }
+    ensureConnected();
+}
+
+void LocalStreamingBackend::shutdown() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (connected_.load()) {
+        closeReceiver();
+        connected_.store(false);
+        std::cout << tag_ << " Connection closed" << std::endl;
+    }
+    if (no_room_frames_ > 0) {
+        std::cout << tag_ << " Dropped " << no_room_frames_ << " frames while the reader was behind" << std::endl;
+        no_room_frames_ = 0;
+    }
+}
+
+// ============================================================================
+// SeqpacketStreamingBackend
+// ============================================================================
+
+SeqpacketStreamingBackend::~SeqpacketStreamingBackend() {
+    shutdown();
+}
+
+bool SeqpacketStreamingBackend::openReceiver() {
+    int fd = connectSocket();
+    if (fd < 0) {
+        return false;
+    }
+    if (!exchangeHello(fd, nullptr, 0)) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return false;
+    }
+    socket_fd_ = fd;
+    return true;
+}
+
+LocalStreamingBackend::SendResult SeqpacketStreamingBackend::sendFrame(const std::string& headers, const AudioChunk& chunk) {
+    // One packet: the headers from our buffer, the PCM from the captured frame
+    struct iovec iov[2];
+    iov[0].iov_base = const_cast<char*>(headers.data());
+    iov[0].iov_len = headers.size();
+    iov[1].iov_base = const_cast<char*>(chunk.frame->data());
+    iov[1].iov_len = chunk.frame->size();
+    struct msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    for (;;) {
+        ssize_t n = sendmsg(socket_fd_, &msg, MSG_NOSIGNAL);
+        if (n >= 0) return SendResult::Sent;     // whole packet or nothing
+        if (errno == EINTR) continue;
+        if (errno == EMSGSIZE) return SendResult::NoRoom;
+        return SendResult::Failed;                // EAGAIN here means the send timeout expired
+    }
+}
+
+void SeqpacketStreamingBackend::closeReceiver() {
+    if (socket_fd_ != -1) {
+        close(socket_fd_);
+        socket_fd_ = -1;
+    }
+}
+
+// ============================================================================
+// ShmRingStreamingBackend
+// ============================================================================
+
+ShmRingStreamingBackend::~ShmRingStreamingBackend() {
+    shutdown();
+}
+
+bool ShmRingStreamingBackend::setOption(const std::string& option) {
+    if (option.compare(0, 8, "ring_kb=") == 0) {
+        // Whole pages, at least 64 KB
+        size_t bytes = static_cast<size_t>(std::max(64, atoi(option.c_str() + 8))) * 1024;
+        ring_bytes_ = (bytes + 4095) & ~static_cast<size_t>(4095);
+        return true;
+    }
+    return false;
+}
+
+bool ShmRingStreamingBackend::openReceiver() {
+    int fd = connectSocket();
+    if (fd < 0) {
+        return false;
+    }
+
+    // A fresh ring per connection. Sealing the size keeps a reader from
+    // truncating the file under us (which would fault our writes).
+    mapping_size_ = kShmRingDataOffset + ring_bytes_;
+    memfd_ = memfd_create("zoombot-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    bool ok = memfd_ >= 0 && ftruncate(memfd_, static_cast<off_t>(mapping_size_)) == 0 &&
+              fcntl(memfd_, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == 0;
+    if (ok) {
+        void* mapping = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_SHARED, memfd_, 0);
+        ok = mapping != MAP_FAILED;
+        mapping_ = ok ? static_cast<char*>(mapping) : nullptr;
+    }
+    if (ok) {
+        data_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        space_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        ok = data_fd_ >= 0 && space_fd_ >= 0;
+    }
+    if (ok) {
+        header_ = new (mapping_) ShmRingHeader();
+        memcpy(header_->magic, kShmRingMagic, sizeof(kShmRingMagic));
+        header_->version = kShmRingVersion;
+        header_->data_offset = static_cast<uint32_t>(kShmRingDataOffset);
+        header_->capacity = ring_bytes_;
+        header_->head.store(0);
+        header_->tail.store(0);
+        data_ = mapping_ + kShmRingDataOffset;
+        head_ = 0;
+        reserved_ = 0;
+        written_ = false;
+
+        int fds[3] = {memfd_, data_fd_, space_fd_};
+        ok = exchangeHello(fd, fds, 3);
+    }
+    if (!ok) {
+        int error = errno;
+        close(fd);
+        closeReceiver();
+        errno = error;
+        return false;
+    }
+    control_fd_ = fd;
+    return true;
+}
+
+size_t ShmRingStreamingBackend::freeBytes() const {
+    return static_cast<size_t>(ring_bytes_ - (head_ - header_->tail.load(std::memory_order_acquire)));
+}
+
+bool ShmRingStreamingBackend::takeCredit(const AudioChunk& chunk) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!header_) {
+        return true;   // not connected: the send drops it
+    }
+
+    // Room for the frame's record at its worst (a declaration and a drop notice
+    // ahead of it), plus what is skipped if it has to start over at the beginning
+    size_t record = shmRingRecordSize(kWireDeclareFixedSize + chunk.user_name->size() + kWireDroppedSize +
+                                      kWireAudioHeaderSize + chunk.frame->size());
+    size_t offset = static_cast<size_t>((head_ + reserved_) % ring_bytes_);
+    size_t skipped = ring_bytes_ - offset < record ? ring_bytes_ - offset : 0;
+    if (freeBytes() < reserved_ + skipped + record) {
+        return false;
+    }
+    reserved_ += skipped + record;
+    return true;
+}
+
+void ShmRingStreamingBackend::waitForCredit(std::chrono::microseconds timeout) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!header_) {
+        return;
+    }
+    struct pollfd fds[2] = {{space_fd_, POLLIN, 0}, {control_fd_, POLLIN, 0}};
+    int timeout_ms = static_cast<int>((timeout.count() + 999) / 1000);
+    if (poll(fds, 2, timeout_ms) > 0 && (fds[0].revents & POLLIN)) {
+        uint64_t value;
+        ssize_t n = read(space_fd_, &value, sizeof(value));
+        (void)n;   // just resets the counter
+    }
+    // A closed control socket is noticed by the next batch
+}
+
+LocalStreamingBackend::SendResult ShmRingStreamingBackend::sendFrame(const std::string& headers, const AudioChunk& chunk) {
+    size_t length = headers.size() + chunk.frame->size();
+    size_t record = shmRingRecordSize(length);
+    size_t offset = static_cast<size_t>(head_ % ring_bytes_);
+    size_t skipped = ring_bytes_ - offset < record ? ring_bytes_ - offset : 0;
+    if (record > ring_bytes_ || freeBytes() < skipped + record) {
+        return SendResult::NoRoom;
+    }
+    if (skipped > 0) {
+        memcpy(data_ + offset, &kShmRingWrap, sizeof(kShmRingWrap));
+        head_ += skipped;
+        offset = 0;
+    }
+
+    // Written once, here; the reader parses it where it is
+    uint32_t length32 = static_cast<uint32_t>(length);
+    memcpy(data_ + offset, &length32, sizeof(length32));
+    memcpy(data_ + offset + 4, headers.data(), headers.size());
+    if (chunk.frame->size() > 0) {
+        memcpy(data_ + offset + 4 + headers.size(), chunk.frame->data(), chunk.frame->size());
+    }
+    head_ += record;
+    header_->head.store(head_, std::memory_order_release);
+    written_ = true;
+    return SendResult::Sent;
+}
+
+bool ShmRingStreamingBackend::finishBatch() {
+    reserved_ = 0;
+    if (written_) {
+        uint64_t one = 1;
+        ssize_t n = write(data_fd_, &one, sizeof(one));
+        (void)n;   // EAGAIN only if the counter is already huge, so the reader is awake anyway
+        written_ = false;
+    }
+
+    // The control socket carries nothing after the hello; readable means the reader is gone
+    char byte;
+    ssize_t n = recv(control_fd_, &byte, 1, MSG_DONTWAIT);
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+}
+
+void ShmRingStreamingBackend::closeReceiver() {
+    if (mapping_) {
+        munmap(mapping_, mapping_size_);
+        mapping_ = nullptr;
+        header_ = nullptr;
+        data_ = nullptr;
+    }
+    for (int* fd : {&control_fd_, &memfd_, &data_fd_, &space_fd_}) {
+        if (*fd != -1) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+} // namespace ZoomBot
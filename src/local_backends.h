@@ -0,0 +1,160 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "audio_streamer.h"
+#include "shm_ring.h"
+
+namespace ZoomBot {
+
+/**
+ * Common part of the backends for a processor on the same host. Speaks the
+ * binary protocol (stream_protocol.h) to a reader listening on a Unix socket
+ * path: streams are declared once per connection, frames carry sequence
+ * numbers, and drops are announced in-band. No credits or acks; a reader that
+ * goes away costs the audio sent meanwhile.
+ *
+ * Connecting is synchronous (a local reader answers its hello at once or not
+ * at all); after a failure the next attempt waits 250 ms, doubling up to 5 s.
+ */
+class LocalStreamingBackend : public StreamingBackend {
+public:
+    bool initialize(const std::string& config) override;
+    bool streamAudio(uint32_t user_id, const std::string& user_name, const AudioFrameRef& frame) override;
+    bool streamBatch(const AudioChunk* chunks, size_t count) override;
+    void noteDropped(const AudioChunk& chunk, DropReason reason) override;
+    void maintain() override;
+    bool isConnected() const override { return connected_.load(); }
+    void shutdown() override;
+
+protected:
+    enum class SendResult { Sent, NoRoom, Failed };
+
+    explicit LocalStreamingBackend(const char* tag) : tag_(tag) {}
+
+    // Subclasses: connect to path_ (true once the reader answered), deliver one
+    // frame's messages (headers, then the frame's PCM) and drop the connection
+    virtual bool openReceiver() = 0;
+    virtual SendResult sendFrame(const std::string& headers, const AudioChunk& chunk) = 0;
+    // After every batch; false if the reader turned out to be gone
+    virtual bool finishBatch() { return true; }
+    virtual void closeReceiver() = 0;
+    // A backend-specific "name=value" from the config; false if unknown
+    virtual bool setOption(const std::string& option) { (void)option; return false; }
+
+    // Connected SOCK_SEQPACKET socket to path_ with send and receive timeouts, or -1
+    int connectSocket();
+    // Hello exchange on fd; the bot's hello can carry file descriptors
+    bool exchangeHello(int fd, const int* fds, size_t fd_count);
+
+    const char* tag_;
+    std::string path_;
+    std::mutex mutex_;
+
+    static const int kSocketTimeoutMs = 2000;
+
+private:
+    struct WireStream {
+        uint32_t user_id;
+        uint32_t sample_rate;
+        uint16_t channels;
+        AudioFormat format;
+        std::string user_name;      // as last declared
+        uint32_t next_sequence = 0;
+        uint64_t declared_on = 0;   // connection generation of the last declare
+        uint32_t dropped_first = 0;
+        uint32_t dropped_count = 0;
+        DropReason dropped_reason = DropReason::Shed;
+        StreamPriority dropped_priority = StreamPriority::Idle;
+    };
+
+    static const int kRetryBaseDelayMs = 250;
+    static const int kRetryMaxDelayMs = 5000;
+
+    std::atomic<bool> connected_{false};
+    uint64_t generation_ = 0;
+    int retry_delay_ms_ = 0;
+    bool reported_down_ = false;
+    std::chrono::steady_clock::time_point next_attempt_;
+    std::vector<WireStream> wire_streams_;
+    std::unordered_map<FormatKey, uint16_t, FormatKeyHash> wire_stream_ids_;
+    std::string headers_;           // reused for every frame
+    uint64_t no_room_frames_ = 0;
+    bool no_room_ = false;          // dropping for lack of room, logged once per episode
+
+    bool ensureConnected();
+    void disconnect(const char* reason);
+    WireStream* wireStreamFor(uint32_t user_id, const AudioFrameRef& frame);
+    void recordDropped(const AudioChunk& chunk, DropReason reason);
+    void noteGap(WireStream& stream, uint32_t sequence, DropReason reason, StreamPriority priority);
+};
+
+/**
+ * SOCK_SEQPACKET Unix socket backend. Config: "unix:PATH".
+ * Each frame is one packet: its headers and the PCM in a single sendmsg
+ * straight from the captured frame. Packet boundaries are kept, so the reader
+ * gets whole messages from each recv.
+ */
+class SeqpacketStreamingBackend : public LocalStreamingBackend {
+public:
+    SeqpacketStreamingBackend() : LocalStreamingBackend("[UNIX]") {}
+    ~SeqpacketStreamingBackend() override;
+
+protected:
+    bool openReceiver() override;
+    SendResult sendFrame(const std::string& headers, const AudioChunk& chunk) override;
+    void closeReceiver() override;
+
+private:
+    int socket_fd_ = -1;
+};
+
+/**
+ * Shared-memory ring backend (layout in shm_ring.h). Config: "shm:PATH[?ring_kb=N]".
+ * On connect the bot creates a sealed memfd ring (default 8 MB) and passes it
+ * to the reader at PATH with two eventfds. Frames are written into the ring
+ * once and read in place; the data eventfd is signalled once per batch.
+ *
+ * Ring space is the flow control: a frame is only taken for a batch while it
+ * fits (takeCredit), so a slow reader makes the streamer hold and eventually
+ * shed audio by priority, as with TCP credits.
+ */
+class ShmRingStreamingBackend : public LocalStreamingBackend {
+public:
+    ShmRingStreamingBackend() : LocalStreamingBackend("[SHM]") {}
+    ~ShmRingStreamingBackend() override;
+
+    bool takeCredit(const AudioChunk& chunk) override;
+    void waitForCredit(std::chrono::microseconds timeout) override;
+
+protected:
+    bool openReceiver() override;
+    SendResult sendFrame(const std::string& headers, const AudioChunk& chunk) override;
+    bool finishBatch() override;
+    void closeReceiver() override;
+    bool setOption(const std::string& option) override;
+
+private:
+    int control_fd_ = -1;
+    int memfd_ = -1;
+    int data_fd_ = -1;              // eventfd: records written
+    int space_fd_ = -1;             // eventfd: records consumed
+    size_t ring_bytes_ = 8192 * 1024;
+    char* mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+    ShmRingHeader* header_ = nullptr;
+    char* data_ = nullptr;
+    uint64_t head_ = 0;             // our copy; published after every record
+    size_t reserved_ = 0;           // taken for the batch being filled
+    bool written_ = false;          // records since the last data signal
+
+    size_t freeBytes() const;
+};
+
+} // namespace ZoomBot
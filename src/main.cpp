@@ -34,36 +34,17 @@
 
 using namespace ZoomBot;
 
-// Global variables for clean shutdown
+// Set by the signal handler; main() does the teardown once the meeting loop sees it
 std::atomic<bool> shouldExit{false};
-ZoomBot::AudioRawHandler* globalAudioHandler = nullptr;
-ZOOM_SDK_NAMESPACE::IMeetingService* globalMeetingService = nullptr;
 
-// Signal handler for clean shutdown
+// Signal handler for clean shutdown. Only async-signal-safe work here: stopping the
+// recording and leaving take locks and join threads, so main() does them.
 void signalHandler(int signal) {
-    std::cout << "\n[SHUTDOWN] Received signal " << signal << " - initiating clean shutdown..." << std::endl;
-    std::cout.flush();
-    
+    (void)signal;
+    static const char message[] = "\n[SHUTDOWN] Received signal - initiating clean shutdown...\n";
+    ssize_t n = write(STDOUT_FILENO, message, sizeof(message) - 1);
+    (void)n;
     shouldExit.store(true);
-    
-    // Stop recording if active
-    if (globalAudioHandler) {
-        std::cout << "[SHUTDOWN] Stopping audio recording..." << std::endl;
-        globalAudioHandler->stopRecording();
-        globalAudioHandler->unsubscribe();
-    }
-    
-    // Leave meeting
-    if (globalMeetingService) {
-        std::cout << "[SHUTDOWN] Leaving meeting..." << std::endl;
-        auto leaveResult = globalMeetingService->Leave(ZOOM_SDK_NAMESPACE::LEAVE_MEETING);
-        if (leaveResult == ZOOM_SDK_NAMESPACE::SDKERR_SUCCESS) {
-            std::cout << "[SHUTDOWN] ✓ Left meeting" << std::endl;
-        }
-    }
-    
-    std::cout << "[SHUTDOWN] Shutdown complete" << std::endl;
-    std::cout.flush();
 }
 
 // Set up robust signal handling
@@ -420,9 +401,7 @@ int main() {
     std::cout << "✓ Successfully joined the meeting!" << std::endl;
 
     // Step 5: Setup audio recording
-    ZoomBot::AudioRawHandler audioHandler;
-    globalAudioHandler = &audioHandler;
-    globalMeetingService = initResult.meetingService;
+    ZoomBot::AudioRawHandler audioHandler(Config::getDiskWriterConfig(), Config::getVoiceActivityConfig());
 
     if (!setupAudioRecording(initResult.meetingService, audioHandler)) {
         std::cout << "⚠ Audio recording setup failed - continuing without recording" << std::endl;
@@ -433,9 +412,20 @@ int main() {
     runMeetingLoop(initResult.meetingService, eventHandler);
 
     // Cleanup
+    if (shouldExit.load()) {
+        std::cout << "[SHUTDOWN] Stopping audio recording..." << std::endl;
+        audioHandler.stopRecording();
+    }
     audioHandler.unsubscribe();
-    globalAudioHandler = nullptr;
-    globalMeetingService = nullptr;
+    
+    if (shouldExit.load()) {
+        std::cout << "[SHUTDOWN] Leaving meeting..." << std::endl;
+        auto leaveResult = initResult.meetingService->Leave(ZOOM_SDK_NAMESPACE::LEAVE_MEETING);
+        if (leaveResult == ZOOM_SDK_NAMESPACE::SDKERR_SUCCESS) {
+            std::cout << "[SHUTDOWN] ✓ Left meeting" << std::endl;
+        }
+        std::cout << "[SHUTDOWN] Shutdown complete" << std::endl;
+    }
     SDKInitializer::cleanup(initResult);
     g_main_loop_unref(mainLoop);
     
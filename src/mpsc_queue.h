@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace ZoomBot {
+
+/**
+ * Bounded multi-producer/single-consumer queue.
+ *
+ * Producers claim a slot with one CAS on the tail and publish it through the
+ * slot's sequence number (Vyukov's bounded queue), so a producer is never
+ * blocked by another one or by the consumer. When the queue is full the push
+ * fails and the overflow counter is bumped instead. Slots are constructed up
+ * front and reused in place; nothing allocates after construction.
+ */
+template <typename T>
+class MPSCQueue {
+public:
+    explicit MPSCQueue(size_t capacity)
+        : capacity_(roundUpPow2(capacity)), mask_(capacity_ - 1), cells_(new Cell[capacity_]) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    // Producers (any thread)
+    bool tryPush(T&& value) {
+        uint64_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            uint64_t seq = cell.sequence.load(std::memory_order_acquire);
+            int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // The slot still holds an entry from one lap ago: full
+                overflows_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer (one thread): the oldest published entry, or nullptr if empty
+    // or the next producer hasn't finished publishing yet
+    T* front() {
+        Cell& cell = cells_[head_ & mask_];
+        if (cell.sequence.load(std::memory_order_acquire) != head_ + 1) return nullptr;
+        return &cell.value;
+    }
+
+    void pop() {
+        Cell& cell = cells_[head_ & mask_];
+        cell.sequence.store(head_ + capacity_, std::memory_order_release);
+        ++head_;
+        popped_.store(head_, std::memory_order_release);
+    }
+
+    bool tryPop(T& out) {
+        T* slot = front();
+        if (!slot) return false;
+        out = std::move(*slot);
+        pop();
+        return true;
+    }
+
+    size_t capacity() const { return capacity_; }
+    // Approximate while producers are active
+    size_t size() const {
+        uint64_t tail = tail_.load(std::memory_order_acquire);
+        uint64_t head = popped_.load(std::memory_order_acquire);
+        return tail > head ? static_cast<size_t>(tail - head) : 0;
+    }
+    bool empty() const { return size() == 0; }
+
+    // Counters (safe to read from any thread)
+    uint64_t overflowCount() const { return overflows_.load(std::memory_order_relaxed); }
+
+private:
+    static size_t roundUpPow2(size_t n) {
+        size_t p = 2;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    struct Cell {
+        std::atomic<uint64_t> sequence;
+        T value;
+    };
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+
+    // Producers' and consumer's indices live on separate cache lines to avoid false sharing
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    std::atomic<uint64_t> overflows_{0};
+    alignas(64) uint64_t head_ = 0;           // consumer only
+    std::atomic<uint64_t> popped_{0};         // head_, published for size()
+};
+
+} // namespace ZoomBot
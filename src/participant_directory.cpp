@@ -0,0 +1,146 @@
+#include "participant_directory.h"
+#include <iostream>
+#include <cctype>
+
+namespace ZoomBot {
+
+ParticipantDirectory::~ParticipantDirectory() {
+    detach();
+}
+
+void ParticipantDirectory::attach(ZOOM_SDK_NAMESPACE::IMeetingParticipantsController* controller) {
+    if (!controller) {
+        std::cerr << "[AUDIO] Participants controller not available - names resolved lazily" << std::endl;
+        return;
+    }
+    controller_ = controller;
+    
+    auto err = controller_->SetEvent(this);
+    if (err != ZOOM_SDK_NAMESPACE::SDKERR_SUCCESS) {
+        std::cerr << "[AUDIO] Failed to register participant events, error: " << err << std::endl;
+    }
+    
+    // Bulk load everyone already in the meeting
+    refreshList(controller_->GetParticipantsList(), true);
+    std::cout << "[AUDIO] Participant directory loaded " << size() << " participants" << std::endl;
+}
+
+void ParticipantDirectory::detach() {
+    if (controller_) {
+        controller_->SetEvent(nullptr);
+        controller_ = nullptr;
+    }
+}
+
+std::shared_ptr<const ParticipantRecord> ParticipantDirectory::find(uint32_t user_id) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = records_.find(user_id);
+    return it != records_.end() ? it->second : nullptr;
+}
+
+std::shared_ptr<const ParticipantRecord> ParticipantDirectory::resolve(uint32_t user_id) {
+    auto record = find(user_id);
+    if (record) return record;
+    
+    // Audio can arrive before the join event; intern a placeholder the event will replace
+    publish(user_id, std::string(), true);
+    return find(user_id);
+}
+
+size_t ParticipantDirectory::size() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return records_.size();
+}
+
+std::string ParticipantDirectory::sanitize(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        if (std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' ) out.push_back(c);
+        else out.push_back('_');
+    }
+    return out;
+}
+
+void ParticipantDirectory::refresh(uint32_t user_id, bool inMeeting) {
+    std::string name;
+    if (controller_) {
+        auto* info = controller_->GetUserByUserID(user_id);
+        if (info && info->GetUserName()) {
+            name = info->GetUserName();
+        }
+    }
+    publish(user_id, name, inMeeting);
+}
+
+void ParticipantDirectory::refreshList(ZOOM_SDK_NAMESPACE::IList<unsigned int>* ids, bool inMeeting) {
+    if (!ids) return;
+    for (int i = 0; i < ids->GetCount(); ++i) {
+        refresh(ids->GetItem(i), inMeeting);
+    }
+}
+
+void ParticipantDirectory::publish(uint32_t user_id, const std::string& name, bool inMeeting) {
+    auto record = std::make_shared<ParticipantRecord>();
+    record->userId = user_id;
+    record->inMeeting = inMeeting;
+    if (!name.empty()) {
+        record->displayName = name;
+        record->sanitizedName = sanitize(name);
+    }
+    
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = records_.find(user_id);
+    if (it != records_.end()) {
+        record->internId = it->second->internId;
+        // The SDK forgets users once they leave; keep the last known name
+        if (name.empty()) {
+            record->displayName = it->second->displayName;
+            record->sanitizedName = it->second->sanitizedName;
+        }
+    } else {
+        record->internId = nextInternId_++;
+    }
+    if (record->displayName.empty()) {
+        record->displayName = "User_" + std::to_string(user_id);
+    }
+    records_[user_id] = std::move(record);
+    version_.fetch_add(1, std::memory_order_release);
+}
+
+void ParticipantDirectory::onUserJoin(ZOOM_SDK_NAMESPACE::IList<unsigned int>* lstUserID, const zchar_t* strUserList) {
+    refreshList(lstUserID, true);
+}
+
+void ParticipantDirectory::onUserLeft(ZOOM_SDK_NAMESPACE::IList<unsigned int>* lstUserID, const zchar_t* strUserList) {
+    refreshList(lstUserID, false);
+}
+
+void ParticipantDirectory::onUserNamesChanged(ZOOM_SDK_NAMESPACE::IList<unsigned int>* lstUserID) {
+    refreshList(lstUserID, true);
+}
+
+// Empty implementations for required virtual functions
+void ParticipantDirectory::onHostChangeNotification(unsigned int userId) {}
+void ParticipantDirectory::onLowOrRaiseHandStatusChanged(bool bLow, unsigned int userid) {}
+void ParticipantDirectory::onCoHostChangeNotification(unsigned int userId, bool isCoHost) {}
+void ParticipantDirectory::onInvalidReclaimHostkey() {}
+void ParticipantDirectory::onAllHandsLowered() {}
+void ParticipantDirectory::onLocalRecordingStatusChanged(unsigned int user_id, ZOOM_SDK_NAMESPACE::RecordingStatus status) {}
+void ParticipantDirectory::onAllowParticipantsRenameNotification(bool bAllow) {}
+void ParticipantDirectory::onAllowParticipantsUnmuteSelfNotification(bool bAllow) {}
+void ParticipantDirectory::onAllowParticipantsStartVideoNotification(bool bAllow) {}
+void ParticipantDirectory::onAllowParticipantsShareWhiteBoardNotification(bool bAllow) {}
+void ParticipantDirectory::onRequestLocalRecordingPrivilegeChanged(ZOOM_SDK_NAMESPACE::LocalRecordingRequestPrivilegeStatus status) {}
+void ParticipantDirectory::onAllowParticipantsRequestCloudRecording(bool bAllow) {}
+void ParticipantDirectory::onInMeetingUserAvatarPathUpdated(unsigned int userID) {}
+void ParticipantDirectory::onParticipantProfilePictureStatusChange(bool bHidden) {}
+void ParticipantDirectory::onFocusModeStateChanged(bool bEnabled) {}
+void ParticipantDirectory::onFocusModeShareTypeChanged(ZOOM_SDK_NAMESPACE::FocusModeShareType type) {}
+void ParticipantDirectory::onRobotRelationChanged(unsigned int authorizeUserID) {}
+void ParticipantDirectory::onVirtualNameTagStatusChanged(bool bOn, unsigned int userID) {}
+void ParticipantDirectory::onVirtualNameTagRosterInfoUpdated(unsigned int userID) {}
+void ParticipantDirectory::onCreateCompanionRelation(unsigned int parentUserID, unsigned int childUserID) {}
+void ParticipantDirectory::onRemoveCompanionRelation(unsigned int childUserID) {}
+
+} // namespace ZoomBot
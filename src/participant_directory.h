@@ -0,0 +1,92 @@
+#pragma once
+
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include "zoom_sdk_def.h"
+#include "meeting_service_components/meeting_participants_ctrl_interface.h"
+
+namespace ZoomBot {
+
+// Immutable snapshot of one participant. A rename publishes a new record,
+// so readers can hold on to the one they have without locking.
+struct ParticipantRecord {
+    uint32_t userId;
+    uint32_t internId;          // compact, dense id assigned on first sight
+    std::string displayName;    // as shown in the meeting ("User_<id>" until known)
+    std::string sanitizedName;  // filesystem-safe form, empty if the name is unknown
+    bool inMeeting;
+};
+
+/**
+ * Participant name cache kept current by SDK participant events.
+ *
+ * Filled in bulk when attached after joining, then updated on join, leave and
+ * rename. Lookups never call into the SDK and never allocate, so they are safe
+ * on the audio hot path.
+ */
+class ParticipantDirectory : public ZOOM_SDK_NAMESPACE::IMeetingParticipantsCtrlEvent {
+public:
+    ParticipantDirectory() = default;
+    ~ParticipantDirectory() override;
+
+    // Register for participant events and load everyone already in the meeting
+    void attach(ZOOM_SDK_NAMESPACE::IMeetingParticipantsController* controller);
+    void detach();
+    bool attached() const { return controller_ != nullptr; }
+
+    // Hot path: returns the current record, or nullptr if the user has not been seen
+    std::shared_ptr<const ParticipantRecord> find(uint32_t user_id) const;
+    // As find(), but interns a placeholder record for users we have no event for yet
+    std::shared_ptr<const ParticipantRecord> resolve(uint32_t user_id);
+
+    // Bumped on every change; lets consumers refresh cached records cheaply
+    uint64_t version() const { return version_.load(std::memory_order_acquire); }
+    size_t size() const;
+
+    static std::string sanitize(const std::string& s);
+
+    // IMeetingParticipantsCtrlEvent
+    void onUserJoin(ZOOM_SDK_NAMESPACE::IList<unsigned int>* lstUserID, const zchar_t* strUserList = nullptr) override;
+    void onUserLeft(ZOOM_SDK_NAMESPACE::IList<unsigned int>* lstUserID, const zchar_t* strUserList = nullptr) override;
+    void onUserNamesChanged(ZOOM_SDK_NAMESPACE::IList<unsigned int>* lstUserID) override;
+    void onHostChangeNotification(unsigned int userId) override;
+    void onLowOrRaiseHandStatusChanged(bool bLow, unsigned int userid) override;
+    void onCoHostChangeNotification(unsigned int userId, bool isCoHost) override;
+    void onInvalidReclaimHostkey() override;
+    void onAllHandsLowered() override;
+    void onLocalRecordingStatusChanged(unsigned int user_id, ZOOM_SDK_NAMESPACE::RecordingStatus status) override;
+    void onAllowParticipantsRenameNotification(bool bAllow) override;
+    void onAllowParticipantsUnmuteSelfNotification(bool bAllow) override;
+    void onAllowParticipantsStartVideoNotification(bool bAllow) override;
+    void onAllowParticipantsShareWhiteBoardNotification(bool bAllow) override;
+    void onRequestLocalRecordingPrivilegeChanged(ZOOM_SDK_NAMESPACE::LocalRecordingRequestPrivilegeStatus status) override;
+    void onAllowParticipantsRequestCloudRecording(bool bAllow) override;
+    void onInMeetingUserAvatarPathUpdated(unsigned int userID) override;
+    void onParticipantProfilePictureStatusChange(bool bHidden) override;
+    void onFocusModeStateChanged(bool bEnabled) override;
+    void onFocusModeShareTypeChanged(ZOOM_SDK_NAMESPACE::FocusModeShareType type) override;
+    void onRobotRelationChanged(unsigned int authorizeUserID) override;
+    void onVirtualNameTagStatusChanged(bool bOn, unsigned int userID) override;
+    void onVirtualNameTagRosterInfoUpdated(unsigned int userID) override;
+    void onCreateCompanionRelation(unsigned int parentUserID, unsigned int childUserID) override;
+    void onRemoveCompanionRelation(unsigned int childUserID) override;
+
+private:
+    ZOOM_SDK_NAMESPACE::IMeetingParticipantsController* controller_ = nullptr; // weak ref
+    mutable std::mutex mtx_;
+    std::unordered_map<uint32_t, std::shared_ptr<const ParticipantRecord>> records_;
+    uint32_t nextInternId_ = 1;   // 0 is reserved for the mixed stream
+    std::atomic<uint64_t> version_{0};
+
+    // Event-thread helpers: query the SDK, then publish under the lock
+    void refresh(uint32_t user_id, bool inMeeting);
+    void refreshList(ZOOM_SDK_NAMESPACE::IList<unsigned int>* ids, bool inMeeting);
+    void publish(uint32_t user_id, const std::string& name, bool inMeeting);
+};
+
+} // namespace ZoomBot
@@ -0,0 +1,108 @@
+#include "pcm_convert.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace ZoomBot {
+
+// Largest chunk handed to one copy_file_range call
+static const size_t kCopyChunk = 1u << 30;
+
+static bool copyReadWrite(int in, int out, off_t inOffset, off_t outOffset, uint64_t remaining) {
+    std::vector<char> buffer(1 << 20);
+    while (remaining > 0) {
+        size_t want = remaining < buffer.size() ? static_cast<size_t>(remaining) : buffer.size();
+        ssize_t n = pread(in, buffer.data(), want, inOffset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        ssize_t done = 0;
+        while (done < n) {
+            ssize_t w = pwrite(out, buffer.data() + done, static_cast<size_t>(n - done), outOffset + done);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) return false;
+            done += w;
+        }
+        inOffset += n;
+        outOffset += n;
+        remaining -= static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+static bool copyData(int in, int out, uint64_t size, ConvertResult& result) {
+    loff_t inOffset = 0;
+    loff_t outOffset = kConvertedDataOffset;
+    uint64_t remaining = size;
+    result.method = CopyMethod::Kernel;
+    while (remaining > 0) {
+        size_t want = remaining < kCopyChunk ? static_cast<size_t>(remaining) : kCopyChunk;
+        ssize_t n = copy_file_range(in, &inOffset, out, &outOffset, want, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+            // Not supported between these files: finish the rest in user space
+            result.method = CopyMethod::ReadWrite;
+            return copyReadWrite(in, out, inOffset, outOffset, remaining);
+        }
+        if (n <= 0) return false;   // error, or the source shrank underneath us
+        remaining -= static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+bool convertPCMToWAV(const std::string& pcmPath, const std::string& wavPath,
+                     const PCMFormat& format, ConvertResult& result) {
+    int in = open(pcmPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        result.error = std::string("cannot open: ") + std::strerror(errno);
+        return false;
+    }
+
+    struct stat st{};
+    if (fstat(in, &st) != 0 || st.st_size == 0) {
+        result.error = "empty file";
+        close(in);
+        return false;
+    }
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+
+    std::string partPath = wavPath + ".part";
+    int out = open(partPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        result.error = std::string("cannot create: ") + std::strerror(errno);
+        close(in);
+        return false;
+    }
+
+    char header[kConvertedDataOffset];
+    // Recordings over 4 GiB come out as RF64
+    makeWAVHeader(header, kConvertedDataOffset, format.sampleRate, format.channels,
+                  format.bitsPerSample, size);
+    bool ok = pwrite(out, header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header)) &&
+              copyData(in, out, size, result);
+    if (!ok) {
+        result.error = std::string("copy failed: ") + std::strerror(errno);
+    }
+
+    close(in);
+    if (close(out) != 0 && ok) {
+        result.error = std::string("close failed: ") + std::strerror(errno);
+        ok = false;
+    }
+    if (ok && rename(partPath.c_str(), wavPath.c_str()) != 0) {
+        result.error = std::string("rename failed: ") + std::strerror(errno);
+        ok = false;
+    }
+    if (!ok) {
+        unlink(partPath.c_str());
+        return false;
+    }
+    result.dataBytes = size;
+    return true;
+}
+
+} // namespace ZoomBot
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include "wav_format.h"
+
+namespace ZoomBot {
+
+// How the audio got into the WAV file
+enum class CopyMethod : uint8_t {
+    Kernel,     // copy_file_range: cloned/reflinked where the filesystem can, else copied in-kernel
+    ReadWrite   // user-space fallback (filesystems without copy_file_range support)
+};
+
+struct ConvertResult {
+    uint64_t dataBytes = 0;
+    CopyMethod method = CopyMethod::Kernel;
+    std::string error;          // empty on success
+};
+
+// Audio starts on a block boundary so copy_file_range can share extents with the source
+static const uint32_t kConvertedDataOffset = 4096;
+
+/**
+ * Wraps a raw .pcm recording in a WAV header without copying it through user space.
+ *
+ * The WAV is written to "<wavPath>.part" and renamed into place once complete,
+ * so an interrupted run never leaves a truncated file behind.
+ */
+bool convertPCMToWAV(const std::string& pcmPath, const std::string& wavPath,
+                     const PCMFormat& format, ConvertResult& result);
+
+} // namespace ZoomBot
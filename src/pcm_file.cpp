@@ -0,0 +1,111 @@
+#include "pcm_file.h"
+#include <algorithm>
+#include <cstring>
+
+namespace ZoomBot {
+
+PCMFile::PCMFile(DiskWriter& writer, const std::string& path, bool allowDirectIO)
+    : writer_(writer), capacity_(writer.config().bufferBytes) {
+    state_ = writer_.open(path, offset_, allowDirectIO);
+}
+
+PCMFile::~PCMFile() {
+    close();
+}
+
+bool PCMFile::good() const {
+    return state_ && !state_->failed.load(std::memory_order_relaxed);
+}
+
+void PCMFile::write(const char* data, size_t len) {
+    if (!state_) return;
+    while (len > 0) {
+        if (!buf_.data) {
+            if (!writer_.takeBuffer(*state_, buf_)) {
+                // Writer is behind by maxBuffersPerFile buffers: drop rather than block capture
+                dropped_ += len;
+                return;
+            }
+        }
+        if (len_ == 0) {
+            pendingSince_ = std::chrono::steady_clock::now();
+        }
+        size_t n = std::min(len, capacity_ - len_);
+        std::memcpy(buf_.data + len_, data, n);
+        len_ += n;
+        data += n;
+        len -= n;
+        if (len_ == capacity_) {
+            seal();
+        }
+    }
+}
+
+void PCMFile::flush() {
+    if (state_ && len_ > 0) {
+        seal();
+    }
+}
+
+void PCMFile::flushIfStale(std::chrono::steady_clock::time_point now) {
+    if (len_ > 0 && now - pendingSince_ >= std::chrono::milliseconds(writer_.config().maxBufferAgeMs)) {
+        seal();
+    }
+}
+
+void PCMFile::patch(uint64_t offset, const void* data, size_t len) {
+    if (!state_) return;
+    DiskWriter::Job job{state_, DiskWriter::Buffer(), 0, offset_, false};
+    setPatch(job, offset, data, len);
+    writer_.submit(std::move(job));
+}
+
+void PCMFile::close(uint64_t patchOffset, const void* patch, size_t patchLen) {
+    if (!state_) return;
+    // Whatever is buffered goes out in full; the writer drops O_DIRECT for this last piece
+    DiskWriter::Job job{state_, buf_, len_, offset_, true};
+    setPatch(job, patchOffset, patch, patchLen);
+    writer_.submit(std::move(job));
+
+    offset_ += len_;
+    buf_ = DiskWriter::Buffer();
+    len_ = 0;
+    closing_ = std::move(state_);
+}
+
+bool PCMFile::closed() const {
+    return !state_ && (!closing_ || closing_->closed.load(std::memory_order_acquire));
+}
+
+void PCMFile::setPatch(DiskWriter::Job& job, uint64_t offset, const void* data, size_t len) {
+    if (!data || len == 0) return;
+    job.patchOffset = offset;
+    job.patchLen = len < DiskWriter::kMaxPatch ? len : DiskWriter::kMaxPatch;
+    std::memcpy(job.patch, data, job.patchLen);
+}
+
+bool PCMFile::seal() {
+    size_t writeLen = len_;
+    if (state_->direct) {
+        // O_DIRECT needs whole blocks; the remainder moves to the next buffer
+        writeLen &= ~(DiskWriter::kBlockSize - 1);
+    }
+    if (writeLen == 0) return false;
+
+    DiskWriter::Buffer next;
+    size_t tail = len_ - writeLen;
+    if (tail > 0) {
+        if (!writer_.takeBuffer(*state_, next)) return false;   // try again once the writer has caught up
+        std::memcpy(next.data, buf_.data + writeLen, tail);
+    }
+
+    // The writer returns buf_ to the pool once it is on disk
+    writer_.submit(DiskWriter::Job{state_, buf_, writeLen, offset_, false});
+
+    offset_ += writeLen;
+    buf_ = next;
+    len_ = tail;
+    return true;
+}
+
+} // namespace ZoomBot
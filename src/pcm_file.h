@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+#include "disk_writer.h"
+
+namespace ZoomBot {
+
+// Appends PCM to a file through the DiskWriter. Owned by a single thread
+// (the capture worker); writes are buffered and never touch the disk directly.
+class PCMFile {
+public:
+    // allowDirectIO=false keeps the file out of O_DIRECT even when the writer uses it,
+    // so every flush reaches the file (small text files such as manifests)
+    PCMFile(DiskWriter& writer, const std::string& path, bool allowDirectIO = true);
+    ~PCMFile();   // close()
+    bool good() const;
+    void write(const char* data, size_t len);
+    // Queue buffered data now / only if the oldest buffered byte exceeds the age limit
+    void flush();
+    void flushIfStale(std::chrono::steady_clock::time_point now);
+    // Overwrite up to DiskWriter::kMaxPatch bytes at offset once everything already
+    // handed to the writer is on disk (keeps file headers current)
+    void patch(uint64_t offset, const void* data, size_t len);
+    // Hand the remaining data to the writer, apply the optional patch after it, then close
+    void close(uint64_t patchOffset = 0, const void* patch = nullptr, size_t patchLen = 0);
+    // True once the writer has finished close(): the file is complete for readers
+    bool closed() const;
+
+    uint64_t size() const { return offset_ + len_; }   // file size once everything is written
+    uint64_t queuedSize() const { return offset_; }    // bytes already handed to the writer
+    DiskWriter& writer() const { return writer_; }
+    // Bytes dropped because the writer fell too far behind
+    uint64_t droppedBytes() const { return dropped_; }
+private:
+    bool seal();
+    static void setPatch(DiskWriter::Job& job, uint64_t offset, const void* data, size_t len);
+
+    DiskWriter& writer_;
+    std::shared_ptr<DiskWriter::FileState> state_;
+    std::shared_ptr<const DiskWriter::FileState> closing_;   // after close(), until the writer is done
+    DiskWriter::Buffer buf_;
+    size_t len_ = 0;
+    size_t capacity_;
+    uint64_t offset_ = 0;                            // file offset of buf_[0]
+    std::chrono::steady_clock::time_point pendingSince_;
+    uint64_t dropped_ = 0;
+};
+
+} // namespace ZoomBot
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace ZoomBot {
+
+// One recording file of a stream, in whichever format the writer config asks
+// for (WavFile, FlacFile). Owned by the capture worker.
+class RecordingFile {
+public:
+    virtual ~RecordingFile() = default;
+
+    virtual bool good() const = 0;
+    virtual void write(const char* data, size_t len) = 0;
+    // Flush policy plus the periodic header update
+    virtual void flushIfStale(std::chrono::steady_clock::time_point now) = 0;
+    // Final header, then close; closed() turns true once the writer has done both
+    virtual void close() = 0;
+    virtual bool closed() const = 0;
+
+    // PCM accepted so far (what segment limits count)
+    virtual uint64_t dataBytes() const = 0;
+    virtual uint64_t droppedBytes() const = 0;
+};
+
+} // namespace ZoomBot
@@ -0,0 +1,68 @@
+#include "segment_manifest.h"
+#include <iostream>
+
+namespace ZoomBot {
+
+SegmentManifest::SegmentManifest(DiskWriter& writer, const std::string& path)
+    : writer_(writer), path_(path) {}
+
+void SegmentManifest::add(std::unique_ptr<RecordingFile> segment, const SegmentRecord& record) {
+    segment->close();
+    pending_.push_back(Pending{std::move(segment), record});
+}
+
+void SegmentManifest::poll() {
+    if (pending_.empty()) return;
+
+    // Segments of different streams finish independently; keep the rest waiting
+    size_t kept = 0;
+    bool wrote = false;
+    for (size_t i = 0; i < pending_.size(); ++i) {
+        if (pending_[i].file->closed()) {
+            append(pending_[i].record);
+            wrote = true;
+        } else {
+            if (kept != i) pending_[kept] = std::move(pending_[i]);
+            ++kept;
+        }
+    }
+    pending_.resize(kept);
+
+    // Lines are rare and small: hand them to the writer right away
+    if (wrote && file_) {
+        file_->flush();
+    }
+}
+
+void SegmentManifest::append(const SegmentRecord& record) {
+    if (!file_) {
+        // Not O_DIRECT: a line must not wait in memory for a full block
+        file_.reset(new PCMFile(writer_, path_, false));
+        if (!file_->good()) {
+            std::cerr << "[AUDIO] Failed to open segment manifest " << path_ << std::endl;
+        }
+    }
+
+    // Names come from sanitized display names and never need JSON escaping
+    line_.clear();
+    line_ += "{\"stream\":\"";
+    line_ += record.stream;
+    line_ += "\",\"segment\":";
+    line_ += std::to_string(record.index);
+    line_ += ",\"file\":\"";
+    line_ += record.file;
+    line_ += "\",\"sample_rate\":";
+    line_ += std::to_string(record.sampleRate);
+    line_ += ",\"channels\":";
+    line_ += std::to_string(record.channels);
+    line_ += ",\"start_sample\":";
+    line_ += std::to_string(record.startSample);
+    line_ += ",\"samples\":";
+    line_ += std::to_string(record.samples);
+    line_ += ",\"start_time_ms\":";
+    line_ += std::to_string(record.startTimeMs);
+    line_ += "}\n";
+    file_->write(line_.data(), line_.size());
+}
+
+} // namespace ZoomBot
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "pcm_file.h"
+#include "recording_file.h"
+
+namespace ZoomBot {
+
+// One finished segment of a stream, as listed in the manifest
+struct SegmentRecord {
+    std::string stream;         // name shared by all segments of a stream, e.g. mixed_32000Hz_1ch
+    std::string file;           // segment file name, relative to the manifest
+    uint32_t index = 0;         // 1-based
+    uint32_t sampleRate = 0;
+    uint16_t channels = 0;
+    uint64_t startSample = 0;   // first sample of the segment within the stream's recorded audio
+    uint64_t samples = 0;
+    int64_t startTimeMs = 0;    // capture time of the segment's first frame (unix ms)
+};
+
+/**
+ * manifest.jsonl next to the recordings: one JSON line per finished segment.
+ *
+ * A line is written only after the writer has closed its segment with the
+ * final header, so a job following the manifest during the meeting can
+ * process every file it lists. Owned by the capture worker, like PCMFile.
+ */
+class SegmentManifest {
+public:
+    SegmentManifest(DiskWriter& writer, const std::string& path);
+
+    // Close the segment; its line follows once the file is complete on disk
+    void add(std::unique_ptr<RecordingFile> segment, const SegmentRecord& record);
+    // Write the lines of segments whose close has completed
+    void poll();
+    size_t pending() const { return pending_.size(); }
+
+private:
+    struct Pending {
+        std::unique_ptr<RecordingFile> file;
+        SegmentRecord record;
+    };
+
+    void append(const SegmentRecord& record);
+
+    DiskWriter& writer_;
+    std::string path_;
+    std::unique_ptr<PCMFile> file_;     // opened with the first line
+    std::vector<Pending> pending_;
+    std::string line_;                  // reused formatting buffer
+};
+
+} // namespace ZoomBot
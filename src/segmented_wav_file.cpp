@@ -0,0 +1,137 @@
+#include "segmented_wav_file.h"
+#include "wav_file.h"
+#include "flac_file.h"
+#include <cstdio>
+#include <iostream>
+
+namespace ZoomBot {
+
+SegmentedWavFile::SegmentedWavFile(DiskWriter& writer, SegmentManifest* manifest, FlacEncodePool* flac,
+                                   SilenceLog* silence, const std::string& basePath, uint32_t sampleRate,
+                                   uint16_t channels, uint16_t bitsPerSample)
+    : writer_(writer), manifest_(manifest), flac_(flac), silence_(silence), basePath_(basePath),
+      sampleRate_(sampleRate), channels_(channels), bitsPerSample_(bitsPerSample) {
+    size_t slash = basePath_.find_last_of('/');
+    streamName_ = slash == std::string::npos ? basePath_ : basePath_.substr(slash + 1);
+    blockAlign_ = channels_ * (bitsPerSample_ / 8u);
+    if (blockAlign_ == 0) blockAlign_ = 1;
+
+    // The tighter of the two limits wins; segments hold whole sample frames
+    const DiskWriterConfig& config = writer_.config();
+    uint64_t timeBytes = static_cast<uint64_t>(config.segmentSeconds) * sampleRate_ * blockAlign_;
+    limitBytes_ = timeBytes;
+    if (config.segmentBytes > 0 && (limitBytes_ == 0 || config.segmentBytes < limitBytes_)) {
+        limitBytes_ = config.segmentBytes;
+    }
+    if (limitBytes_ > 0) {
+        limitBytes_ -= limitBytes_ % blockAlign_;
+        if (limitBytes_ == 0) limitBytes_ = blockAlign_;
+    }
+
+    openSegment();
+}
+
+SegmentedWavFile::~SegmentedWavFile() {
+    close();
+}
+
+void SegmentedWavFile::write(const char* data, size_t len, int64_t captureTimeMs) {
+    if (gapSamples_ > 0) {
+        logGap();
+    }
+    if (current_ && limitBytes_ > 0 && current_->dataBytes() > 0 && current_->dataBytes() + len > limitBytes_) {
+        finishSegment();
+    }
+    if (!current_ && !openSegment()) {
+        droppedBytes_ += len;
+        return;
+    }
+    if (current_->dataBytes() == 0) {
+        startTimeMs_ = captureTimeMs;
+    }
+    current_->write(data, len);
+}
+
+void SegmentedWavFile::gap(uint64_t samples, int64_t captureTimeMs) {
+    if (!silence_) return;
+    if (gapSamples_ == 0) {
+        gapTimeMs_ = captureTimeMs;
+    }
+    gapSamples_ += samples;
+}
+
+void SegmentedWavFile::logGap() {
+    SilenceRecord record;
+    record.stream = streamName_;
+    record.startSample = startSample_ + (current_ ? current_->dataBytes() / blockAlign_ : 0);
+    record.samples = gapSamples_;
+    record.startTimeMs = gapTimeMs_;
+    silence_->add(record);
+    gapSamples_ = 0;
+}
+
+void SegmentedWavFile::flushIfStale(std::chrono::steady_clock::time_point now) {
+    if (current_) {
+        current_->flushIfStale(now);
+    }
+}
+
+void SegmentedWavFile::close() {
+    if (gapSamples_ > 0) {
+        logGap();
+    }
+    if (current_) {
+        finishSegment();
+    }
+}
+
+bool SegmentedWavFile::openSegment() {
+    if (openFailed_) return false;
+
+    const char* extension = flac_ ? "flac" : "wav";
+    if (limitBytes_ > 0) {
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), "_seg%04u.%s", index_ + 1, extension);
+        path_ = basePath_ + suffix;
+    } else {
+        path_ = basePath_ + "." + extension;
+    }
+
+    std::unique_ptr<RecordingFile> file;
+    if (flac_) {
+        file.reset(new FlacFile(*flac_, writer_, path_, sampleRate_, channels_));
+    } else {
+        file.reset(new WavFile(writer_, path_, sampleRate_, channels_, bitsPerSample_));
+    }
+    if (!file->good()) {
+        // Do not retry on every frame; the stream's audio is counted as dropped from here on
+        std::cerr << "[AUDIO] Failed to open " << extension << " file for writing: " << path_ << std::endl;
+        openFailed_ = true;
+        return false;
+    }
+    current_ = std::move(file);
+    ++index_;
+    return true;
+}
+
+void SegmentedWavFile::finishSegment() {
+    uint64_t samples = current_->dataBytes() / blockAlign_;
+    droppedBytes_ += current_->droppedBytes();
+
+    if (manifest_ && limitBytes_ > 0) {
+        SegmentRecord record;
+        record.stream = streamName_;
+        record.file = path_.substr(path_.find_last_of('/') + 1);
+        record.index = index_;
+        record.sampleRate = sampleRate_;
+        record.channels = channels_;
+        record.startSample = startSample_;
+        record.samples = samples;
+        record.startTimeMs = startTimeMs_;
+        manifest_->add(std::move(current_), record);
+    }
+    current_.reset();   // unlisted files close here
+    startSample_ += samples;
+}
+
+} // namespace ZoomBot
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+#include "recording_file.h"
+#include "segment_manifest.h"
+#include "silence_log.h"
+
+namespace ZoomBot {
+
+class FlacEncodePool;
+
+/**
+ * A stream's recording, split into numbered segments when the writer config
+ * sets segmentSeconds or segmentBytes, one file otherwise. Files are WAV, or
+ * FLAC when the config asks for it (segment limits count the PCM either way).
+ *
+ * Segments end on frame boundaries, before the frame that would exceed the
+ * limit. Each finished segment goes to the manifest with its sample offset,
+ * so downstream jobs can pick it up while the meeting is still running.
+ * Silence the voice-activity gate held back isn't written; it goes to the
+ * silence log at the same sample offsets, one line per stretch.
+ */
+class SegmentedWavFile {
+public:
+    // basePath has no extension: segments are <basePath>_seg0001.wav, ...; unsplit, <basePath>.wav
+    // (.flac for FLAC). manifest may be null when segments are off; flac is required for FLAC;
+    // silence may be null when nothing is gated.
+    SegmentedWavFile(DiskWriter& writer, SegmentManifest* manifest, FlacEncodePool* flac, SilenceLog* silence,
+                     const std::string& basePath, uint32_t sampleRate, uint16_t channels,
+                     uint16_t bitsPerSample = 16);
+    ~SegmentedWavFile();   // close()
+
+    bool good() const { return current_ && current_->good(); }
+    const std::string& path() const { return path_; }   // current segment
+    void write(const char* data, size_t len, int64_t captureTimeMs);
+    // Gated silence: samples per channel, left out of the file and logged where they belong
+    void gap(uint64_t samples, int64_t captureTimeMs);
+    void flushIfStale(std::chrono::steady_clock::time_point now);
+    // Finish the current segment; the next write starts a new one (or reopens the unsplit file)
+    void close();
+
+    uint64_t droppedBytes() const { return droppedBytes_ + (current_ ? current_->droppedBytes() : 0); }
+
+private:
+    bool openSegment();
+    void finishSegment();
+    void logGap();
+
+    DiskWriter& writer_;
+    SegmentManifest* manifest_;
+    FlacEncodePool* flac_;              // null: WAV
+    SilenceLog* silence_;
+    std::string basePath_;
+    std::string streamName_;            // basePath without the directory
+    std::string path_;
+    uint32_t sampleRate_;
+    uint16_t channels_;
+    uint16_t bitsPerSample_;
+    uint32_t blockAlign_;
+    uint64_t limitBytes_ = 0;           // audio bytes per segment, 0 = unsplit
+
+    std::unique_ptr<RecordingFile> current_;
+    uint32_t index_ = 0;
+    uint64_t startSample_ = 0;          // of the current segment
+    int64_t startTimeMs_ = 0;
+    uint64_t droppedBytes_ = 0;         // in finished segments, or while no file could be opened
+    bool openFailed_ = false;
+    // Consecutive markers make one line, written when audio resumes or the file closes
+    uint64_t gapSamples_ = 0;
+    int64_t gapTimeMs_ = 0;
+};
+
+} // namespace ZoomBot
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace ZoomBot {
+
+/**
+ * Layout of the shared-memory ring between the bot and a co-located reader
+ * (ShmRingStreamingBackend, stream_reader.cpp, audio_processor.py --shm).
+ *
+ * The bot creates a memfd and hands it to the reader over a Unix socket
+ * together with two eventfds: "data" (the bot wrote records) and "space" (the
+ * reader consumed some). The first page is the header; the data area follows.
+ *
+ * head and tail count bytes since the ring was created, so head - tail is
+ * what is unread and the offset of a position is position % capacity. The
+ * bot only writes head, the reader only writes tail; each publishes with a
+ * release store after the bytes it covers are written (or done with).
+ *
+ * A record is a u32 length (host byte order), then that many bytes of
+ * complete v2 wire messages (stream_protocol.h), padded to 8 bytes. A record
+ * never wraps: if it doesn't fit before the end of the data area, a length of
+ * kShmRingWrap says the rest of the area is skipped.
+ */
+static const char kShmRingMagic[8] = {'Z', 'B', 'O', 'T', 'R', 'I', 'N', 'G'};
+static const uint32_t kShmRingVersion = 1;
+static const uint32_t kShmRingWrap = 0xFFFFFFFF;
+static const size_t kShmRingDataOffset = 4096;
+
+struct ShmRingHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t data_offset;                   // from the start of the mapping
+    uint64_t capacity;                      // bytes in the data area, a multiple of 8
+    alignas(64) std::atomic<uint64_t> head; // written by the bot
+    alignas(64) std::atomic<uint64_t> tail; // written by the reader
+};
+
+// Fixed offsets, so readers in other languages can find them
+static const size_t kShmRingHeadOffset = 64;
+static const size_t kShmRingTailOffset = 128;
+
+inline size_t shmRingRecordSize(size_t length) {
+    return (4 + length + 7) & ~static_cast<size_t>(7);
+}
+
+} // namespace ZoomBot
@@ -0,0 +1,44 @@
+#include "silence_log.h"
+#include <iostream>
+
+namespace ZoomBot {
+
+SilenceLog::SilenceLog(DiskWriter& writer, const std::string& path)
+    : writer_(writer), path_(path) {}
+
+void SilenceLog::add(const SilenceRecord& record) {
+    if (!file_) {
+        // Not O_DIRECT: lines are small and must not wait in memory for a full block
+        file_.reset(new PCMFile(writer_, path_, false));
+        if (!file_->good()) {
+            std::cerr << "[AUDIO] Failed to open silence log " << path_ << std::endl;
+        }
+    }
+
+    // Stream names come from sanitized display names and never need JSON escaping
+    line_.clear();
+    line_ += "{\"stream\":\"";
+    line_ += record.stream;
+    line_ += "\",\"start_sample\":";
+    line_ += std::to_string(record.startSample);
+    line_ += ",\"samples\":";
+    line_ += std::to_string(record.samples);
+    line_ += ",\"start_time_ms\":";
+    line_ += std::to_string(record.startTimeMs);
+    line_ += "}\n";
+    file_->write(line_.data(), line_.size());
+}
+
+void SilenceLog::flushIfStale(std::chrono::steady_clock::time_point now) {
+    if (file_) {
+        file_->flushIfStale(now);
+    }
+}
+
+void SilenceLog::flush() {
+    if (file_) {
+        file_->flush();
+    }
+}
+
+} // namespace ZoomBot
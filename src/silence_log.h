@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+
+#include "pcm_file.h"
+
+namespace ZoomBot {
+
+// A stretch of a stream the voice-activity gate left out of its recording
+struct SilenceRecord {
+    std::string stream;         // as in the segment manifest, e.g. user_16778240_Alice_32000Hz_1ch
+    uint64_t startSample = 0;   // the silence goes before this sample of the stream's recorded audio
+    uint64_t samples = 0;       // per channel
+    int64_t startTimeMs = 0;    // capture time of its first frame (unix ms)
+};
+
+/**
+ * silence.jsonl next to the recordings: one JSON line per gated stretch, so
+ * the recorded audio can be put back on the meeting's timeline by inserting
+ * the silence. Lines follow the recording's flush policy. Owned by the
+ * capture worker, like PCMFile.
+ */
+class SilenceLog {
+public:
+    SilenceLog(DiskWriter& writer, const std::string& path);
+
+    void add(const SilenceRecord& record);
+    void flushIfStale(std::chrono::steady_clock::time_point now);
+    // Hand everything written so far to the writer
+    void flush();
+
+private:
+    DiskWriter& writer_;
+    std::string path_;
+    std::unique_ptr<PCMFile> file_;     // opened with the first line
+    std::string line_;                  // reused formatting buffer
+};
+
+} // namespace ZoomBot
@@ -0,0 +1,89 @@
+#include "spill_log.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+
+namespace ZoomBot {
+
+SpillLog::~SpillLog() {
+    clear();
+}
+
+void SpillLog::configure(const std::string& directory, uint64_t segmentBytes) {
+    clear();
+    directory_ = directory;
+    segmentBytes_ = segmentBytes;
+}
+
+bool SpillLog::openSegment(uint64_t base) {
+    int fd = -1;
+#ifdef O_TMPFILE
+    fd = open(directory_.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+#endif
+    if (fd < 0) {
+        // Filesystems without O_TMPFILE: create a name and drop it at once
+        std::string path = directory_ + "/zoombot-spill-XXXXXX";
+        fd = mkostemp(&path[0], O_CLOEXEC);
+        if (fd < 0) return false;
+        unlink(path.c_str());
+    }
+    segments_.push_back({fd, base});
+    return true;
+}
+
+bool SpillLog::append(const char* data, size_t len, uint64_t& offset) {
+    // Records never straddle segments, so releasing one never cuts a record short
+    if (segments_.empty() || end_ + len > segments_.back().base + segmentBytes_) {
+        if (!openSegment(end_)) return false;
+    }
+    const Segment& segment = segments_.back();
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pwrite(segment.fd, data + done, len - done, static_cast<off_t>(end_ - segment.base + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (n == 0) errno = ENOSPC;
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    offset = end_;
+    end_ += len;
+    return true;
+}
+
+bool SpillLog::read(uint64_t offset, char* out, size_t len) const {
+    for (size_t i = segments_.size(); i-- > 0;) {
+        const Segment& segment = segments_[i];
+        if (segment.base > offset) continue;
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = pread(segment.fd, out + done, len - done, static_cast<off_t>(offset - segment.base + done));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    }
+    return false;
+}
+
+void SpillLog::release(uint64_t offset) {
+    // A segment can go once the next one starts at or before offset; the last one once all is released
+    while (!segments_.empty()) {
+        bool done = segments_.size() > 1 ? segments_[1].base <= offset : end_ <= offset;
+        if (!done) break;
+        close(segments_.front().fd);
+        segments_.erase(segments_.begin());
+    }
+}
+
+void SpillLog::clear() {
+    for (const Segment& segment : segments_) {
+        close(segment.fd);
+    }
+    segments_.clear();
+}
+
+} // namespace ZoomBot
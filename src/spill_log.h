@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ZoomBot {
+
+/**
+ * Append-only log for streamed audio that doesn't fit in memory while the
+ * receiver is away or behind.
+ *
+ * Records go into fixed-size segments, each an anonymous file in the spill
+ * directory (O_TMPFILE, or unlinked right after creation), so nothing is left
+ * on disk if the process dies. Offsets are global and only grow; segments are
+ * closed from the front once everything before an offset is released. Owned
+ * by a single thread.
+ */
+class SpillLog {
+public:
+    SpillLog() = default;
+    ~SpillLog();
+
+    SpillLog(const SpillLog&) = delete;
+    SpillLog& operator=(const SpillLog&) = delete;
+
+    // Nothing is created until the first append
+    void configure(const std::string& directory, uint64_t segmentBytes);
+    const std::string& directory() const { return directory_; }
+
+    // False if the data could not be written (errno is set); offset is where it went otherwise
+    bool append(const char* data, size_t len, uint64_t& offset);
+    bool read(uint64_t offset, char* out, size_t len) const;
+    // Records before offset are no longer needed
+    void release(uint64_t offset);
+    void clear();
+
+    uint64_t diskBytes() const { return segments_.empty() ? 0 : end_ - segments_.front().base; }
+
+private:
+    struct Segment {
+        int fd;
+        uint64_t base;
+    };
+
+    bool openSegment(uint64_t base);
+
+    std::string directory_ = "/tmp";
+    uint64_t segmentBytes_ = 64ull << 20;
+    std::vector<Segment> segments_;   // oldest first
+    uint64_t end_ = 0;                // offset of the next record
+};
+
+} // namespace ZoomBot
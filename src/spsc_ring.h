@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace ZoomBot {
+
+/**
+ * Bounded single-producer/single-consumer ring buffer.
+ *
+ * The producer side never blocks and never allocates: when the ring is full
+ * the push fails and the overflow counter is bumped instead. Slots are
+ * constructed up front so they can be reused in place (see acquire/publish).
+ */
+template <typename T>
+class SPSCRing {
+public:
+    explicit SPSCRing(size_t capacity)
+        : slots_(roundUpPow2(capacity)), mask_(slots_.size() - 1) {}
+
+    SPSCRing(const SPSCRing&) = delete;
+    SPSCRing& operator=(const SPSCRing&) = delete;
+
+    // Producer: returns the next free slot, or nullptr (and counts an overflow) if full.
+    // The slot becomes visible to the consumer only after publish().
+    T* acquire() {
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        if (head - tailCache_ >= slots_.size()) {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            if (head - tailCache_ >= slots_.size()) {
+                overflows_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        return &slots_[head & mask_];
+    }
+
+    void publish() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        pushed_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool tryPush(T&& value) {
+        T* slot = acquire();
+        if (!slot) return false;
+        *slot = std::move(value);
+        publish();
+        return true;
+    }
+
+    // Consumer: peek at the oldest published slot, or nullptr if empty.
+    T* front() {
+        const uint64_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == headCache_) {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail == headCache_) return nullptr;
+        }
+        return &slots_[tail & mask_];
+    }
+
+    void pop() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool tryPop(T& out) {
+        T* slot = front();
+        if (!slot) return false;
+        out = std::move(*slot);
+        pop();
+        return true;
+    }
+
+    size_t capacity() const { return slots_.size(); }
+    size_t size() const {
+        return static_cast<size_t>(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+    }
+    bool empty() const { return size() == 0; }
+
+    // Counters (safe to read from any thread)
+    uint64_t pushedCount() const { return pushed_.load(std::memory_order_relaxed); }
+    uint64_t overflowCount() const { return overflows_.load(std::memory_order_relaxed); }
+
+private:
+    static size_t roundUpPow2(size_t n) {
+        size_t p = 2;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    std::vector<T> slots_;
+    const size_t mask_;
+
+    // Producer and consumer indices live on separate cache lines to avoid false sharing
+    alignas(64) std::atomic<uint64_t> head_{0};
+    uint64_t tailCache_ = 0;                  // producer's last view of tail_
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    uint64_t headCache_ = 0;                  // consumer's last view of head_
+
+    alignas(64) std::atomic<uint64_t> pushed_{0};
+    std::atomic<uint64_t> overflows_{0};
+};
+
+} // namespace ZoomBot
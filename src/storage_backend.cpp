@@ -0,0 +1,118 @@
+#include "storage_backend.h"
+#include "io_uring_backend.h"
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+
+namespace ZoomBot {
+
+// Upper bound on buffers merged into one pwritev call
+static const size_t kMaxIovecs = 64;
+
+const char* storageBackendName(StorageBackendType type) {
+    switch (type) {
+        case StorageBackendType::Posix: return "posix";
+        case StorageBackendType::IoUring: return "io_uring";
+    }
+    return "unknown";
+}
+
+StorageBackendType parseStorageBackend(const std::string& name) {
+    if (name == "io_uring" || name == "uring") return StorageBackendType::IoUring;
+    return StorageBackendType::Posix;
+}
+
+// Plain pwritev/fdatasync. Adjacent buffers of the same file go out in one call.
+class PosixStorageBackend : public StorageBackend {
+public:
+    const char* name() const override { return "posix"; }
+
+    uint64_t write(WriteOp* ops, size_t count) override {
+        order_.resize(count);
+        for (size_t i = 0; i < count; ++i) order_[i] = i;
+        std::stable_sort(order_.begin(), order_.end(), [ops](size_t a, size_t b) {
+            return ops[a].fd != ops[b].fd ? ops[a].fd < ops[b].fd : ops[a].offset < ops[b].offset;
+        });
+
+        uint64_t calls = 0;
+        size_t i = 0;
+        while (i < count) {
+            WriteOp& first = ops[order_[i]];
+            size_t n = 1;
+            uint64_t end = first.offset + first.len;
+            while (i + n < count && n < kMaxIovecs) {
+                const WriteOp& next = ops[order_[i + n]];
+                if (next.fd != first.fd || next.offset != end) break;
+                end += next.len;
+                ++n;
+            }
+            int result = writeRun(&order_[i], ops, n, calls);
+            for (size_t k = 0; k < n; ++k) {
+                ops[order_[i + k]].result = result;
+            }
+            i += n;
+        }
+        return calls;
+    }
+
+    uint64_t sync(const int* fds, size_t count) override {
+        for (size_t i = 0; i < count; ++i) {
+            fdatasync(fds[i]);
+        }
+        return count;
+    }
+
+private:
+    std::vector<size_t> order_;
+
+    static int writeRun(const size_t* idx, const WriteOp* ops, size_t count, uint64_t& calls) {
+        struct iovec iov[kMaxIovecs];
+        for (size_t k = 0; k < count; ++k) {
+            iov[k].iov_base = const_cast<char*>(ops[idx[k]].data);
+            iov[k].iov_len = ops[idx[k]].len;
+        }
+
+        struct iovec* cur = iov;
+        int left = static_cast<int>(count);
+        int fd = ops[idx[0]].fd;
+        off_t offset = static_cast<off_t>(ops[idx[0]].offset);
+        while (left > 0) {
+            ssize_t n = pwritev(fd, cur, left, offset);
+            ++calls;
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return -errno;
+            }
+            offset += n;
+
+            // Short write: skip what went out and retry the rest
+            size_t done = static_cast<size_t>(n);
+            while (left > 0 && done >= cur->iov_len) {
+                done -= cur->iov_len;
+                ++cur;
+                --left;
+            }
+            if (left > 0) {
+                cur->iov_base = static_cast<char*>(cur->iov_base) + done;
+                cur->iov_len -= done;
+            }
+        }
+        return 0;
+    }
+};
+
+std::unique_ptr<StorageBackend> createStorageBackend(StorageBackendType type, unsigned queueDepth) {
+    if (type == StorageBackendType::IoUring) {
+        auto ring = IoUringStorageBackend::create(queueDepth);
+        if (ring) {
+            return ring;
+        }
+        std::cerr << "[AUDIO] io_uring not available, recordings use pwritev" << std::endl;
+    }
+    return std::unique_ptr<StorageBackend>(new PosixStorageBackend());
+}
+
+} // namespace ZoomBot
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ZoomBot {
+
+enum class StorageBackendType : uint8_t {
+    Posix,      // pwritev from the writer thread
+    IoUring     // one io_uring for every file, registered buffers
+};
+
+const char* storageBackendName(StorageBackendType type);
+// "posix" / "io_uring"; anything else maps to Posix
+StorageBackendType parseStorageBackend(const std::string& name);
+
+// One buffer to write at an absolute file offset. slab is the buffer's
+// arena index (see StorageBackend::addSlab). result is filled in by the
+// backend: 0 once every byte is written, -errno otherwise.
+struct WriteOp {
+    int fd;
+    const char* data;
+    size_t len;
+    uint64_t offset;
+    uint32_t slab;
+    int result;
+};
+
+/**
+ * How the DiskWriter thread gets bytes to disk.
+ *
+ * Only the writer thread calls write()/sync(); addSlab() may come from any
+ * thread. Both calls block until every operation has completed, and return
+ * the number of system calls they took so the writer can report it.
+ */
+class StorageBackend {
+public:
+    virtual ~StorageBackend() = default;
+    virtual const char* name() const = 0;
+
+    // Buffer memory the DiskWriter will hand out from now on
+    virtual void addSlab(uint32_t index, char* base, size_t len) { (void)index; (void)base; (void)len; }
+
+    virtual uint64_t write(WriteOp* ops, size_t count) = 0;
+    virtual uint64_t sync(const int* fds, size_t count) = 0;
+};
+
+// Falls back to Posix (with a log line) if the requested backend is not available here
+std::unique_ptr<StorageBackend> createStorageBackend(StorageBackendType type, unsigned queueDepth);
+
+} // namespace ZoomBot
@@ -0,0 +1,205 @@
+#include "stream_protocol.h"
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstring>
+
+namespace ZoomBot {
+
+static const char kWireMagic[4] = {'Z', 'B', 'O', 'T'};
+
+static void put16(char* p, uint16_t v) { v = htons(v); std::memcpy(p, &v, 2); }
+static void put32(char* p, uint32_t v) { v = htonl(v); std::memcpy(p, &v, 4); }
+static uint16_t get16(const char* p) { uint16_t v; std::memcpy(&v, p, 2); return ntohs(v); }
+static uint32_t get32(const char* p) { uint32_t v; std::memcpy(&v, p, 4); return ntohl(v); }
+static void put64(char* p, uint64_t v) {
+    put32(p, static_cast<uint32_t>(v >> 32));
+    put32(p + 4, static_cast<uint32_t>(v));
+}
+
+static void encodePrefix(char* out, uint8_t type, uint16_t streamId, uint32_t bodyLength) {
+    out[0] = static_cast<char>(type);
+    out[1] = 0;     // flags
+    put16(out + 2, streamId);
+    put32(out + 4, bodyLength);
+}
+
+const char* streamProtocolName(StreamProtocol protocol) {
+    switch (protocol) {
+        case StreamProtocol::Binary: return "binary";
+        case StreamProtocol::Json: return "json";
+    }
+    return "unknown";
+}
+
+const char* wireSampleFormatName(uint8_t format) {
+    switch (format) {
+        case kWirePcmS16LE: return "pcm_s16le";
+        case kWireOpus: return "opus";
+    }
+    return "unknown";
+}
+
+void encodeWireHello(char* out, uint16_t flags) {
+    std::memcpy(out, kWireMagic, 4);
+    put16(out + 4, kWireVersion);
+    put16(out + 6, flags);
+}
+
+bool decodeWireHello(const char* in, uint16_t& version, uint16_t& flags) {
+    if (std::memcmp(in, kWireMagic, 4) != 0) return false;
+    version = get16(in + 4);
+    flags = get16(in + 6);
+    return true;
+}
+
+void appendWireStreamDeclare(std::string& out, uint16_t streamId, uint32_t userId,
+                             uint32_t sampleRate, uint16_t channels, uint8_t format, const std::string& name) {
+    char fixed[kWireDeclareFixedSize];
+    encodePrefix(fixed, kWireStreamDeclare, streamId, static_cast<uint32_t>(12 + name.size()));
+    put32(fixed + 8, userId);
+    put32(fixed + 12, sampleRate);
+    put16(fixed + 16, channels);
+    fixed[18] = static_cast<char>(format);
+    fixed[19] = 0;
+    out.append(fixed, sizeof(fixed));
+    out += name;
+}
+
+void encodeWireAudioHeader(char* out, uint16_t streamId, uint32_t sequence,
+                           uint64_t captureTimeMs, uint32_t length) {
+    encodePrefix(out, kWireAudio, streamId, 12 + length);
+    put32(out + 8, sequence);
+    put64(out + 12, captureTimeMs);
+}
+
+void encodeWireSilence(char* out, uint16_t streamId, uint32_t sequence, uint64_t captureTimeMs, uint32_t samples) {
+    encodePrefix(out, kWireSilence, streamId, 16);
+    put32(out + 8, sequence);
+    put64(out + 12, captureTimeMs);
+    put32(out + 20, samples);
+}
+
+void encodeWireDropped(char* out, uint16_t streamId, uint32_t firstSequence, uint32_t count,
+                       uint8_t reason, uint8_t priority) {
+    encodePrefix(out, kWireDropped, streamId, 12);
+    put32(out + 8, firstSequence);
+    put32(out + 12, count);
+    out[16] = static_cast<char>(reason);
+    out[17] = static_cast<char>(priority);
+    put16(out + 18, 0);
+}
+
+void decodeWirePrefix(const char* in, uint8_t& type, uint16_t& streamId, uint32_t& bodyLength) {
+    type = static_cast<uint8_t>(in[0]);
+    streamId = get16(in + 2);
+    bodyLength = get32(in + 4);
+}
+
+bool decodeWireStreamDeclare(const char* body, size_t len, uint32_t& userId, uint32_t& sampleRate,
+                             uint16_t& channels, uint8_t& format, std::string& name) {
+    if (len < kWireDeclareFixedSize - kWirePrefixSize) return false;
+    userId = get32(body);
+    sampleRate = get32(body + 4);
+    channels = get16(body + 8);
+    format = static_cast<uint8_t>(body[10]);
+    name.assign(body + 12, len - 12);
+    return true;
+}
+
+bool decodeWireAudioHeader(const char* body, size_t len, uint32_t& sequence, uint64_t& captureTimeMs) {
+    if (len < kWireAudioHeaderSize - kWirePrefixSize) return false;
+    sequence = get32(body);
+    captureTimeMs = static_cast<uint64_t>(get32(body + 4)) << 32 | get32(body + 8);
+    return true;
+}
+
+bool decodeWireDropped(const char* body, size_t len, uint32_t& firstSequence, uint32_t& count,
+                       uint8_t& reason, uint8_t& priority) {
+    if (len < kWireDroppedSize - kWirePrefixSize) return false;
+    firstSequence = get32(body);
+    count = get32(body + 4);
+    reason = static_cast<uint8_t>(body[8]);
+    priority = static_cast<uint8_t>(body[9]);
+    return true;
+}
+
+bool decodeWireSilence(const char* body, size_t len, uint32_t& sequence, uint64_t& captureTimeMs, uint32_t& samples) {
+    if (len < kWireSilenceSize - kWirePrefixSize) return false;
+    sequence = get32(body);
+    captureTimeMs = static_cast<uint64_t>(get32(body + 4)) << 32 | get32(body + 8);
+    samples = get32(body + 12);
+    return true;
+}
+
+void encodeWireCredit(char* out, uint16_t streamId, uint32_t bytes) {
+    encodePrefix(out, kWireCredit, streamId, 4);
+    put32(out + 8, bytes);
+}
+
+void encodeWireAck(char* out, uint16_t streamId, uint32_t nextSequence) {
+    encodePrefix(out, kWireAck, streamId, 4);
+    put32(out + 8, nextSequence);
+}
+
+bool decodeWireCredit(const char* in, uint16_t& streamId, uint32_t& bytes) {
+    if (static_cast<uint8_t>(in[0]) != kWireCredit || get32(in + 4) != 4) return false;
+    streamId = get16(in + 2);
+    bytes = get32(in + 8);
+    return true;
+}
+
+bool decodeWireAck(const char* in, uint16_t& streamId, uint32_t& nextSequence) {
+    if (static_cast<uint8_t>(in[0]) != kWireAck || get32(in + 4) != 4) return false;
+    streamId = get16(in + 2);
+    nextSequence = get32(in + 8);
+    return true;
+}
+
+static void appendNumber(std::string& out, long long value) {
+    char buf[24];
+    int n = snprintf(buf, sizeof(buf), "%lld", value);
+    out.append(buf, n);
+}
+
+static void appendJsonString(std::string& out, const std::string& value) {
+    out += '"';
+    for (char c : value) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char esc[8];
+                    snprintf(esc, sizeof(esc), "\\u%04x", static_cast<unsigned char>(c));
+                    out += esc;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+void formatJsonAudioHeader(std::string& out, uint32_t userId, const std::string& userName,
+                           uint32_t sampleRate, uint16_t channels, uint8_t format, long long timestampMs) {
+    // Formatted into a reused buffer instead of building a json object
+    out.clear();
+    out += "{\"type\":\"audio_header\",\"user_id\":";
+    appendNumber(out, userId);
+    out += ",\"user_name\":";
+    appendJsonString(out, userName);
+    out += ",\"sample_rate\":";
+    appendNumber(out, sampleRate);
+    out += ",\"channels\":";
+    appendNumber(out, channels);
+    out += ",\"format\":\"";
+    out += wireSampleFormatName(format);
+    out += "\",\"timestamp\":";
+    appendNumber(out, timestampMs);
+    out += "}";
+}
+
+} // namespace ZoomBot
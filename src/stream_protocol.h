@@ -0,0 +1,129 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace ZoomBot {
+
+/**
+ * Wire format between the bot and the audio processing service.
+ *
+ * Binary (v2, default): the client opens with a hello and the server answers
+ * with the version it accepts. Every message then starts with an 8-byte
+ * prefix (type, flags, stream id, body length). A stream's metadata is
+ * declared once per connection; audio frames only carry its id, a per-stream
+ * sequence number and the capture time. All integers are network byte order.
+ *
+ *   hello      "ZBOT" u16 version u16 flags
+ *   prefix     u8 type  u8 flags  u16 stream_id  u32 body_len
+ *   declare    u32 user_id  u32 sample_rate  u16 channels  u8 format  u8 reserved  name (utf-8, rest of body)
+ *   audio      u32 sequence  u64 capture_time_ms  data (rest of body: pcm, or one Opus packet)
+ *   dropped    u32 first_sequence  u32 count  u8 reason  u8 priority  u16 reserved
+ *   credit     u32 bytes                                  (receiver to bot)
+ *   ack        u32 next_sequence                          (receiver to bot)
+ *   silence    u32 sequence  u64 capture_time_ms  u32 samples
+ *
+ * A silence message takes the place of audio the voice-activity gate held
+ * back (ZOOM_BOT_VAD): the stream was silent for samples (per channel, at the
+ * declared rate) from capture_time_ms on. It uses up a sequence number like
+ * audio, so receivers keep their timeline by inserting that much silence.
+ *
+ * A dropped notice precedes the stream's next audio message when the bot gave
+ * up frames on purpose (shed under backpressure, or the receiver was away),
+ * so the receiver can tell those gaps from losses.
+ *
+ * Flow control: a hello with kWireHelloCredits asks for credits. A receiver
+ * that sets the flag in its answer follows the hello with a credit for
+ * kWireAllStreams, the window every stream starts each connection with, and
+ * then grants each stream more bytes as it consumes them.
+ *
+ * Replay: a hello with kWireHelloAcks asks the receiver to acknowledge audio.
+ * A receiver that sets the flag in its answer sends, per stream, the sequence
+ * number of the first frame it has not processed yet. The bot keeps every
+ * frame until then and sends the unacknowledged ones again after a reconnect,
+ * so the receiver can see duplicates and discards them by sequence number.
+ * Positions only carry over to a connection whose hello has kWireHelloResume;
+ * without it the bot is a new process and its sequence numbers start over.
+ *
+ * Json (compat): per chunk a length-prefixed JSON header, then length-prefixed PCM.
+ */
+enum class StreamProtocol : uint8_t { Binary, Json };
+
+const char* streamProtocolName(StreamProtocol protocol);
+
+static const uint16_t kWireVersion = 2;
+static const size_t kWireHelloSize = 8;
+static const size_t kWirePrefixSize = 8;
+static const size_t kWireAudioHeaderSize = kWirePrefixSize + 12;
+static const size_t kWireDeclareFixedSize = kWirePrefixSize + 12;
+static const size_t kWireDroppedSize = kWirePrefixSize + 12;
+static const size_t kWireCreditSize = kWirePrefixSize + 4;
+static const size_t kWireAckSize = kWirePrefixSize + 4;
+static const size_t kWireSilenceSize = kWirePrefixSize + 16;
+
+// Hello flags
+static const uint16_t kWireHelloCredits = 0x0001;
+static const uint16_t kWireHelloAcks = 0x0002;
+static const uint16_t kWireHelloResume = 0x0004;   // sequence numbers continue from an earlier connection
+// Credit stream id for the initial window of every stream; never declared, so ids end at 0xFFFE
+static const uint16_t kWireAllStreams = 0xFFFF;
+
+enum WireMessageType : uint8_t {
+    kWireStreamDeclare = 1,
+    kWireAudio = 2,
+    kWireDropped = 3,
+    kWireCredit = 4,
+    kWireAck = 5,
+    kWireSilence = 6
+};
+
+enum WireSampleFormat : uint8_t {
+    kWirePcmS16LE = 1,
+    kWireOpus = 2       // sample_rate is what the packets decode to
+};
+
+// "pcm_s16le", "opus" (also the format names in JSON headers)
+const char* wireSampleFormatName(uint8_t format);
+
+void encodeWireHello(char* out, uint16_t flags = 0);
+// Returns false if in is not a hello
+bool decodeWireHello(const char* in, uint16_t& version, uint16_t& flags);
+// Appends a complete declare message to out
+void appendWireStreamDeclare(std::string& out, uint16_t streamId, uint32_t userId,
+                             uint32_t sampleRate, uint16_t channels, uint8_t format, const std::string& name);
+// Fixed-size header of an audio message carrying length bytes of PCM
+void encodeWireAudioHeader(char* out, uint16_t streamId, uint32_t sequence,
+                           uint64_t captureTimeMs, uint32_t length);
+
+void encodeWireSilence(char* out, uint16_t streamId, uint32_t sequence, uint64_t captureTimeMs, uint32_t samples);
+
+// Notice for count frames starting at firstSequence; reason and priority are the
+// numeric DropReason and StreamPriority (audio_streamer.h)
+void encodeWireDropped(char* out, uint16_t streamId, uint32_t firstSequence, uint32_t count,
+                       uint8_t reason, uint8_t priority);
+
+// Decoders for readers (the reference reader in stream_reader.cpp). Bodies are
+// what follows the prefix; false if one is too short for its message.
+void decodeWirePrefix(const char* in, uint8_t& type, uint16_t& streamId, uint32_t& bodyLength);
+bool decodeWireStreamDeclare(const char* body, size_t len, uint32_t& userId, uint32_t& sampleRate,
+                             uint16_t& channels, uint8_t& format, std::string& name);
+bool decodeWireAudioHeader(const char* body, size_t len, uint32_t& sequence, uint64_t& captureTimeMs);
+bool decodeWireDropped(const char* body, size_t len, uint32_t& firstSequence, uint32_t& count,
+                       uint8_t& reason, uint8_t& priority);
+bool decodeWireSilence(const char* body, size_t len, uint32_t& sequence, uint64_t& captureTimeMs, uint32_t& samples);
+
+// Receiver side of flow control and replay: kWireCreditSize and kWireAckSize bytes
+void encodeWireCredit(char* out, uint16_t streamId, uint32_t bytes);
+void encodeWireAck(char* out, uint16_t streamId, uint32_t nextSequence);
+
+// Returns false if in is not a credit message
+bool decodeWireCredit(const char* in, uint16_t& streamId, uint32_t& bytes);
+// Returns false if in is not an ack
+bool decodeWireAck(const char* in, uint16_t& streamId, uint32_t& nextSequence);
+
+// Json compat mode: the per-chunk header object, formatted into out
+void formatJsonAudioHeader(std::string& out, uint32_t userId, const std::string& userName,
+                           uint32_t sampleRate, uint16_t channels, uint8_t format, long long timestampMs);
+
+} // namespace ZoomBot
@@ -0,0 +1,367 @@
+// Reference reader for the local streaming backends. Listens on a Unix socket
+// path, takes one bot connection at a time and consumes the v2 messages it
+// sends, either as SOCK_SEQPACKET packets (unix:) or from the shared-memory
+// ring the bot hands over (shm:, layout in shm_ring.h). Prints per-stream
+// counts; useful as a sink for testing and as a template for C++ processors.
+//
+// Usage: stream_reader <unix|shm> <socket_path> [report_seconds=5]
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "stream_protocol.h"
+#include "shm_ring.h"
+
+using namespace ZoomBot;
+
+namespace {
+    std::atomic<bool> g_stop{false};
+
+    void onSignal(int) { g_stop.store(true); }
+
+    struct StreamStats {
+        uint32_t userId = 0;
+        std::string name;
+        uint32_t sampleRate = 0;
+        uint16_t channels = 0;
+        uint8_t format = 0;
+        uint32_t nextSequence = 0;
+        bool started = false;
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        uint64_t dropped = 0;    // announced by the bot
+        uint64_t lost = 0;       // gaps nobody announced
+        uint64_t silentSamples = 0;   // gated by the bot's voice-activity gate
+    };
+
+    struct Session {
+        std::map<uint16_t, StreamStats> streams;
+        uint64_t messages = 0;
+        uint64_t errors = 0;
+    };
+
+    void report(const Session& session, const char* when) {
+        uint64_t frames = 0, bytes = 0, dropped = 0, lost = 0;
+        for (const auto& entry : session.streams) {
+            frames += entry.second.frames;
+            bytes += entry.second.bytes;
+            dropped += entry.second.dropped;
+            lost += entry.second.lost;
+        }
+        std::cout << "[READER] " << when << ": " << session.streams.size() << " streams, " << frames << " frames, "
+                  << std::fixed << std::setprecision(1) << bytes / (1024.0 * 1024.0) << " MB, " << dropped
+                  << " dropped, " << lost << " lost, " << session.errors << " bad messages" << std::endl;
+    }
+
+    void reportStreams(const Session& session) {
+        for (const auto& entry : session.streams) {
+            const StreamStats& s = entry.second;
+            std::cout << "[READER]   stream " << entry.first << " user " << s.userId << " (" << s.name << ", "
+                      << s.sampleRate << " Hz, " << s.channels << " ch, " << wireSampleFormatName(s.format) << "): "
+                      << s.frames << " frames, " << std::fixed << std::setprecision(1)
+                      << (s.sampleRate > 0 ? static_cast<double>(s.silentSamples) / s.sampleRate : 0.0) << " s silent, "
+                      << s.dropped << " dropped, " << s.lost << " lost" << std::endl;
+        }
+    }
+
+    // Consumes the complete messages in [data, data + len)
+    void handleMessages(Session& session, const char* data, size_t len) {
+        while (len >= kWirePrefixSize) {
+            uint8_t type;
+            uint16_t streamId;
+            uint32_t bodyLength;
+            decodeWirePrefix(data, type, streamId, bodyLength);
+            if (bodyLength > len - kWirePrefixSize) {
+                session.errors++;
+                return;
+            }
+            const char* body = data + kWirePrefixSize;
+            session.messages++;
+
+            if (type == kWireStreamDeclare) {
+                StreamStats& s = session.streams[streamId];
+                std::string name;
+                if (!decodeWireStreamDeclare(body, bodyLength, s.userId, s.sampleRate, s.channels, s.format, name)) {
+                    session.errors++;
+                } else if (name != s.name) {
+                    s.name = name;
+                    std::cout << "[READER] Stream " << streamId << ": user " << s.userId << " (" << s.name << "), "
+                              << s.sampleRate << " Hz, " << s.channels << " ch, " << wireSampleFormatName(s.format) << std::endl;
+                }
+            } else if (type == kWireAudio) {
+                uint32_t sequence;
+                uint64_t captureTimeMs;
+                auto it = session.streams.find(streamId);
+                if (it == session.streams.end() || !decodeWireAudioHeader(body, bodyLength, sequence, captureTimeMs)) {
+                    session.errors++;
+                } else {
+                    StreamStats& s = it->second;
+                    if (s.started && sequence != s.nextSequence) {
+                        s.lost += static_cast<uint32_t>(sequence - s.nextSequence);
+                    }
+                    s.started = true;
+                    s.nextSequence = sequence + 1;
+                    s.frames++;
+                    s.bytes += bodyLength - (kWireAudioHeaderSize - kWirePrefixSize);
+                }
+            } else if (type == kWireSilence) {
+                uint32_t sequence, samples;
+                uint64_t captureTimeMs;
+                auto it = session.streams.find(streamId);
+                if (it == session.streams.end() || !decodeWireSilence(body, bodyLength, sequence, captureTimeMs, samples)) {
+                    session.errors++;
+                } else {
+                    // Takes a sequence number like audio; a processor would insert the silence here
+                    StreamStats& s = it->second;
+                    if (s.started && sequence != s.nextSequence) {
+                        s.lost += static_cast<uint32_t>(sequence - s.nextSequence);
+                    }
+                    s.started = true;
+                    s.nextSequence = sequence + 1;
+                    s.silentSamples += samples;
+                }
+            } else if (type == kWireDropped) {
+                uint32_t first, count;
+                uint8_t reason, priority;
+                auto it = session.streams.find(streamId);
+                if (it == session.streams.end() || !decodeWireDropped(body, bodyLength, first, count, reason, priority)) {
+                    session.errors++;
+                } else {
+                    // The announced frames are not a loss; the stream continues after them
+                    StreamStats& s = it->second;
+                    s.dropped += count;
+                    s.started = true;
+                    s.nextSequence = first + count;
+                }
+            }
+            // Unknown types are skipped, as the protocol allows
+            data = body + bodyLength;
+            len -= kWirePrefixSize + bodyLength;
+        }
+        if (len > 0) {
+            session.errors++;
+        }
+    }
+
+    int listenOn(const std::string& path) {
+        struct sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            std::cerr << "Socket path too long: " << path << std::endl;
+            return -1;
+        }
+        int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            std::cerr << "socket: " << std::strerror(errno) << std::endl;
+            return -1;
+        }
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.c_str(), path.size());
+        unlink(path.c_str());   // left over from an earlier run
+        if (bind(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, 4) < 0) {
+            std::cerr << "Cannot listen on " << path << ": " << std::strerror(errno) << std::endl;
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // Receives the bot's hello (and the descriptors sent with it) and answers it
+    bool acceptHello(int fd, int* fds, size_t& fd_count) {
+        char hello[kWireHelloSize];
+        struct iovec iov{hello, sizeof(hello)};
+        char control[CMSG_SPACE(sizeof(int) * 4)] = {};
+        struct msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+
+        fd_count = 0;
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                fd_count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                memcpy(fds, CMSG_DATA(cmsg), fd_count * sizeof(int));
+            }
+        }
+
+        uint16_t version = 0, flags = 0;
+        if (n != static_cast<ssize_t>(sizeof(hello)) || !decodeWireHello(hello, version, flags) || version != kWireVersion) {
+            std::cerr << "[READER] Not a v" << kWireVersion << " hello, closing" << std::endl;
+            return false;
+        }
+        // No credits, acks or resume over local transports
+        char reply[kWireHelloSize];
+        encodeWireHello(reply, 0);
+        return send(fd, reply, sizeof(reply), MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(reply));
+    }
+
+    void serveSeqpacket(int fd, Session& session, int report_seconds) {
+        std::vector<char> packet(1 << 20);
+        auto next_report = std::chrono::steady_clock::now() + std::chrono::seconds(report_seconds);
+        while (!g_stop.load()) {
+            struct pollfd pfd{fd, POLLIN, 0};
+            if (poll(&pfd, 1, 500) > 0) {
+                ssize_t n = recv(fd, packet.data(), packet.size(), 0);
+                if (n == 0 || (n < 0 && errno != EINTR && errno != EAGAIN)) {
+                    return;
+                }
+                if (n > 0) {
+                    handleMessages(session, packet.data(), static_cast<size_t>(n));
+                }
+            }
+            if (std::chrono::steady_clock::now() >= next_report) {
+                report(session, "Running");
+                next_report += std::chrono::seconds(report_seconds);
+            }
+        }
+    }
+
+    void serveShmRing(int fd, const int* fds, Session& session, int report_seconds) {
+        int memfd = fds[0], data_fd = fds[1], space_fd = fds[2];
+        struct stat st{};
+        if (fstat(memfd, &st) != 0 || static_cast<size_t>(st.st_size) <= kShmRingDataOffset) {
+            std::cerr << "[READER] Bad ring" << std::endl;
+            return;
+        }
+        size_t size = static_cast<size_t>(st.st_size);
+        void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+        if (mapping == MAP_FAILED) {
+            std::cerr << "[READER] mmap: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        auto* header = static_cast<ShmRingHeader*>(mapping);
+        if (memcmp(header->magic, kShmRingMagic, sizeof(kShmRingMagic)) != 0 || header->version != kShmRingVersion ||
+            header->data_offset + header->capacity > size) {
+            std::cerr << "[READER] Unknown ring layout" << std::endl;
+            munmap(mapping, size);
+            return;
+        }
+        const char* data = static_cast<const char*>(mapping) + header->data_offset;
+        uint64_t capacity = header->capacity;
+        uint64_t tail = header->tail.load(std::memory_order_relaxed);
+        std::cout << "[READER] Ring of " << capacity / 1024 << " KB mapped" << std::endl;
+
+        auto next_report = std::chrono::steady_clock::now() + std::chrono::seconds(report_seconds);
+        while (!g_stop.load()) {
+            struct pollfd pfds[2] = {{data_fd, POLLIN, 0}, {fd, POLLIN, 0}};
+            if (poll(pfds, 2, 500) > 0) {
+                if (pfds[0].revents & POLLIN) {
+                    uint64_t value;
+                    ssize_t n = read(data_fd, &value, sizeof(value));
+                    (void)n;
+                }
+                // Drain what is there, then hand the space back
+                uint64_t head = header->head.load(std::memory_order_acquire);
+                bool consumed = tail != head;
+                while (tail != head) {
+                    size_t offset = static_cast<size_t>(tail % capacity);
+                    uint32_t length;
+                    memcpy(&length, data + offset, sizeof(length));
+                    if (length == kShmRingWrap) {
+                        tail += capacity - offset;
+                        continue;
+                    }
+                    handleMessages(session, data + offset + 4, length);
+                    tail += shmRingRecordSize(length);
+                }
+                if (consumed) {
+                    header->tail.store(tail, std::memory_order_release);
+                    uint64_t one = 1;
+                    ssize_t n = write(space_fd, &one, sizeof(one));
+                    (void)n;
+                }
+                // The bot only closes the control socket
+                if (pfds[1].revents & (POLLIN | POLLHUP)) {
+                    char byte;
+                    if (recv(fd, &byte, 1, MSG_DONTWAIT) <= 0 && errno != EAGAIN) {
+                        break;
+                    }
+                }
+            }
+            if (std::chrono::steady_clock::now() >= next_report) {
+                report(session, "Running");
+                next_report += std::chrono::seconds(report_seconds);
+            }
+        }
+        munmap(mapping, size);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3 || (std::string(argv[1]) != "unix" && std::string(argv[1]) != "shm")) {
+        std::cerr << "Usage: " << argv[0] << " <unix|shm> <socket_path> [report_seconds=5]" << std::endl;
+        return 1;
+    }
+    bool shm = std::string(argv[1]) == "shm";
+    std::string path = argv[2];
+    int report_seconds = argc > 3 ? std::max(1, std::atoi(argv[3])) : 5;
+
+    struct sigaction action{};
+    action.sa_handler = onSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    int listen_fd = listenOn(path);
+    if (listen_fd < 0) {
+        return 1;
+    }
+    std::cout << "[READER] Waiting for the bot on " << path << " (" << argv[1] << ")" << std::endl;
+
+    Session total;
+    while (!g_stop.load()) {
+        struct pollfd pfd{listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 500) <= 0) {
+            continue;
+        }
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        int fds[4] = {-1, -1, -1, -1};
+        size_t fd_count = 0;
+        if (acceptHello(fd, fds, fd_count) && (!shm || fd_count == 3)) {
+            std::cout << "[READER] Bot connected" << std::endl;
+            Session session;
+            if (shm) {
+                serveShmRing(fd, fds, session, report_seconds);
+            } else {
+                serveSeqpacket(fd, session, report_seconds);
+            }
+            report(session, "Disconnected");
+            reportStreams(session);
+            total.messages += session.messages;
+            total.errors += session.errors;
+            for (const auto& entry : session.streams) {
+                StreamStats& s = total.streams[static_cast<uint16_t>(total.streams.size())];
+                s = entry.second;
+            }
+        } else if (shm) {
+            std::cerr << "[READER] Expected a ring and two eventfds with the hello" << std::endl;
+        }
+        for (size_t i = 0; i < fd_count; ++i) {
+            close(fds[i]);
+        }
+        close(fd);
+    }
+
+    report(total, "Total");
+    close(listen_fd);
+    unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "stream_registry.h"
+
+namespace ZoomBot {
+
+const char* streamKindName(StreamKind kind) {
+    switch (kind) {
+        case StreamKind::Mixed: return "mixed";
+        case StreamKind::User: return "user";
+        case StreamKind::Share: return "share";
+        case StreamKind::Interpreter: return "interpreter";
+    }
+    return "unknown";
+}
+
+StreamRegistry::StreamRegistry(size_t ringDepth) : ringDepth_(ringDepth) {}
+
+CaptureStream* StreamRegistry::find(const StreamKey& key) {
+    auto& index = index_[static_cast<size_t>(key.kind)];
+    auto it = index.find(key);
+    return it != index.end() ? it->second : nullptr;
+}
+
+CaptureStream* StreamRegistry::create(const StreamKey& key, const std::string& fileTag, const std::string& name,
+                                      std::shared_ptr<const ParticipantRecord> participant) {
+    auto stream = std::make_shared<CaptureStream>(key, fileTag, name, ringDepth_);
+    stream->participant = std::move(participant);
+    index_[static_cast<size_t>(key.kind)][key] = stream.get();
+    
+    std::lock_guard<std::mutex> lk(mtx_);
+    streams_.push_back(stream);
+    generation_++;
+    return stream.get();
+}
+
+uint32_t StreamRegistry::internLanguage(const std::string& language) {
+    auto it = languages_.find(language);
+    if (it != languages_.end()) return it->second;
+    uint32_t id = static_cast<uint32_t>(languages_.size()) + 1;
+    languages_.emplace(language, id);
+    return id;
+}
+
+bool StreamRegistry::snapshot(std::vector<std::shared_ptr<CaptureStream>>& out, uint64_t& generation) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (generation == generation_) return false;
+    out = streams_;
+    generation = generation_;
+    return true;
+}
+
+std::vector<StreamStatsSnapshot> StreamRegistry::stats() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    std::vector<StreamStatsSnapshot> out;
+    out.reserve(streams_.size());
+    for (const auto& stream : streams_) {
+        StreamStatsSnapshot snap;
+        snap.key = stream->key;
+        snap.name = stream->displayName;
+        snap.frames = stream->stats.frames.load(std::memory_order_relaxed);
+        snap.bytes = stream->stats.bytes.load(std::memory_order_relaxed);
+        snap.overflows = stream->ring.overflowCount();
+        snap.streamDrops = stream->streamDrops.load(std::memory_order_relaxed);
+        snap.firstTimestampMs = stream->stats.firstTimestampMs.load(std::memory_order_relaxed);
+        snap.lastTimestampMs = stream->stats.lastTimestampMs.load(std::memory_order_relaxed);
+        out.push_back(std::move(snap));
+    }
+    return out;
+}
+
+void StreamRegistry::clear() {
+    for (auto& index : index_) {
+        index.clear();
+    }
+    languages_.clear();
+    
+    std::lock_guard<std::mutex> lk(mtx_);
+    streams_.clear();
+    generation_++;
+}
+
+} // namespace ZoomBot
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+#include "spsc_ring.h"
+#include "audio_frame.h"
+#include "segmented_wav_file.h"
+#include "voice_activity.h"
+#include "participant_directory.h"
+
+namespace ZoomBot {
+
+enum class StreamKind : uint8_t { Mixed, User, Share, Interpreter };
+
+const char* streamKindName(StreamKind kind);
+
+// Identifies one recorded stream. id is the user id for User/Share streams, the
+// interned language id for Interpreter streams and 0 for the mixed stream.
+// A format change opens a new stream rather than mixing rates in one file.
+struct StreamKey {
+    StreamKind kind;
+    uint32_t id;
+    uint32_t sampleRate;
+    uint16_t channels;
+
+    bool operator==(const StreamKey& other) const {
+        return kind == other.kind && id == other.id && sampleRate == other.sampleRate && channels == other.channels;
+    }
+};
+
+// Everything but the kind, for the per-kind indexes; keys compare in full, so no format aliases another
+struct StreamKeyHash {
+    size_t operator()(const StreamKey& key) const {
+        return std::hash<uint64_t>()(((static_cast<uint64_t>(key.id) << 32) | key.sampleRate) * 31 + key.channels);
+    }
+};
+
+// Counters written by the producer only; readable from any thread
+struct StreamStats {
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<int64_t> firstTimestampMs{0};
+    std::atomic<int64_t> lastTimestampMs{0};
+};
+
+struct StreamStatsSnapshot {
+    StreamKey key;
+    std::string name;
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t overflows;
+    uint64_t streamDrops;
+    int64_t firstTimestampMs;
+    int64_t lastTimestampMs;
+};
+
+// Capture state for one audio stream. The SDK callback is the single producer
+// into ring; the capture worker is the single consumer and owns file.
+// Ring slots hold references to SDK-owned frames, not copies.
+struct CaptureStream {
+    CaptureStream(const StreamKey& k, const std::string& tag, const std::string& name, size_t depth)
+        : key(k), fileTag(tag), displayName(name), ring(depth) {}
+
+    StreamKey key;
+    std::string fileTag;        // language used in interpreter filenames
+    std::string displayName;    // name at creation; immutable, safe to read from any thread
+    SPSCRing<AudioFrameRef> ring;
+    StreamStats stats;
+    std::atomic<uint64_t> streamDrops{0};   // frames the streamer's queue had no room for (capture worker)
+
+    // Consumer-side state from here on.
+    // Per-participant streams follow the directory record, so renames show up mid-meeting
+    std::shared_ptr<const ParticipantRecord> participant;
+    uint64_t directoryVersion = 0;
+    std::shared_ptr<const std::string> currentName;  // handed to the streamer without copying
+
+    // Opened on the first frame; the current segment is closed when the capture
+    // worker stops, and the next frame after a restart starts a new one
+    std::unique_ptr<SegmentedWavFile> file;
+    bool openFailed = false;
+    uint64_t reportedOverflows = 0;
+    uint64_t reportedDiskDrops = 0;
+    bool spoke = false;             // lastSpeechMs is valid
+    int64_t lastSpeechMs = 0;       // capture time of the last frame with speech, for streaming priority
+    // Participant streams with ZOOM_BOT_VAD: frames pass through the gate first
+    std::unique_ptr<VoiceActivityGate> gate;
+    std::vector<AudioFrameRef> released;    // what the gate let out, reused
+};
+
+/**
+ * Registry of every capture stream, keyed by (kind, id, format).
+ *
+ * Producer lookups go through one index per kind. Each kind is fed by exactly
+ * one SDK callback, so lookups are lock-free; only creating a stream and
+ * taking a consumer snapshot touch the mutex.
+ */
+class StreamRegistry {
+public:
+    explicit StreamRegistry(size_t ringDepth);
+
+    // Producer side
+    CaptureStream* find(const StreamKey& key);
+    CaptureStream* create(const StreamKey& key, const std::string& fileTag, const std::string& name,
+                          std::shared_ptr<const ParticipantRecord> participant = nullptr);
+    uint32_t internLanguage(const std::string& language);   // interpreter callback only
+
+    // Consumer side: refreshes out if streams were added since generation
+    bool snapshot(std::vector<std::shared_ptr<CaptureStream>>& out, uint64_t& generation) const;
+    std::vector<StreamStatsSnapshot> stats() const;
+
+    // Only once callbacks have stopped and the consumer is gone
+    void clear();
+
+private:
+    size_t ringDepth_;
+    std::unordered_map<StreamKey, CaptureStream*, StreamKeyHash> index_[4];
+    std::unordered_map<std::string, uint32_t> languages_;
+
+    mutable std::mutex mtx_;
+    std::vector<std::shared_ptr<CaptureStream>> streams_;
+    uint64_t generation_ = 0;
+};
+
+} // namespace ZoomBot
@@ -0,0 +1,423 @@
+// Verifies that FLAC recordings decode to exactly the PCM that was written:
+// mono and stereo, short blocks from stale flushes, a resumed file, and the
+// silence that stands in for blocks dropped while the encoder was behind.
+// The decoder below is independent of flac_format.cpp and covers what a FLAC
+// decoder needs for these files (constant, verbatim and fixed subframes, Rice
+// residuals, the stereo decorrelation modes), checking both CRCs of every frame.
+// Build target: test_flac_roundtrip
+//
+// Usage: test_flac_roundtrip [dir]   (default: a temporary directory, removed afterwards)
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "flac_file.h"
+#include "flac_format.h"
+#include "disk_writer.h"
+
+using namespace ZoomBot;
+
+namespace {
+    class BitReader {
+    public:
+        BitReader(const uint8_t* data, size_t len) : data_(data), len_(len) {}
+
+        bool ok() const { return ok_; }
+        size_t bytePos() const { return pos_ / 8; }
+
+        uint32_t bits(unsigned n) {
+            uint32_t value = 0;
+            for (unsigned i = 0; i < n; ++i) {
+                if (pos_ >= len_ * 8) {
+                    ok_ = false;
+                    return 0;
+                }
+                value = (value << 1) | ((data_[pos_ / 8] >> (7 - pos_ % 8)) & 1u);
+                ++pos_;
+            }
+            return value;
+        }
+
+        int32_t signedBits(unsigned n) {
+            uint32_t value = bits(n);
+            return n == 0 ? 0 : static_cast<int32_t>(value << (32 - n)) >> (32 - n);
+        }
+
+        int32_t rice(unsigned k) {
+            uint32_t q = 0;
+            while (ok_ && bits(1) == 0) ++q;
+            uint32_t u = (q << k) | bits(k);
+            return static_cast<int32_t>(u >> 1) ^ -static_cast<int32_t>(u & 1);
+        }
+
+        void align() { pos_ = (pos_ + 7) & ~size_t(7); }
+
+    private:
+        const uint8_t* data_;
+        size_t len_;
+        size_t pos_ = 0;
+        bool ok_ = true;
+    };
+
+    uint8_t crc8(const uint8_t* p, size_t n) {
+        uint8_t crc = 0;
+        for (size_t i = 0; i < n; ++i) {
+            crc ^= p[i];
+            for (int b = 0; b < 8; ++b) crc = static_cast<uint8_t>(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+        }
+        return crc;
+    }
+
+    uint16_t crc16(const uint8_t* p, size_t n) {
+        uint16_t crc = 0;
+        for (size_t i = 0; i < n; ++i) {
+            crc ^= static_cast<uint16_t>(p[i] << 8);
+            for (int b = 0; b < 8; ++b) crc = static_cast<uint16_t>(crc & 0x8000 ? (crc << 1) ^ 0x8005 : crc << 1);
+        }
+        return crc;
+    }
+
+    bool decodeSubframe(BitReader& br, uint32_t n, unsigned bps, std::vector<int32_t>& x, std::string& error) {
+        x.assign(n, 0);
+        if (br.bits(1) != 0) { error = "subframe padding bit set"; return false; }
+        uint32_t type = br.bits(6);
+        if (br.bits(1) != 0) { error = "wasted bits"; return false; }
+        if (type == 0) {
+            int32_t value = br.signedBits(bps);
+            for (uint32_t i = 0; i < n; ++i) x[i] = value;
+            return true;
+        }
+        if (type == 1) {
+            for (uint32_t i = 0; i < n; ++i) x[i] = br.signedBits(bps);
+            return true;
+        }
+        if (type < 8 || type > 12) { error = "subframe type " + std::to_string(type); return false; }
+
+        uint32_t order = type - 8;
+        for (uint32_t i = 0; i < order; ++i) x[i] = br.signedBits(bps);
+        uint32_t method = br.bits(2);
+        if (method > 1) { error = "residual coding method"; return false; }
+        unsigned paramBits = method == 0 ? 4 : 5;
+        uint32_t escape = method == 0 ? 0xF : 0x1F;
+        uint32_t partitionOrder = br.bits(4);
+        uint32_t partitions = 1u << partitionOrder;
+        uint32_t i = order;
+        for (uint32_t p = 0; p < partitions; ++p) {
+            uint32_t count = (n >> partitionOrder) - (p == 0 ? order : 0);
+            uint32_t k = br.bits(paramBits);
+            if (k == escape) {
+                unsigned raw = br.bits(5);
+                for (uint32_t j = 0; j < count; ++j) x[i++] = br.signedBits(raw);
+            } else {
+                for (uint32_t j = 0; j < count; ++j) x[i++] = br.rice(k);
+            }
+        }
+        // Residuals to samples
+        for (uint32_t s = order; s < n; ++s) {
+            int64_t prediction = 0;
+            switch (order) {
+                case 1: prediction = x[s - 1]; break;
+                case 2: prediction = 2ll * x[s - 1] - x[s - 2]; break;
+                case 3: prediction = 3ll * x[s - 1] - 3ll * x[s - 2] + x[s - 3]; break;
+                case 4: prediction = 4ll * x[s - 1] - 6ll * x[s - 2] + 4ll * x[s - 3] - x[s - 4]; break;
+                default: break;
+            }
+            x[s] = static_cast<int32_t>(x[s] + prediction);
+        }
+        return br.ok();
+    }
+
+    struct Decoded {
+        FLACStreamInfo info;
+        std::vector<FLACSeekPoint> points;
+        std::vector<int16_t> pcm;               // interleaved
+        std::vector<uint64_t> frameOffsets;     // from the first frame
+        std::vector<uint64_t> frameSamples;     // first sample of each frame
+    };
+
+    bool decodeFile(const std::string& path, Decoded& out, std::string& error) {
+        std::ifstream in(path, std::ios::binary);
+        std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (!parseFLACHeader(reinterpret_cast<const char*>(file.data()), file.size(), out.info, out.points)) {
+            error = "no FLAC header";
+            return false;
+        }
+        const uint16_t channels = out.info.channels;
+        size_t pos = kFLACHeaderSize;
+        uint64_t expectedSample = 0;
+        std::vector<int32_t> sub[2];
+        while (pos < file.size()) {
+            BitReader br(file.data() + pos, file.size() - pos);
+            if (br.bits(15) != 0x7FFC) { error = "lost frame sync at " + std::to_string(pos); return false; }
+            if (br.bits(1) != 1) { error = "fixed block size numbering"; return false; }
+            uint32_t blockCode = br.bits(4);
+            uint32_t rateCode = br.bits(4);
+            uint32_t assignment = br.bits(4);
+            uint32_t sizeCode = br.bits(3);
+            br.bits(1);
+            if (sizeCode != 4) { error = "not 16 bits per sample"; return false; }
+
+            // Sample number, UTF-8 style
+            uint32_t lead = br.bits(8);
+            uint64_t sample = lead;
+            int extra = 0;
+            while (extra < 7 && (lead << extra) & 0x80) ++extra;
+            if (extra > 0) {
+                sample = lead & (0x7F >> extra);
+                for (int i = 1; i < extra; ++i) sample = (sample << 6) | (br.bits(8) & 0x3F);
+            }
+            uint32_t samples = 0;
+            if (blockCode == 6) samples = br.bits(8) + 1;
+            else if (blockCode == 7) samples = br.bits(16) + 1;
+            else if (blockCode >= 8) samples = 256u << (blockCode - 8);
+            else if (blockCode >= 2) samples = 576u << (blockCode - 2);
+            else { error = "block size code " + std::to_string(blockCode); return false; }
+            if (rateCode == 12) br.bits(8);
+            else if (rateCode == 13 || rateCode == 14) br.bits(16);
+            size_t headerLen = br.bytePos();
+            if (br.bits(8) != crc8(file.data() + pos, headerLen)) { error = "frame header CRC"; return false; }
+            if (sample != expectedSample) {
+                error = "frame starts at sample " + std::to_string(sample) + ", expected " + std::to_string(expectedSample);
+                return false;
+            }
+
+            uint32_t subframes = assignment < 8 ? assignment + 1 : 2;
+            if (subframes != channels) { error = "channel assignment"; return false; }
+            for (uint32_t c = 0; c < subframes; ++c) {
+                // The side channel has one more bit
+                bool side = (assignment == 8 && c == 1) || (assignment == 9 && c == 0) || (assignment == 10 && c == 1);
+                if (!decodeSubframe(br, samples, side ? 17 : 16, sub[c], error)) return false;
+            }
+            br.align();
+            size_t frameLen = br.bytePos();
+            if (frameLen + 2 > file.size() - pos) { error = "frame cut short"; return false; }
+            uint16_t crc = static_cast<uint16_t>(file[pos + frameLen] << 8 | file[pos + frameLen + 1]);
+            if (crc != crc16(file.data() + pos, frameLen)) { error = "frame CRC"; return false; }
+
+            for (uint32_t i = 0; i < samples; ++i) {
+                int32_t a = sub[0][i];
+                if (channels == 1) {
+                    out.pcm.push_back(static_cast<int16_t>(a));
+                    continue;
+                }
+                int32_t b = sub[1][i];
+                int32_t left = a, right = b;
+                if (assignment == 8) right = a - b;
+                else if (assignment == 9) left = a + b;
+                else if (assignment == 10) {
+                    int32_t mid = (a << 1) | (b & 1);
+                    left = (mid + b) >> 1;
+                    right = (mid - b) >> 1;
+                }
+                out.pcm.push_back(static_cast<int16_t>(left));
+                out.pcm.push_back(static_cast<int16_t>(right));
+            }
+            out.frameOffsets.push_back(pos - kFLACHeaderSize);
+            out.frameSamples.push_back(sample);
+            expectedSample += samples;
+            pos += frameLen + 2;
+        }
+        return true;
+    }
+
+    // Speech-like: voiced bursts of a few harmonics over a little noise, with stretches of digital silence
+    std::vector<int16_t> speech(uint32_t rate, uint16_t channels, size_t samples, unsigned seed) {
+        std::mt19937 rng(seed);
+        std::normal_distribution<double> noise(0.0, 40.0);
+        std::vector<int16_t> pcm(samples * channels);
+        for (size_t i = 0; i < samples; ++i) {
+            double t = static_cast<double>(i) / rate;
+            bool talking = std::fmod(t, 1.5) < 1.0;
+            double envelope = talking ? 0.5 + 0.5 * std::sin(2 * M_PI * 3 * t) : 0.0;
+            double f0 = 120 + 30 * std::sin(2 * M_PI * 0.7 * t);
+            double voice = 0;
+            for (int h = 1; h <= 5; ++h) voice += std::sin(2 * M_PI * f0 * h * t) / h;
+            for (uint16_t c = 0; c < channels; ++c) {
+                double v = talking ? 6000 * envelope * voice * (c == 0 ? 1.0 : 0.8) + noise(rng) : 0.0;
+                pcm[i * channels + c] = static_cast<int16_t>(std::max(-32768.0, std::min(32767.0, v)));
+            }
+        }
+        return pcm;
+    }
+
+    // Full-scale square waves, in and out of phase: the side channel needs all 17 bits
+    std::vector<int16_t> extremes(size_t samples) {
+        std::vector<int16_t> pcm(samples * 2);
+        for (size_t i = 0; i < samples; ++i) {
+            bool high = (i / 37) % 2 == 0;
+            pcm[2 * i] = high ? 32767 : -32768;
+            pcm[2 * i + 1] = (i / 500) % 2 == 0 ? (high ? -32768 : 32767) : pcm[2 * i];
+        }
+        return pcm;
+    }
+
+    bool check(bool ok, const std::string& what) {
+        std::cout << (ok ? "✓ " : "✗ ") << what << std::endl;
+        return ok;
+    }
+
+    // Writes pcm in 10 ms frames; every flushEvery frames the partial block is handed over as if
+    // stale. Far faster than real time, so it waits for the encoder every half second of audio.
+    void record(FlacEncodePool& pool, FlacFile& file, const std::vector<int16_t>& pcm, uint32_t rate,
+                uint16_t channels, int flushEvery) {
+        const size_t frame = rate / 100 * channels;
+        auto later = std::chrono::steady_clock::now() + std::chrono::hours(1);
+        for (size_t i = 0, n = 0; i < pcm.size(); i += frame, ++n) {
+            size_t len = std::min(frame, pcm.size() - i);
+            file.write(reinterpret_cast<const char*>(pcm.data() + i), len * sizeof(int16_t));
+            if (flushEvery > 0 && n % flushEvery == flushEvery - 1) {
+                file.flushIfStale(later);
+            }
+            if (n % 50 == 49) {
+                pool.drain();
+            }
+        }
+    }
+
+    bool roundTrip(const std::string& dir, const std::string& name, uint32_t rate, uint16_t channels,
+                   const std::vector<int16_t>& pcm, int flushEvery) {
+        std::string path = dir + "/" + name + ".flac";
+        unlink(path.c_str());
+        {
+            DiskWriter writer;
+            FlacEncodePool pool(1);
+            FlacFile file(pool, writer, path, rate, channels);
+            record(pool, file, pcm, rate, channels, flushEvery);
+        }
+        Decoded decoded;
+        std::string error;
+        if (!check(decodeFile(path, decoded, error), name + ": decodes" + (error.empty() ? "" : " (" + error + ")"))) {
+            return false;
+        }
+        bool ok = true;
+        ok &= check(decoded.pcm == pcm, name + ": " + std::to_string(decoded.frameSamples.size()) +
+                    " frames decode to the samples written");
+        ok &= check(decoded.info.totalSamples == pcm.size() / channels && decoded.info.sampleRate == rate &&
+                    decoded.info.channels == channels, name + ": STREAMINFO matches");
+        bool points = !decoded.points.empty();
+        for (const FLACSeekPoint& point : decoded.points) {
+            bool found = false;
+            for (size_t f = 0; f < decoded.frameOffsets.size(); ++f) {
+                found = found || (decoded.frameOffsets[f] == point.offset && decoded.frameSamples[f] == point.sample);
+            }
+            points = points && found;
+        }
+        ok &= check(points, name + ": " + std::to_string(decoded.points.size()) + " seek points land on frames");
+        return ok;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::cout << "=== FLAC recording round-trip test ===" << std::endl;
+    std::string dir;
+    bool temporary = argc < 2;
+    if (temporary) {
+        char tmpl[] = "/tmp/flac_roundtrip_XXXXXX";
+        if (!mkdtemp(tmpl)) {
+            std::cerr << "Failed to create a temporary directory" << std::endl;
+            return 1;
+        }
+        dir = tmpl;
+    } else {
+        dir = argv[1];
+    }
+    bool ok = true;
+
+    ok &= roundTrip(dir, "mono_16k", 16000, 1, speech(16000, 1, 16000 * 25, 1), 0);
+    ok &= roundTrip(dir, "stereo_48k_flushes", 48000, 2, speech(48000, 2, 48000 * 12, 2), 7);
+    ok &= roundTrip(dir, "stereo_extremes", 32000, 2, extremes(32000 * 3), 3);
+
+    // Resume: a second file on the same path appends
+    {
+        std::string path = dir + "/resumed.flac";
+        unlink(path.c_str());
+        std::vector<int16_t> first = speech(32000, 1, 32000 * 4 + 123, 3);
+        std::vector<int16_t> second = speech(32000, 1, 32000 * 5, 4);
+        for (const std::vector<int16_t>* part : {&first, &second}) {
+            DiskWriter writer;
+            FlacEncodePool pool(1);
+            FlacFile file(pool, writer, path, 32000, 1);
+            record(pool, file, *part, 32000, 1, 0);
+        }
+        std::vector<int16_t> both = first;
+        both.insert(both.end(), second.begin(), second.end());
+        Decoded decoded;
+        std::string error;
+        ok &= check(decodeFile(path, decoded, error) && decoded.pcm == both && decoded.info.totalSamples == both.size(),
+                    "resumed file decodes to both recordings" + (error.empty() ? "" : " (" + error + ")"));
+    }
+
+    // Encoder behind: blocks written much faster than one thread encodes them. Full blocks
+    // only, so every 4096-sample span is either the audio or silence of the same length.
+    {
+        const uint32_t rate = 48000;
+        const uint32_t block = 4096;
+        std::string path = dir + "/behind.flac";
+        unlink(path.c_str());
+        std::mt19937 rng(5);
+        std::uniform_int_distribution<int> noise(-20000, 20000);
+        std::vector<int16_t> pcm(static_cast<size_t>(block) * 2 * 800);
+        for (int16_t& s : pcm) s = static_cast<int16_t>(noise(rng));
+        uint64_t dropped = 0;
+        {
+            DiskWriterConfig config;
+            config.maxBuffersPerFile = 1024;    // only the encoder may fall behind
+            DiskWriter writer(config);
+            FlacEncodePool pool(1);
+            FlacFile file(pool, writer, path, rate, 2);
+            file.write(reinterpret_cast<const char*>(pcm.data()), pcm.size() * sizeof(int16_t));
+            ok &= check(file.dataBytes() == pcm.size() * sizeof(int16_t), "dropped blocks still count towards the file");
+            file.close();
+            pool.drain();
+            writer.drain();
+            dropped = file.droppedBytes();
+        }
+        Decoded decoded;
+        std::string error;
+        bool decodes = decodeFile(path, decoded, error);
+        ok &= check(decodes && decoded.pcm.size() == pcm.size(),
+                    "file keeps its length with blocks dropped" + (error.empty() ? "" : " (" + error + ")"));
+        size_t silent = 0;
+        bool spans = decodes && decoded.pcm.size() == pcm.size();
+        const size_t span = static_cast<size_t>(block) * 2;
+        for (size_t i = 0; spans && i < pcm.size(); i += span) {
+            bool same = std::equal(pcm.begin() + i, pcm.begin() + i + span, decoded.pcm.begin() + i);
+            bool zero = std::all_of(decoded.pcm.begin() + i, decoded.pcm.begin() + i + span,
+                                    [](int16_t s) { return s == 0; });
+            spans = same || zero;
+            if (zero) silent++;
+        }
+        ok &= check(spans, "every block decodes to its audio or to silence");
+        ok &= check(silent * span * sizeof(int16_t) == dropped,
+                    std::to_string(silent) + " of " + std::to_string(pcm.size() / span) +
+                    " blocks were dropped and are silence, as droppedBytes() says");
+        if (silent == 0) {
+            std::cout << "  (the encoder kept up, so the drop path wasn't exercised)" << std::endl;
+        }
+    }
+
+    if (temporary) {
+        std::string cleanup = "rm -rf '" + dir + "'";
+        if (std::system(cleanup.c_str()) != 0) {
+            std::cerr << "Failed to remove " << dir << std::endl;
+        }
+    }
+
+    if (!ok) {
+        std::cout << "✗ FAIL: FLAC round trip" << std::endl;
+        return 1;
+    }
+    std::cout << "✓ PASS: FLAC recordings decode to what was written" << std::endl;
+    return 0;
+}
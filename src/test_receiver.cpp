@@ -0,0 +1,179 @@
+#include "test_receiver.h"
+#include "stream_protocol.h"
+#include <chrono>
+#include <unordered_map>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace ZoomBot {
+
+TestReceiver::~TestReceiver() {
+    close();
+}
+
+bool TestReceiver::open(const Options& options) {
+    options_ = options;
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(options.port);
+    socklen_t len = sizeof(addr);
+    if (listen_fd_ < 0 || setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+        bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listen_fd_, 4) < 0 ||
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+        if (listen_fd_ >= 0) ::close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+    port_ = ntohs(addr.sin_port);
+    running_.store(true);
+    thread_ = std::thread(&TestReceiver::run, this);
+    return true;
+}
+
+void TestReceiver::close() {
+    running_.store(false);
+    if (thread_.joinable()) thread_.join();
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+}
+
+void TestReceiver::disconnect() {
+    drop_.store(true);
+}
+
+bool TestReceiver::grant(uint16_t streamId, uint32_t bytes) {
+    char credit[kWireCreditSize];
+    encodeWireCredit(credit, streamId, bytes);
+    std::lock_guard<std::mutex> lock(send_mtx_);
+    return fd_ >= 0 && send(fd_, credit, sizeof(credit), MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(credit));
+}
+
+bool TestReceiver::reply(int fd, const char* data, size_t len) {
+    std::lock_guard<std::mutex> lock(send_mtx_);
+    return send(fd, data, len, MSG_NOSIGNAL) == static_cast<ssize_t>(len);
+}
+
+std::vector<TestReceiver::Message> TestReceiver::messages() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return messages_;
+}
+
+size_t TestReceiver::count(uint8_t type) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    size_t n = 0;
+    for (const Message& message : messages_) {
+        if (message.type == type) n++;
+    }
+    return n;
+}
+
+void TestReceiver::run() {
+    while (running_.load()) {
+        struct pollfd pfd{listen_fd_, POLLIN, 0};
+        if (poll(&pfd, 1, 20) <= 0) continue;
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) continue;
+        drop_.store(false);
+        serve(fd, ++connections_);
+        {
+            std::lock_guard<std::mutex> lock(send_mtx_);
+            fd_ = -1;
+        }
+        ::close(fd);
+    }
+}
+
+// Handshake, then message by message until EOF, disconnect() or close()
+void TestReceiver::serve(int fd, int connection) {
+    char hello[kWireHelloSize];
+    uint16_t version = 0;
+    uint16_t flags = 0;
+    if (recv(fd, hello, sizeof(hello), MSG_WAITALL) != static_cast<ssize_t>(sizeof(hello)) ||
+        !decodeWireHello(hello, version, flags)) {
+        return;
+    }
+    hello_flags_.store(flags);
+    uint16_t accepted = 0;
+    if (options_.credits && (flags & kWireHelloCredits)) accepted |= kWireHelloCredits;
+    if (options_.acks && (flags & kWireHelloAcks)) accepted |= kWireHelloAcks;
+    char answer[kWireHelloSize + kWireCreditSize];
+    encodeWireHello(answer, accepted);
+    size_t answer_len = kWireHelloSize;
+    if (accepted & kWireHelloCredits) {
+        encodeWireCredit(answer + kWireHelloSize, kWireAllStreams, options_.window);
+        answer_len += kWireCreditSize;
+    }
+    if (!reply(fd, answer, answer_len)) return;
+    {
+        std::lock_guard<std::mutex> lock(send_mtx_);
+        fd_ = fd;
+    }
+
+    std::unordered_map<uint16_t, uint32_t> users;   // stream id -> user id, for this connection
+    std::vector<char> body;
+    char prefix[kWirePrefixSize];
+    while (running_.load() && !drop_.load()) {
+        struct pollfd pfd{fd, POLLIN, 0};
+        if (poll(&pfd, 1, 20) <= 0) continue;
+        if (recv(fd, prefix, sizeof(prefix), MSG_WAITALL) != static_cast<ssize_t>(sizeof(prefix))) return;
+        Message message;
+        message.connection = connection;
+        uint32_t length = 0;
+        decodeWirePrefix(prefix, message.type, message.streamId, length);
+        body.resize(length);
+        if (length > 0 && recv(fd, body.data(), length, MSG_WAITALL) != static_cast<ssize_t>(length)) return;
+
+        if (message.type == kWireStreamDeclare) {
+            uint32_t rate = 0;
+            uint16_t channels = 0;
+            uint8_t format = 0;
+            std::string name;
+            if (decodeWireStreamDeclare(body.data(), length, message.userId, rate, channels, format, name)) {
+                users[message.streamId] = message.userId;
+            }
+        } else {
+            auto it = users.find(message.streamId);
+            message.userId = it == users.end() ? 0 : it->second;
+            if (message.type == kWireAudio) {
+                decodeWireAudioHeader(body.data(), length, message.sequence, message.captureTimeMs);
+                message.dataBytes = length - 12;
+                message.data.assign(body.data() + 12, message.dataBytes);
+                char control[kWireCreditSize];
+                if ((accepted & kWireHelloCredits) && options_.refill && message.userId != options_.stallUser) {
+                    encodeWireCredit(control, message.streamId, static_cast<uint32_t>(message.dataBytes));
+                    if (!reply(fd, control, sizeof(control))) return;
+                }
+                if ((accepted & kWireHelloAcks) && acked_ < options_.ackFrames) {
+                    acked_++;
+                    encodeWireAck(control, message.streamId, message.sequence + 1);
+                    if (!reply(fd, control, sizeof(control))) return;
+                }
+            } else if (message.type == kWireSilence) {
+                decodeWireSilence(body.data(), length, message.sequence, message.captureTimeMs, message.count);
+            } else if (message.type == kWireDropped) {
+                uint8_t reason = 0;
+                decodeWireDropped(body.data(), length, message.sequence, message.count, reason, message.priority);
+            }
+        }
+        std::lock_guard<std::mutex> lock(mtx_);
+        messages_.push_back(message);
+    }
+}
+
+bool waitUntil(const std::function<bool()>& done, int timeout_ms) {
+    for (int waited = 0; waited < timeout_ms; waited += 10) {
+        if (done()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return done();
+}
+
+} // namespace ZoomBot
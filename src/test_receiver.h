@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+namespace ZoomBot {
+
+/**
+ * Local binary-protocol receiver for the streamer tests. Listens on loopback,
+ * answers the handshake and records every message it reads, with the user id
+ * from the stream's declare. One connection at a time; the bot's reconnects
+ * are accepted in turn. It can take part in flow control and replay when the
+ * bot asks for them, as a real receiver would.
+ */
+class TestReceiver {
+public:
+    struct Options {
+        uint16_t port = 0;              // 0: any free port
+        bool credits = false;           // accept flow control: window, then refills
+        uint32_t window = 0;            // every stream's initial credit
+        bool refill = true;             // grant each audio message's bytes back once read
+        uint32_t stallUser = 0;         // never refilled (0: none)
+        bool acks = false;              // accept replay and acknowledge audio as it is read
+        size_t ackFrames = SIZE_MAX;    // audio messages acknowledged in all; later ones aren't
+    };
+
+    // A message as read. Fields a message type doesn't have are 0.
+    struct Message {
+        int connection = 0;          // 1 for the first connection accepted, and so on
+        uint8_t type = 0;
+        uint16_t streamId = 0;
+        uint32_t userId = 0;         // declared for the stream on this connection
+        uint32_t sequence = 0;       // audio and silence; the first one for dropped
+        uint32_t count = 0;          // dropped: frames; silence: samples
+        uint8_t priority = 0;        // dropped
+        uint64_t captureTimeMs = 0;
+        size_t dataBytes = 0;        // audio payload
+        std::string data;
+    };
+
+    TestReceiver() = default;
+    ~TestReceiver();
+    TestReceiver(const TestReceiver&) = delete;
+    TestReceiver& operator=(const TestReceiver&) = delete;
+
+    bool open() { return open(Options()); }
+    bool open(const Options& options);
+    void close();           // stops listening and drops the connection
+    void disconnect();      // drops the current connection, keeps listening
+    // Sends a credit on the current connection; false if there is none
+    bool grant(uint16_t streamId, uint32_t bytes);
+
+    std::string config() const { return "127.0.0.1:" + std::to_string(port_); }
+    uint16_t port() const { return port_; }
+    int connections() const { return connections_.load(); }
+    uint16_t helloFlags() const { return hello_flags_.load(); }
+
+    std::vector<Message> messages() const;
+    size_t count(uint8_t type) const;
+
+private:
+    Options options_;
+    int listen_fd_ = -1;
+    uint16_t port_ = 0;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> drop_{false};
+    std::atomic<int> connections_{0};
+    std::atomic<uint16_t> hello_flags_{0};
+    std::thread thread_;
+    mutable std::mutex mtx_;
+    std::vector<Message> messages_;
+    std::mutex send_mtx_;           // replies from the serving thread and grant()
+    int fd_ = -1;                   // current connection, under send_mtx_
+    size_t acked_ = 0;
+
+    void run();
+    void serve(int fd, int connection);
+    bool reply(int fd, const char* data, size_t len);
+};
+
+// Polls done() every 10 ms until it holds (true) or timeout_ms pass (false)
+bool waitUntil(const std::function<bool()>& done, int timeout_ms = 5000);
+
+} // namespace ZoomBot
@@ -0,0 +1,119 @@
+// Verifies that the steady-state queue/send path of AudioStreamer does not
+// touch the heap. Runs against a local TCP sink that answers the protocol
+// handshake and discards everything after it.
+// Build target: test_streamer_alloc (compiled with ZOOMBOT_COUNT_ALLOCATIONS)
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <string>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "audio_streamer.h"
+#include "stream_protocol.h"
+#include "audio_frame.h"
+#include "alloc_counter.h"
+
+using namespace ZoomBot;
+
+namespace {
+    constexpr int WARMUP_FRAMES = 2000;
+    constexpr int MEASURED_FRAMES = 20000;
+    constexpr size_t FRAME_BYTES = 640;   // 10 ms of 32 kHz mono s16
+    char g_pcm[FRAME_BYTES];
+
+    std::atomic<bool> g_sinkRunning{true};
+
+    // Accepts one connection, completes the handshake and reads into a fixed buffer until EOF
+    void runSink(int listenFd) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) return;
+        char hello[kWireHelloSize];
+        if (recv(fd, hello, sizeof(hello), MSG_WAITALL) != static_cast<ssize_t>(sizeof(hello))) {
+            close(fd);
+            return;
+        }
+        encodeWireHello(hello);
+        send(fd, hello, sizeof(hello), 0);
+        char buf[64 * 1024];
+        while (g_sinkRunning.load() && recv(fd, buf, sizeof(buf), 0) > 0) {}
+        close(fd);
+    }
+
+    void pushFrames(AudioStreamer& streamer, const SharedName& name, int count) {
+        for (int i = 0; i < count; ++i) {
+            AudioFrameRef frame = AudioFramePool::instance().acquire();
+            frame->attach(g_pcm, sizeof(g_pcm), nullptr, nullptr);
+            frame->sampleRate = 32000;
+            frame->channels = 1;
+            streamer.queueAudio(42, name, frame);
+            if (i % 10 == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+    void waitForDrain(AudioStreamer& streamer) {
+        while (streamer.getQueueSize() > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        // Let the worker finish the chunk it already popped
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+int main() {
+    std::cout << "=== AudioStreamer allocation test ===" << std::endl;
+    if (!AllocCounter::enabled()) {
+        std::cerr << "Allocation counting not compiled in (define ZOOMBOT_COUNT_ALLOCATIONS)" << std::endl;
+        return 1;
+    }
+
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (listenFd < 0 || bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(listenFd, 1) < 0 || getsockname(listenFd, (sockaddr*)&addr, &len) < 0) {
+        std::cerr << "Failed to set up local sink" << std::endl;
+        return 1;
+    }
+    std::thread sink(runSink, listenFd);
+
+    AudioStreamer streamer;
+    if (!streamer.initialize("tcp", "127.0.0.1:" + std::to_string(ntohs(addr.sin_port)))) {
+        std::cerr << "Failed to connect streamer to local sink" << std::endl;
+        return 1;
+    }
+    streamer.start();
+
+    auto name = std::make_shared<const std::string>("Alloc_Test_User");
+
+    // Warm up: enough pooled frames to cover a full queue, then size the reusable buffers
+    AudioFramePool::instance().reserve(1100);
+    pushFrames(streamer, name, WARMUP_FRAMES);
+    waitForDrain(streamer);
+
+    uint64_t before = AllocCounter::allocations();
+    pushFrames(streamer, name, MEASURED_FRAMES);
+    waitForDrain(streamer);
+    uint64_t allocations = AllocCounter::allocations() - before;
+
+    streamer.stop();
+    g_sinkRunning.store(false);
+    sink.join();
+    close(listenFd);
+
+    std::cout << "Steady-state allocations over " << MEASURED_FRAMES << " frames: " << allocations << std::endl;
+    if (allocations != 0) {
+        std::cout << "✗ FAIL: queue/send path allocated" << std::endl;
+        return 1;
+    }
+    std::cout << "✓ PASS: queue/send path is allocation-free" << std::endl;
+    return 0;
+}
@@ -0,0 +1,127 @@
+// Verifies fan-out to several sinks when one of them can't be set up: the
+// others get all of the audio, stop() doesn't wait on the sink being retried,
+// a stopped streamer turns audio away and starts again on the same sinks, and
+// a streamer initialized again only streams to its new sink.
+// Runs against local receivers (test_receiver.h) that count the audio
+// messages they get.
+// Build target: test_streamer_fanout
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "audio_streamer.h"
+#include "stream_protocol.h"
+#include "audio_frame.h"
+#include "test_receiver.h"
+
+using namespace ZoomBot;
+
+namespace {
+    constexpr int FRAMES = 2000;
+    constexpr size_t FRAME_BYTES = 640;   // 10 ms of 32 kHz mono s16
+    char g_pcm[FRAME_BYTES];
+
+    void pushFrames(AudioStreamer& streamer, int count) {
+        auto name = std::make_shared<const std::string>("Fanout_Test_User");
+        for (int i = 0; i < count; ++i) {
+            AudioFrameRef frame = AudioFramePool::instance().acquire();
+            frame->attach(g_pcm, sizeof(g_pcm), nullptr, nullptr);
+            frame->sampleRate = 32000;
+            frame->channels = 1;
+            streamer.queueAudio(42, name, frame);
+            if (i % 10 == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+    // Waits until every sink has seen the expected number of audio messages, or gives up after 5 s
+    bool waitForAudio(const std::vector<TestReceiver*>& sinks, size_t expected) {
+        return waitUntil([&] {
+            for (const TestReceiver* sink : sinks) {
+                if (sink->count(kWireAudio) < expected) return false;
+            }
+            return true;
+        });
+    }
+
+    bool check(bool ok, const std::string& what) {
+        std::cout << (ok ? "✓ " : "✗ ") << what << std::endl;
+        return ok;
+    }
+}
+
+int main() {
+    std::cout << "=== AudioStreamer fan-out test ===" << std::endl;
+
+    TestReceiver a, b, c;
+    if (!a.open() || !b.open() || !c.open()) {
+        std::cerr << "Failed to set up local sinks" << std::endl;
+        return 1;
+    }
+    const std::string options = "?replay=0&credits=0";
+    const std::string bad = "sink-without-port";
+    bool ok = true;
+
+    AudioStreamer streamer;
+    ok &= check(!streamer.initialize("tcp", bad + ";" + bad + "2"), "initialize fails when no sink can be set up");
+
+    ok &= check(streamer.initialize("tcp", a.config() + options + ";" + bad + ";" + b.config() + options),
+                "initialize succeeds with one of three sinks failing");
+    streamer.start();
+    pushFrames(streamer, FRAMES);
+    ok &= check(waitForAudio({&a, &b}, FRAMES), "the working sinks get all of the audio");
+
+    auto stopStart = std::chrono::steady_clock::now();
+    streamer.stop();
+    auto stopMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - stopStart).count();
+    ok &= check(stopMs < 2000, "stop() doesn't wait for the retry backoff (" + std::to_string(stopMs) + " ms)");
+
+    AudioFrameRef late = AudioFramePool::instance().acquire();
+    late->attach(g_pcm, sizeof(g_pcm), nullptr, nullptr);
+    late->sampleRate = 32000;
+    late->channels = 1;
+    ok &= check(!streamer.queueAudio(42, std::make_shared<const std::string>("Late"), late),
+                "queueAudio after stop() is turned away");
+    late.reset();
+
+    // Started again without initialize: the same sinks carry on once their
+    // workers have reconnected (with replay=0, audio before that is dropped)
+    size_t before = a.count(kWireAudio);
+    int reconnects = a.connections();
+    streamer.start();
+    waitUntil([&] { return a.connections() > reconnects; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));   // handshake, on the idle tick
+    pushFrames(streamer, FRAMES);
+    ok &= check(waitForAudio({&a}, before + FRAMES), "start() after stop() streams to the same sinks");
+    streamer.stop();
+
+    // Initialized again with one endpoint, the earlier sinks must be gone
+    int connectionsA = a.connections();
+    int connectionsB = b.connections();
+    size_t audioA = a.count(kWireAudio);
+    size_t audioB = b.count(kWireAudio);
+    ok &= check(streamer.initialize("tcp", c.config() + options), "initialize again after stop()");
+    streamer.start();
+    pushFrames(streamer, FRAMES);
+    ok &= check(waitForAudio({&c}, FRAMES), "the new sink gets all of the audio");
+    streamer.stop();
+    ok &= check(a.connections() == connectionsA && b.connections() == connectionsB &&
+                a.count(kWireAudio) == audioA && b.count(kWireAudio) == audioB,
+                "the earlier sinks get nothing after initialize again");
+
+    a.close();
+    b.close();
+    c.close();
+
+    if (!ok) {
+        std::cout << "✗ FAIL: fan-out" << std::endl;
+        return 1;
+    }
+    std::cout << "✓ PASS: fan-out keeps working sinks and resets on initialize" << std::endl;
+    return 0;
+}
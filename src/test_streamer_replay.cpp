@@ -0,0 +1,152 @@
+// Verifies replay after a reconnect: audio the receiver hasn't acknowledged,
+// including what is queued while the connection is down, is sent again on the
+// next connection with its sequence numbers and payload, and acknowledged
+// audio is not. Runs once with the journal in memory and once with every
+// frame spilled to disk (replay_kb=0).
+// Runs against a local receiver (test_receiver.h) that acknowledges the first
+// frames only.
+// Build target: test_streamer_replay
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdlib>
+#include <cstring>
+
+#include "audio_streamer.h"
+#include "stream_protocol.h"
+#include "audio_frame.h"
+#include "test_receiver.h"
+
+using namespace ZoomBot;
+
+namespace {
+    constexpr size_t FRAME_BYTES = 320;
+    constexpr size_t BEFORE = 20;       // frames on the first connection
+    constexpr size_t DURING = 10;       // frames queued as it goes down
+    constexpr size_t ACKED = 8;         // frames the receiver acknowledges
+    constexpr uint32_t USER = 7;
+    char g_pcm[BEFORE + DURING][FRAME_BYTES];   // journaled frames point here
+
+    void pushFrames(AudioStreamer& streamer, size_t first, size_t frames) {
+        static const SharedName name = std::make_shared<const std::string>("Replay_Test_User");
+        for (size_t i = first; i < first + frames; ++i) {
+            AudioFrameRef frame = AudioFramePool::instance().acquire();
+            frame->attach(g_pcm[i], FRAME_BYTES, nullptr, nullptr);
+            frame->sampleRate = 16000;
+            frame->channels = 1;
+            streamer.queueAudio(USER, name, frame);
+        }
+    }
+
+    // Index of the frame a payload came from, or -1
+    int frameOf(const std::string& data) {
+        for (size_t i = 0; i < BEFORE + DURING; ++i) {
+            if (data.size() == FRAME_BYTES && memcmp(data.data(), g_pcm[i], FRAME_BYTES) == 0) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    std::vector<TestReceiver::Message> audioOn(const TestReceiver& receiver, int connection) {
+        std::vector<TestReceiver::Message> audio;
+        for (const TestReceiver::Message& message : receiver.messages()) {
+            if (message.type == kWireAudio && message.userId == USER && message.connection == connection) {
+                audio.push_back(message);
+            }
+        }
+        return audio;
+    }
+
+    bool check(bool ok, const std::string& what) {
+        std::cout << (ok ? "✓ " : "✗ ") << what << std::endl;
+        return ok;
+    }
+
+    bool runCase(const std::string& label, const std::string& options) {
+        std::cout << "--- " << label << " ---" << std::endl;
+        TestReceiver receiver;
+        TestReceiver::Options receiverOptions;
+        receiverOptions.acks = true;
+        receiverOptions.ackFrames = ACKED;
+        if (!receiver.open(receiverOptions)) {
+            std::cerr << "Failed to set up a local receiver" << std::endl;
+            return false;
+        }
+        AudioStreamer streamer;
+        if (!streamer.initialize("tcp", receiver.config() + "?credits=0&replay=1" + options)) {
+            std::cerr << "Failed to initialize the streamer" << std::endl;
+            return false;
+        }
+        streamer.start();
+        waitUntil([&] { return receiver.connections() > 0; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+        bool ok = true;
+
+        pushFrames(streamer, 0, BEFORE);
+        waitUntil([&] { return audioOn(receiver, 1).size() >= BEFORE; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));   // the acks are read on an idle tick
+        std::map<int, uint32_t> sequences;    // frame -> sequence on the first connection
+        for (const TestReceiver::Message& message : audioOn(receiver, 1)) {
+            sequences[frameOf(message.data)] = message.sequence;
+        }
+        ok &= check(sequences.size() == BEFORE && sequences.count(-1) == 0, "the first connection gets every frame");
+
+        receiver.disconnect();
+        pushFrames(streamer, BEFORE, DURING);
+        waitUntil([&] { return receiver.connections() >= 2; });
+        waitUntil([&] { return audioOn(receiver, 2).size() >= BEFORE + DURING - ACKED; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        ok &= check((receiver.helloFlags() & kWireHelloResume) != 0, "the reconnect asks to resume");
+
+        // Exactly the unacknowledged frames, in order, with the sequences they had
+        std::vector<TestReceiver::Message> replayed = audioOn(receiver, 2);
+        bool in_order = replayed.size() == BEFORE + DURING - ACKED;
+        for (size_t i = 0; in_order && i < replayed.size(); ++i) {
+            int frame = frameOf(replayed[i].data);
+            in_order = frame == static_cast<int>(ACKED + i);
+            if (in_order && frame < static_cast<int>(BEFORE)) {
+                in_order = replayed[i].sequence == sequences[frame];
+            } else if (in_order && i > 0) {
+                in_order = replayed[i].sequence == replayed[i - 1].sequence + 1;
+            }
+        }
+        ok &= check(in_order, std::to_string(replayed.size()) + " frames on the new connection: the unacknowledged ones, "
+                    "with their payloads and sequence numbers");
+
+        streamer.stop();
+        receiver.close();
+        return ok;
+    }
+}
+
+int main() {
+    std::cout << "=== AudioStreamer replay test ===" << std::endl;
+    for (size_t i = 0; i < BEFORE + DURING; ++i) {
+        for (size_t b = 0; b < FRAME_BYTES; ++b) {
+            g_pcm[i][b] = static_cast<char>(i * 31 + b * 7 + 1);
+        }
+    }
+
+    char dir[] = "/tmp/replay_test_XXXXXX";
+    if (!mkdtemp(dir)) {
+        std::cerr << "Failed to create a spill directory" << std::endl;
+        return 1;
+    }
+
+    bool ok = runCase("journal in memory", "");
+    ok &= runCase("journal spilled to disk", std::string("&replay_kb=0&spill_dir=") + dir);
+    std::string cleanup = std::string("rm -rf '") + dir + "'";
+    if (std::system(cleanup.c_str()) != 0) {
+        std::cerr << "Failed to remove " << dir << std::endl;
+    }
+
+    if (!ok) {
+        std::cout << "✗ FAIL: replay" << std::endl;
+        return 1;
+    }
+    std::cout << "✓ PASS: unacknowledged audio is replayed after a reconnect" << std::endl;
+    return 0;
+}
@@ -0,0 +1,212 @@
+// Verifies participant routing across several endpoints: each participant's
+// audio goes to one endpoint and stays there, an endpoint that fails to
+// initialize is routed around, participants move when their endpoint is
+// unreachable for failover_ms and stay moved after it comes back, and
+// forgetUser() frees routes. The route table has 4096 slots; far more
+// participants than that come and go before the routes that are checked are
+// made, so those only stick if forgotten routes are reused.
+// Runs against local receivers (test_receiver.h).
+// Build target: test_streamer_routing
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "audio_streamer.h"
+#include "stream_protocol.h"
+#include "audio_frame.h"
+#include "test_receiver.h"
+
+using namespace ZoomBot;
+
+namespace {
+    constexpr uint32_t USERS = 300;
+    constexpr uint32_t CHURN = 20000;         // participants that join and leave
+    constexpr uint32_t CHURN_FIRST_ID = 100000;
+    constexpr int NOWHERE = -1;
+    constexpr int SEVERAL = -2;
+    char g_pcm[64];
+
+    void pushFrame(AudioStreamer& streamer, uint32_t user) {
+        static const SharedName name = std::make_shared<const std::string>("Routing_Test_User");
+        AudioFrameRef frame = AudioFramePool::instance().acquire();
+        frame->attach(g_pcm, sizeof(g_pcm), nullptr, nullptr);
+        frame->sampleRate = 16000;
+        frame->channels = 1;
+        streamer.queueAudio(user, name, frame);
+    }
+
+    void pushRound(AudioStreamer& streamer) {
+        for (uint32_t user = 1; user <= USERS; ++user) {
+            pushFrame(streamer, user);
+        }
+    }
+
+    std::vector<size_t> marks(const std::vector<TestReceiver*>& receivers) {
+        std::vector<size_t> at;
+        for (const TestReceiver* receiver : receivers) {
+            at.push_back(receiver->messages().size());
+        }
+        return at;
+    }
+
+    // For users 1..USERS: the receiver that got their audio after the marks, NOWHERE or SEVERAL
+    std::vector<int> owners(const std::vector<TestReceiver*>& receivers, const std::vector<size_t>& since) {
+        std::vector<int> owner(USERS + 1, NOWHERE);
+        for (size_t r = 0; r < receivers.size(); ++r) {
+            std::vector<TestReceiver::Message> messages = receivers[r]->messages();
+            for (size_t i = since[r]; i < messages.size(); ++i) {
+                const TestReceiver::Message& message = messages[i];
+                if (message.type != kWireAudio || message.userId == 0 || message.userId > USERS) continue;
+                int& current = owner[message.userId];
+                current = current == NOWHERE || current == static_cast<int>(r) ? static_cast<int>(r) : SEVERAL;
+            }
+        }
+        return owner;
+    }
+
+    bool everyoneHeard(const std::vector<int>& owner) {
+        for (uint32_t user = 1; user <= USERS; ++user) {
+            if (owner[user] == NOWHERE) return false;
+        }
+        return true;
+    }
+
+    // One round after the marks, until every user's audio has arrived somewhere
+    std::vector<int> routeRound(AudioStreamer& streamer, const std::vector<TestReceiver*>& receivers) {
+        std::vector<size_t> since = marks(receivers);
+        pushRound(streamer);
+        std::vector<int> owner;
+        waitUntil([&] { owner = owners(receivers, since); return everyoneHeard(owner); });
+        return owner;
+    }
+
+    // Until each receiver has a connection, and the handshake has had an idle tick to finish
+    void settle(const std::vector<TestReceiver*>& receivers, int connections) {
+        waitUntil([&] {
+            for (const TestReceiver* receiver : receivers) {
+                if (receiver->connections() < connections) return false;
+            }
+            return true;
+        }, 15000);
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    }
+
+    bool check(bool ok, const std::string& what) {
+        std::cout << (ok ? "✓ " : "✗ ") << what << std::endl;
+        return ok;
+    }
+}
+
+int main() {
+    std::cout << "=== AudioStreamer endpoint routing test ===" << std::endl;
+
+    TestReceiver a, b, c;
+    if (!a.open() || !b.open() || !c.open()) {
+        std::cerr << "Failed to set up local receivers" << std::endl;
+        return 1;
+    }
+    std::vector<TestReceiver*> receivers = {&a, &b, &c};
+    const std::string options = "?replay=0&credits=0&failover_ms=300";
+    bool ok = true;
+
+    AudioStreamer streamer;
+    ok &= check(streamer.initialize("tcp", a.config() + "," + b.config() + ",endpoint-without-port," + c.config() + options),
+                "initialize succeeds with one of four endpoints failing");
+    streamer.start();
+    settle(receivers, 1);
+
+    auto churnStart = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < CHURN; ++i) {
+        pushFrame(streamer, CHURN_FIRST_ID + i);
+        streamer.forgetUser(CHURN_FIRST_ID + i);
+        if (i % 200 == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    auto churnMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - churnStart).count();
+    std::cout << CHURN << " participants joined and left in " << churnMs << " ms" << std::endl;
+
+    std::vector<int> first = routeRound(streamer, receivers);
+    bool single = true;
+    std::vector<int> per_receiver(receivers.size(), 0);
+    for (uint32_t user = 1; user <= USERS; ++user) {
+        single = single && first[user] >= 0;
+        if (first[user] >= 0) per_receiver[first[user]]++;
+    }
+    ok &= check(everyoneHeard(first) && single, "each participant's audio goes to exactly one endpoint");
+    ok &= check(per_receiver[0] > 0 && per_receiver[1] > 0 && per_receiver[2] > 0,
+                "participants are spread over the working endpoints (" + std::to_string(per_receiver[0]) + "/" +
+                std::to_string(per_receiver[1]) + "/" + std::to_string(per_receiver[2]) + ")");
+    ok &= check(routeRound(streamer, receivers) == first, "routes are sticky");
+
+    // Failover: the endpoint of user 1 goes away
+    int down = first[1];
+    TestReceiver& gone = *receivers[down];
+    uint16_t port = gone.port();
+    gone.close();
+    std::vector<size_t> since = marks(receivers);
+    std::vector<int> moved;
+    bool all_moved = waitUntil([&] {
+        pushRound(streamer);
+        moved = owners(receivers, since);
+        for (uint32_t user = 1; user <= USERS; ++user) {
+            if (first[user] == down && (moved[user] == NOWHERE || moved[user] == down)) return false;
+        }
+        return true;
+    }, 10000);
+    ok &= check(all_moved, "participants of an unreachable endpoint move after failover_ms");
+
+    bool others_stayed = true;
+    for (uint32_t user = 1; user <= USERS; ++user) {
+        if (first[user] != down) others_stayed = others_stayed && moved[user] == first[user];
+    }
+    ok &= check(others_stayed, "only that endpoint's participants move");
+
+    // Back on the same port: the moved participants stay where they are now
+    TestReceiver::Options again;
+    again.port = port;
+    int before = gone.connections();
+    if (!gone.open(again)) {
+        std::cerr << "Failed to reopen receiver on port " << port << std::endl;
+        return 1;
+    }
+    settle({&gone}, before + 1);
+    std::vector<int> after = routeRound(streamer, receivers);
+    ok &= check(after == moved, "moved participants stay after their endpoint comes back");
+
+    // Forgotten, a participant gets the ring's endpoint again
+    for (uint32_t user = 1; user <= USERS; ++user) {
+        if (first[user] == down) streamer.forgetUser(user);
+    }
+    ok &= check(routeRound(streamer, receivers) == first, "forgotten participants are routed afresh");
+    streamer.stop();
+
+    // Routing depends on the endpoints' names only, not on their order or a failed one
+    AudioStreamer reordered;
+    std::vector<int> connected;
+    for (const TestReceiver* receiver : receivers) {
+        connected.push_back(receiver->connections());
+    }
+    ok &= check(reordered.initialize("tcp", c.config() + "," + b.config() + "," + a.config() + options),
+                "initialize with the endpoints in another order");
+    reordered.start();
+    for (size_t r = 0; r < receivers.size(); ++r) {
+        settle({receivers[r]}, connected[r] + 1);
+    }
+    ok &= check(routeRound(reordered, receivers) == first, "the same participants go to the same endpoints");
+    reordered.stop();
+
+    a.close();
+    b.close();
+    c.close();
+
+    if (!ok) {
+        std::cout << "✗ FAIL: endpoint routing" << std::endl;
+        return 1;
+    }
+    std::cout << "✓ PASS: endpoint routing is consistent, sticky and survives churn" << std::endl;
+    return 0;
+}
@@ -0,0 +1,159 @@
+// Verifies which audio the streamer sheds when its backlog is over queue_kb:
+// the lowest priority class goes first (Share, then Idle, ActiveSpeaker and
+// Mixed last), and a stream the receiver has stopped granting credit to goes
+// before any other, so one slow consumer costs only its own audio.
+// Runs against local receivers (test_receiver.h) that control the credit.
+// Build target: test_streamer_shedding
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <string>
+
+#include "audio_streamer.h"
+#include "stream_protocol.h"
+#include "audio_frame.h"
+#include "test_receiver.h"
+
+using namespace ZoomBot;
+
+namespace {
+    constexpr size_t FRAME_BYTES = 640;      // 20 ms at 16 kHz mono
+    constexpr size_t BUDGET_FRAMES = 64 * 1024 / FRAME_BYTES;   // queue_kb=64 holds 102 of them
+    char g_pcm[FRAME_BYTES];
+
+    void pushFrame(AudioStreamer& streamer, uint32_t user, StreamPriority priority) {
+        static const SharedName name = std::make_shared<const std::string>("Shedding_Test_User");
+        AudioFrameRef frame = AudioFramePool::instance().acquire();
+        frame->attach(g_pcm, sizeof(g_pcm), nullptr, nullptr);
+        frame->sampleRate = 16000;
+        frame->channels = 1;
+        streamer.queueAudio(user, name, frame, priority);
+    }
+
+    uint64_t totalShed(const AudioStreamer& streamer) {
+        uint64_t total = 0;
+        for (size_t i = 0; i < kStreamPriorityCount; ++i) {
+            total += streamer.getShedFrames(static_cast<StreamPriority>(i));
+        }
+        return total;
+    }
+
+    // Connected, and the handshake has had an idle tick to finish
+    bool settle(const TestReceiver& receiver) {
+        bool connected = waitUntil([&] { return receiver.connections() > 0; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+        return connected;
+    }
+
+    bool check(bool ok, const std::string& what) {
+        std::cout << (ok ? "✓ " : "✗ ") << what << std::endl;
+        return ok;
+    }
+}
+
+int main() {
+    std::cout << "=== AudioStreamer backlog shedding test ===" << std::endl;
+    bool ok = true;
+
+    // Class order: no stream gets any credit, so everything stays in the backlog
+    // and only the priority decides. The backlog keeps the BUDGET_FRAMES most
+    // important frames: all of Mixed, then ActiveSpeaker up to the budget.
+    {
+        const size_t rounds = 60;
+        TestReceiver receiver;
+        TestReceiver::Options options;
+        options.credits = true;
+        options.window = 0;
+        if (!receiver.open(options)) {
+            std::cerr << "Failed to set up a local receiver" << std::endl;
+            return 1;
+        }
+        AudioStreamer streamer;
+        if (!streamer.initialize("tcp", receiver.config() + "?queue_kb=64&replay=0") || (streamer.start(), !settle(receiver))) {
+            std::cerr << "Streamer didn't connect to the local receiver" << std::endl;
+            return 1;
+        }
+        for (size_t r = 0; r < rounds; ++r) {
+            pushFrame(streamer, 1, StreamPriority::Mixed);
+            pushFrame(streamer, 2, StreamPriority::ActiveSpeaker);
+            pushFrame(streamer, 3, StreamPriority::Idle);
+            pushFrame(streamer, 4, StreamPriority::Share);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        const uint64_t expected = 4 * rounds - BUDGET_FRAMES;
+        waitUntil([&] { return totalShed(streamer) >= expected; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        uint64_t mixed = streamer.getShedFrames(StreamPriority::Mixed);
+        uint64_t speaker = streamer.getShedFrames(StreamPriority::ActiveSpeaker);
+        uint64_t idle = streamer.getShedFrames(StreamPriority::Idle);
+        uint64_t share = streamer.getShedFrames(StreamPriority::Share);
+        std::cout << "Shed: Mixed " << mixed << ", ActiveSpeaker " << speaker << ", Idle " << idle
+                  << ", Share " << share << std::endl;
+        ok &= check(receiver.count(kWireAudio) == 0, "no audio goes out without credit");
+        ok &= check(share == rounds && idle == rounds, "Share and Idle are shed completely");
+        ok &= check(speaker == 2 * rounds - BUDGET_FRAMES, "ActiveSpeaker is shed down to what fits next to Mixed");
+        ok &= check(mixed == 0, "Mixed is never shed while other classes have audio");
+        streamer.stop();
+    }
+
+    // Blocked first: the receiver stops granting credit to a Mixed stream, and
+    // bursts of Idle audio arrive while that stream fills the backlog. The
+    // blocked stream is shed, though Idle is the lower class.
+    {
+        const uint32_t stalled = 10;
+        const uint32_t idleUser = 11;
+        const size_t bursts = 5;
+        const size_t burstFrames = 40;
+        TestReceiver receiver;
+        TestReceiver::Options options;
+        options.credits = true;
+        options.window = 64 * 1024;
+        options.stallUser = stalled;
+        if (!receiver.open(options)) {
+            std::cerr << "Failed to set up a local receiver" << std::endl;
+            return 1;
+        }
+        AudioStreamer streamer;
+        if (!streamer.initialize("tcp", receiver.config() + "?queue_kb=64&replay=0") || (streamer.start(), !settle(receiver))) {
+            std::cerr << "Streamer didn't connect to the local receiver" << std::endl;
+            return 1;
+        }
+        // Its window, then a full backlog
+        for (size_t i = 0; i < 3 * BUDGET_FRAMES; ++i) {
+            pushFrame(streamer, stalled, StreamPriority::Mixed);
+            if (i % 10 == 9) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ok &= check(waitUntil([&] { return streamer.getShedFrames(StreamPriority::Mixed) > 0; }),
+                    "the stalled stream fills the backlog");
+
+        for (size_t b = 0; b < bursts; ++b) {
+            for (size_t i = 0; i < burstFrames; ++i) {
+                pushFrame(streamer, idleUser, StreamPriority::Idle);
+            }
+            pushFrame(streamer, stalled, StreamPriority::Mixed);
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        size_t idleArrived = 0;
+        waitUntil([&] {
+            idleArrived = 0;
+            for (const TestReceiver::Message& message : receiver.messages()) {
+                if (message.type == kWireAudio && message.userId == idleUser) idleArrived++;
+            }
+            return idleArrived == bursts * burstFrames;
+        });
+        std::cout << "Shed: Mixed " << streamer.getShedFrames(StreamPriority::Mixed) << ", Idle "
+                  << streamer.getShedFrames(StreamPriority::Idle) << std::endl;
+        ok &= check(streamer.getShedFrames(StreamPriority::Idle) == 0 && idleArrived == bursts * burstFrames,
+                    "every Idle frame arrives (" + std::to_string(idleArrived) + "); the blocked Mixed stream is shed instead");
+        streamer.stop();
+    }
+
+    if (!ok) {
+        std::cout << "✗ FAIL: backlog shedding" << std::endl;
+        return 1;
+    }
+    std::cout << "✓ PASS: backlog shedding takes the blocked and lowest classes first" << std::endl;
+    return 0;
+}
@@ -0,0 +1,100 @@
+// Verifies that the binary protocol never declares stream id 0xFFFF, which
+// credit messages use for all streams: a connection runs out of stream ids
+// after 0xFFFF declarations, and audio for more streams is turned away.
+// Runs against a local receiver (test_receiver.h).
+// Build target: test_streamer_stream_ids
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "audio_streamer.h"
+#include "stream_protocol.h"
+#include "audio_frame.h"
+#include "test_receiver.h"
+
+using namespace ZoomBot;
+
+namespace {
+    constexpr uint32_t STREAMS = 0x10000;   // one more than there are ids
+    constexpr size_t BATCH = 256;
+    char g_pcm[32];
+
+    bool check(bool ok, const std::string& what) {
+        std::cout << (ok ? "✓ " : "✗ ") << what << std::endl;
+        return ok;
+    }
+}
+
+int main() {
+    std::cout << "=== Binary protocol stream id test ===" << std::endl;
+
+    TestReceiver receiver;
+    if (!receiver.open()) {
+        std::cerr << "Failed to set up a local receiver" << std::endl;
+        return 1;
+    }
+
+    TCPStreamingBackend backend;
+    if (!backend.initialize(receiver.config() + "?replay=0&credits=0")) {
+        std::cerr << "Failed to initialize the TCP backend" << std::endl;
+        return 1;
+    }
+    if (!waitUntil([&] { backend.maintain(); return backend.isConnected(); })) {
+        std::cerr << "Not connected to the local receiver" << std::endl;
+        return 1;
+    }
+
+    // One participant per stream, so each needs its own id
+    SharedName name = std::make_shared<const std::string>("Stream_Id_Test_User");
+    std::vector<AudioChunk> chunks(BATCH);
+    bool last_sent = true;
+    for (uint32_t user = 0; user < STREAMS; user += BATCH) {
+        for (size_t i = 0; i < BATCH; ++i) {
+            chunks[i].user_id = user + static_cast<uint32_t>(i);
+            chunks[i].user_name = name;
+            chunks[i].frame = AudioFramePool::instance().acquire();
+            chunks[i].frame->attach(g_pcm, sizeof(g_pcm), nullptr, nullptr);
+            chunks[i].frame->sampleRate = 16000;
+            chunks[i].frame->channels = 1;
+        }
+        if (user + BATCH < STREAMS) {
+            backend.streamBatch(chunks.data(), BATCH);
+        } else {
+            // The last stream alone, to see it turned away
+            backend.streamBatch(chunks.data(), BATCH - 1);
+            last_sent = backend.streamBatch(&chunks[BATCH - 1], 1);
+        }
+    }
+    backend.flush(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+
+    const size_t ids = kWireAllStreams;
+    waitUntil([&] { return receiver.count(kWireAudio) >= ids; }, 10000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    bool reserved_declared = false;
+    uint32_t last_user_audio = 0;
+    for (const TestReceiver::Message& message : receiver.messages()) {
+        if (message.type == kWireStreamDeclare && message.streamId == kWireAllStreams) reserved_declared = true;
+        if (message.type == kWireAudio && message.userId == STREAMS - 1) last_user_audio++;
+    }
+
+    bool ok = true;
+    ok &= check(receiver.count(kWireStreamDeclare) == ids,
+                std::to_string(receiver.count(kWireStreamDeclare)) + " streams declared (" + std::to_string(ids) + " ids)");
+    ok &= check(receiver.count(kWireAudio) == ids, "audio arrived for every declared stream");
+    ok &= check(!reserved_declared, "stream id 0xFFFF is never declared");
+    ok &= check(!last_sent && last_user_audio == 0, "audio for one stream more is turned away");
+
+    backend.shutdown();
+    receiver.close();
+
+    if (!ok) {
+        std::cout << "✗ FAIL: stream ids" << std::endl;
+        return 1;
+    }
+    std::cout << "✓ PASS: stream ids stop short of the all-streams id" << std::endl;
+    return 0;
+}
@@ -0,0 +1,168 @@
+// Verifies the voice-activity gate: every frame analyzer this CPU can run
+// (AVX2, SSE2) gives the scalar one's energy and zero crossings for any
+// length, channel count, alignment and full-scale samples; and the gate's
+// output accounts for every sample in order, with each silence marker at the
+// capture time of the first audio it stands for and no longer than a second.
+// Build target: test_voice_activity
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "voice_activity.h"
+#include "audio_frame.h"
+
+using namespace ZoomBot;
+
+namespace {
+    bool check(bool ok, const std::string& what) {
+        std::cout << (ok ? "✓ " : "✗ ") << what << std::endl;
+        return ok;
+    }
+
+    // Every analyzer against the scalar one; the description of the first mismatch, or empty
+    std::string compare(const std::vector<int16_t>& pcm, size_t offset, size_t count, uint16_t channels) {
+        FrameFeatures expected = analyzeFrameScalar(pcm.data() + offset, count, channels);
+        for (const FrameAnalyzer& analyzer : frameAnalyzers()) {
+            FrameFeatures got = analyzer.analyze(pcm.data() + offset, count, channels);
+            if (got.energy != expected.energy || got.crossings != expected.crossings) {
+                return std::string(analyzer.name) + " differs at " + std::to_string(count) + " samples, " +
+                       std::to_string(channels) + " channels, offset " + std::to_string(offset) + ": energy " +
+                       std::to_string(got.energy) + " vs " + std::to_string(expected.energy) + ", crossings " +
+                       std::to_string(got.crossings) + " vs " + std::to_string(expected.crossings);
+            }
+        }
+        return std::string();
+    }
+
+    bool analyzerParity() {
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> any(-32768, 32767);
+        const size_t longest = 2000;
+        std::vector<std::vector<int16_t>> inputs(4, std::vector<int16_t>(longest + 4));
+        for (size_t i = 0; i < longest + 4; ++i) {
+            inputs[0][i] = static_cast<int16_t>(any(rng));
+            inputs[1][i] = -32768;                                          // largest squares
+            inputs[2][i] = i % 2 ? 32767 : -32768;                          // a crossing every sample
+            inputs[3][i] = static_cast<int16_t>(any(rng) % 3 == 0 ? 0 : any(rng) % 5);   // around zero
+        }
+
+        std::string mismatch;
+        size_t cases = 0;
+        for (const std::vector<int16_t>& pcm : inputs) {
+            for (uint16_t channels : {1, 2, 3, 6}) {
+                for (size_t offset = 0; offset < 4; ++offset) {
+                    for (size_t count = 0; count <= 100 && mismatch.empty(); ++count, ++cases) {
+                        mismatch = compare(pcm, offset, count, channels);
+                    }
+                    for (size_t count : {size_t(480), size_t(960), size_t(1920), size_t(1999), longest}) {
+                        if (mismatch.empty()) mismatch = compare(pcm, offset, count, channels);
+                        cases++;
+                    }
+                }
+            }
+        }
+
+        std::string names;
+        for (const FrameAnalyzer& analyzer : frameAnalyzers()) {
+            names += names.empty() ? analyzer.name : std::string(", ") + analyzer.name;
+        }
+        if (!mismatch.empty()) {
+            std::cout << "  " << mismatch << std::endl;
+        }
+        return check(mismatch.empty(), names + " agree on " + std::to_string(cases) + " frames (analyzeFrame uses " +
+                     frameAnalyzerName() + ")");
+    }
+
+    // Talk, pause, talk over a quiet noise floor, in 10 ms frames; the gate's output
+    // must cover the same timeline
+    bool markerTimeline(uint32_t rate, uint16_t channels) {
+        const std::string label = std::to_string(rate) + " Hz, " + std::to_string(channels) + " ch";
+        const size_t frameSamples = rate / 100;     // per channel
+        const std::vector<std::pair<bool, int>> script = {
+            {false, 1000}, {true, 800}, {false, 2500}, {true, 300}, {false, 150}, {true, 500}, {false, 3700}};
+
+        std::mt19937 rng(3);
+        std::normal_distribution<double> hiss(0.0, 20.0);
+        std::vector<std::vector<int16_t>> buffers;   // frames point into these
+        std::vector<bool> speech;
+        size_t total = 0;
+        for (const auto& part : script) {
+            for (int ms = 0; ms < part.second; ms += 10) {
+                std::vector<int16_t> pcm(frameSamples * channels);
+                for (size_t s = 0; s < frameSamples; ++s) {
+                    double t = static_cast<double>(total + s) / rate;
+                    double value = part.first ? 8000.0 * std::sin(2 * M_PI * 440.0 * t) : hiss(rng);
+                    for (uint16_t c = 0; c < channels; ++c) {
+                        pcm[s * channels + c] = static_cast<int16_t>(value);
+                    }
+                }
+                buffers.push_back(std::move(pcm));
+                speech.push_back(part.first);
+                total += frameSamples;
+            }
+        }
+
+        VoiceActivityConfig config;
+        config.enabled = true;
+        VoiceActivityGate gate(config, rate, channels);
+        std::vector<AudioFrameRef> out;
+        for (size_t f = 0; f < buffers.size(); ++f) {
+            AudioFrameRef frame = AudioFramePool::instance().acquire();
+            frame->attach(reinterpret_cast<const char*>(buffers[f].data()), buffers[f].size() * sizeof(int16_t), nullptr, nullptr);
+            frame->sampleRate = rate;
+            frame->channels = channels;
+            frame->captureTimeMs = static_cast<int64_t>(f) * 10;
+            gate.push(frame, out);
+        }
+        gate.flush(out);
+
+        // Walk the output: each item starts where the previous one ended
+        uint64_t position = 0;      // samples per channel
+        bool contiguous = true;
+        bool markersShort = true;
+        size_t markers = 0;
+        size_t speechOut = 0;
+        for (const AudioFrameRef& item : out) {
+            contiguous = contiguous && item->captureTimeMs == static_cast<int64_t>(position * 1000 / rate);
+            if (item->silentSamples > 0) {
+                markers++;
+                markersShort = markersShort && item->silentSamples <= rate;
+                position += item->silentSamples;
+            } else {
+                size_t f = static_cast<size_t>(item->captureTimeMs / 10);
+                speechOut += speech[f];
+                position += item->size() / (sizeof(int16_t) * channels);
+            }
+        }
+        size_t speechIn = 0;
+        for (bool s : speech) {
+            speechIn += s;
+        }
+
+        bool ok = true;
+        ok &= check(contiguous && position == total,
+                    label + ": markers and frames cover all " + std::to_string(total) + " samples in order");
+        ok &= check(markers > 0 && markersShort && gate.framesGated() > 0,
+                    label + ": " + std::to_string(markers) + " markers for " + std::to_string(gate.framesGated()) +
+                    " gated frames, none over a second");
+        ok &= check(speechOut == speechIn, label + ": every speech frame goes out");
+        return ok;
+    }
+}
+
+int main() {
+    std::cout << "=== Voice-activity gate test ===" << std::endl;
+    bool ok = analyzerParity();
+    ok &= markerTimeline(16000, 1);
+    ok &= markerTimeline(48000, 2);
+
+    if (!ok) {
+        std::cout << "✗ FAIL: voice-activity gate" << std::endl;
+        return 1;
+    }
+    std::cout << "✓ PASS: analyzers agree and silence markers keep the timeline" << std::endl;
+    return 0;
+}
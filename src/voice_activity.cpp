@@ -0,0 +1,281 @@
+#include "voice_activity.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define ZOOMBOT_VAD_X86 1
+#endif
+
+namespace ZoomBot {
+
+// ---------------- Frame analysis ----------------
+FrameFeatures analyzeFrameScalar(const int16_t* pcm, size_t count, uint16_t channels) {
+    FrameFeatures features;
+    for (size_t i = 0; i < count; ++i) {
+        features.energy += static_cast<uint64_t>(static_cast<int32_t>(pcm[i]) * pcm[i]);
+    }
+    for (size_t i = channels; i < count; ++i) {
+        features.crossings += (pcm[i] < 0) != (pcm[i - channels] < 0);
+    }
+    return features;
+}
+
+#ifdef ZOOMBOT_VAD_X86
+// madd of a sample with itself can reach 2^31 (two -32768s), so the pair sums
+// are widened as unsigned before they are added up
+static FrameFeatures analyzeFrameSSE2(const int16_t* pcm, size_t count, uint16_t channels) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i energy = zero;
+    __m128i crossings = zero;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pcm + i));
+        __m128i squares = _mm_madd_epi16(v, v);
+        energy = _mm_add_epi64(energy, _mm_unpacklo_epi32(squares, zero));
+        energy = _mm_add_epi64(energy, _mm_unpackhi_epi32(squares, zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), energy);
+    FrameFeatures features;
+    features.energy = lanes[0] + lanes[1];
+    for (; i < count; ++i) {
+        features.energy += static_cast<uint64_t>(static_cast<int32_t>(pcm[i]) * pcm[i]);
+    }
+
+    // A crossing is a sign bit that differs from the same channel's previous sample
+    i = channels;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pcm + i));
+        __m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pcm + i - channels));
+        __m128i differs = _mm_srai_epi16(_mm_xor_si128(v, previous), 15);
+        crossings = _mm_sub_epi32(crossings, _mm_madd_epi16(differs, ones));
+    }
+    uint32_t counts[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(counts), crossings);
+    features.crossings = counts[0] + counts[1] + counts[2] + counts[3];
+    for (; i < count; ++i) {
+        features.crossings += (pcm[i] < 0) != (pcm[i - channels] < 0);
+    }
+    return features;
+}
+
+__attribute__((target("avx2")))
+static FrameFeatures analyzeFrameAVX2(const int16_t* pcm, size_t count, uint16_t channels) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i energy = _mm256_setzero_si256();
+    __m256i crossings = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pcm + i));
+        __m256i squares = _mm256_madd_epi16(v, v);
+        energy = _mm256_add_epi64(energy, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(squares)));
+        energy = _mm256_add_epi64(energy, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(squares, 1)));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), energy);
+    FrameFeatures features;
+    features.energy = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < count; ++i) {
+        features.energy += static_cast<uint64_t>(static_cast<int32_t>(pcm[i]) * pcm[i]);
+    }
+
+    i = channels;
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pcm + i));
+        __m256i previous = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pcm + i - channels));
+        __m256i differs = _mm256_srai_epi16(_mm256_xor_si256(v, previous), 15);
+        crossings = _mm256_sub_epi32(crossings, _mm256_madd_epi16(differs, ones));
+    }
+    uint32_t counts[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(counts), crossings);
+    for (uint32_t c : counts) {
+        features.crossings += c;
+    }
+    for (; i < count; ++i) {
+        features.crossings += (pcm[i] < 0) != (pcm[i - channels] < 0);
+    }
+    return features;
+}
+#endif
+
+std::vector<FrameAnalyzer> frameAnalyzers() {
+    std::vector<FrameAnalyzer> analyzers;
+#ifdef ZOOMBOT_VAD_X86
+    if (__builtin_cpu_supports("avx2")) {
+        analyzers.push_back({&analyzeFrameAVX2, "avx2"});
+    }
+    analyzers.push_back({&analyzeFrameSSE2, "sse2"});   // always there on x86-64
+#endif
+    analyzers.push_back({&analyzeFrameScalar, "scalar"});
+    return analyzers;
+}
+
+namespace {
+    const FrameAnalyzer& analyzer() {
+        static const FrameAnalyzer picked = frameAnalyzers().front();
+        return picked;
+    }
+}
+
+FrameFeatures analyzeFrame(const int16_t* pcm, size_t count, uint16_t channels) {
+    return analyzer().analyze(pcm, count, channels);
+}
+
+const char* frameAnalyzerName() {
+    return analyzer().name;
+}
+
+// ---------------- VoiceActivityGate ----------------
+// Levels are mean energy per sample; a full-scale sample squared is 2^30
+static const double kFullScale = 32768.0 * 32768.0;
+// The floor doesn't go below about -70 dBFS, so digital silence keeps a sane threshold
+static const double kMinFloor = kFullScale * 1e-7;
+// Nothing under about -50 dBFS counts as speech, whatever the floor
+static const double kMinSpeech = kFullScale * 1e-5;
+// The floor drops to a quieter frame at once and rises towards louder ones this fast
+static const double kFloorRiseDbPerSecond = 1.5;
+// For the first seconds it rises faster: it starts low, so a stream that begins
+// with speech isn't gated, and has to find a noisy stream's level quickly
+static const double kStartupSeconds = 2.0;
+static const double kStartupRiseDbPerSecond = 10.0;
+// Within 6 dB of the threshold, a crossing rate this high is broadband noise, not a voice
+static const double kNoiseHeadroom = 4.0;
+static const double kNoiseCrossingRate = 0.4;
+// Longest stretch of silence one marker stands for
+static const uint32_t kMaxMarkerMs = 1000;
+// Frames the pre-roll ring starts with room for (10 ms frames, grows if they are shorter)
+static const uint32_t kTypicalFrameMs = 10;
+
+VoiceActivityGate::VoiceActivityGate(const VoiceActivityConfig& config, uint32_t sampleRate, uint16_t channels)
+    : sampleRate_(sampleRate), channels_(std::max<uint16_t>(1, channels)) {
+    hangoverSamples_ = static_cast<uint64_t>(sampleRate_) * config.hangoverMs / 1000;
+    prerollSamples_ = static_cast<uint64_t>(sampleRate_) * config.prerollMs / 1000;
+    maxMarkerSamples_ = std::max<uint64_t>(1, static_cast<uint64_t>(sampleRate_) * kMaxMarkerMs / 1000);
+    margin_ = std::pow(10.0, config.marginDb / 10.0);
+    preroll_.resize(config.prerollMs / kTypicalFrameMs + 2);
+}
+
+bool VoiceActivityGate::isSpeech(const AudioFrame& frame, uint64_t samples) {
+    size_t count = frame.size() / sizeof(int16_t);
+    if (count == 0) {
+        return false;
+    }
+    FrameFeatures features = analyzeFrame(reinterpret_cast<const int16_t*>(frame.data()), count, channels_);
+    double mean = static_cast<double>(features.energy) / count;
+    if (floor_ == 0) {
+        floor_ = std::max(std::min(mean, kMinSpeech / margin_), kMinFloor);
+    }
+
+    double threshold = std::max(floor_ * margin_, kMinSpeech);
+    bool speech = mean > threshold;
+    if (speech && mean < threshold * kNoiseHeadroom && count > channels_) {
+        speech = features.crossings <= kNoiseCrossingRate * (count - channels_);
+    }
+
+    // Minimum tracking: quiet frames pull the floor down, it only creeps back up
+    double seconds = sampleRate_ > 0 ? static_cast<double>(samples) / sampleRate_ : 0;
+    if (mean < floor_) {
+        floor_ = std::max(mean, kMinFloor);
+    } else {
+        double rise = elapsed_ < kStartupSeconds ? kStartupRiseDbPerSecond : kFloorRiseDbPerSecond;
+        floor_ = std::min(mean, floor_ * std::pow(10.0, rise * seconds / 10.0));
+    }
+    elapsed_ += seconds;
+    return speech;
+}
+
+void VoiceActivityGate::push(AudioFrameRef frame, std::vector<AudioFrameRef>& out) {
+    framesIn_++;
+    uint64_t samples = frame->size() / (sizeof(int16_t) * channels_);
+    if (isSpeech(*frame, samples)) {
+        if (!open_) {
+            // Onset: the silence so far, then the pre-roll, oldest first
+            emitSilence(out);
+            for (; prerollSize_ > 0; --prerollSize_) {
+                out.push_back(std::move(preroll_[prerollHead_]));
+                prerollHead_ = (prerollHead_ + 1) % preroll_.size();
+            }
+            prerollHeld_ = 0;
+            open_ = true;
+        }
+        sinceSpeech_ = 0;
+    } else if (open_) {
+        sinceSpeech_ += samples;
+        open_ = sinceSpeech_ <= hangoverSamples_;
+    }
+
+    if (open_) {
+        out.push_back(std::move(frame));
+    } else {
+        hold(std::move(frame), out);
+    }
+}
+
+void VoiceActivityGate::hold(AudioFrameRef&& frame, std::vector<AudioFrameRef>& out) {
+    if (prerollSamples_ == 0) {
+        gate(frame, out);
+        return;
+    }
+    if (prerollSize_ == preroll_.size()) {
+        // Shorter frames than expected; only happens once per stream
+        std::vector<AudioFrameRef> grown(preroll_.size() * 2);
+        for (size_t i = 0; i < prerollSize_; ++i) {
+            grown[i] = std::move(preroll_[(prerollHead_ + i) % preroll_.size()]);
+        }
+        preroll_.swap(grown);
+        prerollHead_ = 0;
+    }
+    prerollHeld_ += frame->size() / (sizeof(int16_t) * channels_);
+    preroll_[(prerollHead_ + prerollSize_++) % preroll_.size()] = std::move(frame);
+
+    // Keep just enough to cover prerollSamples_; older frames are gated for good
+    while (prerollSize_ > 1) {
+        AudioFrameRef& oldest = preroll_[prerollHead_];
+        uint64_t samples = oldest->size() / (sizeof(int16_t) * channels_);
+        if (prerollHeld_ - samples < prerollSamples_) break;
+        gate(oldest, out);
+        oldest.reset();
+        prerollHeld_ -= samples;
+        prerollHead_ = (prerollHead_ + 1) % preroll_.size();
+        prerollSize_--;
+    }
+}
+
+void VoiceActivityGate::gate(const AudioFrameRef& frame, std::vector<AudioFrameRef>& out) {
+    framesGated_++;
+    bytesGated_ += frame->size();
+    if (silentSamples_ == 0) {
+        silentSinceMs_ = frame->captureTimeMs;
+    }
+    silentSamples_ += frame->size() / (sizeof(int16_t) * channels_);
+    if (silentSamples_ >= maxMarkerSamples_) {
+        emitSilence(out);
+    }
+}
+
+void VoiceActivityGate::emitSilence(std::vector<AudioFrameRef>& out) {
+    if (silentSamples_ == 0) {
+        return;
+    }
+    AudioFrameRef marker = AudioFramePool::instance().acquire();
+    marker->sampleRate = sampleRate_;
+    marker->channels = channels_;
+    marker->captureTimeMs = silentSinceMs_;
+    marker->silentSamples = static_cast<uint32_t>(silentSamples_);
+    out.push_back(std::move(marker));
+    silentSamples_ = 0;
+}
+
+void VoiceActivityGate::flush(std::vector<AudioFrameRef>& out) {
+    for (; prerollSize_ > 0; --prerollSize_) {
+        gate(preroll_[prerollHead_], out);
+        preroll_[prerollHead_].reset();
+        prerollHead_ = (prerollHead_ + 1) % preroll_.size();
+    }
+    prerollHeld_ = 0;
+    emitSilence(out);
+}
+
+} // namespace ZoomBot
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "audio_frame.h"
+
+namespace ZoomBot {
+
+// Voice-activity gate for per-participant streams (ZOOM_BOT_VAD* variables)
+struct VoiceActivityConfig {
+    bool enabled = false;
+    uint32_t hangoverMs = 400;      // the gate stays open this long after the last speech frame
+    uint32_t prerollMs = 200;       // audio kept ahead of a speech onset
+    uint32_t marginDb = 9;          // frame energy above the noise floor that counts as speech
+};
+
+// Energy and zero crossings of a frame of interleaved 16-bit PCM
+struct FrameFeatures {
+    uint64_t energy = 0;            // sum of squares over every sample
+    uint32_t crossings = 0;         // sign changes between consecutive samples of a channel
+};
+
+// Picks the widest implementation the CPU has (AVX2, SSE2, scalar) on first use
+FrameFeatures analyzeFrame(const int16_t* pcm, size_t count, uint16_t channels);
+// The plain C++ version, for checking the vector ones against
+FrameFeatures analyzeFrameScalar(const int16_t* pcm, size_t count, uint16_t channels);
+// "avx2", "sse2" or "scalar"
+const char* frameAnalyzerName();
+
+struct FrameAnalyzer {
+    FrameFeatures (*analyze)(const int16_t* pcm, size_t count, uint16_t channels);
+    const char* name;
+};
+// Every implementation this build and CPU can run, widest first, scalar last
+std::vector<FrameAnalyzer> frameAnalyzers();
+
+/**
+ * Drops the silent stretches of one stream before it is written or streamed.
+ *
+ * A frame counts as speech when its energy is marginDb above the stream's
+ * noise floor (tracked from the quietest recent frames) and above an absolute
+ * minimum; frames that barely clear it with a noise-like zero-crossing rate
+ * (hiss, fans, keyboard) don't. Once speech stops the gate stays open for
+ * hangoverMs. While it is closed, frames wait in a prerollMs ring, so the
+ * start of the next utterance goes out with it; what falls out of the ring is
+ * replaced by a silence marker: a frame without data whose silentSamples say
+ * how much audio it stands for, with the capture time of the first of it.
+ * Markers cover at most about a second, so receivers see the stream advance.
+ *
+ * Owned by the capture worker; released frames and markers keep stream order.
+ */
+class VoiceActivityGate {
+public:
+    VoiceActivityGate(const VoiceActivityConfig& config, uint32_t sampleRate, uint16_t channels);
+
+    // Takes the stream's next frame and appends what is released by it to out
+    void push(AudioFrameRef frame, std::vector<AudioFrameRef>& out);
+    // The stream stops for now: the ring and the pending silence go out as a marker
+    void flush(std::vector<AudioFrameRef>& out);
+
+    bool open() const { return open_; }
+    uint64_t framesIn() const { return framesIn_; }
+    uint64_t framesGated() const { return framesGated_; }
+    uint64_t bytesGated() const { return bytesGated_; }
+
+private:
+    bool isSpeech(const AudioFrame& frame, uint64_t samples);
+    void hold(AudioFrameRef&& frame, std::vector<AudioFrameRef>& out);
+    void gate(const AudioFrameRef& frame, std::vector<AudioFrameRef>& out);
+    void emitSilence(std::vector<AudioFrameRef>& out);
+
+    uint32_t sampleRate_;
+    uint16_t channels_;
+    uint64_t hangoverSamples_;
+    uint64_t prerollSamples_;
+    uint64_t maxMarkerSamples_;
+    double margin_;                 // marginDb as an energy ratio
+    double floor_ = 0;              // mean energy per sample, 0 until the first frame
+    double elapsed_ = 0;            // seconds of audio the floor has tracked
+
+    bool open_ = false;
+    uint64_t sinceSpeech_ = 0;      // samples since the last speech frame
+
+    // Pre-roll ring, held while the gate is closed
+    std::vector<AudioFrameRef> preroll_;
+    size_t prerollHead_ = 0;
+    size_t prerollSize_ = 0;
+    uint64_t prerollHeld_ = 0;      // samples in the ring
+
+    // Gated audio not yet covered by a marker
+    uint64_t silentSamples_ = 0;
+    int64_t silentSinceMs_ = 0;
+
+    uint64_t framesIn_ = 0;
+    uint64_t framesGated_ = 0;
+    uint64_t bytesGated_ = 0;
+};
+
+} // namespace ZoomBot
@@ -1,55 +1,195 @@
+// Batch converter for raw .pcm recordings (sessions recorded before the bot
+// wrote WAV directly). Scans the given directories recursively, reads each
+// file's format from its name, and converts on a pool of worker threads with
+// copy_file_range, so the audio never passes through user space.
+
 #include <iostream>
-#include "../src/audio_raw_handler.h"
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pcm_convert.h"
+
+using namespace ZoomBot;
+
+namespace {
+    struct Options {
+        unsigned jobs = 0;
+        bool force = false;
+        bool deleteSource = false;
+        bool dryRun = false;
+    };
+
+    struct Task {
+        std::string pcmPath;
+        std::string wavPath;
+        PCMFormat format;
+    };
+
+    bool hasSuffix(const std::string& s, const std::string& suffix) {
+        return s.size() > suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    bool isRegularFile(const std::string& path, struct stat& st) {
+        return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+    }
+
+    void addFile(const std::string& pcmPath, const Options& opts, std::vector<Task>& tasks, size_t& skipped) {
+        Task task;
+        task.pcmPath = pcmPath;
+        task.wavPath = pcmPath.substr(0, pcmPath.size() - 4) + ".wav";
+
+        // Already converted by an earlier run
+        struct stat st{};
+        if (!opts.force && isRegularFile(task.wavPath, st)) {
+            ++skipped;
+            return;
+        }
+        if (!parsePCMFilename(pcmPath, task.format)) {
+            std::cerr << "No format in filename, assuming " << task.format.sampleRate << " Hz, "
+                      << task.format.channels << " ch: " << pcmPath << std::endl;
+        }
+        tasks.push_back(std::move(task));
+    }
+
+    void scan(const std::string& path, const Options& opts, std::vector<Task>& tasks, size_t& skipped) {
+        struct stat st{};
+        if (stat(path.c_str(), &st) != 0) {
+            std::cerr << "Cannot access " << path << ": " << std::strerror(errno) << std::endl;
+            return;
+        }
+        if (S_ISREG(st.st_mode)) {
+            if (hasSuffix(path, ".pcm")) addFile(path, opts, tasks, skipped);
+            return;
+        }
+        if (!S_ISDIR(st.st_mode)) return;
+
+        DIR* dir = opendir(path.c_str());
+        if (!dir) {
+            std::cerr << "Cannot open directory " << path << ": " << std::strerror(errno) << std::endl;
+            return;
+        }
+        std::vector<std::string> subdirs;
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            std::string name(entry->d_name);
+            if (name == "." || name == "..") continue;
+            std::string child = path + "/" + name;
+            if (hasSuffix(name, ".pcm") && isRegularFile(child, st)) {
+                addFile(child, opts, tasks, skipped);
+            } else if (stat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+                subdirs.push_back(child);
+            }
+        }
+        closedir(dir);
+        for (const auto& sub : subdirs) {
+            scan(sub, opts, tasks, skipped);
+        }
+    }
+
+    void usage(const char* prog) {
+        std::cout << "Usage: " << prog << " [options] <directory|file.pcm>..." << std::endl;
+        std::cout << "  -j N        worker threads (default: number of CPUs)" << std::endl;
+        std::cout << "  --force     reconvert files that already have a .wav" << std::endl;
+        std::cout << "  --delete    remove each .pcm after it was converted" << std::endl;
+        std::cout << "  --dry-run   only list what would be converted" << std::endl;
+        std::cout << "Example: " << prog << " -j 8 ./recordings" << std::endl;
+    }
+}
 
 int main(int argc, char* argv[]) {
     std::cout << "WAV Conversion Utility for Zoom Bot Recordings\n" << std::endl;
-    
-    if (argc != 2) {
-        std::cout << "Usage: " << argv[0] << " <recordings_directory>" << std::endl;
-        std::cout << "Example: " << argv[0] << " ./recordings/20250924_170906" << std::endl;
+
+    Options opts;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) opts.jobs = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (arg.compare(0, 2, "-j") == 0 && arg.size() > 2) opts.jobs = static_cast<unsigned>(std::atoi(arg.c_str() + 2));
+        else if (arg == "--force") opts.force = true;
+        else if (arg == "--delete") opts.deleteSource = true;
+        else if (arg == "--dry-run") opts.dryRun = true;
+        else if (arg == "-h" || arg == "--help") { usage(argv[0]); return 0; }
+        else paths.push_back(arg);
+    }
+    if (paths.empty()) {
+        usage(argv[0]);
         return 1;
     }
-    
-    std::string recordingsDir = argv[1];
-    std::cout << "Converting PCM files in directory: " << recordingsDir << std::endl;
-    
-    // Create a temporary AudioRawHandler just for the conversion utility
-    ZoomBot::AudioRawHandler handler;
-    
-    // Manually set the output directory for conversion
-    // We'll need to make outDir_ accessible or create a static method
-    
-    // For now, let's test with individual file conversions
-    std::cout << "Testing WAV conversion functionality..." << std::endl;
-    
-    // Test conversion of a few common formats
-    bool success1 = ZoomBot::AudioRawHandler::convertPCMToWAV(
-        recordingsDir + "/mixed_32000Hz_1ch.pcm",
-        recordingsDir + "/mixed_32000Hz_1ch.wav",
-        32000, 1, 16
-    );
-    
-    bool success2 = ZoomBot::AudioRawHandler::convertPCMToWAV(
-        recordingsDir + "/user_16778240_Cory_Brightman_32000Hz_1ch.pcm",
-        recordingsDir + "/user_16778240_Cory_Brightman_32000Hz_1ch.wav",
-        32000, 1, 16
-    );
-    
-    bool success3 = ZoomBot::AudioRawHandler::convertPCMToWAV(
-        recordingsDir + "/user_16784384_MyBot_32000Hz_1ch.pcm",
-        recordingsDir + "/user_16784384_MyBot_32000Hz_1ch.wav",
-        32000, 1, 16
-    );
-    
-    int totalConverted = (success1 ? 1 : 0) + (success2 ? 1 : 0) + (success3 ? 1 : 0);
-    std::cout << "\nConversion complete! Successfully converted " << totalConverted << " files." << std::endl;
-    
-    if (totalConverted > 0) {
-        std::cout << "You can now play the WAV files with any audio player:" << std::endl;
-        std::cout << "  vlc " << recordingsDir << "/*.wav" << std::endl;
-        std::cout << "  mpv " << recordingsDir << "/mixed_32000Hz_1ch.wav" << std::endl;
-        std::cout << "  aplay " << recordingsDir << "/mixed_32000Hz_1ch.wav" << std::endl;
-    }
-    
-    return 0;
-}
\ No newline at end of file
+
+    std::vector<Task> tasks;
+    size_t skipped = 0;
+    for (const auto& path : paths) {
+        scan(path, opts, tasks, skipped);
+    }
+    std::cout << "Found " << tasks.size() << " PCM files to convert"
+              << (skipped ? " (" + std::to_string(skipped) + " already converted)" : "") << std::endl;
+    if (opts.dryRun) {
+        for (const auto& t : tasks) {
+            std::cout << "  " << t.pcmPath << " (" << t.format.sampleRate << " Hz, " << t.format.channels << " ch)" << std::endl;
+        }
+        return 0;
+    }
+    if (tasks.empty()) return 0;
+
+    unsigned jobs = opts.jobs ? opts.jobs : std::max(1u, std::thread::hardware_concurrency());
+    if (jobs > tasks.size()) jobs = static_cast<unsigned>(tasks.size());
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> converted{0};
+    std::atomic<size_t> failed{0};
+    std::atomic<size_t> fallbacks{0};
+    std::atomic<uint64_t> bytes{0};
+    std::mutex logMtx;
+    auto start = std::chrono::steady_clock::now();
+
+    auto worker = [&] {
+        for (size_t i = next++; i < tasks.size(); i = next++) {
+            const Task& t = tasks[i];
+            ConvertResult result;
+            bool ok = convertPCMToWAV(t.pcmPath, t.wavPath, t.format, result);
+            if (ok) {
+                converted++;
+                bytes += result.dataBytes;
+                if (result.method == CopyMethod::ReadWrite) fallbacks++;
+                if (opts.deleteSource) unlink(t.pcmPath.c_str());
+            } else {
+                failed++;
+            }
+            std::lock_guard<std::mutex> lk(logMtx);
+            if (ok) {
+                std::cout << "Converted " << t.pcmPath << " (" << t.format.sampleRate << " Hz, "
+                          << t.format.channels << " channels, " << result.dataBytes << " bytes)" << std::endl;
+            } else {
+                std::cerr << "Failed " << t.pcmPath << ": " << result.error << std::endl;
+            }
+        }
+    };
+
+    std::cout << "Converting with " << jobs << " threads..." << std::endl;
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < jobs; ++i) {
+        pool.emplace_back(worker);
+    }
+    for (auto& th : pool) {
+        th.join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "\nConversion complete! Converted " << converted << " files, " << failed << " failed, "
+              << std::fixed << std::setprecision(1) << bytes / (1024.0 * 1024.0) << " MB in "
+              << seconds << " s" << std::endl;
+    if (fallbacks > 0) {
+        std::cout << fallbacks << " files were copied in user space (copy_file_range not supported there)" << std::endl;
+    }
+    return failed > 0 ? 2 : 0;
+}
@@ -0,0 +1,52 @@
+#include "wav_file.h"
+
+namespace ZoomBot {
+
+static_assert(kWAVHeaderSize <= DiskWriter::kMaxPatch, "header updates must fit in one patch");
+
+WavFile::WavFile(DiskWriter& writer, const std::string& path,
+                 uint32_t sampleRate, uint16_t channels, uint16_t bitsPerSample)
+    : pcm_(writer, path), sampleRate_(sampleRate), channels_(channels), bitsPerSample_(bitsPerSample),
+      lastPatch_(std::chrono::steady_clock::now()) {
+    if (!pcm_.good()) return;
+    if (pcm_.size() == 0) {
+        // New file: the placeholder header rides along with the first buffer
+        char header[kWAVHeaderSize];
+        headerFor(kWAVHeaderSize, header);
+        pcm_.write(header, sizeof(header));
+    }
+    // Otherwise a resumed stream is appending to a file that already has its header
+    patchedSize_ = pcm_.size();
+}
+
+WavFile::~WavFile() {
+    close();
+}
+
+void WavFile::close() {
+    if (!pcm_.good()) return;
+    char header[kWAVHeaderSize];
+    headerFor(pcm_.size(), header);
+    pcm_.close(0, header, sizeof(header));
+}
+
+void WavFile::flushIfStale(std::chrono::steady_clock::time_point now) {
+    pcm_.flushIfStale(now);
+
+    // Describe only what the writer already has, so the header never runs ahead of the data
+    uint64_t queued = pcm_.queuedSize();
+    if (queued > kWAVHeaderSize && queued != patchedSize_ &&
+        now - lastPatch_ >= std::chrono::milliseconds(pcm_.writer().config().headerUpdateMs)) {
+        char header[kWAVHeaderSize];
+        headerFor(queued, header);
+        pcm_.patch(0, header, sizeof(header));
+        patchedSize_ = queued;
+        lastPatch_ = now;
+    }
+}
+
+void WavFile::headerFor(uint64_t fileSize, char* out) const {
+    makeWAVHeader(out, kWAVHeaderSize, sampleRate_, channels_, bitsPerSample_, fileSize - kWAVHeaderSize);
+}
+
+} // namespace ZoomBot
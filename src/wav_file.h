@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+#include "pcm_file.h"
+#include "recording_file.h"
+#include "wav_format.h"
+
+namespace ZoomBot {
+
+/**
+ * Recording written as a playable WAV from the first byte.
+ *
+ * A placeholder header goes out with the first buffer; the sizes are patched
+ * in place every headerUpdateMs and once more on close, so finalizing a file
+ * costs one small write no matter how long the meeting ran. Past 4 GiB the
+ * same header is rewritten as RF64.
+ */
+class WavFile : public RecordingFile {
+public:
+    WavFile(DiskWriter& writer, const std::string& path,
+            uint32_t sampleRate, uint16_t channels, uint16_t bitsPerSample = 16);
+    ~WavFile() override;   // close()
+
+    bool good() const override { return pcm_.good(); }
+    void write(const char* data, size_t len) override { pcm_.write(data, len); }
+    void flushIfStale(std::chrono::steady_clock::time_point now) override;
+    void close() override;
+    bool closed() const override { return pcm_.closed(); }
+
+    uint64_t dataBytes() const override { return pcm_.size() - kWAVHeaderSize; }
+    uint64_t droppedBytes() const override { return pcm_.droppedBytes(); }
+
+private:
+    void headerFor(uint64_t fileSize, char* out) const;
+
+    PCMFile pcm_;
+    uint32_t sampleRate_;
+    uint16_t channels_;
+    uint16_t bitsPerSample_;
+    uint64_t patchedSize_ = 0;          // file size the on-disk header describes
+    std::chrono::steady_clock::time_point lastPatch_;
+};
+
+} // namespace ZoomBot
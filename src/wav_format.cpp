@@ -0,0 +1,98 @@
+#include "wav_format.h"
+#include <cctype>
+#include <stdexcept>
+#include <cstring>
+
+namespace ZoomBot {
+
+static void put16(char* p, uint16_t v) { std::memcpy(p, &v, 2); }
+static void put32(char* p, uint32_t v) { std::memcpy(p, &v, 4); }
+static void put64(char* p, uint64_t v) { std::memcpy(p, &v, 8); }
+
+bool makeWAVHeader(char* out, uint32_t dataOffset, uint32_t sampleRate, uint16_t channels,
+                   uint16_t bitsPerSample, uint64_t dataBytes) {
+    const uint32_t padding = dataOffset - kWAVHeaderSize;
+    if (dataOffset < kWAVHeaderSize || (padding > 0 && (padding < 8 || padding % 2 != 0))) {
+        return false;
+    }
+    const uint16_t blockAlign = static_cast<uint16_t>(channels * (bitsPerSample / 8));
+    const uint64_t riffSize = dataOffset - 8 + dataBytes;
+    const bool rf64 = riffSize > 0xFFFFFFFFull;
+
+    // RIFF header; RF64 files carry 0xFFFFFFFF here and the real sizes in ds64
+    std::memcpy(out, rf64 ? "RF64" : "RIFF", 4);
+    put32(out + 4, rf64 ? 0xFFFFFFFFu : static_cast<uint32_t>(riffSize));
+    std::memcpy(out + 8, "WAVE", 4);
+
+    // ds64, or JUNK of the same size for ordinary files
+    std::memcpy(out + 12, rf64 ? "ds64" : "JUNK", 4);
+    put32(out + 16, 28);
+    std::memset(out + 20, 0, 28);
+    if (rf64) {
+        put64(out + 20, riffSize);
+        put64(out + 28, dataBytes);
+        put64(out + 36, blockAlign ? dataBytes / blockAlign : 0);
+    }
+
+    // fmt chunk
+    std::memcpy(out + 48, "fmt ", 4);
+    put32(out + 52, 16);
+    put16(out + 56, 1);     // PCM
+    put16(out + 58, channels);
+    put32(out + 60, sampleRate);
+    put32(out + 64, sampleRate * blockAlign);
+    put16(out + 68, blockAlign);
+    put16(out + 70, bitsPerSample);
+
+    if (padding > 0) {
+        std::memcpy(out + 72, "JUNK", 4);
+        put32(out + 76, padding - 8);
+        std::memset(out + 80, 0, padding - 8);
+    }
+
+    // data chunk header right before the audio
+    std::memcpy(out + dataOffset - 8, "data", 4);
+    put32(out + dataOffset - 4, rf64 ? 0xFFFFFFFFu : static_cast<uint32_t>(dataBytes));
+    return true;
+}
+
+bool parsePCMFilename(const std::string& filename, PCMFormat& format) {
+    // Strip directory and extension
+    std::string baseName = filename;
+    size_t slash = baseName.find_last_of('/');
+    if (slash != std::string::npos) baseName = baseName.substr(slash + 1);
+    size_t dot = baseName.find_last_of('.');
+    if (dot != std::string::npos) baseName = baseName.substr(0, dot);
+
+    // Expected format: mixed_48000Hz_2ch or user_12345_DisplayName_48000Hz_1ch
+    size_t hzPos = baseName.rfind("Hz_");
+    if (hzPos == std::string::npos) return false;
+    size_t chPos = baseName.find("ch", hzPos);
+    if (chPos == std::string::npos) return false;
+
+    // Find start of sample rate (work backwards from Hz)
+    size_t rateStart = hzPos;
+    while (rateStart > 0 && std::isdigit(static_cast<unsigned char>(baseName[rateStart - 1]))) {
+        rateStart--;
+    }
+    if (rateStart < hzPos) {
+        try {
+            format.sampleRate = static_cast<uint32_t>(std::stoul(baseName.substr(rateStart, hzPos - rateStart)));
+        } catch (const std::exception&) {
+            // Keep default on parse error
+        }
+    }
+
+    // Extract channels (should be right after Hz_)
+    size_t chStart = hzPos + 3; // Skip "Hz_"
+    if (chStart < chPos) {
+        try {
+            format.channels = static_cast<uint16_t>(std::stoul(baseName.substr(chStart, chPos - chStart)));
+        } catch (const std::exception&) {
+            // Keep default on parse error
+        }
+    }
+    return true;
+}
+
+} // namespace ZoomBot
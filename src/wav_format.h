@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace ZoomBot {
+
+// Header size without padding: RIFF/WAVE, a 28-byte chunk reserved for ds64,
+// fmt, then the data chunk header. Audio starts right after it.
+static const uint32_t kWAVHeaderSize = 80;
+
+/**
+ * Writes the header for dataBytes of audio starting at dataOffset into out
+ * (dataOffset bytes). The chunk after WAVE is JUNK while every size fits in
+ * 32 bits and becomes ds64 once the file outgrows 4 GiB (RF64, EBU Tech 3306),
+ * so a growing file switches format by rewriting its header in place.
+ * Room beyond kWAVHeaderSize is filled with a second JUNK chunk, which lets
+ * the audio start on a block boundary. Returns false if dataOffset cannot be
+ * padded that way.
+ */
+bool makeWAVHeader(char* out, uint32_t dataOffset, uint32_t sampleRate, uint16_t channels,
+                   uint16_t bitsPerSample, uint64_t dataBytes);
+
+struct PCMFormat {
+    uint32_t sampleRate = 48000;
+    uint16_t channels = 2;
+    uint16_t bitsPerSample = 16;
+};
+
+// Reads the format from a recording name such as mixed_48000Hz_2ch.pcm or
+// user_12345_DisplayName_32000Hz_1ch.pcm. Fields that cannot be parsed keep
+// the defaults; returns false if the name has no format at all.
+bool parsePCMFilename(const std::string& filename, PCMFormat& format);
+
+} // namespace ZoomBot